@@ -20,6 +20,8 @@ HEADERS += \
 FORMS -= \
     mainwindow.ui
 
+include(Hgt/Hgt.pri)
+
 # Default rules for deployment.
 qnx: target.path = /tmp/$${TARGET}/bin
 else: unix:!android: target.path = /opt/$${TARGET}/bin
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <QList>
+#include <QVector>
+#include <QPointF>
+#include "../HgtLoader.h"
+
+class QThreadPool;
+
+struct ContourLine {
+	double level = 0.0;
+	//lon,lat, a closed line repeats its first point at the end
+	QVector<QPointF> points;
+	bool closed = false;
+};
+
+/**
+ * @brief contour lines with marching squares over the sample grid.
+ * Tiles are split into blocks of cells that run in parallel, blocks whose min/max no level crosses are skipped.
+ * Crossings are identified by the grid edge they lie on, which is the same in both neighbouring blocks or tiles,
+ * so segments are stitched into polylines across block and tile boundaries.
+ * Cells with a void corner are skipped, lines end there.
+ */
+class ContourGenerator
+{
+public:
+	explicit ContourGenerator(HgtLoader* loader);
+
+	//default is QThreadPool::globalInstance()
+	void setThreadPool(QThreadPool* threadPool);
+	//cells per block side
+	void setBlockSize(const int blockSize);
+
+	QList<ContourLine> generate(const double minLon, const double maxLon, const double minLat, const double maxLat,
+								const QVector<double>& levels);
+	/**
+	 * @brief levels base + k*interval between the lowest and highest sample of the area
+	 */
+	QList<ContourLine> generate(const double minLon, const double maxLon, const double minLat, const double maxLat,
+								const double interval, const double base = 0.0);
+
+private:
+	QList<ContourLine> generate(const double minLon, const double maxLon, const double minLat, const double maxLat,
+								const QVector<double>& levels, const double interval, const double base);
+
+private:
+	HgtLoader* m_loader = nullptr;
+	QThreadPool* m_threadPool = nullptr;
+	int m_blockSize = 128;
+};
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <QList>
+#include <QVector>
+#include <QPointF>
+#include "../HgtLoader.h"
+
+class QThreadPool;
+
+struct DesignPoint {
+	double lon = 0.0;
+	double lat = 0.0;
+	double elevation = 0.0;
+};
+
+/**
+ * @brief design surface for earthworks: a plane z = z0 + a*lon + b*lat or a TIN.
+ * The plane is linear in degrees, which is accurate enough for construction sites but not for whole tiles.
+ */
+class DesignSurface
+{
+public:
+	DesignSurface() {}
+
+	static DesignSurface horizontal(const double elevation);
+	//plane through three points, invalid if they are collinear
+	static DesignSurface plane(const DesignPoint& p1, const DesignPoint& p2, const DesignPoint& p3);
+	/**
+	 * @brief triangulated surface, every three indices of triangles make one triangle
+	 */
+	static DesignSurface tin(const QVector<DesignPoint>& vertices, const QVector<int>& triangles);
+
+	bool isValid() const {return m_type != Type::Invalid;}
+	bool isPlane() const {return m_type == Type::Plane;}
+
+	/**
+	 * @brief elevation of the surface, false outside of the TIN
+	 * @param triangleHint: last triangle found, speeds up lookups of neighbouring points (TIN only)
+	 */
+	bool elevation(double& z, const double lon, const double lat, int* triangleHint = nullptr) const;
+
+	//plane coefficients
+	double z0() const {return m_z0;}
+	double dzdLon() const {return m_dzdLon;}
+	double dzdLat() const {return m_dzdLat;}
+
+private:
+	bool triangleElevation(double& z, const int triangle, const double lon, const double lat) const;
+	void buildIndex();
+
+private:
+	enum class Type {
+		Invalid,
+		Plane,
+		Tin
+	};
+	Type m_type = Type::Invalid;
+
+	double m_z0 = 0.0;
+	double m_dzdLon = 0.0;
+	double m_dzdLat = 0.0;
+
+	QVector<DesignPoint> m_vertices;
+	QVector<int> m_triangles;
+	//uniform grid over the TIN's bounding box, each cell lists the triangles overlapping it
+	double m_indexLon = 0.0;
+	double m_indexLat = 0.0;
+	double m_indexCellSize = 1.0;
+	int m_indexCols = 0;
+	int m_indexRows = 0;
+	QVector<QVector<int>> m_index;
+};
+
+/**
+ * @brief volume between the DEM and the design surface inside a polygon.
+ * Cut is terrain above the design, fill is terrain below it.
+ */
+struct CutFillResult {
+	double cutVolume = 0.0;   //m^3
+	double fillVolume = 0.0;  //m^3
+	double cutArea = 0.0;     //m^2
+	double fillArea = 0.0;    //m^2
+	double area = 0.0;        //m^2, samples with valid terrain and design elevation
+	qint64 count = 0;
+	qint64 voidCount = 0;
+	//samples inside the polygon but outside of the TIN
+	qint64 outsideDesignCount = 0;
+	int missingTiles = 0;
+
+	double netVolume() const {return cutVolume - fillVolume;}
+};
+
+/**
+ * @brief every sample stands for a cell of one sample spacing, its area follows the WGS84 ellipsoid
+ * at the sample's latitude. Tiles are processed in parallel on a thread pool, rows are accumulated
+ * with branch-free loops the compiler vectorizes.
+ */
+class CutFillVolume
+{
+public:
+	explicit CutFillVolume(HgtLoader* loader);
+
+	//default is QThreadPool::globalInstance()
+	void setThreadPool(QThreadPool* threadPool);
+
+	CutFillResult compute(const QList<QPointF>& polygon, const DesignSurface& design);
+
+	/**
+	 * @brief area of a cell of dLon x dLat degrees centred at lat, in m^2 (WGS84)
+	 */
+	static double cellArea(const double lat, const double dLon, const double dLat);
+
+private:
+	HgtLoader* m_loader = nullptr;
+	QThreadPool* m_threadPool = nullptr;
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <QPoint>
+#include <QString>
+#include "../HgtLoader.h"
+
+class QThreadPool;
+
+/**
+ * @brief samples of a rectangle of whole tiles, seams shared by the neighbouring tiles are stored once.
+ * Rows run from north to south, cell (col,row) is at lon = left + col/pixPerDeg, lat = top - row/pixPerDeg.
+ */
+struct HydrologyGrid {
+	//of the south-western tile
+	QPoint leftBottomCorner;
+	int tilesLon = 0;
+	int tilesLat = 0;
+	int pixPerDeg = 0;
+
+	bool isValid() const {return tilesLon > 0 && tilesLat > 0 && pixPerDeg > 0;}
+	int cols() const {return tilesLon*pixPerDeg + 1;}
+	int rows() const {return tilesLat*pixPerDeg + 1;}
+	qint64 cellCount() const {return qint64(cols())*rows();}
+	double lon(const int col) const {return leftBottomCorner.x() + double(col)/pixPerDeg;}
+	double lat(const int row) const {return leftBottomCorner.y() + tilesLat - double(row)/pixPerDeg;}
+};
+
+/**
+ * @brief products of Hydrology::compute(), native-endian rasters of grid.cols()*grid.rows() values row by row:
+ * filled - float32, elevations with the depressions filled, NaN for voids;
+ * direction - uint8, D8 code of the downslope neighbour 1 E, 2 SE, 4 S, 8 SW, 16 W, 32 NW, 64 N, 128 NE, 0 for outlets;
+ * accumulation - uint32, cells draining through the cell including itself, 0 for voids.
+ */
+struct HydrologyResult {
+	HydrologyGrid grid;
+	QString filledPath;
+	QString directionPath;
+	QString accumulationPath;
+
+	//rounds of halo exchange until the tiles agreed
+	int fillRounds = 0;
+	int accumulationRounds = 0;
+	//cells of the depressions raised by the filling, not the flats that only got the gradient
+	//(unless it grows over a metre, flats thousands of cells long at high altitude)
+	qint64 filledCells = 0;
+	quint32 maxAccumulation = 0;
+};
+
+/**
+ * @brief depression filling, D8 flow direction and flow accumulation over a mosaic of tiles.
+ * Every tile is a block processed by its own job, blocks meet at the tile seams and exchange a halo of one cell
+ * between rounds until nothing changes. The filling is a priority flood (Barnes et al.) seeded by the mosaic edge,
+ * voids and the halo; flats get a gradient of one float step per cell so every cell but the outlets drains.
+ * Accumulation is summed inside each block in topological order, flow leaving a block is passed on through its
+ * neighbour's halo. The rasters are memory-mapped files, a job holds only the elevations of its tile, so the
+ * mosaic does not have to fit in RAM. Voids and missing tiles are outlets.
+ */
+class Hydrology
+{
+public:
+	explicit Hydrology(HgtLoader* loader);
+
+	//default is QThreadPool::globalInstance()
+	void setThreadPool(QThreadPool* threadPool);
+
+	/**
+	 * @brief computes the tiles covering the rectangle, the rasters are created or overwritten in directory.
+	 * All tiles must have the same resolution
+	 */
+	bool compute(HydrologyResult& result, const QString& directory,
+				 const double minLon, const double maxLon, const double minLat, const double maxLat);
+
+private:
+	HgtLoader* m_loader = nullptr;
+	QThreadPool* m_threadPool = nullptr;
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <QVector>
+#include <QPointF>
+#include "../HgtLoader.h"
+
+struct CostPathResult {
+	//lon,lat of the cells from the start to the end at full DEM resolution
+	QVector<QPointF> path;
+	//NaN for voids
+	QVector<float> elevations;
+
+	double cost = 0.0;
+	//metres along the path, ascent and descent over it
+	double length = 0.0;
+	double climb = 0.0;
+	double descent = 0.0;
+
+	//cells taken from the open set over all levels, levels searched, memory of the largest level
+	qint64 expandedCells = 0;
+	int levels = 0;
+	qint64 peakMemory = 0;
+
+	bool isValid() const {return !path.isEmpty();}
+};
+
+/**
+ * @brief cheapest ground path between two points over the DEM grid, A* on 8 neighbours.
+ * A step of length d (metres) climbing dz costs d + climbWeight*max(dz,0) + descentWeight*max(-dz,0),
+ * steps steeper than maxSlope are impassable, voids count as flat and missing tiles as impassable.
+ *
+ * The search runs coarse to fine: cells of the coarser levels are block means of 4^n x 4^n samples, the coarsest
+ * level covers the box around the two points, every finer level only the corridor around the path of the level
+ * above. Tiles are read lazily through TileHandles, per-cell state lives in 64x64 blocks that are allocated
+ * when the search reaches them, so memory follows the corridor and stops at setMaxMemory(), which also covers
+ * the open set. The open set is a radix heap, the heuristic is the flat distance to the goal (steps through voids
+ * climb for free, so no climb can be counted on). Coarse cells average the tiles that exist, a level that finds
+ * no path leaves the next finer one to search the whole box.
+ */
+class LeastCostPath
+{
+public:
+	explicit LeastCostPath(HgtLoader* loader);
+
+	//cost of one metre of ascent in metres of flat ground, default 8
+	void setClimbWeight(const double weight);
+	//default 0
+	void setDescentWeight(const double weight);
+	//degrees, default 40
+	void setMaxSlope(const double degrees);
+	//half width of the corridor around a coarser path in its cells, default 6
+	void setCorridor(const int cells);
+	//the search fails when a level needs more, default 256 MB
+	void setMaxMemory(const qint64 bytes);
+
+	bool find(CostPathResult& result, const QPointF& from, const QPointF& to);
+
+private:
+	HgtLoader* m_loader = nullptr;
+	double m_climbWeight = 8.0;
+	double m_descentWeight = 0.0;
+	double m_maxSlope = 40.0;
+	int m_corridor = 6;
+	qint64 m_maxMemory = qint64(256) << 20;
+};
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <QList>
+#include <QVector>
+#include <QPoint>
+#include <QPointF>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <QFutureSynchronizer>
+#include <QDebug>
+#include <algorithm>
+#include "../HgtLoader.h"
+#include "../Geo/PolygonRaster.h"
+
+/**
+ * @brief one tile touched by one polygon
+ */
+struct PolygonTile {
+	int polygonIndex = 0;
+	QPoint leftBottomCorner;
+	//the tile could not be loaded or has an unknown format, it got no spans
+	bool missing = false;
+};
+
+/**
+ * @brief samples of one span inside the polygon, values[i] is sample (colBegin + i, row)
+ */
+struct PolygonSpanRow {
+	QPoint leftBottomCorner;
+	int pixPerDeg = 0;
+	int row = 0;
+	int colBegin = 0;
+	int count = 0;
+	const qint16* values = nullptr;
+
+	double degPerPix() const {return 1.0/pixPerDeg;}
+	double lat() const {return leftBottomCorner.y() + 1 - double(row)/pixPerDeg;}
+	double lon(const int i) const {return leftBottomCorner.x() + double(colBegin + i)/pixPerDeg;}
+};
+
+/**
+ * @brief polygon -> covered tiles -> masked spans. Every (polygon, tile) pair is one job on the thread pool,
+ * the samples inside the polygon are read as contiguous spans and passed to a callback.
+ * Samples on a tile's northern row and eastern column belong to the neighbour tiles and are skipped,
+ * so shared edges are visited once.
+ */
+class PolygonTileWalk
+{
+public:
+	//(polygon, tile) pairs in polygon order
+	static QVector<PolygonTile> coveredTiles(const QList<QList<QPointF>>& polygons);
+
+	/**
+	 * @brief calls onSpan(tileIndex, const PolygonSpanRow&) for every span of every tile, spans of one tile
+	 * come from one thread in row order. Marks the tiles that could not be read as missing.
+	 */
+	template<typename Func>
+	static void walk(QVector<PolygonTile>& tiles, HgtLoader* loader, QThreadPool* threadPool,
+					 const QList<QList<QPointF>>& polygons, Func onSpan);
+
+private:
+	template<typename Func>
+	static void walkTile(const int tileIndex, PolygonTile& tile, HgtLoader* loader, const QList<QPointF>& polygon, Func& onSpan);
+};
+
+inline QVector<PolygonTile> PolygonTileWalk::coveredTiles(const QList<QList<QPointF>>& polygons)
+{
+	QVector<PolygonTile> retVal;
+	for (int i = 0; i < polygons.size(); ++i) {
+		for (const QPoint& corner : Geo::PolygonRaster::coveredTiles(polygons.at(i))) {
+			PolygonTile tile;
+			tile.polygonIndex = i;
+			tile.leftBottomCorner = corner;
+			retVal.append(tile);
+		}
+	}
+	return retVal;
+}
+
+template<typename Func>
+void PolygonTileWalk::walk(QVector<PolygonTile>& tiles, HgtLoader* loader, QThreadPool* threadPool,
+						   const QList<QList<QPointF>>& polygons, Func onSpan)
+{
+	QFutureSynchronizer<void> synchronizer;
+	for (int i = 0; i < tiles.size(); ++i) {
+		PolygonTile* tile = &tiles[i];
+		const QList<QPointF>* polygon = &polygons.at(tile->polygonIndex);
+		Func* func = &onSpan;
+		synchronizer.addFuture(QtConcurrent::run(threadPool, [i, tile, loader, polygon, func]() {
+			walkTile(i, *tile, loader, *polygon, *func);
+		}));
+	}
+	synchronizer.waitForFinished();
+}
+
+template<typename Func>
+void PolygonTileWalk::walkTile(const int tileIndex, PolygonTile& tile, HgtLoader* loader, const QList<QPointF>& polygon, Func& onSpan)
+{
+	TileHandle handle;
+	if (!loader->getTileHandle(handle, tile.leftBottomCorner.x() + 0.5, tile.leftBottomCorner.y() + 0.5)) {
+		tile.missing = true;
+		return;
+	}
+
+	const QVector<Geo::SampleSpan> spans = loader->getPolygonMask(polygon, handle);
+	bool known = loader->visitTileView(handle, [&](const auto& view) {
+		const int sideSize = view.SIDE_SIZE;
+		QVector<qint16> values(sideSize);
+		PolygonSpanRow row;
+		row.leftBottomCorner = tile.leftBottomCorner;
+		row.pixPerDeg = view.PIX_PER_DEG;
+		row.values = values.constData();
+
+		for (const Geo::SampleSpan& span : spans) {
+			if (span.row == 0) continue;
+			int colEnd = std::min(span.colEnd, sideSize - 1);
+			int count = colEnd - span.colBegin;
+			if (count <= 0) continue;
+
+			view.readRow(values.data(), span.row, span.colBegin, count);
+			row.row = span.row;
+			row.colBegin = span.colBegin;
+			row.count = count;
+			onSpan(tileIndex, row);
+		}
+	});
+
+	if (!known) {
+		qDebug() << QString("PolygonTileWalk.walkTile. Unknown tile format lon=%1, lat=%2.").arg(tile.leftBottomCorner.x()).arg(tile.leftBottomCorner.y());
+		tile.missing = true;
+	}
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <QVector>
+#include <QPointF>
+#include <limits>
+#include "../HgtLoader.h"
+
+class QThreadPool;
+
+struct RadioLink {
+	//lon,lat of the antennas
+	QPointF from;
+	QPointF to;
+	//antenna heights above the terrain, metres
+	double fromHeight = 0.0;
+	double toHeight = 0.0;
+};
+
+/**
+ * @brief profile of a radio path as arrays for plotting, value i belongs to distance[i].
+ * Heights are metres above the geoid, the earth bulge is added to the terrain so the line of sight is straight.
+ */
+struct RadioPathResult {
+	QVector<double> distance;
+	//nearest sample, NaN for voids and missing tiles
+	QVector<float> terrain;
+	QVector<float> bulge;
+	QVector<float> terrainWithBulge;
+	QVector<float> lineOfSight;
+	//radius of the first Fresnel zone, 0 at the antennas
+	QVector<float> fresnelRadius;
+	//line of sight minus terrain with bulge, negative where the path is obstructed
+	QVector<float> clearance;
+
+	double length = 0.0;
+	float fromAltitude = 0.0f;
+	float toAltitude = 0.0f;
+
+	//lowest clearance/fresnelRadius between the antennas and its sample, criticalIndex is -1 without terrain
+	float minClearanceRatio = std::numeric_limits<float>::quiet_NaN();
+	float minClearance = std::numeric_limits<float>::quiet_NaN();
+	int criticalIndex = -1;
+
+	bool isValid() const {return criticalIndex >= 0;}
+	bool hasLineOfSight() const {return isValid() && minClearance >= 0.0f;}
+	//the usual planning rule is 60% of the first Fresnel zone free
+	bool isClear(const double fresnelFraction = 0.6) const {return isValid() && minClearanceRatio >= fresnelFraction;}
+};
+
+/**
+ * @brief terrain profiles of microwave links with earth bulge d1*d2/(2*k*R) and first Fresnel zone sqrt(lambda*d1*d2/d).
+ * Terrain is sampled like RouteProfile, the rest is computed by evaluate() in flat loops over the arrays.
+ */
+class RadioPathProfile
+{
+public:
+	explicit RadioPathProfile(HgtLoader* loader);
+
+	void setFrequency(const double frequencyMHz);
+	//effective earth radius factor, default 4/3 (standard atmosphere)
+	void setKFactor(const double kFactor);
+	//samples per link including both antennas, default 256
+	void setSamples(const int samples);
+	//false keeps only the summary of the results (minClearanceRatio, ...), for screening many links
+	void setKeepArrays(const bool keepArrays);
+	//default is QThreadPool::globalInstance()
+	void setThreadPool(QThreadPool* threadPool);
+
+	bool compute(RadioPathResult& result, const RadioLink& link);
+	/**
+	 * @brief links in parallel, result i belongs to link i
+	 */
+	QVector<RadioPathResult> compute(const QVector<RadioLink>& links);
+
+	/**
+	 * @brief fills the arrays and the summary from result.distance and result.terrain, e.g. of a profile sampled elsewhere.
+	 * The antennas are at the first and the last distance, altitudes above the geoid
+	 */
+	static void evaluate(RadioPathResult& result, const double fromAltitude, const double toAltitude,
+						 const double frequencyMHz, const double kFactor);
+
+private:
+	HgtLoader* m_loader = nullptr;
+	QThreadPool* m_threadPool = nullptr;
+	double m_frequencyMHz = 7000.0;
+	double m_kFactor = 4.0/3.0;
+	int m_samples = 256;
+	bool m_keepArrays = true;
+};
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <QVector>
+#include <QPointF>
+#include "../HgtLoader.h"
+#include "../HgtTrace.h"
+#include "../Geo/GeoConstants.h"
+
+class QThreadPool;
+namespace Geo {
+class GeoidGrid;
+}
+
+struct ProfilePoint {
+	//metres from the start of the route along great circles
+	double distance = 0.0;
+	double lon = 0.0;
+	double lat = 0.0;
+	//nearest sample, NaN for voids and missing tiles. Orthometric (EGM96) unless a geoid is set
+	float elevation = 0.0f;
+};
+
+struct ProfileWaypoint {
+	double lon = 0.0;
+	double lat = 0.0;
+	//height of the waypoint itself, e.g. of an aircraft, not of the terrain
+	double height = 0.0;
+};
+
+/**
+ * @brief elevation profiles of routes (lon,lat waypoints), sampled like MainWindow::createPathPoints:
+ * every segment is split into equal steps in degrees, distances are great circle distances.
+ * The shared waypoint of two segments is sampled once.
+ * Samples are read from TileHandles kept per job, so the loader's cache lock is taken once per tile and job.
+ */
+class RouteProfile
+{
+public:
+	explicit RouteProfile(HgtLoader* loader);
+
+	//samples of one segment including both ends, default 101
+	void setSamplesPerSegment(const int samples);
+	//default is QThreadPool::globalInstance()
+	void setThreadPool(QThreadPool* threadPool);
+	/**
+	 * @brief elevations are converted to ellipsoidal WGS84 heights with the geoid, e.g. to compare them with GPS tracks.
+	 * The grid is not owned, nullptr keeps the heights of the tiles
+	 */
+	void setGeoid(const Geo::GeoidGrid* geoid);
+
+	void compute(QVector<ProfilePoint>& profile, const QVector<QPointF>& route);
+	/**
+	 * @brief profiles of all routes in parallel, profile i belongs to route i
+	 */
+	QVector<QVector<ProfilePoint>> compute(const QVector<QVector<QPointF>>& routes);
+
+	/**
+	 * @brief sample positions and distances of the route without elevations, for callers that read them elsewhere
+	 */
+	static void samplePoints(QVector<ProfilePoint>& profile, const QVector<QPointF>& route, const int samplesPerSegment);
+
+	/**
+	 * @brief MainWindow's chart of the route: x is the distance in metres, y is height(lon, lat) at 101 samples
+	 * per segment, each segment is followed by the height of its end waypoint. Distances are appended alongside
+	 */
+	template<typename HeightFunc>
+	static void chartPoints(QVector<QPointF>& pathPoints, QVector<double>& distances, const QVector<ProfileWaypoint>& waypoints,
+							HeightFunc&& height);
+
+private:
+	HgtLoader* m_loader = nullptr;
+	QThreadPool* m_threadPool = nullptr;
+	const Geo::GeoidGrid* m_geoid = nullptr;
+	int m_samplesPerSegment = 101;
+};
+
+template<typename HeightFunc>
+void RouteProfile::chartPoints(QVector<QPointF>& pathPoints, QVector<double>& distances, const QVector<ProfileWaypoint>& waypoints,
+							   HeightFunc&& height)
+{
+	pathPoints.clear();
+	distances.clear();
+	if (waypoints.size() < 2) {
+		return;
+	}
+
+	double totalDistance = 0.0;
+	pathPoints.append(QPointF(0.0, waypoints.first().height));
+	distances.append(0.0);
+
+	for (int i = 1; i < waypoints.size(); ++i) {
+		const ProfileWaypoint& from = waypoints.at(i - 1);
+		const ProfileWaypoint& to = waypoints.at(i);
+		double segmentLength = 0.0;
+		{
+			HGT_TRACE_SCOPE("Geo::Constants::distance");
+			segmentLength = Geo::Constants::distance(from.lon, from.lat, to.lon, to.lat);
+		}
+
+		HGT_TRACE_SCOPE("RouteProfile::sampleSegment");
+		for (int j = 0; j <= 100; ++j) {
+			const double t = j/100.0;
+			const double lon = from.lon + t*(to.lon - from.lon);
+			const double lat = from.lat + t*(to.lat - from.lat);
+			const double dist = totalDistance + t*segmentLength;
+			pathPoints.append(QPointF(dist, height(lon, lat)));
+			distances.append(dist);
+		}
+
+		totalDistance += segmentLength;
+		pathPoints.append(QPointF(totalDistance, to.height));
+		distances.append(totalDistance);
+	}
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <QVector>
+#include <QPointF>
+#include <limits>
+#include "../HgtLoader.h"
+
+class QThreadPool;
+namespace Geo {
+class GeoidGrid;
+}
+
+/**
+ * @brief stretch of a segment whose clearance is below the required margin, distances from the start of the route
+ */
+struct ClearanceViolation {
+	double fromDistance = 0.0;
+	double toDistance = 0.0;
+	//lowest clearance inside the stretch, metres
+	float minClearance = 0.0f;
+};
+
+struct SegmentClearance {
+	//altitude minus terrain at the lowest point, NaN if no terrain sample was found
+	float minClearance = std::numeric_limits<float>::quiet_NaN();
+	//where the minimum is, distance from the start of the route
+	double distance = 0.0;
+	double lon = 0.0;
+	double lat = 0.0;
+	float terrain = 0.0f;
+	float altitude = 0.0f;
+
+	QVector<ClearanceViolation> violations;
+
+	//metres of the segment over tiles that could not be loaded, nothing is known about them
+	double unknownDistance = 0.0;
+	//samples at DEM resolution along the segment and the ones actually read, the rest was bounded by the block maxima
+	qint64 totalSamples = 0;
+	qint64 readSamples = 0;
+	//void samples among the read ones, they are skipped
+	qint64 voidSamples = 0;
+
+	bool hasMinimum() const {return minClearance == minClearance;}
+};
+
+struct RouteClearance {
+	//segment i goes from waypoint i to waypoint i + 1
+	QVector<SegmentClearance> segments;
+	//lowest clearance of the route and its segment, -1 if no terrain sample was found
+	float minClearance = std::numeric_limits<float>::quiet_NaN();
+	int minSegment = -1;
+
+	bool isValid() const {return minSegment >= 0;}
+	//no violation on any segment, stretches over missing tiles are not checked
+	bool isClear() const;
+};
+
+/**
+ * @brief clearance of planned altitudes above the terrain. Waypoints are joined like in RouteProfile (equal steps
+ * in degrees, great circle distances) and altitudes are interpolated linearly between them. The terrain is the
+ * nearest sample at DEM resolution, one sample per pixel step along the segment.
+ *
+ * A segment is split at the tile edges and searched best first: the lowest altitude of a stretch minus the block
+ * maximum of the terrain under it (TileMaxPyramid) bounds its clearance from below, stretches that can hold neither
+ * a violation nor a lower minimum are skipped. Only the stretches close to the terrain are read sample by sample,
+ * so the result is the same as full resolution sampling.
+ */
+class TerrainClearance
+{
+public:
+	explicit TerrainClearance(HgtLoader* loader);
+
+	//required clearance, metres, default 0
+	void setMargin(const double margin);
+	double margin() const {return m_margin;}
+	/**
+	 * @brief altitudes are WGS84 ellipsoidal heights (GPS) and are converted to orthometric ones at the waypoints.
+	 * The grid is not owned, nullptr takes them as heights above the geoid like the tiles
+	 */
+	void setGeoid(const Geo::GeoidGrid* geoid);
+	//default is QThreadPool::globalInstance()
+	void setThreadPool(QThreadPool* threadPool);
+
+	/**
+	 * @brief clearance of every segment, altitudes[i] belongs to route[i]
+	 */
+	bool compute(RouteClearance& clearance, const QVector<QPointF>& route, const QVector<double>& altitudes);
+	/**
+	 * @brief routes in parallel, result i belongs to route i. Routes with a wrong count of altitudes stay empty
+	 */
+	QVector<RouteClearance> compute(const QVector<QVector<QPointF>>& routes, const QVector<QVector<double>>& altitudes);
+
+private:
+	HgtLoader* m_loader = nullptr;
+	QThreadPool* m_threadPool = nullptr;
+	const Geo::GeoidGrid* m_geoid = nullptr;
+	double m_margin = 0.0;
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <QList>
+#include <QVector>
+#include <QPoint>
+#include <QString>
+#include <QSharedPointer>
+#include <QWeakPointer>
+#include <QMutex>
+#include "../HgtLoader.h"
+
+enum class TerrainProduct {
+	Slope,      //degrees
+	Aspect,     //degrees clockwise from north of the downslope direction, -1 on flat ground
+	Curvature,  //general curvature, -2*(d2z/dx2 + d2z/dy2)*100, positive on convex ground
+	Hillshade   //0..255
+};
+
+/**
+ * @brief float raster with the tile's grid, row 0 is the northern edge, NaN where the stencil touches a void
+ */
+struct TerrainRaster {
+	QPoint leftBottomCorner;
+	int sideSize = 0;
+	TerrainProduct product = TerrainProduct::Slope;
+	QVector<float> data;
+
+	inline float value(const int col, const int row) const {return data.at(row*sideSize + col);}
+};
+
+/**
+ * @brief slope, aspect, curvature and hillshade with Horn's 3x3 stencil.
+ * The stencil reads across tile seams from the neighbouring tiles, so a mosaic of tiles has no edge artifacts.
+ * Horizontal distances follow the latitude of each row (WGS84). Tiles are processed in row blocks that
+ * fit in cache, blocks run on the global thread pool. Gradients use AVX when the CPU supports it (CpuFeatures).
+ */
+class TerrainDerivatives
+{
+public:
+	explicit TerrainDerivatives(HgtLoader* loader);
+
+	/**
+	 * @brief light for the hillshade, azimuth clockwise from north, altitude above the horizon, degrees.
+	 * Rounded to 0.1 degree, cached hillshades are kept per position
+	 */
+	void setSunPosition(const double azimuth, const double altitude);
+
+	//memory of the rasters kept by cached() over all tiles, default 256 MB, the least recently used are dropped first.
+	//The raster just computed is kept even if it is larger
+	void setMaxCacheMemory(const qint64 bytes);
+	qint64 maxCacheMemory() const;
+
+	/**
+	 * @brief computes the product of the tile into raster, its buffer is reused if it has the right size
+	 */
+	bool compute(TerrainRaster& raster, const TileHandle& tile, const TerrainProduct product);
+
+	/**
+	 * @brief like compute(), but keeps the result with the tile's cache entry, repeated calls return the same raster
+	 * until it is dropped to stay within maxCacheMemory()
+	 */
+	QSharedPointer<const TerrainRaster> cached(const TileHandle& tile, const TerrainProduct product);
+	QList<QSharedPointer<const TerrainRaster>> cachedByRect(const double minLon, const double maxLon,
+															const double minLat, const double maxLat, const TerrainProduct product);
+
+private:
+	QString cacheKey(const TerrainProduct product) const;
+	//moves the raster to the most recently used end and drops the oldest ones over the budget
+	void touchCached(const QSharedPointer<TileStorage>& storage, const QString& key, const qint64 builtBytes);
+
+private:
+	HgtLoader* m_loader = nullptr;
+	double m_sunAzimuth = 315.0;
+	double m_sunAltitude = 45.0;
+
+	struct CacheEntry {
+		QWeakPointer<TileStorage> storage;
+		QString key;
+		qint64 bytes = 0;
+	};
+	//rasters kept by cached(), least recently used first
+	QMutex m_cacheLock;
+	QList<CacheEntry> m_cache;
+	qint64 m_cacheBytes = 0;
+	qint64 m_maxCacheBytes = qint64(256)*1024*1024;
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+#include "../HgtLoader.h"
+#include "../Geo/UtmProjection.h"
+
+class QThreadPool;
+
+/**
+ * @brief regular metric grid in a UTM zone. Rows run from north to south, cell (col,row) is centred at
+ * easting = minEasting + (col + 0.5)*cellSize, northing = maxNorthing - (row + 0.5)*cellSize.
+ */
+struct UtmGrid {
+	int zone = 0;
+	bool north = true;
+	double minEasting = 0.0;
+	double maxNorthing = 0.0;
+	double cellSize = 0.0;
+	int cols = 0;
+	int rows = 0;
+
+	bool isValid() const {return zone >= 1 && zone <= 60 && cellSize > 0.0 && cols > 0 && rows > 0;}
+	qint64 cellCount() const {return qint64(cols)*rows;}
+};
+
+/**
+ * @brief resamples the elevation mosaic into a UTM grid with bilinear interpolation, NaN where there is no data.
+ * Output rows are split into blocks that run in parallel, every row is inverse projected in one batch
+ * and then gathered tile by tile, so each run of cells in the same source tile reads it through one TileView.
+ */
+class UtmResampler
+{
+public:
+	explicit UtmResampler(HgtLoader* loader);
+
+	//default is QThreadPool::globalInstance()
+	void setThreadPool(QThreadPool* threadPool);
+	//output rows per job
+	void setBlockRows(const int blockRows);
+
+	/**
+	 * @brief writes grid.cols*grid.rows floats, row by row, into raster, which the caller allocates
+	 */
+	bool resample(float* raster, const UtmGrid& grid);
+	bool resample(QVector<float>& raster, const UtmGrid& grid);
+	/**
+	 * @brief resamples into a memory-mapped file of native-endian float32 rows, the file is created or overwritten
+	 */
+	bool resampleToFile(const QString& path, const UtmGrid& grid);
+
+private:
+	void resampleRows(float* raster, const UtmGrid& grid, const Geo::UtmProjection& projection, const int rowBegin, const int rowEnd);
+
+private:
+	HgtLoader* m_loader = nullptr;
+	QThreadPool* m_threadPool = nullptr;
+	int m_blockRows = 64;
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <QString>
+#include <QHash>
+#include <QMutex>
+#include <QByteArray>
+#include <QRect>
+#include "../HgtLoader.h"
+
+class QImage;
+class QThreadPool;
+struct XyzSources;
+
+enum class XyzTileFormat {
+	TerrainRgb, //elevation = -10000 + (R*65536 + G*256 + B)*0.1, transparent on voids
+	Hillshade   //grey 0..255, transparent on voids
+};
+
+struct XyzTileCounters {
+	int rendered = 0;
+	//output was up to date
+	int skipped = 0;
+	//no source data under the tile, nothing written
+	int empty = 0;
+	int failed = 0;
+};
+
+/**
+ * @brief renders Web Mercator (EPSG:3857) map tiles of 256x256 pixels into outputDir/z/x/y.png.
+ * Pixels are resampled bilinearly from the source tiles. Map tiles are spread over the workers of the
+ * thread pool in spatially coherent runs, a worker that runs out of work steals from the others.
+ * Every map tile is keyed by a hash of its render settings and the content of the source tiles it reads,
+ * the keys are kept in outputDir/pyramid.hash and tiles whose key did not change are not rendered again.
+ */
+class XyzTileGenerator
+{
+public:
+	explicit XyzTileGenerator(HgtLoader* loader);
+
+	void setFormat(const XyzTileFormat format);
+	/**
+	 * @brief light for the hillshade, azimuth clockwise from north, altitude above the horizon, degrees
+	 */
+	void setSunPosition(const double azimuth, const double altitude);
+	//default is QThreadPool::globalInstance(), one worker per pool thread
+	void setThreadPool(QThreadPool* threadPool);
+
+	bool generate(const QString& outputDir, const double minLon, const double maxLon, const double minLat, const double maxLat,
+				  const int minZoom, const int maxZoom, XyzTileCounters* counters = nullptr);
+
+	/**
+	 * @brief renders one map tile, false if no source tile lies under it.
+	 * Only source tiles already in the cache directory are read, nothing is downloaded. Each 1 degree cell
+	 * under the map tile costs one file existence check, about 62000 of them at zoom 0
+	 */
+	bool render(QImage& image, const int zoom, const int x, const int y);
+
+private:
+	/**
+	 * @brief source tiles under the map tile, limited to the tiles of area if it is valid,
+	 * otherwise to the tiles in the cache directory
+	 */
+	bool collectSources(XyzSources& sources, const int zoom, const int x, const int y, const QRect& area);
+	QByteArray tileKey(const XyzSources& sources, const int zoom, const int x, const int y);
+	QByteArray sourceDigest(const TileHandle& tile);
+	void render(QImage& image, const XyzSources& sources, const int zoom, const int x, const int y);
+
+private:
+	HgtLoader* m_loader = nullptr;
+	QThreadPool* m_threadPool = nullptr;
+	XyzTileFormat m_format = XyzTileFormat::TerrainRgb;
+	double m_sunAzimuth = 315.0;
+	double m_sunAltitude = 45.0;
+
+	//content hashes of the source tiles, valid for one generate() call
+	QMutex m_digestLock;
+	QHash<quint32, QByteArray> m_digests;
+};
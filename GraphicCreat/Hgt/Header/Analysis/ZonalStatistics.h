@@ -0,0 +1,61 @@
+#pragma once
+
+#include <QList>
+#include <QVector>
+#include <QPointF>
+#include <limits>
+#include "../HgtLoader.h"
+
+class QThreadPool;
+
+/**
+ * @brief elevation statistics of one polygon, void samples are skipped
+ */
+struct ZonalStats {
+	//valid samples inside the polygon
+	qint64 count = 0;
+	qint64 voidCount = 0;
+	//tiles touched by the polygon that could not be loaded
+	int missingTiles = 0;
+
+	qint16 min = std::numeric_limits<qint16>::max();
+	qint16 max = std::numeric_limits<qint16>::min();
+	double mean = 0.0;
+	//population standard deviation
+	double stddev = 0.0;
+
+	//bin i counts elevations in [histogramMin + i*binWidth, histogramMin + (i+1)*binWidth),
+	//values outside of the range go to the first or the last bin
+	QVector<qint64> histogram;
+	double histogramMin = 0.0;
+	double binWidth = 0.0;
+
+	bool isValid() const {return count > 0;}
+};
+
+/**
+ * @brief rasterizes polygons against the tiles' sample grid and reduces the covered samples.
+ * The spans come from PolygonTileWalk, partial results are merged per polygon.
+ */
+class ZonalStatistics
+{
+public:
+	explicit ZonalStatistics(HgtLoader* loader);
+
+	/**
+	 * @brief enables the histogram, binCount = 0 disables it
+	 */
+	void setHistogram(const int binCount, const double minElevation, const double maxElevation);
+	//default is QThreadPool::globalInstance()
+	void setThreadPool(QThreadPool* threadPool);
+
+	ZonalStats compute(const QList<QPointF>& polygon);
+	QVector<ZonalStats> compute(const QList<QList<QPointF>>& polygons);
+
+private:
+	HgtLoader* m_loader = nullptr;
+	QThreadPool* m_threadPool = nullptr;
+	int m_binCount = 0;
+	double m_histogramMin = 0.0;
+	double m_histogramMax = 0.0;
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+/**
+ * @brief runtime choice of x86 SIMD kernels. With GCC and Clang the kernels are compiled for their instruction
+ * set through HGT_TARGET, so the build does not need -mavx2, and are called only if the CPU reports it.
+ * Other compilers and CPUs use the scalar loops.
+ */
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define HGT_X86_DISPATCH
+#define HGT_TARGET(isa) __attribute__((target(isa)))
+#include <immintrin.h>
+#endif
+
+namespace CpuFeatures {
+
+#if defined(HGT_X86_DISPATCH)
+inline bool hasSsse3()
+{
+	static const bool retVal = (__builtin_cpu_init(), __builtin_cpu_supports("ssse3"));
+	return retVal;
+}
+
+inline bool hasAvx()
+{
+	static const bool retVal = (__builtin_cpu_init(), __builtin_cpu_supports("avx"));
+	return retVal;
+}
+
+inline bool hasAvx2()
+{
+	static const bool retVal = (__builtin_cpu_init(), __builtin_cpu_supports("avx2"));
+	return retVal;
+}
+#else
+inline bool hasSsse3() {return false;}
+inline bool hasAvx() {return false;}
+inline bool hasAvx2() {return false;}
+#endif
+
+}
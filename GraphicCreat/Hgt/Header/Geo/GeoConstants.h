@@ -13,6 +13,8 @@ namespace Constants
 {
 
 const double EarthRad = 6371.0;
+//mean radius used by QGeoCoordinate::distanceTo, metres
+const double EARTH_MEAN_RADIUS = 6371007.2;
 const double DEG2RAD1 = 1.74532925199e-02;
 
 //Semi-major Axis WGS84
@@ -68,6 +70,8 @@ const int MAX_ZOOM_LEVEL = 22;
 const int OSM_MAX_ZOOM_LEVEL = 19; //open street map 0..19
 const int ERROR_ZOOM_LEVEL = -1;
 const double ERROR_ZOOM = -1.0;
+//EPSG:3857 is cut at the latitude where the map is square
+const double MERCATOR_MAX_LAT = 85.05112877980659;
 //-----vector map-----
 
 bool isCorrectCoord(const double val);
@@ -76,6 +80,13 @@ bool isCorrectGeoCoord(const double lon, const double lat);
 
 bool isCorrectGeoCoord(const QPointF& pos);
 
+//length of one degree on the WGS84 ellipsoid at latitude lat, along the meridian and along the parallel
+double metersPerDegreeLat(const double lat);
+double metersPerDegreeLon(const double lat);
+
+//great circle distance in metres (haversine on the sphere of EARTH_MEAN_RADIUS), as QGeoCoordinate::distanceTo
+double distance(const double lon1, const double lat1, const double lon2, const double lat2);
+
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+#include <algorithm>
+#include <cmath>
+
+///////////////////////////////////////////////////////////////////////////////
+namespace Geo {
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief geoid undulation N on a regular lat/lon grid, e.g. EGM96 (WW15MGH.GRD from NGA, 15' grid).
+ * Ellipsoidal WGS84 height h = H + N, where H is the orthometric height of SRTM and GDEM tiles.
+ *
+ * The text grid is parsed once and cached next to it (or in cacheDir) as samples in centimetres, native byte order,
+ * about 2 MB for EGM96 15'. The cache is rebuilt when the source changes, like NativeTileCache.
+ * Lookups are bilinear and wrap around the antimeridian for global grids.
+ */
+class GeoidGrid
+{
+public:
+	GeoidGrid() {}
+
+	/**
+	 * @brief reads a text grid (south north west east latStep lonStep, then rows from north to south)
+	 * or a cache file written by it
+	 */
+	bool load(const QString& fileName, const QString& cacheDir = QString());
+	bool isValid() const {return !m_samples.isEmpty();}
+
+	static QString cacheFileName(const QString& sourceFileName, const QString& cacheDir);
+
+	//metres, 0 without a grid
+	inline float undulation(const double lon, const double lat) const;
+
+	/**
+	 * @brief undulations of count points, out may alias neither lon nor lat
+	 */
+	void undulations(float* out, const double* lon, const double* lat, const int count) const;
+	//heights[i] += N, orthometric to ellipsoidal, NaN stays NaN
+	void toEllipsoidal(float* heights, const double* lon, const double* lat, const int count) const;
+	//heights[i] -= N, ellipsoidal to orthometric
+	void toOrthometric(float* heights, const double* lon, const double* lat, const int count) const;
+
+private:
+	bool parseTextGrid(const QString& fileName);
+	bool readCacheFile(const QString& cacheFileName, const QString& sourceFileName);
+	bool writeCacheFile(const QString& cacheFileName, const QString& sourceFileName) const;
+	void updateSteps();
+
+private:
+	//row 0 is the northern edge
+	QVector<qint16> m_samples;
+	int m_rows = 0;
+	int m_cols = 0;
+	double m_north = 0.0;
+	double m_west = 0.0;
+	double m_latStep = 0.0;
+	double m_lonStep = 0.0;
+	float m_scale = 0.01f;
+
+	double m_invLatStep = 0.0;
+	double m_invLonStep = 0.0;
+	//cells around the globe for global grids, 0 if longitudes are clamped
+	double m_period = 0.0;
+	double m_invPeriod = 0.0;
+};
+
+float GeoidGrid::undulation(const double lon, const double lat) const
+{
+	if (m_samples.isEmpty()) {
+		return 0.0f;
+	}
+
+	//m_period is 0 for regional grids, the wrap is a no-op then
+	double x = (lon - m_west)*m_invLonStep;
+	x -= std::floor(x*m_invPeriod)*m_period;
+	double y = (m_north - lat)*m_invLatStep;
+	//written so that NaN coordinates end up at 0
+	x = std::min(x > 0.0 ? x : 0.0, double(m_cols - 1));
+	y = std::min(y > 0.0 ? y : 0.0, double(m_rows - 1));
+
+	//the last cell is used for the far edge, so the 4 samples are always inside
+	const int col = std::min(int(x), m_cols - 2);
+	const int row = std::min(int(y), m_rows - 2);
+	const float fx = float(x - col);
+	const float fy = float(y - row);
+
+	const qint16* top = m_samples.constData() + qint64(row)*m_cols + col;
+	const qint16* bottom = top + m_cols;
+	const float upper = top[0] + fx*(top[1] - top[0]);
+	const float lower = bottom[0] + fx*(bottom[1] - bottom[0]);
+	return (upper + fy*(lower - upper))*m_scale;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+} ///namespace Geo
+///////////////////////////////////////////////////////////////////////////////
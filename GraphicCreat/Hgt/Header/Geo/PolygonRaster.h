@@ -0,0 +1,46 @@
+#pragma once
+
+#include <QList>
+#include <QVector>
+#include <QPoint>
+#include <QPointF>
+
+///////////////////////////////////////////////////////////////////////////////
+namespace Geo {
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief covered samples [colBegin, colEnd) of one tile row, row 0 is the northern edge
+ */
+struct SampleSpan {
+	int row = 0;
+	int colBegin = 0;
+	int colEnd = 0;
+};
+
+/**
+ * @brief polygon (lon,lat nodes, implicitly closed) against the 1 degree tile grid and the sample grid of a tile
+ */
+class PolygonRaster
+{
+public:
+	/**
+	 * @brief left bottom corners of the 1x1 degree tiles the polygon touches (interior or boundary),
+	 * a tile is addressed like HgtLoader does it: floor(lon), floor(lat).
+	 * One node selects one tile, two nodes a segment.
+	 */
+	static QVector<QPoint> coveredTiles(const QList<QPointF>& nodes);
+
+	/**
+	 * @brief scanline mask of the samples of the tile whose position lies inside the polygon (even-odd rule).
+	 * Samples are on the tile edges, sample (col,row) is at lon = corner.x + col/(sideSize-1),
+	 * lat = corner.y + 1 - row/(sideSize-1). Spans are sorted by row, empty rows are skipped.
+	 */
+	static QVector<SampleSpan> sampleMask(const QList<QPointF>& nodes, const QPoint& leftBottomCorner, const int sideSize);
+
+	static qint64 sampleCount(const QVector<SampleSpan>& spans);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+} ///namespace Geo
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <QPointF>
+
+///////////////////////////////////////////////////////////////////////////////
+namespace Geo {
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief UTM (transverse Mercator on WGS84) of one zone, Krüger series to n^3, accurate to a few
+ * millimetres inside the zone. Easting includes the 500 km false easting, southern zones
+ * the 10000 km false northing.
+ */
+class UtmProjection
+{
+public:
+	UtmProjection(const int zone, const bool north);
+
+	int zone() const {return m_zone;}
+	bool isNorth() const {return m_north;}
+	bool isValid() const {return m_zone >= 1 && m_zone <= 60;}
+	double centralMeridian() const {return m_lon0;}
+
+	//zone of the longitude, 1..60
+	static int zoneOf(const double lon);
+
+	QPointF forward(const double lon, const double lat) const;
+	QPointF inverse(const double easting, const double northing) const;
+
+	/**
+	 * @brief inverse of count points, written as branch-free loops over arrays so the compiler
+	 * can vectorize them where vector math functions are available
+	 */
+	void inverse(const double* easting, const double* northing, double* lon, double* lat, const int count) const;
+
+private:
+	int m_zone = 0;
+	bool m_north = true;
+	double m_lon0 = 0.0;
+	double m_falseNorthing = 0.0;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+} ///namespace Geo
+///////////////////////////////////////////////////////////////////////////////
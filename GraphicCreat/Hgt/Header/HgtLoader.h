@@ -10,9 +10,16 @@
 #include <limits>
 #include <QReadWriteLock>
 #include "./Loaders/IHgtLoader.h"
+#include "TileView.h"
+#include "TileHandle.h"
+#include "HgtStats.h"
+#include "TileIntegral.h"
+#include "TileMaxPyramid.h"
+#include "Geo/PolygonRaster.h"
 
 class QThread;
 class QRectF;
+class QTimer;
 
 //-32768
 const short ERROR_ELEVATION_SRTM_HGT = std::numeric_limits<short>::min();
@@ -32,19 +39,61 @@ public:
 	void setHgtType(HgtType type);
 
 	void setCacheDirectory(const QString &hgtCachePath);
+	/**
+	 * @brief tiles missing in the cache directory are downloaded from serverAddress + "/" + file name
+	 * unless only the cache is used (setOnlyFromCache()). Lookups of a tile being downloaded fail without
+	 * waiting, tileDownloaded() is emitted when the file is in the cache and the tile has been dropped from
+	 * the RAM cache, so the next lookup opens it.
+	 */
     void setServerAddress(const QString &serverAddress);
 
     void setOnlyFromCache(const bool onlyFromCache);
     bool isOnlyFromCache() const;
 
+	//downloads in flight, default 4
+	void setMaxConcurrentDownloads(const int requests);
+	/**
+	 * @brief starts the downloads of the tiles of the rectangle missing in the cache directory
+	 * @return number of tiles queued or already downloading
+	 */
+	int downloadHgtByRect(const double minLon, const double maxLon, const double minLat, const double maxLat);
+
+	//tiles kept mapped by the loader's cache, default 10
+	void setMaxTilesInRam(const int maxTiles);
+	int maxTilesInRam() const;
+	//memory of the summed-area tables of all tiles, default 512 MB. The table just used is kept even if it is larger
+	void setMaxIntegralMemory(const qint64 bytes);
+	qint64 maxIntegralMemory() const;
+
+	/**
+	 * @brief enables the on-disk cache of native-endian tiles, empty path disables it.
+	 * With the cache enabled tiles are handed out in native byte order (TileOwn::byteOrder).
+	 * @param fillVoids: set 'true' to replace void samples in the cached tiles
+	 */
+	void setNativeCacheDirectory(const QString& nativeCachePath, const bool fillVoids = false);
+	QString nativeCacheDirectory() const;
+
+	/**
+	 * @brief keeps native-endian tiles in shared memory, one copy per host for all processes reading the same
+	 * .hgt files (see SharedTileCache). Tiles are handed out in native byte order as with the native cache.
+	 * @param fillVoids: set 'true' to replace void samples, the setting is shared with setNativeCacheDirectory()
+	 */
+	void setSharedMemoryCache(const bool enabled, const bool fillVoids = false);
+	bool isSharedMemoryCache() const;
+
     /**
-	 * @brief checks does the region exist in cache, fills requiredFiles List with required .hgt files. First you have to set Cache Directory
+	 * @brief checks does the region exist in cache, fills requiredFiles List with required .hgt files. First you have to set Cache Directory.
+	 * Only the tiles the polygon touches are required.
 	 */
 	bool doesExistHgtByPolygon(const QList<QPointF>& nodes, QList<QString>& requiredFiles);
 	bool doesExistHgtByPolygon(const QList<QPointF>& nodes);
 
 	bool doesExistHgtByRect(const double minLon, const double maxLon, const double minLat, const double maxLat, QList<QString>& requiredFiles, const bool exitOnFirstFail = false);
 	bool doesExistHgtByRect(const double minLon, const double maxLon, const double minLat, const double maxLat, const bool exitOnFirstFail = false);
+	/**
+	 * @brief checks does the tile with the point lie in the cache directory as the loaders read it, without opening it
+	 */
+	bool doesExistHgtInCache(const double lon, const double lat) const;
 
 	/**
      * @brief looks for .hgt file in saved tile map, then looks for .hgt file in cache.
@@ -68,12 +117,80 @@ public:
 	QList<TileOwn> getHgtTilesByRect(const double minLon, const double maxLon,
 											  const double minLat, const double maxLat, const bool saveTilesInsideModule);
 
-	bool getElevationFromTile(qint16& elevation, const double lon, const double lat, const QByteArray data) const;
+	//byteOrder of the samples in data, tiles of one loader may differ (see TileOwn::byteOrder)
+	bool getElevationFromTile(qint16& elevation, const double lon, const double lat, const QByteArray& data,
+							  const QSysInfo::Endian byteOrder) const;
+	bool getElevationFromTile(qint16& elevation, const double lon, const double lat, const TileOwn& tile) const;
+	bool getElevationFromTile(qint16& elevation, const double lon, const double lat, const TileHandle& tile) const;
+
+	/**
+	 * @brief zero-copy handle of the tile containing the point. The tile stays mapped while the handle
+	 * (or any copy of it) is held, even if the loader evicts it from its cache in the meantime.
+	 */
+	bool getTileHandle(TileHandle& handle, const double lon, const double lat);
+	QList<TileHandle> getTileHandlesByRect(const double minLon, const double maxLon, const double minLat, const double maxLat);
+
+	/**
+	 * @brief mean and variance of the samples inside the rectangle, O(1) per tile.
+	 * Summed-area tables are built on the first query of a tile and live as long as the tile is cached or held,
+	 * unless they are dropped to stay within maxIntegralMemory(). A dropped table is built again on the next query.
+	 */
+	bool getRectStatistics(RectStatistics& stats, const double minLon, const double maxLon, const double minLat, const double maxLat);
+	QSharedPointer<const TileIntegral> getTileIntegral(const TileHandle& tile) const;
+	/**
+	 * @brief upper bounds of the tile's elevations per block, built on the first call and kept like the summed-area tables
+	 */
+	QSharedPointer<const TileMaxPyramid> getTileMaxPyramid(const TileHandle& tile) const;
+
+	/**
+	 * @brief elevation grid of the rectangle into a caller buffer of at least cols*rows samples (see rasterSize()).
+	 * Sample (col,row) is at lon = minLon + col*stepDeg, lat = maxLat - row*stepDeg, rows run from north to south.
+	 * Rows that lie on a tile's own sample grid are copied, other steps are interpolated bilinearly.
+	 * Voids and missing tiles are ERROR_ELEVATION_SRTM_HGT in the qint16 buffer and NaN in the float one.
+	 */
+	bool extractRaster(qint16* buffer, const qint64 bufferSize, const double minLon, const double maxLon,
+					   const double minLat, const double maxLat, const double stepDeg);
+	bool extractRaster(float* buffer, const qint64 bufferSize, const double minLon, const double maxLon,
+					   const double minLat, const double maxLat, const double stepDeg);
+	static bool rasterSize(int& cols, int& rows, const double minLon, const double maxLon,
+						   const double minLat, const double maxLat, const double stepDeg);
 
 	bool getHgtFileOffset(qint64& offset, const double lon, const double lat) const;
 
+	/**
+	 * @brief samples of the tile that lie inside the polygon, as row spans (see Geo::PolygonRaster::sampleMask)
+	 */
+	QVector<Geo::SampleSpan> getPolygonMask(const QList<QPointF>& nodes, const TileOwn& tile) const;
+	QVector<Geo::SampleSpan> getPolygonMask(const QList<QPointF>& nodes, const TileHandle& tile) const;
+
+	/**
+	 * @brief calls func once with the TileView specialized for the tile's sample type, grid and byte order,
+	 * so the per-sample access inside func is resolved at compile time.
+	 * func has to accept any TileView, e.g. a generic lambda [](const auto& view) {...}
+	 * @return false if the tile format is unknown
+	 */
+	template<typename Func>
+	bool visitTileView(const TileOwn& tile, Func&& func) const;
+	template<typename Func>
+	bool visitTileView(const TileHandle& tile, Func&& func) const;
+
 	bool gdalAvailable();
 
+	/**
+	 * @brief counters of the tile cache since the loader was created: hits, misses, evictions, mapped files,
+	 * cache lock waits, open/map latencies and accesses per tile. Counting is per thread and stays enabled.
+	 */
+	HgtStatsSnapshot stats() const;
+
+	/**
+	 * @brief emits statsUpdated() every msec milliseconds from the loader's thread, 0 stops it
+	 */
+	void setStatsInterval(const int msec);
+
+signals:
+	void statsUpdated(const HgtStatsSnapshot& stats);
+	void tileDownloaded(const QPoint& leftBottomCorner, const bool ok);
+
 private:
 	bool isCorrectPoint(const double lon, const double lat) const;
 	int getLonIndex(const double lon) const;
@@ -87,7 +204,23 @@ private:
 
 	QPointF getLeftBottomNode(const QString& hgtName);
 
+	bool doesExistHgtTiles(const QVector<QPoint>& leftBottomCorners, QList<QString>& requiredFiles, const bool exitOnFirstFail);
+
+	template<typename OutT>
+	bool extractRasterSamples(OutT* buffer, const qint64 bufferSize, const double minLon, const double maxLon,
+							  const double minLat, const double maxLat, const double stepDeg);
+
 	void initHgtType(HgtType type);    
+	void reloadHgtLoaderCore();
+	//creates the downloader on first use, hands it to the core while downloads are enabled
+	void updateDownloader();
+
+	//moves the storage's table to the most recently used end and drops the oldest ones over the budget
+	void touchIntegral(const QSharedPointer<TileStorage>& storage, const qint64 builtBytes) const;
+
+	template<typename Func>
+	static bool visitTileData(const uchar* data, const qint64 size, const QPoint& leftBottomCorner,
+							  const QSysInfo::Endian byteOrder, Func&& func);
 
 private:
     static HgtLoader* m_instance;
@@ -95,4 +228,63 @@ private:
 	HgtType m_hgtType = HgtType::SRTM;
 	IHgtLoader* m_hgtLoaderCore = nullptr;
 	HgtSettings m_settings;
+	//shared with the cores and the tiles mapped by them
+	QSharedPointer<HgtStats> m_stats;
+	QTimer* m_statsTimer = nullptr;
+	//shared with the cores, kept when the core is recreated so queued downloads go on
+	QSharedPointer<HgtDownloader> m_downloader;
+	int m_maxConcurrentDownloads = 4;
+
+	struct IntegralEntry {
+		QWeakPointer<TileStorage> storage;
+		qint64 bytes = 0;
+	};
+	//tiles with a summed-area table, least recently used first
+	mutable QMutex m_integralLock;
+	mutable QList<IntegralEntry> m_integrals;
+	mutable qint64 m_integralBytes = 0;
 };
+
+template<typename Func>
+bool HgtLoader::visitTileView(const TileOwn& tile, Func&& func) const
+{
+	return visitTileData(reinterpret_cast<const uchar*>(tile.data.constData()), tile.data.size(),
+						 tile.leftBottomCorner, tile.byteOrder, std::forward<Func>(func));
+}
+
+template<typename Func>
+bool HgtLoader::visitTileView(const TileHandle& tile, Func&& func) const
+{
+	return visitTileData(tile.data(), tile.size(), tile.leftBottomCorner(), tile.byteOrder(), std::forward<Func>(func));
+}
+
+template<typename Func>
+bool HgtLoader::visitTileData(const uchar* data, const qint64 size, const QPoint& leftBottomCorner,
+							  const QSysInfo::Endian byteOrder, Func&& func)
+{
+	if (!data) {
+		return false;
+	}
+
+	if (byteOrder == QSysInfo::ByteOrder) {
+		if (size == Srtm3NativeTileView::DATA_SIZE) {
+			func(Srtm3NativeTileView(data, size, leftBottomCorner));
+			return true;
+		}
+		if (size == Srtm1NativeTileView::DATA_SIZE) {
+			func(Srtm1NativeTileView(data, size, leftBottomCorner));
+			return true;
+		}
+		return false;
+	}
+
+	if (size == Srtm3TileView::DATA_SIZE) {
+		func(Srtm3TileView(data, size, leftBottomCorner));
+		return true;
+	}
+	if (size == Srtm1TileView::DATA_SIZE) {
+		func(Srtm1TileView(data, size, leftBottomCorner));
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <QString>
+#include <QByteArray>
+#include <QPoint>
+#include "TileOwn.h"
+
+typedef struct HgtSettings {
+    QString hgtArchiveDir = "";
+    QString hgtCachePath = "";
+    QString serverAddress = "";
+    int maxNumOfTilesInRAM = 10;
+    //summed-area tables of all tiles (HgtLoader::getTileIntegral), the least recently used are dropped first
+    qint64 maxIntegralBytes = qint64(512)*1024*1024;
+    bool onlyFromCache = true;
+    //directory of native-endian tile copies, empty - disabled
+    QString nativeCachePath = "";
+    bool fillVoids = false;
+    //native-endian tiles in shared memory, one copy per host (SharedTileCache)
+    bool sharedMemoryCache = false;
+} HgtSettings;
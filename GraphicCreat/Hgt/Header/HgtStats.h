@@ -0,0 +1,184 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QMetaType>
+#include <QMutex>
+#include <QPoint>
+#include <QThreadStorage>
+#include <QVector>
+#include <atomic>
+
+/**
+ * @brief latency histogram with power of two buckets, bucket i counts durations in [2^i, 2^(i+1)) ns
+ */
+struct HgtLatencyHistogram
+{
+	static const int BUCKET_COUNT = 40;
+
+	QVector<quint64> buckets = QVector<quint64>(BUCKET_COUNT, 0);
+	quint64 count = 0;
+	quint64 sumNs = 0;
+
+	double meanNs() const {return count ? double(sumNs)/count : 0.0;}
+	//upper bound of the bucket holding the percentile (0..100), 0 without samples
+	double percentileNs(const double percentile) const;
+};
+
+struct HgtTileAccess
+{
+	QPoint leftBottomCorner;
+	quint64 count = 0;
+};
+
+/**
+ * @brief snapshot of the tile cache counters, see HgtLoader::stats()
+ */
+struct HgtStatsSnapshot
+{
+	//lookups answered by the cache, tiles known to be missing included
+	quint64 hits = 0;
+	//lookups that had to open a tile
+	quint64 misses = 0;
+	quint64 evictions = 0;
+
+	//tiles mapped from files, also the evicted ones still held by a TileHandle
+	qint64 mappedBytes = 0;
+	int openFiles = 0;
+
+	//time getHgt waited for the cache lock
+	double lockWaitMeanNs = 0.0;
+	double lockWaitP99Ns = 0.0;
+	HgtLatencyHistogram lockWait;
+	HgtLatencyHistogram openLatency;
+	HgtLatencyHistogram mapLatency;
+
+	//accesses per tile, most accessed first
+	QVector<HgtTileAccess> tileAccess;
+	//accesses that did not fit into the per-thread tile tables
+	quint64 otherTileAccess = 0;
+	//threads that have accessed the cache
+	int threads = 0;
+};
+
+Q_DECLARE_METATYPE(HgtStatsSnapshot)
+
+/**
+ * @brief counters of the loaders' tile cache. Every thread writes its own block of counters with plain
+ * relaxed stores, so counting costs no atomic read-modify-write and no shared cache line.
+ * When a thread finishes, its block is added to the retired totals and freed.
+ * snapshot() sums the retired totals and the blocks of the running threads and can be called from any thread.
+ */
+class HgtStats
+{
+public:
+	HgtStats() {}
+	Q_DISABLE_COPY(HgtStats)
+
+	void recordHit(const int lon, const int lat);
+	void recordMiss(const int lon, const int lat);
+	void recordEviction();
+	void recordLockWait(const qint64 ns);
+	void recordOpen(const qint64 ns);
+	void recordMap(const qint64 ns);
+
+	//gauges, a mapped file is counted until its cache entry is destroyed
+	void fileOpened(const qint64 mappedBytes);
+	void fileClosed(const qint64 mappedBytes);
+
+	HgtStatsSnapshot snapshot() const;
+
+private:
+	static const int TILE_SLOT_COUNT = 256;
+
+	struct Histogram {
+		std::atomic<quint64> buckets[HgtLatencyHistogram::BUCKET_COUNT] = {};
+		std::atomic<quint64> count {0};
+		std::atomic<quint64> sumNs {0};
+	};
+
+	struct TileSlot {
+		//0 - empty, else tileKey()
+		std::atomic<quint32> key {0};
+		std::atomic<quint64> count {0};
+	};
+
+	//written only by its thread
+	struct ThreadCounters {
+		std::atomic<quint64> hits {0};
+		std::atomic<quint64> misses {0};
+		std::atomic<quint64> evictions {0};
+		std::atomic<quint64> otherTileAccess {0};
+		Histogram lockWait;
+		Histogram openLatency;
+		Histogram mapLatency;
+		TileSlot tiles[TILE_SLOT_COUNT];
+	};
+
+	//deleted by m_local when its thread finishes
+	struct LocalCounters {
+		HgtStats* stats = nullptr;
+		ThreadCounters counters;
+		~LocalCounters();
+	};
+
+	//sums of the blocks of the finished threads
+	struct Totals {
+		quint64 hits = 0;
+		quint64 misses = 0;
+		quint64 evictions = 0;
+		quint64 otherTileAccess = 0;
+		HgtLatencyHistogram lockWait;
+		HgtLatencyHistogram openLatency;
+		HgtLatencyHistogram mapLatency;
+		QHash<quint32, quint64> tileAccess;
+		int threads = 0;
+	};
+
+	ThreadCounters* local();
+	void retire(const ThreadCounters* counters);
+	static void record(Histogram& histogram, const qint64 ns);
+	static void add(HgtLatencyHistogram& sum, const Histogram& histogram);
+	static void add(Totals& sum, const ThreadCounters& counters);
+	static void recordTile(ThreadCounters* counters, const int lon, const int lat);
+
+private:
+	QThreadStorage<LocalCounters*> m_local;
+	//guards m_threads and m_retired, blocks are read under it so a finishing thread cannot free one
+	mutable QMutex m_threadsLock;
+	QList<ThreadCounters*> m_threads;
+	Totals m_retired;
+
+	std::atomic<qint64> m_mappedBytes {0};
+	std::atomic<int> m_openFiles {0};
+};
+
+/**
+ * @brief QMutexLocker that records the time spent waiting for the mutex, uncontended locking reads no clock
+ */
+class HgtStatsLocker
+{
+public:
+	HgtStatsLocker(QMutex* mutex, HgtStats* stats) :
+		m_mutex(mutex)
+	{
+		if (m_mutex->tryLock()) {
+			if (stats) {
+				stats->recordLockWait(0);
+			}
+			return;
+		}
+		QElapsedTimer timer;
+		timer.start();
+		m_mutex->lock();
+		if (stats) {
+			stats->recordLockWait(timer.nsecsElapsed());
+		}
+	}
+	~HgtStatsLocker() {m_mutex->unlock();}
+	Q_DISABLE_COPY(HgtStatsLocker)
+
+private:
+	QMutex* m_mutex;
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+
+/**
+ * @brief span recorder for incident timelines. Spans go to a fixed ring buffer with lock-free writes,
+ * the newest TRACE_CAPACITY spans are kept. toChromeJson() renders them in the Chrome trace event format,
+ * which chrome://tracing and ui.perfetto.dev open directly.
+ *
+ * Spans are placed with HGT_TRACE_SCOPE("name") and compiled in only with HGT_TRACE defined
+ * (CONFIG += hgt_trace), otherwise the macro expands to nothing.
+ */
+class HgtTrace
+{
+public:
+	static const int TRACE_CAPACITY = 1 << 16;
+
+	//monotonic time in ns since the first call
+	static qint64 now();
+
+	/**
+	 * @brief records one finished span, name has to stay valid for the lifetime of the process (string literal)
+	 */
+	static void record(const char* name, const qint64 beginNs, const qint64 endNs);
+
+	static QByteArray toChromeJson();
+	static bool dump(const QString& filePath);
+	static void clear();
+};
+
+/**
+ * @brief records the span from construction to destruction
+ */
+class HgtTraceScope
+{
+public:
+	explicit HgtTraceScope(const char* name) :
+		m_name(name),
+		m_begin(HgtTrace::now())
+	{
+	}
+	~HgtTraceScope() {HgtTrace::record(m_name, m_begin, HgtTrace::now());}
+	Q_DISABLE_COPY(HgtTraceScope)
+
+private:
+	const char* m_name;
+	qint64 m_begin;
+};
+
+#define HGT_TRACE_CONCAT_(a, b) a##b
+#define HGT_TRACE_CONCAT(a, b) HGT_TRACE_CONCAT_(a, b)
+
+#ifdef HGT_TRACE
+#define HGT_TRACE_SCOPE(name) HgtTraceScope HGT_TRACE_CONCAT(hgtTraceScope, __LINE__)(name)
+#else
+#define HGT_TRACE_SCOPE(name)
+#endif
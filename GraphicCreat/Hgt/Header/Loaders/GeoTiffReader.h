@@ -0,0 +1,94 @@
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+#include <QMap>
+#include <QVector>
+
+/**
+ * @brief minimal GeoTIFF reader for single band DEM tiles (ASTER GDEM and alike).
+ * Works directly on memory mapped file data, supports stripped and tiled layouts,
+ * uncompressed and deflate compression, int16 and float32 samples.
+ * Not thread safe, the owner has to serialize access.
+ */
+class GeoTiffReader
+{
+public:
+	GeoTiffReader() {}
+
+	bool open(const uchar* data, const qint64 size);
+	bool isValid() const {return m_valid;}
+
+	int width() const {return m_width;}
+	int height() const {return m_height;}
+
+	/**
+	 * @brief finds raster column and row for the coordinates using the model tiepoint and pixel scale tags
+	 */
+	bool getPixelIndex(int& col, int& row, const double lon, const double lat) const;
+
+	bool getSample(qint16& value, const int col, const int row);
+
+	/**
+	 * @return true if the whole raster is stored as one uncompressed native-endian int16 block,
+	 * then rasterData() can be used without decoding.
+	 */
+	bool isNativeInt16Raster() const;
+	const uchar* rasterData() const;
+
+	/**
+	 * @brief decodes the whole raster into row-major native-endian int16 samples
+	 */
+	bool decodeRaster(QByteArray& raster);
+
+private:
+	enum class SampleType {
+		Unknown,
+		Int16,
+		Float32
+	};
+
+	quint16 readU16(const qint64 pos) const;
+	quint32 readU32(const qint64 pos) const;
+	double readDouble(const qint64 pos) const;
+	bool readTagValues(QVector<double>& values, const qint64 entryPos) const;
+	bool readIfd(const qint64 ifdOffset);
+
+	int chunkIndex(const int col, const int row) const;
+	int chunkRows(const int index) const;
+	const uchar* chunk(const int index, bool& native);
+	qint16 toElevation(const uchar* sample, const bool native) const;
+
+private:
+	const uchar* m_data = nullptr;
+	qint64 m_size = 0;
+	bool m_valid = false;
+	bool m_bigEndian = false;
+
+	int m_width = 0;
+	int m_height = 0;
+	int m_bytesPerSample = 0;
+	SampleType m_sampleType = SampleType::Unknown;
+	bool m_deflate = false;
+	int m_predictor = 1;
+
+	bool m_tiled = false;
+	int m_chunkWidth = 0;
+	int m_chunkHeight = 0;
+	int m_chunksAcross = 0;
+	QVector<qint64> m_chunkOffsets;
+	QVector<qint64> m_chunkByteCounts;
+
+	double m_originLon = 0.0;
+	double m_originLat = 0.0;
+	double m_pixelLon = 0.0;
+	double m_pixelLat = 0.0;
+	bool m_hasGeoReference = false;
+	bool m_pixelIsPoint = false;
+
+	bool m_hasNoData = false;
+	double m_noData = 0.0;
+
+	QList<int> m_decodedKeys;
+	QMap<int, QByteArray> m_decodedChunks;
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QPoint>
+#include <QHash>
+#include <QSet>
+#include <QQueue>
+#include <QMutex>
+#include <QThread>
+#include <QElapsedTimer>
+
+class QNetworkAccessManager;
+class QNetworkReply;
+class QSaveFile;
+
+/**
+ * @brief fetches missing tiles from HgtSettings::serverAddress into the cache directory in the background.
+ * At most maxConcurrent requests are in flight, the others wait in a queue, and a file requested again while
+ * it is queued or downloading is not requested twice. Data goes to a QSaveFile that is renamed into place
+ * only when the download is complete and has a valid size, so loaders never map a partial tile.
+ * fetch() can be called from any thread and never waits for the network, requests run on the downloader's thread.
+ */
+class HgtDownloader : public QObject
+{
+	Q_OBJECT
+
+public:
+	explicit HgtDownloader(QObject* parent = nullptr);
+	~HgtDownloader();
+
+	//file URLs are serverAddress + "/" + file name, empty address disables fetching
+	void setServerAddress(const QString& serverAddress);
+	void setCacheDirectory(const QString& hgtCachePath);
+	//requests in flight, default 4
+	void setMaxConcurrent(const int requests);
+	//a failed file is not requested again before msec have passed, default 60000
+	void setRetryInterval(const int msec);
+
+	/**
+	 * @brief queues the download of fileName (relative to the cache directory) of the tile at leftBottomCorner
+	 * @return true if the file is queued or in flight now, false if it failed recently or fetching is disabled
+	 */
+	bool fetch(const QPoint& leftBottomCorner, const QString& fileName);
+	//queued and in flight
+	int pendingCount() const;
+
+signals:
+	//emitted from the downloader's thread, ok - the file is in the cache directory now
+	void tileDownloaded(const QPoint& leftBottomCorner, const bool ok);
+
+private:
+	struct Request {
+		QPoint leftBottomCorner;
+		QString fileName;
+		QString url;
+		QString filePath;
+	};
+
+	//downloader's thread
+	void startRequests();
+	void startRequest(const Request& request);
+	//ends a request started by startRequests()
+	void finishRequest(const Request& request, const bool ok);
+
+	static bool isValidSize(const QString& fileName, const qint64 size);
+
+private:
+	QThread m_thread;
+	//lives in m_thread, parent of the network manager and the replies
+	QObject* m_worker = nullptr;
+	QNetworkAccessManager* m_network = nullptr;
+
+	mutable QMutex m_lock;
+	QString m_serverAddress;
+	QString m_cachePath;
+	int m_maxConcurrent = 4;
+	int m_retryInterval = 60000;
+	int m_running = 0;
+	QQueue<Request> m_queue;
+	//queued and in flight
+	QSet<QString> m_active;
+	//file name - m_clock time of the failure
+	QHash<QString, qint64> m_failed;
+	QElapsedTimer m_clock;
+};
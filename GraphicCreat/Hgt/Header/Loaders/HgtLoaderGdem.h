@@ -0,0 +1,94 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QList>
+#include <QVector>
+#include <QPointF>
+#include <QFile>
+#include <QMap>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QSet>
+#include <QHash>
+#include <QElapsedTimer>
+#include <QSharedPointer>
+#include "IHgtLoader.h"
+#include "GeoTiffReader.h"
+#include "../HgtSettings.h"
+
+struct GdemCache : public TileStorage {
+    GdemCache() {}
+    ~GdemCache() override {
+        delete gdemFile; //this will unmap and close the file
+    }
+    QFile*  gdemFile = nullptr;
+    quint8* data = nullptr;
+    qint64 fileSize = 0;
+    //reader and raster are used under readerLock
+    QMutex readerLock;
+    GeoTiffReader reader;
+    //decoded int16 raster, filled on first request of the whole tile
+    QByteArray raster;
+};
+
+/**
+ * @brief ASTER GDEM loader, reads GeoTIFF tiles directly from memory mapped files without GDAL.
+ * Tiles returned by getHgtTilesByRect() hold row-major native-endian int16 samples.
+ */
+class HgtLoaderGdem : public IHgtLoader
+{
+public:
+    HgtLoaderGdem(HgtSettings* settings, QObject* parent = 0);
+	~HgtLoaderGdem();
+
+	bool getElevation(qint16& elevation, const double lon, const double lat, const bool saveTileInsideModule);
+
+    QString getHgtFilePathAndNameFromCoordinates(const QPointF& geoPos);
+
+    QVector<QPointF> getLeftBottomLocalHgt(const QString& dirPath);
+
+	QList<TileOwn> getHgtTilesByPolygon(const QList<QPointF>& nodes, const bool saveTilesInsideModule);
+	QList<TileOwn> getHgtTilesByRect(const double minLon, const double maxLon,
+											  const double minLat, const double maxLat, const bool saveTilesInsideModule);
+
+	bool getElevationFromTile(qint16& elevation, const double lon, const double lat, const QByteArray& data,
+							  const QSysInfo::Endian byteOrder);
+	bool getTileHandle(TileHandle& handle, const double lon, const double lat);
+	// O/35/ASTGTMV003_N59E029_dem.tif
+	QString getHgtHalfPathFileName(const double lon, const double lat) const;
+
+    bool getHgtFileOffset(qint64& offset, const double lon, const double lat) const;
+	void forgetTile(const QPoint& leftBottomCorner);
+
+	// ASTGTMV003_N59E029_dem.tif
+	QString getHgtName(const double lon, const double lat) const;
+
+private:
+	bool isCorrectPoint(const double lon, const double lat) const;
+	int getLonIndex(const double lon) const;
+	int getLatIndex(const double lat) const;
+	QString getLonCellName(const double lon) const;
+	QString getLatCellName(const double lat) const;
+    HgtSettings* m_settings = nullptr;
+    QMutex  m_cacheLock;
+    QList<quint32> m_CashKey;
+    //entries are shared with TileHandles, eviction only drops the cache reference
+    QMap<quint32, QSharedPointer<GdemCache>> m_Cash;
+    //tiles being opened outside m_cacheLock, m_tileOpened is signalled when one is cached
+    QSet<quint32> m_opening;
+    QWaitCondition m_tileOpened;
+    //tiles found missing while downloads are enabled - m_missingClock time of the check
+    QHash<quint32, qint64> m_missingSince;
+    QElapsedTimer m_missingClock;
+
+    bool getHgt(const double lon, const double lat, TileHandle* handle, qint16* elevation = nullptr);
+    QSharedPointer<GdemCache> openTile(const QString& gdemFileName);
+
+	QPointF getLeftBottomNode(const QString& hgtName);
+
+private:
+	const QString gdemPrefix = "ASTGTMV003_";
+	const QString gdemSuffix = "_dem.tif";
+
+};
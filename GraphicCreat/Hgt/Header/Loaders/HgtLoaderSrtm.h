@@ -10,20 +10,32 @@
 #include <limits>
 #include <QMap>
 #include <QMutex>
+#include <QWaitCondition>
+#include <QSet>
+#include <QHash>
+#include <QElapsedTimer>
+#include <QSharedPointer>
+#include <QSharedMemory>
 #include "IHgtLoader.h"
 #include "../HgtSettings.h"
 
 class QThread;
 class QRectF;
 
-struct SrtmCache {
+struct SrtmCache : public TileStorage {
     SrtmCache() {}
-    ~SrtmCache() {
+    ~SrtmCache() override {
         delete hgtFile; //this will unmap and close the file
+        delete sharedMemory; //detaches, the last process removes the segment
     }
     QFile*  hgtFile = nullptr;
+    QSharedMemory* sharedMemory = nullptr;
     quint8* data = nullptr;
     qint64 fileSize = 0;
+    //data holds native-endian samples from NativeTileCache
+    bool nativeEndian = false;
+    //in-memory conversion if the native cache file can't be written
+    QByteArray nativeData;
 };
 
 class HgtLoaderSrtm : public IHgtLoader
@@ -58,12 +70,19 @@ public:
 	 */
 	//QList<TileOwn> getSavedMap();
 
-	bool getElevationFromTile(qint16& elevation, const double lon, const double lat, const QByteArray data);
+	bool getElevationFromTile(qint16& elevation, const double lon, const double lat, const QByteArray& data,
+							  const QSysInfo::Endian byteOrder);
+	bool getTileHandle(TileHandle& handle, const double lon, const double lat);
 	// O/35/N59E029.hgt
 	// P/36/N60E030.hgt
 	QString getHgtHalfPathFileName(const double lon, const double lat) const;
 
     bool getHgtFileOffset(qint64& offset, const double lon, const double lat) const;
+	void forgetTile(const QPoint& leftBottomCorner);
+
+	// N59E029.hgt
+	// N60E030.hgt
+	QString getHgtName(const double lon, const double lat) const;
 
 private:
 	bool isCorrectPoint(const double lon, const double lat) const;
@@ -74,13 +93,20 @@ private:
     HgtSettings* m_settings = nullptr;
     QMutex  m_cacheLock;
     QList<quint32> m_CashKey;
-    QMap<quint32, SrtmCache*> m_Cash;
-
-    bool getHgt(const double lon, const double lat, QByteArray *dat, qint16* elevation = nullptr);
-
-	// N59E029.hgt
-	// N60E030.hgt
-	QString getHgtName(const double lon, const double lat) const;
+    //entries are shared with TileHandles, eviction only drops the cache reference
+    QMap<quint32, QSharedPointer<SrtmCache>> m_Cash;
+    //tiles being opened outside m_cacheLock, m_tileOpened is signalled when one is cached
+    QSet<quint32> m_opening;
+    QWaitCondition m_tileOpened;
+    //tiles found missing while downloads are enabled - m_missingClock time of the check
+    QHash<quint32, qint64> m_missingSince;
+    QElapsedTimer m_missingClock;
+
+    bool getHgt(const double lon, const double lat, TileHandle* handle, qint16* elevation = nullptr);
+    QSharedPointer<SrtmCache> openTile(const QString& hgtFileName);
+    bool openNativeTile(SrtmCache* srtm, const QString& hgtFileName);
+    bool openSharedTile(SrtmCache* srtm, const QString& hgtFileName);
+    bool convertTileInMemory(SrtmCache* srtm, const QString& hgtFileName);
 
 	QPointF getLeftBottomNode(const QString& hgtName);
 
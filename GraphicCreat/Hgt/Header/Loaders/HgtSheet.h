@@ -0,0 +1,34 @@
+#pragma once
+
+#include <QPoint>
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief one .hgt file read into rows of samples, the way MainWindow shows a single sheet.
+ * Samples are read one by one through QDataStream, which is the baseline the benchmarks compare HgtLoader with.
+ */
+class HgtSheet
+{
+public:
+	HgtSheet() {}
+
+	/**
+	 * @param gridSize: samples per side, 1201 for SRTM3 and 3601 for SRTM1
+	 * @param leftBottomCorner: lon,lat of the south-western sample
+	 */
+	bool read(const QString& filePath, const int gridSize, const QPoint& leftBottomCorner);
+
+	bool isEmpty() const {return m_rows.isEmpty();}
+	int gridSize() const {return m_gridSize;}
+
+	/**
+	 * @brief sample to the north-west of lon,lat, clamped to the sheet, 0 for an empty sheet
+	 */
+	double height(const double lon, const double lat) const;
+
+private:
+	QVector<QVector<qint16>> m_rows;
+	int m_gridSize = 0;
+	QPoint m_leftBottomCorner;
+};
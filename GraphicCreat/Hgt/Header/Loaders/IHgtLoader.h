@@ -8,6 +8,8 @@
 #include <QCoreApplication>
 
 #include "../HgtSettings.h"
+#include "../HgtStats.h"
+#include "HgtDownloader.h"
 
 enum class HgtType {
 	Unknown,
@@ -51,11 +53,38 @@ public:
 	virtual QList<TileOwn> getHgtTilesByRect(const double minLon, const double maxLon,
 											  const double minLat, const double maxLat, const bool saveTilesInsideModule) = 0;
 
-    virtual bool getElevationFromTile(qint16& elevation, const double lon, const double lat, const QByteArray data) = 0;
+    //byteOrder of the samples in data, see TileOwn::byteOrder
+    virtual bool getElevationFromTile(qint16& elevation, const double lon, const double lat, const QByteArray& data,
+                                      const QSysInfo::Endian byteOrder) = 0;
+
+	/**
+	 * @brief reference counted handle of the tile containing the point, see TileHandle
+	 */
+	virtual bool getTileHandle(TileHandle& handle, const double lon, const double lat) = 0;
 	// O/35/N59E029.hgt
 	// P/36/N60E030.hgt
 	virtual QString getHgtHalfPathFileName(const double lon, const double lat) const = 0;
+	// N59E029.hgt, the file the tile is read from inside hgtCachePath
+	virtual QString getHgtName(const double lon, const double lat) const = 0;
 
 	virtual bool getHgtFileOffset(qint64& offset, const double lon, const double lat) const = 0;
 
+	/**
+	 * @brief drops the RAM cache entry of the tile, the next lookup opens its file again
+	 */
+	virtual void forgetTile(const QPoint& leftBottomCorner) = 0;
+
+	/**
+	 * @brief counters of the tile cache, see HgtLoader::stats()
+	 */
+	void setStats(const QSharedPointer<HgtStats>& stats) {m_stats = stats;}
+
+	/**
+	 * @brief tiles missing in the cache directory are requested from the downloader, null disables downloads
+	 */
+	void setDownloader(const QSharedPointer<HgtDownloader>& downloader) {m_downloader = downloader;}
+
+protected:
+	QSharedPointer<HgtStats> m_stats;
+	QSharedPointer<HgtDownloader> m_downloader;
 };
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QString>
+#include <QByteArray>
+#include <QFile>
+
+/**
+ * @brief on-disk cache of srtm tiles converted to native byte order (and optionally with filled voids).
+ * Cache files are created on first use next to each other in one directory, are checked against
+ * the size and modification time of the source .hgt file and are mapped directly.
+ * Samples start at a 64 byte aligned offset, so they can be streamed with SIMD loads.
+ */
+class NativeTileCache
+{
+public:
+	/**
+	 * @brief maps the native copy of sourceFileName, creates or refreshes it when needed.
+	 * @param file: receives the opened cache file, the caller owns it, deleting it unmaps the data
+	 * @param dataSize: receives the size of the sample data in bytes
+	 * @return pointer to the first sample or nullptr
+	 */
+	static uchar* mapTile(QFile*& file, qint64& dataSize, const QString& sourceFileName, const QString& cacheDir, const bool fillVoids);
+
+	/**
+	 * @brief converts big-endian .hgt samples to native byte order
+	 */
+	static bool convertTile(QByteArray& nativeData, const uchar* bigEndianData, const qint64 size, const bool fillVoids);
+	//into a caller buffer of size bytes
+	static bool convertTile(uchar* nativeData, const uchar* bigEndianData, const qint64 size, const bool fillVoids);
+
+	/**
+	 * @brief replaces void samples (-32768) by the inverse distance weighted mean of the nearest
+	 * valid samples to the left, right, top and bottom
+	 */
+	static void fillVoids(qint16* samples, const int sideSize);
+
+	// N40E042.hgt -> <cacheDir>/N40E042.le.hgtn or N40E042.le.filled.hgtn
+	static QString cacheFileName(const QString& sourceFileName, const QString& cacheDir, const bool fillVoids);
+
+private:
+	static bool isValidCacheFile(const uchar* data, const qint64 size, const QString& sourceFileName, const bool fillVoids);
+	static bool writeCacheFile(const QString& cacheFileName, const QString& sourceFileName, const bool fillVoids);
+};
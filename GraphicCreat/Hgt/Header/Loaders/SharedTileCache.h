@@ -0,0 +1,31 @@
+#pragma once
+
+#include <QString>
+
+class QSharedMemory;
+
+/**
+ * @brief host-wide cache of srtm tiles converted to native byte order (and optionally with filled voids)
+ * in shared memory, so processes reading the same tiles hold one copy of each.
+ * A tile's segment is keyed by its source file, modification time and fillVoids, the first process that
+ * needs the tile creates and fills it, the others attach it and poll its state until it is ready.
+ * The header holds the pid of the filling process; segments survive the processes that created them,
+ * so when that process has died before the tile was ready the first waiting process takes over and refills it.
+ * QSharedMemory itself serializes create/attach through a system semaphore.
+ */
+class SharedTileCache
+{
+public:
+	/**
+	 * @brief attaches the segment holding the native copy of sourceFileName, creates and fills it if there is none.
+	 * @param segment: receives the attached segment, the caller owns it, deleting it detaches
+	 * @param dataSize: receives the size of the sample data in bytes
+	 * @return pointer to the first sample or nullptr, then the caller has to load the tile itself
+	 */
+	static const uchar* attachTile(QSharedMemory*& segment, qint64& dataSize, const QString& sourceFileName, const bool fillVoids);
+
+	static QString segmentKey(const QString& sourceFileName, const bool fillVoids);
+
+	//converts sourceFileName into the samples of a segment
+	static bool fillSegment(uchar* data, const qint64 dataSize, const QString& sourceFileName, const bool fillVoids);
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <QByteArray>
+#include <QPoint>
+#include <QSharedPointer>
+#include <QSysInfo>
+#include <QMutex>
+#include <QHash>
+#include <QString>
+#include "HgtStats.h"
+
+class TileIntegral;
+class TileMaxPyramid;
+struct TerrainRaster;
+
+/**
+ * @brief base of the loaders' per-tile cache entries, a tile's memory stays valid while its storage is referenced
+ */
+struct TileStorage {
+	virtual ~TileStorage()
+	{
+		if (stats) {
+			stats->fileClosed(mappedBytes);
+		}
+	}
+
+	//set when the tile was mapped from a file, the gauges of HgtStats drop with the last reference
+	QSharedPointer<HgtStats> stats;
+	qint64 mappedBytes = 0;
+
+	//summed-area tables, built on the first rectangle query (HgtLoader::getRectStatistics), dropped over maxIntegralMemory()
+	QMutex integralLock;
+	QSharedPointer<const TileIntegral> integral;
+
+	//block maxima, built on the first clearance query (HgtLoader::getTileMaxPyramid)
+	QMutex maxPyramidLock;
+	QSharedPointer<const TileMaxPyramid> maxPyramid;
+
+	//rasters derived from the tile (TerrainDerivatives::cached), keyed by product and parameters, dropped over maxCacheMemory()
+	QMutex derivedLock;
+	QHash<QString, QSharedPointer<const TerrainRaster>> derived;
+};
+
+/**
+ * @brief reference counted, zero-copy handle of one tile's samples.
+ * Keeps the tile mapped while held, also after the loader evicted the tile from its cache.
+ * Copying a handle is cheap and thread safe.
+ */
+class TileHandle
+{
+public:
+	TileHandle() {}
+	TileHandle(const QSharedPointer<TileStorage>& storage, const uchar* data, const qint64 size,
+			   const QPoint& leftBottomCorner, const QSysInfo::Endian byteOrder) :
+		m_storage(storage),
+		m_data(data),
+		m_size(size),
+		m_leftBottomCorner(leftBottomCorner),
+		m_byteOrder(byteOrder)
+	{
+	}
+
+	bool isValid() const {return m_storage && m_data;}
+
+	const uchar* data() const {return m_data;}
+	qint64 size() const {return m_size;}
+	QPoint leftBottomCorner() const {return m_leftBottomCorner;}
+	//byte order of the int16 samples
+	QSysInfo::Endian byteOrder() const {return m_byteOrder;}
+	QSharedPointer<TileStorage> storage() const {return m_storage;}
+
+	/**
+	 * @brief QByteArray over the samples without copying, valid only while this handle (or a copy) is held
+	 */
+	QByteArray rawData() const {return QByteArray::fromRawData(reinterpret_cast<const char*>(m_data), int(m_size));}
+
+	void reset() {*this = TileHandle();}
+
+private:
+	QSharedPointer<TileStorage> m_storage;
+	const uchar* m_data = nullptr;
+	qint64 m_size = 0;
+	QPoint m_leftBottomCorner;
+	QSysInfo::Endian m_byteOrder = QSysInfo::BigEndian;
+};
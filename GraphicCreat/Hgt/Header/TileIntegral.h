@@ -0,0 +1,115 @@
+#pragma once
+
+#include <QVector>
+#include <QPair>
+#include <QSharedPointer>
+#include <QtConcurrent>
+#include <limits>
+
+/**
+ * @brief mean and variance of the samples of a lon/lat rectangle, voids are skipped
+ */
+struct RectStatistics {
+	qint64 count = 0;
+	qint64 voidCount = 0;
+	//tiles inside the rectangle that could not be loaded
+	int missingTiles = 0;
+	double mean = 0.0;
+	//population variance
+	double variance = 0.0;
+
+	bool isValid() const {return count > 0;}
+};
+
+/**
+ * @brief summed-area tables of one tile: sums, sums of squares and void counts.
+ * The sum of any sample rectangle is read with four lookups.
+ * Memory is (side+1)^2 * 20 bytes, about 29 MB for SRTM3 and 260 MB for SRTM1 tiles.
+ */
+class TileIntegral
+{
+public:
+	/**
+	 * @brief builds the tables from a TileView, rows and then columns are accumulated on the global thread pool
+	 */
+	template<typename View>
+	static QSharedPointer<const TileIntegral> build(const View& view);
+
+	int sideSize() const {return m_stride - 1;}
+	//bytes of the tables
+	qint64 memory() const {return qint64(m_sum.size())*(sizeof(qint64) + sizeof(qint64) + sizeof(qint32));}
+
+	/**
+	 * @brief sums of the samples col0..col1, row0..row1 (inclusive, row 0 is the northern edge)
+	 */
+	inline void query(qint64& sum, qint64& sumSq, qint64& voidCount, const int col0, const int row0, const int col1, const int row1) const
+	{
+		const qint64 a = qint64(row0)*m_stride + col0;
+		const qint64 b = qint64(row0)*m_stride + col1 + 1;
+		const qint64 c = qint64(row1 + 1)*m_stride + col0;
+		const qint64 d = qint64(row1 + 1)*m_stride + col1 + 1;
+		sum = m_sum.at(d) - m_sum.at(b) - m_sum.at(c) + m_sum.at(a);
+		sumSq = m_sumSq.at(d) - m_sumSq.at(b) - m_sumSq.at(c) + m_sumSq.at(a);
+		voidCount = m_void.at(d) - m_void.at(b) - m_void.at(c) + m_void.at(a);
+	}
+
+private:
+	explicit TileIntegral(const int sideSize);
+	static void accumulateColumns(qint64* sums, qint64* sumsSq, qint32* voidCounts, const int stride,
+								  const int colBegin, const int colEnd);
+
+private:
+	//(side+1) x (side+1), first row and column are zero
+	int m_stride = 0;
+	QVector<qint64> m_sum;
+	QVector<qint64> m_sumSq;
+	QVector<qint32> m_void;
+};
+
+template<typename View>
+QSharedPointer<const TileIntegral> TileIntegral::build(const View& view)
+{
+	const int sideSize = View::SIDE_SIZE;
+	QSharedPointer<TileIntegral> integral(new TileIntegral(sideSize));
+	TileIntegral* table = integral.data();
+	//taken once, the tables are written from several threads
+	qint64* sums = table->m_sum.data();
+	qint64* sumsSq = table->m_sumSq.data();
+	qint32* voidCounts = table->m_void.data();
+	const int stride = table->m_stride;
+
+	//row prefix sums, independent per row
+	QVector<int> rows(sideSize);
+	for (int row = 0; row < sideSize; ++row) rows[row] = row;
+	QtConcurrent::blockingMap(rows, [&view, sums, sumsSq, voidCounts, stride, sideSize](const int row) {
+		QVector<qint16> samples(sideSize);
+		view.readRow(samples.data(), row, 0, sideSize);
+		const qint64 base = qint64(row + 1)*stride + 1;
+		qint64 sum = 0;
+		qint64 sumSq = 0;
+		qint32 voids = 0;
+		for (int col = 0; col < sideSize; ++col) {
+			const qint16 value = samples.at(col);
+			const bool isVoid = value == std::numeric_limits<qint16>::min();
+			const qint64 masked = isVoid ? 0 : value;
+			sum += masked;
+			sumSq += masked*masked;
+			voids += isVoid;
+			sums[base + col] = sum;
+			sumsSq[base + col] = sumSq;
+			voidCounts[base + col] = voids;
+		}
+	});
+
+	//column sums, independent per column block
+	const int blockSize = 256;
+	QVector<QPair<int, int>> blocks;
+	for (int col = 1; col <= sideSize; col += blockSize) {
+		blocks.append(qMakePair(col, std::min(col + blockSize, sideSize + 1)));
+	}
+	QtConcurrent::blockingMap(blocks, [sums, sumsSq, voidCounts, stride](const QPair<int, int>& block) {
+		accumulateColumns(sums, sumsSq, voidCounts, stride, block.first, block.second);
+	});
+
+	return integral;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <QVector>
+#include <QSharedPointer>
+#include <QtConcurrent>
+#include <algorithm>
+#include <limits>
+
+/**
+ * @brief upper bounds of the elevations of one tile: maxima of BLOCK_SIZE x BLOCK_SIZE sample blocks,
+ * coarsened by 2 per level up to the maximum of the whole tile. Voids are ignored, a block of voids only is
+ * -32768. About 16 KB for SRTM3 and 140 KB for SRTM1 tiles.
+ */
+class TileMaxPyramid
+{
+public:
+	static const int BLOCK_SIZE = 16;
+
+	template<typename View>
+	static QSharedPointer<const TileMaxPyramid> build(const View& view);
+
+	int sideSize() const {return m_sideSize;}
+	qint16 tileMax() const {return m_levels.last().first();}
+
+	/**
+	 * @brief upper bound of the samples col0..col1, row0..row1 (inclusive, row 0 is the northern edge),
+	 * read from the finest level whose blocks are at least half the rectangle, at most 9 lookups
+	 */
+	qint16 query(int col0, int row0, int col1, int row1) const;
+
+private:
+	explicit TileMaxPyramid(const int sideSize);
+	void buildLevels();
+
+private:
+	int m_sideSize = 0;
+	//blocks per side of each level, level 0 has the finest blocks
+	QVector<int> m_widths;
+	QVector<QVector<qint16>> m_levels;
+};
+
+template<typename View>
+QSharedPointer<const TileMaxPyramid> TileMaxPyramid::build(const View& view)
+{
+	const int sideSize = View::SIDE_SIZE;
+	QSharedPointer<TileMaxPyramid> pyramid(new TileMaxPyramid(sideSize));
+	const int width = pyramid->m_widths.first();
+	qint16* blocks = pyramid->m_levels.first().data();
+
+	//rows of blocks are independent
+	QVector<int> blockRows(width);
+	for (int i = 0; i < width; ++i) blockRows[i] = i;
+	QtConcurrent::blockingMap(blockRows, [&view, blocks, width, sideSize](const int blockRow) {
+		QVector<qint16> samples(sideSize);
+		qint16* maxima = blocks + qint64(blockRow)*width;
+		const int rowEnd = std::min(sideSize, (blockRow + 1)*BLOCK_SIZE);
+		for (int row = blockRow*BLOCK_SIZE; row < rowEnd; ++row) {
+			view.readRow(samples.data(), row, 0, sideSize);
+			for (int col = 0; col < sideSize; ++col) {
+				qint16& value = maxima[col/BLOCK_SIZE];
+				value = std::max(value, samples.at(col));
+			}
+		}
+	});
+
+	pyramid->buildLevels();
+	return pyramid;
+}
@@ -2,9 +2,24 @@
 
 #include <QByteArray>
 #include <QPoint>
+#include <QSysInfo>
+#include "TileHandle.h"
 
 typedef struct TileOwn {
 	QPoint leftBottomCorner;
 	QByteArray data;
+	//byte order of the int16 samples in data
+	QSysInfo::Endian byteOrder = QSysInfo::BigEndian;
+	//keeps data valid while the tile is held, also after the loader evicted it
+	QSharedPointer<TileStorage> storage;
 } TileOwn;
 
+inline TileOwn tileOwnFromHandle(const TileHandle& handle) {
+	TileOwn tile;
+	tile.leftBottomCorner = handle.leftBottomCorner();
+	tile.data = handle.rawData();
+	tile.byteOrder = handle.byteOrder();
+	tile.storage = handle.storage();
+	return tile;
+}
+
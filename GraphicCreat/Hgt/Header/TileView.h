@@ -0,0 +1,201 @@
+#pragma once
+
+#include <QtEndian>
+#include <QSysInfo>
+#include <QPoint>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include "TileOwn.h"
+
+/**
+ * @brief converts one stored sample to its native value, resolved at compile time
+ */
+template<typename SampleT, QSysInfo::Endian Endian>
+struct TileSampleTraits
+{
+	static inline SampleT load(const uchar* src)
+	{
+		SampleT value;
+		memcpy(&value, src, sizeof(value));
+		return value;
+	}
+};
+
+template<>
+struct TileSampleTraits<qint16, QSysInfo::BigEndian>
+{
+	static inline qint16 load(const uchar* src) {return qFromBigEndian<qint16>(src);}
+};
+
+template<>
+struct TileSampleTraits<qint16, QSysInfo::LittleEndian>
+{
+	static inline qint16 load(const uchar* src) {return qFromLittleEndian<qint16>(src);}
+};
+
+template<>
+struct TileSampleTraits<float, QSysInfo::BigEndian>
+{
+	static inline float load(const uchar* src)
+	{
+		quint32 bits = qFromBigEndian<quint32>(src);
+		float value;
+		memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+};
+
+template<>
+struct TileSampleTraits<float, QSysInfo::LittleEndian>
+{
+	static inline float load(const uchar* src)
+	{
+		quint32 bits = qFromLittleEndian<quint32>(src);
+		float value;
+		memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+};
+
+/**
+ * @brief read only view of a 1x1 degree tile of Side x Side samples with samples on the tile edges (srtm layout).
+ * Sample type, grid size and byte order are template parameters, so offset computation and conversion
+ * are inlined into the caller's loop instead of going through IHgtLoader.
+ * The view does not own the data, the tile it was created from must outlive it.
+ */
+template<typename SampleT, int Side, QSysInfo::Endian Endian>
+class TileView
+{
+public:
+	typedef SampleT Sample;
+	static constexpr int SIDE_SIZE = Side;
+	static constexpr double PIX_PER_DEG = Side - 1;
+	static constexpr qint64 DATA_SIZE = qint64(Side)*Side*sizeof(SampleT);
+	static constexpr QSysInfo::Endian SAMPLE_BYTE_ORDER = Endian;
+
+	TileView() {}
+	TileView(const uchar* data, const qint64 size, const QPoint& leftBottomCorner) :
+		m_data(size >= DATA_SIZE ? data : nullptr),
+		m_lon(leftBottomCorner.x()),
+		m_lat(leftBottomCorner.y())
+	{
+	}
+	explicit TileView(const TileOwn& tile) :
+		TileView(reinterpret_cast<const uchar*>(tile.data.constData()), tile.data.size(), tile.leftBottomCorner)
+	{
+	}
+
+	bool isValid() const {return m_data != nullptr;}
+	QPoint leftBottomCorner() const {return QPoint(m_lon, m_lat);}
+
+	static constexpr qint64 offset(const int col, const int row) {return qint64(row)*Side + col;}
+
+	//stored bytes of the sample, in the view's byte order
+	inline const uchar* sampleData(const int col, const int row) const {return m_data + offset(col, row)*qint64(sizeof(SampleT));}
+
+	inline SampleT sample(const int col, const int row) const
+	{
+		return TileSampleTraits<SampleT, Endian>::load(m_data + offset(col, row)*qint64(sizeof(SampleT)));
+	}
+
+	/**
+	 * @brief sample as elevation in metres, non finite float samples are returned as void (-32768)
+	 */
+	inline qint16 elevation(const int col, const int row) const
+	{
+		return toElevation(sample(col, row));
+	}
+
+	/**
+	 * @brief nearest sample of the point, false if the point is outside of this tile
+	 */
+	inline bool getPixelIndex(int& col, int& row, const double lon, const double lat) const
+	{
+		double colF = (lon - m_lon)*PIX_PER_DEG + 0.5;
+		double rowF = (m_lat + 1 - lat)*PIX_PER_DEG + 0.5;
+		if (!(colF >= 0.0 && colF < Side) || !(rowF >= 0.0 && rowF < Side)) {
+			return false;
+		}
+		//values are non-negative here, truncation is floor
+		col = int(colF);
+		row = int(rowF);
+		return true;
+	}
+
+	inline bool getElevation(qint16& elevation, const double lon, const double lat) const
+	{
+		int col = 0;
+		int row = 0;
+		if (!m_data || !getPixelIndex(col, row, lon, lat)) {
+			return false;
+		}
+		elevation = this->elevation(col, row);
+		return true;
+	}
+
+	/**
+	 * @brief bilinear elevation at fractional sample coordinates, colF from the western and rowF from the northern edge.
+	 * If one of the four samples is void the nearest one is returned, NaN if that is void as well.
+	 */
+	inline float interpolate(const double colF, const double rowF) const
+	{
+		const int col = std::max(0, std::min(Side - 2, int(colF)));
+		const int row = std::max(0, std::min(Side - 2, int(rowF)));
+		const float fx = colF - col;
+		const float fy = rowF - row;
+		const qint16 a = elevation(col, row);
+		const qint16 b = elevation(col + 1, row);
+		const qint16 c = elevation(col, row + 1);
+		const qint16 d = elevation(col + 1, row + 1);
+		const qint16 invalid = std::numeric_limits<qint16>::min();
+		if (a != invalid && b != invalid && c != invalid && d != invalid) {
+			const float top = a + (b - a)*fx;
+			const float bottom = c + (d - c)*fx;
+			return top + (bottom - top)*fy;
+		}
+		const qint16 nearest = fy < 0.5f ? (fx < 0.5f ? a : b) : (fx < 0.5f ? c : d);
+		return nearest == invalid ? std::numeric_limits<float>::quiet_NaN() : float(nearest);
+	}
+
+	/**
+	 * @brief converts count samples of the row starting at col to native values
+	 */
+	template<typename OutT>
+	inline void readRow(OutT* out, const int row, const int col, const int count) const
+	{
+		const uchar* src = m_data + offset(col, row)*qint64(sizeof(SampleT));
+		for (int i = 0; i < count; ++i) {
+			out[i] = OutT(TileSampleTraits<SampleT, Endian>::load(src + qint64(i)*sizeof(SampleT)));
+		}
+	}
+
+private:
+	static inline qint16 toElevation(const qint16 value) {return value;}
+	static inline qint16 toElevation(const float value)
+	{
+		if (!std::isfinite(value)) {
+			return std::numeric_limits<qint16>::min();
+		}
+		return qint16(std::max(-32767.0f, std::min(32767.0f, std::round(value))));
+	}
+
+private:
+	const uchar* m_data = nullptr;
+	int m_lon = 0;
+	int m_lat = 0;
+};
+
+//SRTM3 .hgt, 3 arc second
+typedef TileView<qint16, 1201, QSysInfo::BigEndian> Srtm3TileView;
+//SRTM1 .hgt, 1 arc second
+typedef TileView<qint16, 3601, QSysInfo::BigEndian> Srtm1TileView;
+//native-endian copies from NativeTileCache
+typedef TileView<qint16, 1201, QSysInfo::ByteOrder> Srtm3NativeTileView;
+typedef TileView<qint16, 3601, QSysInfo::ByteOrder> Srtm1NativeTileView;
+//decoded GDEM rasters handed out by HgtLoaderGdem
+typedef TileView<qint16, 3601, QSysInfo::ByteOrder> GdemTileView;
+typedef TileView<qint16, 1201, QSysInfo::ByteOrder> GdemLowResTileView;
+//float32 little-endian rasters
+typedef TileView<float, 3601, QSysInfo::LittleEndian> Float32TileView;
@@ -0,0 +1,81 @@
+# elevation module, include from a .pro with include(Hgt/Hgt.pri)
+
+QT += core gui concurrent network
+
+CONFIG += c++17
+
+# qmake CONFIG+=hgt_trace compiles in the HGT_TRACE_SCOPE spans (HgtTrace.h)
+hgt_trace {
+    DEFINES += HGT_TRACE
+}
+
+INCLUDEPATH += \
+    $$PWD/Header \
+    $$PWD/Header/Loaders \
+    $$PWD/Header/Geo \
+    $$PWD/Header/Analysis
+
+HEADERS += \
+    $$PWD/Header/CpuFeatures.h \
+    $$PWD/Header/HgtLoader.h \
+    $$PWD/Header/HgtSettings.h \
+    $$PWD/Header/HgtStats.h \
+    $$PWD/Header/HgtTrace.h \
+    $$PWD/Header/TileHandle.h \
+    $$PWD/Header/TileIntegral.h \
+    $$PWD/Header/TileMaxPyramid.h \
+    $$PWD/Header/TileOwn.h \
+    $$PWD/Header/TileView.h \
+    $$PWD/Header/Loaders/IHgtLoader.h \
+    $$PWD/Header/Loaders/HgtLoaderSrtm.h \
+    $$PWD/Header/Loaders/HgtLoaderGdem.h \
+    $$PWD/Header/Loaders/GeoTiffReader.h \
+    $$PWD/Header/Loaders/NativeTileCache.h \
+    $$PWD/Header/Loaders/SharedTileCache.h \
+    $$PWD/Header/Loaders/HgtDownloader.h \
+    $$PWD/Header/Loaders/HgtSheet.h \
+    $$PWD/Header/Geo/GeoConstants.h \
+    $$PWD/Header/Geo/GeoidGrid.h \
+    $$PWD/Header/Geo/PolygonRaster.h \
+    $$PWD/Header/Geo/UtmProjection.h \
+    $$PWD/Header/Analysis/ContourGenerator.h \
+    $$PWD/Header/Analysis/CutFillVolume.h \
+    $$PWD/Header/Analysis/Hydrology.h \
+    $$PWD/Header/Analysis/LeastCostPath.h \
+    $$PWD/Header/Analysis/PolygonTileWalk.h \
+    $$PWD/Header/Analysis/RadioPathProfile.h \
+    $$PWD/Header/Analysis/RouteProfile.h \
+    $$PWD/Header/Analysis/TerrainClearance.h \
+    $$PWD/Header/Analysis/TerrainDerivatives.h \
+    $$PWD/Header/Analysis/UtmResampler.h \
+    $$PWD/Header/Analysis/XyzTileGenerator.h \
+    $$PWD/Header/Analysis/ZonalStatistics.h
+
+SOURCES += \
+    $$PWD/Source/HgtLoader.cpp \
+    $$PWD/Source/HgtStats.cpp \
+    $$PWD/Source/HgtTrace.cpp \
+    $$PWD/Source/TileIntegral.cpp \
+    $$PWD/Source/TileMaxPyramid.cpp \
+    $$PWD/Source/Loaders/HgtLoaderSrtm.cpp \
+    $$PWD/Source/Loaders/HgtLoaderGdem.cpp \
+    $$PWD/Source/Loaders/GeoTiffReader.cpp \
+    $$PWD/Source/Loaders/NativeTileCache.cpp \
+    $$PWD/Source/Loaders/SharedTileCache.cpp \
+    $$PWD/Source/Loaders/HgtDownloader.cpp \
+    $$PWD/Source/Loaders/HgtSheet.cpp \
+    $$PWD/Source/Geo/GeoConstants.cpp \
+    $$PWD/Source/Geo/GeoidGrid.cpp \
+    $$PWD/Source/Geo/PolygonRaster.cpp \
+    $$PWD/Source/Geo/UtmProjection.cpp \
+    $$PWD/Source/Analysis/ContourGenerator.cpp \
+    $$PWD/Source/Analysis/CutFillVolume.cpp \
+    $$PWD/Source/Analysis/Hydrology.cpp \
+    $$PWD/Source/Analysis/LeastCostPath.cpp \
+    $$PWD/Source/Analysis/RadioPathProfile.cpp \
+    $$PWD/Source/Analysis/RouteProfile.cpp \
+    $$PWD/Source/Analysis/TerrainClearance.cpp \
+    $$PWD/Source/Analysis/TerrainDerivatives.cpp \
+    $$PWD/Source/Analysis/UtmResampler.cpp \
+    $$PWD/Source/Analysis/XyzTileGenerator.cpp \
+    $$PWD/Source/Analysis/ZonalStatistics.cpp
@@ -0,0 +1,409 @@
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <QFutureSynchronizer>
+#include <QHash>
+#include <QtMath>
+#include <QDebug>
+#include <algorithm>
+#include <limits>
+#include "ContourGenerator.h"
+
+//global sample indices are shifted by this to make edge keys unsigned
+const qint64 EDGE_KEY_OFFSET_CONTOUR = qint64(1) << 22;
+
+enum ContourEdge {
+	EDGE_TOP = 0,
+	EDGE_RIGHT = 1,
+	EDGE_BOTTOM = 2,
+	EDGE_LEFT = 3
+};
+
+//edge pairs of the marching squares cases, bit 8 = top left, 4 = top right, 2 = bottom right, 1 = bottom left.
+//saddles 5 and 10 are resolved by the cell centre
+const int CASE_EDGES_CONTOUR[16][2] = {
+	{-1, -1}, {EDGE_LEFT, EDGE_BOTTOM}, {EDGE_BOTTOM, EDGE_RIGHT}, {EDGE_LEFT, EDGE_RIGHT},
+	{EDGE_TOP, EDGE_RIGHT}, {-1, -1}, {EDGE_TOP, EDGE_BOTTOM}, {EDGE_LEFT, EDGE_TOP},
+	{EDGE_LEFT, EDGE_TOP}, {EDGE_TOP, EDGE_BOTTOM}, {-1, -1}, {EDGE_TOP, EDGE_RIGHT},
+	{EDGE_LEFT, EDGE_RIGHT}, {EDGE_BOTTOM, EDGE_RIGHT}, {EDGE_LEFT, EDGE_BOTTOM}, {-1, -1}
+};
+
+struct ContourSegment {
+	int level = 0;
+	quint64 keys[2];
+	//global sample grid units
+	QPointF points[2];
+};
+
+/**
+ * @brief cells [col0,col1) x [row0,row1) of one tile
+ */
+struct ContourBlock {
+	TileHandle tile;
+	//neighbours that own the shared top row and right column, invalid if not available
+	TileHandle north;
+	TileHandle east;
+	TileHandle northEast;
+	int col0 = 0;
+	int row0 = 0;
+	int col1 = 0;
+	int row1 = 0;
+	bool hasValid = false;
+	qint16 min = std::numeric_limits<qint16>::max();
+	qint16 max = std::numeric_limits<qint16>::min();
+	QVector<ContourSegment> segments;
+};
+
+static inline quint64 edgeKey(const qint64 gx, const qint64 gy, const int vertical)
+{
+	return ((quint64(gx + EDGE_KEY_OFFSET_CONTOUR) << 24 | quint64(gy + EDGE_KEY_OFFSET_CONTOUR)) << 1) | quint64(vertical);
+}
+
+/**
+ * @brief samples of the block including the cells' right and bottom corners.
+ * Neighbouring tiles do not always agree on the samples of their shared edge, so the top row is taken
+ * from the northern tile and the right column from the eastern one, both sides of a seam then see the same values.
+ */
+static void readBlockSamples(HgtLoader* loader, const ContourBlock& block, QVector<qint16>& samples, const int sideSize)
+{
+	const int width = block.col1 - block.col0 + 1;
+	const int height = block.row1 - block.row0 + 1;
+	samples.resize(width*height);
+	loader->visitTileView(block.tile, [&](const auto& view) {
+		for (int row = block.row0; row <= block.row1; ++row) {
+			view.readRow(samples.data() + (row - block.row0)*width, row, block.col0, width);
+		}
+	});
+
+	if (block.row0 == 0 && block.north.isValid()) {
+		loader->visitTileView(block.north, [&](const auto& view) {
+			view.readRow(samples.data(), sideSize - 1, block.col0, width);
+		});
+	}
+	if (block.col1 == sideSize - 1 && block.east.isValid()) {
+		loader->visitTileView(block.east, [&](const auto& view) {
+			for (int row = std::max(1, block.row0); row <= block.row1; ++row) {
+				view.readRow(samples.data() + (row - block.row0)*width + width - 1, row, 0, 1);
+			}
+		});
+		if (block.row0 == 0 && block.northEast.isValid()) {
+			loader->visitTileView(block.northEast, [&](const auto& view) {
+				view.readRow(samples.data() + width - 1, sideSize - 1, 0, 1);
+			});
+		}
+	}
+}
+
+static void blockMinMax(HgtLoader* loader, ContourBlock& block, const int sideSize)
+{
+	QVector<qint16> samples;
+	readBlockSamples(loader, block, samples, sideSize);
+	for (qint16 value : samples) {
+		if (value == ERROR_ELEVATION_SRTM_HGT) continue;
+		block.hasValid = true;
+		block.min = std::min(block.min, value);
+		block.max = std::max(block.max, value);
+	}
+}
+
+static void marchBlock(HgtLoader* loader, ContourBlock& block, const QVector<double>& levels, const int sideSize)
+{
+	QVector<qint16> samples;
+	readBlockSamples(loader, block, samples, sideSize);
+	const int width = block.col1 - block.col0 + 1;
+	const qint64 cellsPerDeg = sideSize - 1;
+	const qint64 gx0 = block.tile.leftBottomCorner().x()*cellsPerDeg;
+	const qint64 gyTop = (block.tile.leftBottomCorner().y() + 1)*cellsPerDeg;
+
+	for (int levelIndex = 0; levelIndex < levels.size(); ++levelIndex) {
+		const double level = levels.at(levelIndex);
+		if (!(block.min < level && level <= block.max)) {
+			continue;
+		}
+
+		for (int row = block.row0; row < block.row1; ++row) {
+			const qint16* top = samples.constData() + (row - block.row0)*width;
+			const qint16* bottom = top + width;
+			const qint64 gy = gyTop - row;
+			for (int col = block.col0; col < block.col1; ++col) {
+				const int i = col - block.col0;
+				const qint16 tl = top[i];
+				const qint16 tr = top[i + 1];
+				const qint16 br = bottom[i + 1];
+				const qint16 bl = bottom[i];
+				if (tl == ERROR_ELEVATION_SRTM_HGT || tr == ERROR_ELEVATION_SRTM_HGT
+						|| br == ERROR_ELEVATION_SRTM_HGT || bl == ERROR_ELEVATION_SRTM_HGT) {
+					continue;
+				}
+
+				const int index = (tl >= level) << 3 | (tr >= level) << 2 | (br >= level) << 1 | (bl >= level);
+				if (index == 0 || index == 15) {
+					continue;
+				}
+
+				const qint64 gx = gx0 + col;
+				//key and crossing point of a cell edge, values are always interpolated in the same direction,
+				//so the neighbour cell computes the identical point
+				auto crossing = [&](const int edge, quint64& key, QPointF& point) {
+					switch (edge) {
+					case EDGE_TOP:
+						key = edgeKey(gx, gy, 0);
+						point = QPointF(gx + (level - tl)/double(tr - tl), gy);
+						break;
+					case EDGE_BOTTOM:
+						key = edgeKey(gx, gy - 1, 0);
+						point = QPointF(gx + (level - bl)/double(br - bl), gy - 1);
+						break;
+					case EDGE_LEFT:
+						key = edgeKey(gx, gy - 1, 1);
+						point = QPointF(gx, gy - 1 + (level - bl)/double(tl - bl));
+						break;
+					default:
+						key = edgeKey(gx + 1, gy - 1, 1);
+						point = QPointF(gx + 1, gy - 1 + (level - br)/double(tr - br));
+						break;
+					}
+				};
+				auto addSegment = [&](const int edgeA, const int edgeB) {
+					ContourSegment segment;
+					segment.level = levelIndex;
+					crossing(edgeA, segment.keys[0], segment.points[0]);
+					crossing(edgeB, segment.keys[1], segment.points[1]);
+					block.segments.append(segment);
+				};
+
+				if (index == 5 || index == 10) {
+					const bool centreAbove = (tl + tr + br + bl)/4.0 >= level;
+					if ((index == 5) == centreAbove) {
+						addSegment(EDGE_LEFT, EDGE_TOP);
+						addSegment(EDGE_BOTTOM, EDGE_RIGHT);
+					} else {
+						addSegment(EDGE_TOP, EDGE_RIGHT);
+						addSegment(EDGE_LEFT, EDGE_BOTTOM);
+					}
+					continue;
+				}
+				addSegment(CASE_EDGES_CONTOUR[index][0], CASE_EDGES_CONTOUR[index][1]);
+			}
+		}
+	}
+}
+
+/**
+ * @brief joins the segments of one level at shared edge keys, open lines first, then closed rings
+ */
+static void stitchLevel(QList<ContourLine>& lines, const QVector<const ContourSegment*>& segments, const double level, const double pixPerDeg)
+{
+	QHash<quint64, QPair<int, int>> ends;
+	ends.reserve(segments.size()*2);
+	for (int i = 0; i < segments.size(); ++i) {
+		for (int end = 0; end < 2; ++end) {
+			auto it = ends.find(segments.at(i)->keys[end]);
+			if (it == ends.end()) {
+				ends.insert(segments.at(i)->keys[end], qMakePair(i, -1));
+			} else {
+				it.value().second = i;
+			}
+		}
+	}
+
+	auto toGeo = [pixPerDeg](const QPointF& point) {return QPointF(point.x()/pixPerDeg, point.y()/pixPerDeg);};
+	QVector<bool> used(segments.size(), false);
+
+	auto walk = [&](const int first, const int firstEnd) {
+		ContourLine line;
+		line.level = level;
+		int segment = first;
+		int entry = firstEnd;
+		line.points.append(toGeo(segments.at(segment)->points[entry]));
+		while (true) {
+			used[segment] = true;
+			const int exit = 1 - entry;
+			const quint64 key = segments.at(segment)->keys[exit];
+			line.points.append(toGeo(segments.at(segment)->points[exit]));
+			const QPair<int, int> pair = ends.value(key);
+			const int next = pair.first == segment ? pair.second : pair.first;
+			if (next < 0 || used.at(next)) {
+				line.closed = next == first && key == segments.at(first)->keys[firstEnd];
+				break;
+			}
+			entry = segments.at(next)->keys[0] == key ? 0 : 1;
+			segment = next;
+		}
+		lines.append(line);
+	};
+
+	for (int i = 0; i < segments.size(); ++i) {
+		for (int end = 0; end < 2 && !used.at(i); ++end) {
+			if (ends.value(segments.at(i)->keys[end]).second < 0) {
+				walk(i, end);
+			}
+		}
+	}
+	for (int i = 0; i < segments.size(); ++i) {
+		if (!used.at(i)) {
+			walk(i, 0);
+		}
+	}
+}
+
+ContourGenerator::ContourGenerator(HgtLoader* loader) :
+	m_loader(loader),
+	m_threadPool(QThreadPool::globalInstance())
+{
+}
+
+void ContourGenerator::setThreadPool(QThreadPool* threadPool)
+{
+	m_threadPool = threadPool ? threadPool : QThreadPool::globalInstance();
+}
+
+void ContourGenerator::setBlockSize(const int blockSize)
+{
+	m_blockSize = std::max(8, blockSize);
+}
+
+QList<ContourLine> ContourGenerator::generate(const double minLon, const double maxLon, const double minLat, const double maxLat,
+											  const QVector<double>& levels)
+{
+	return generate(minLon, maxLon, minLat, maxLat, levels, 0.0, 0.0);
+}
+
+QList<ContourLine> ContourGenerator::generate(const double minLon, const double maxLon, const double minLat, const double maxLat,
+											  const double interval, const double base)
+{
+	if (interval <= 0.0) {
+		qDebug() << "ContourGenerator.generate. Interval has to be positive.";
+		return QList<ContourLine>();
+	}
+	return generate(minLon, maxLon, minLat, maxLat, QVector<double>(), interval, base);
+}
+
+QList<ContourLine> ContourGenerator::generate(const double minLon, const double maxLon, const double minLat, const double maxLat,
+											  const QVector<double>& requestedLevels, const double interval, const double base)
+{
+	QList<ContourLine> retVal;
+
+	const double west = std::min(minLon, maxLon);
+	const double east = std::max(minLon, maxLon);
+	const double south = std::min(minLat, maxLat);
+	const double north = std::max(minLat, maxLat);
+
+	QList<TileHandle> tiles = m_loader->getTileHandlesByRect(west, east, south, north);
+	if (tiles.isEmpty()) {
+		return retVal;
+	}
+
+	//all tiles have to share the grid of the first one
+	const qint64 tileSize = tiles.first().size();
+	const int sideSize = qRound(sqrt(double(tileSize/sizeof(qint16))));
+	const double pixPerDeg = sideSize - 1;
+
+	QVector<ContourBlock> blocks;
+	for (const TileHandle& tile : tiles) {
+		if (tile.size() != tileSize || !m_loader->visitTileView(tile, [](const auto&) {})) {
+			qDebug() << "ContourGenerator.generate. Tile with different grid skipped.";
+			continue;
+		}
+		const QPoint corner = tile.leftBottomCorner();
+		//cells whose corners lie inside the rectangle
+		int col0 = std::max(0, int(ceil((west - corner.x())*pixPerDeg)));
+		int col1 = std::min(sideSize - 1, int(floor((east - corner.x())*pixPerDeg)));
+		int row0 = std::max(0, int(ceil((corner.y() + 1 - north)*pixPerDeg)));
+		int row1 = std::min(sideSize - 1, int(floor((corner.y() + 1 - south)*pixPerDeg)));
+
+		//only cells on the northern or eastern seam need the neighbours
+		TileHandle neighbours[3];
+		const QPoint offsets[3] = {QPoint(0, 1), QPoint(1, 0), QPoint(1, 1)};
+		const bool needed[3] = {row0 == 0, col1 == sideSize - 1, row0 == 0 && col1 == sideSize - 1};
+		for (int i = 0; i < 3; ++i) {
+			if (!needed[i]) continue;
+			if (!m_loader->getTileHandle(neighbours[i], corner.x() + offsets[i].x() + 0.5, corner.y() + offsets[i].y() + 0.5)
+					|| neighbours[i].size() != tileSize) {
+				neighbours[i].reset();
+			}
+		}
+		for (int row = row0; row < row1; row += m_blockSize) {
+			for (int col = col0; col < col1; col += m_blockSize) {
+				ContourBlock block;
+				block.tile = tile;
+				block.north = neighbours[0];
+				block.east = neighbours[1];
+				block.northEast = neighbours[2];
+				block.col0 = col;
+				block.row0 = row;
+				block.col1 = std::min(col1, col + m_blockSize);
+				block.row1 = std::min(row1, row + m_blockSize);
+				blocks.append(block);
+			}
+		}
+	}
+
+	HgtLoader* loader = m_loader;
+	{
+		QFutureSynchronizer<void> synchronizer;
+		for (int i = 0; i < blocks.size(); ++i) {
+			ContourBlock* block = &blocks[i];
+			synchronizer.addFuture(QtConcurrent::run(m_threadPool, [loader, block, sideSize]() {
+				blockMinMax(loader, *block, sideSize);
+			}));
+		}
+	}
+
+	QVector<double> levels = requestedLevels;
+	if (interval > 0.0) {
+		qint16 areaMin = std::numeric_limits<qint16>::max();
+		qint16 areaMax = std::numeric_limits<qint16>::min();
+		for (const ContourBlock& block : blocks) {
+			if (!block.hasValid) continue;
+			areaMin = std::min(areaMin, block.min);
+			areaMax = std::max(areaMax, block.max);
+		}
+		for (double level = ceil((areaMin - base)/interval)*interval + base; level <= areaMax; level += interval) {
+			levels.append(level);
+		}
+	}
+	if (levels.isEmpty()) {
+		return retVal;
+	}
+
+	{
+		QFutureSynchronizer<void> synchronizer;
+		for (int i = 0; i < blocks.size(); ++i) {
+			ContourBlock* block = &blocks[i];
+			if (!block->hasValid) continue;
+			//blocks no level crosses are not read again
+			auto crossed = std::find_if(levels.constBegin(), levels.constEnd(), [block](const double level) {
+				return block->min < level && level <= block->max;
+			});
+			if (crossed == levels.constEnd()) continue;
+			synchronizer.addFuture(QtConcurrent::run(m_threadPool, [loader, block, &levels, sideSize]() {
+				marchBlock(loader, *block, levels, sideSize);
+			}));
+		}
+	}
+
+	QVector<QVector<const ContourSegment*>> levelSegments(levels.size());
+	for (const ContourBlock& block : blocks) {
+		for (const ContourSegment& segment : block.segments) {
+			levelSegments[segment.level].append(&segment);
+		}
+	}
+
+	QVector<QList<ContourLine>> levelLines(levels.size());
+	{
+		QFutureSynchronizer<void> synchronizer;
+		for (int i = 0; i < levels.size(); ++i) {
+			QList<ContourLine>* lines = &levelLines[i];
+			const QVector<const ContourSegment*>* segments = &levelSegments.at(i);
+			const double level = levels.at(i);
+			synchronizer.addFuture(QtConcurrent::run(m_threadPool, [lines, segments, level, pixPerDeg]() {
+				stitchLevel(*lines, *segments, level, pixPerDeg);
+			}));
+		}
+	}
+
+	for (const QList<ContourLine>& lines : levelLines) {
+		retVal += lines;
+	}
+	return retVal;
+}
@@ -0,0 +1,288 @@
+#include <QThreadPool>
+#include <QtMath>
+#include <QDebug>
+#include <algorithm>
+#include <limits>
+#include "CutFillVolume.h"
+#include "PolygonTileWalk.h"
+#include "../Geo/GeoConstants.h"
+
+//barycentric coordinates down to this value count as inside, points on shared edges find a triangle
+const double TRIANGLE_EPS_CUT_FILL = 1e-12;
+
+struct CutFillJob {
+	CutFillResult result;
+	//design elevations of the current span
+	QVector<double> surface;
+	int triangleHint = -1;
+};
+
+struct CutFillRowSums {
+	double cut = 0.0;
+	double fill = 0.0;
+	int cutCount = 0;
+	int fillCount = 0;
+	int validCount = 0;
+	int voidCount = 0;
+};
+
+//branch free like accumulateSpan of ZonalStatistics, with blends for the NaN design
+static void accumulateRow(CutFillRowSums& sums, const qint16* terrain, const double* design, const int count)
+{
+	double cut = 0.0;
+	double fill = 0.0;
+	int cutCount = 0;
+	int fillCount = 0;
+	int validCount = 0;
+	int voidCount = 0;
+
+	for (int i = 0; i < count; ++i) {
+		const bool isVoid = terrain[i] == ERROR_ELEVATION_SRTM_HGT;
+		//design is NaN outside of the TIN, comparisons with NaN are false
+		const bool isValid = !isVoid && design[i] == design[i];
+		const double diff = isValid ? terrain[i] - design[i] : 0.0;
+		cut += std::max(diff, 0.0);
+		fill += std::max(-diff, 0.0);
+		cutCount += diff > 0.0;
+		fillCount += diff < 0.0;
+		validCount += isValid;
+		voidCount += isVoid;
+	}
+
+	sums.cut = cut;
+	sums.fill = fill;
+	sums.cutCount = cutCount;
+	sums.fillCount = fillCount;
+	sums.validCount = validCount;
+	sums.voidCount = voidCount;
+}
+
+static void accumulateSpan(CutFillJob& job, const PolygonSpanRow& row, const DesignSurface& design)
+{
+	const int count = row.count;
+	const double degPerPix = row.degPerPix();
+	const double lat = row.lat();
+	if (job.surface.size() < count) {
+		job.surface.resize(count);
+	}
+	double* surface = job.surface.data();
+
+	if (design.isPlane()) {
+		const double rowBase = design.z0() + design.dzdLat()*lat;
+		const double step = design.dzdLon()*degPerPix;
+		const double first = rowBase + design.dzdLon()*row.lon(0);
+		for (int i = 0; i < count; ++i) {
+			surface[i] = first + i*step;
+		}
+	} else {
+		for (int i = 0; i < count; ++i) {
+			double z = 0.0;
+			surface[i] = design.elevation(z, row.lon(i), lat, &job.triangleHint) ? z : std::numeric_limits<double>::quiet_NaN();
+		}
+	}
+
+	CutFillRowSums sums;
+	accumulateRow(sums, row.values, surface, count);
+
+	const double cellArea = CutFillVolume::cellArea(lat, degPerPix, degPerPix);
+	job.result.cutVolume += sums.cut*cellArea;
+	job.result.fillVolume += sums.fill*cellArea;
+	job.result.cutArea += sums.cutCount*cellArea;
+	job.result.fillArea += sums.fillCount*cellArea;
+	job.result.area += sums.validCount*cellArea;
+	job.result.count += sums.validCount;
+	job.result.voidCount += sums.voidCount;
+	job.result.outsideDesignCount += count - sums.validCount - sums.voidCount;
+}
+
+DesignSurface DesignSurface::horizontal(const double elevation)
+{
+	DesignSurface retVal;
+	retVal.m_type = Type::Plane;
+	retVal.m_z0 = elevation;
+	return retVal;
+}
+
+DesignSurface DesignSurface::plane(const DesignPoint& p1, const DesignPoint& p2, const DesignPoint& p3)
+{
+	DesignSurface retVal;
+
+	const double det = (p2.lon - p1.lon)*(p3.lat - p1.lat) - (p3.lon - p1.lon)*(p2.lat - p1.lat);
+	if (qFuzzyIsNull(det)) {
+		qDebug() << "DesignSurface.plane. Points are collinear.";
+		return retVal;
+	}
+
+	retVal.m_type = Type::Plane;
+	retVal.m_dzdLon = ((p2.elevation - p1.elevation)*(p3.lat - p1.lat) - (p3.elevation - p1.elevation)*(p2.lat - p1.lat))/det;
+	retVal.m_dzdLat = ((p2.lon - p1.lon)*(p3.elevation - p1.elevation) - (p3.lon - p1.lon)*(p2.elevation - p1.elevation))/det;
+	retVal.m_z0 = p1.elevation - retVal.m_dzdLon*p1.lon - retVal.m_dzdLat*p1.lat;
+	return retVal;
+}
+
+DesignSurface DesignSurface::tin(const QVector<DesignPoint>& vertices, const QVector<int>& triangles)
+{
+	DesignSurface retVal;
+	if (triangles.isEmpty() || triangles.size() % 3 != 0) {
+		qDebug() << "DesignSurface.tin. Incorrect triangle list.";
+		return retVal;
+	}
+	for (int index : triangles) {
+		if (index < 0 || index >= vertices.size()) {
+			qDebug() << "DesignSurface.tin. Triangle vertex index out of range.";
+			return retVal;
+		}
+	}
+
+	retVal.m_type = Type::Tin;
+	retVal.m_vertices = vertices;
+	retVal.m_triangles = triangles;
+	retVal.buildIndex();
+	return retVal;
+}
+
+void DesignSurface::buildIndex()
+{
+	double minLon = std::numeric_limits<double>::max();
+	double minLat = std::numeric_limits<double>::max();
+	double maxLon = -std::numeric_limits<double>::max();
+	double maxLat = -std::numeric_limits<double>::max();
+	for (const DesignPoint& point : m_vertices) {
+		minLon = std::min(minLon, point.lon);
+		maxLon = std::max(maxLon, point.lon);
+		minLat = std::min(minLat, point.lat);
+		maxLat = std::max(maxLat, point.lat);
+	}
+
+	//about one triangle per cell
+	const int triangleCount = m_triangles.size()/3;
+	const int cellsPerSide = std::max(1, int(ceil(sqrt(double(triangleCount)))));
+	m_indexLon = minLon;
+	m_indexLat = minLat;
+	m_indexCellSize = std::max(maxLon - minLon, maxLat - minLat)/cellsPerSide;
+	if (m_indexCellSize <= 0.0) {
+		m_indexCellSize = 1.0;
+	}
+	m_indexCols = int(floor((maxLon - minLon)/m_indexCellSize)) + 1;
+	m_indexRows = int(floor((maxLat - minLat)/m_indexCellSize)) + 1;
+	m_index = QVector<QVector<int>>(m_indexCols*m_indexRows);
+
+	for (int triangle = 0; triangle < triangleCount; ++triangle) {
+		const DesignPoint& a = m_vertices.at(m_triangles.at(3*triangle));
+		const DesignPoint& b = m_vertices.at(m_triangles.at(3*triangle + 1));
+		const DesignPoint& c = m_vertices.at(m_triangles.at(3*triangle + 2));
+		int col0 = floor((std::min({a.lon, b.lon, c.lon}) - m_indexLon)/m_indexCellSize);
+		int col1 = floor((std::max({a.lon, b.lon, c.lon}) - m_indexLon)/m_indexCellSize);
+		int row0 = floor((std::min({a.lat, b.lat, c.lat}) - m_indexLat)/m_indexCellSize);
+		int row1 = floor((std::max({a.lat, b.lat, c.lat}) - m_indexLat)/m_indexCellSize);
+		for (int row = std::max(0, row0); row <= std::min(m_indexRows - 1, row1); ++row) {
+			for (int col = std::max(0, col0); col <= std::min(m_indexCols - 1, col1); ++col) {
+				m_index[row*m_indexCols + col].append(triangle);
+			}
+		}
+	}
+}
+
+bool DesignSurface::triangleElevation(double& z, const int triangle, const double lon, const double lat) const
+{
+	const DesignPoint& a = m_vertices.at(m_triangles.at(3*triangle));
+	const DesignPoint& b = m_vertices.at(m_triangles.at(3*triangle + 1));
+	const DesignPoint& c = m_vertices.at(m_triangles.at(3*triangle + 2));
+
+	const double det = (b.lat - c.lat)*(a.lon - c.lon) + (c.lon - b.lon)*(a.lat - c.lat);
+	if (det == 0.0) {
+		return false;
+	}
+	const double wa = ((b.lat - c.lat)*(lon - c.lon) + (c.lon - b.lon)*(lat - c.lat))/det;
+	const double wb = ((c.lat - a.lat)*(lon - c.lon) + (a.lon - c.lon)*(lat - c.lat))/det;
+	const double wc = 1.0 - wa - wb;
+	if (wa < -TRIANGLE_EPS_CUT_FILL || wb < -TRIANGLE_EPS_CUT_FILL || wc < -TRIANGLE_EPS_CUT_FILL) {
+		return false;
+	}
+
+	z = wa*a.elevation + wb*b.elevation + wc*c.elevation;
+	return true;
+}
+
+bool DesignSurface::elevation(double& z, const double lon, const double lat, int* triangleHint) const
+{
+	if (m_type == Type::Plane) {
+		z = m_z0 + m_dzdLon*lon + m_dzdLat*lat;
+		return true;
+	}
+	if (m_type != Type::Tin) {
+		return false;
+	}
+
+	if (triangleHint && *triangleHint >= 0 && triangleElevation(z, *triangleHint, lon, lat)) {
+		return true;
+	}
+
+	int col = floor((lon - m_indexLon)/m_indexCellSize);
+	int row = floor((lat - m_indexLat)/m_indexCellSize);
+	if (col < 0 || col >= m_indexCols || row < 0 || row >= m_indexRows) {
+		return false;
+	}
+
+	for (int triangle : m_index.at(row*m_indexCols + col)) {
+		if (triangleElevation(z, triangle, lon, lat)) {
+			if (triangleHint) {
+				*triangleHint = triangle;
+			}
+			return true;
+		}
+	}
+	return false;
+}
+
+CutFillVolume::CutFillVolume(HgtLoader* loader) :
+	m_loader(loader),
+	m_threadPool(QThreadPool::globalInstance())
+{
+}
+
+void CutFillVolume::setThreadPool(QThreadPool* threadPool)
+{
+	m_threadPool = threadPool ? threadPool : QThreadPool::globalInstance();
+}
+
+double CutFillVolume::cellArea(const double lat, const double dLon, const double dLat)
+{
+	return dLon*Geo::Constants::metersPerDegreeLon(lat)*dLat*Geo::Constants::metersPerDegreeLat(lat);
+}
+
+CutFillResult CutFillVolume::compute(const QList<QPointF>& polygon, const DesignSurface& design)
+{
+	CutFillResult retVal;
+	if (!design.isValid()) {
+		qDebug() << "CutFillVolume.compute. Design surface is invalid.";
+		return retVal;
+	}
+
+	QList<QList<QPointF>> polygons;
+	polygons.append(polygon);
+	QVector<PolygonTile> tiles = PolygonTileWalk::coveredTiles(polygons);
+	QVector<CutFillJob> jobs(tiles.size());
+
+	PolygonTileWalk::walk(tiles, m_loader, m_threadPool, polygons, [&jobs, &design](const int tileIndex, const PolygonSpanRow& row) {
+		accumulateSpan(jobs[tileIndex], row, design);
+	});
+
+	for (int i = 0; i < tiles.size(); ++i) {
+		jobs[i].result.missingTiles = tiles.at(i).missing ? 1 : 0;
+	}
+
+	for (const CutFillJob& job : jobs) {
+		retVal.cutVolume += job.result.cutVolume;
+		retVal.fillVolume += job.result.fillVolume;
+		retVal.cutArea += job.result.cutArea;
+		retVal.fillArea += job.result.fillArea;
+		retVal.area += job.result.area;
+		retVal.count += job.result.count;
+		retVal.voidCount += job.result.voidCount;
+		retVal.outsideDesignCount += job.result.outsideDesignCount;
+		retVal.missingTiles += job.result.missingTiles;
+	}
+
+	return retVal;
+}
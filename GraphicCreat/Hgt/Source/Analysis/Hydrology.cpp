@@ -0,0 +1,489 @@
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <QFutureSynchronizer>
+#include <QFile>
+#include <QDir>
+#include <QtMath>
+#include <QDebug>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <queue>
+#include "Hydrology.h"
+#include "../Geo/GeoConstants.h"
+
+const QString FILLED_FILE_HYDROLOGY = "filled.f32";
+const QString DIRECTION_FILE_HYDROLOGY = "direction.u8";
+const QString ACCUMULATION_FILE_HYDROLOGY = "accumulation.u32";
+
+const float NAN_HYDROLOGY = std::numeric_limits<float>::quiet_NaN();
+const float INF_HYDROLOGY = std::numeric_limits<float>::infinity();
+
+//D8 neighbours in the order of the codes 1, 2, 4 ... 128, rows grow to the south
+const int DIRECTION_COL_HYDROLOGY[8] = {1, 1, 0, -1, -1, -1, 0, 1};
+const int DIRECTION_ROW_HYDROLOGY[8] = {0, 1, 1, 1, 0, -1, -1, -1};
+
+struct FloodEntry {
+	float level;
+	qint64 index;
+
+	bool operator>(const FloodEntry& other) const {return level > other.level;}
+};
+
+/**
+ * @brief raster file mapped for the time of the computation
+ */
+class HydrologyRaster
+{
+public:
+	~HydrologyRaster()
+	{
+		if (m_data) {
+			m_file.unmap(m_data);
+		}
+	}
+
+	bool create(const QString& path, const qint64 bytes)
+	{
+		m_file.setFileName(path);
+		if (!m_file.open(QIODevice::ReadWrite | QIODevice::Truncate) || !m_file.resize(bytes)) {
+			qDebug() << "Hydrology.compute. Can't create" << path;
+			return false;
+		}
+		m_data = m_file.map(0, bytes);
+		if (!m_data) {
+			qDebug() << "Hydrology.compute. Can't map" << path;
+			return false;
+		}
+		return true;
+	}
+
+	template<typename T>
+	T* data() const {return reinterpret_cast<T*>(m_data);}
+
+private:
+	QFile m_file;
+	uchar* m_data = nullptr;
+};
+
+/**
+ * @brief cells [col0,col1) x [row0,row1) of one tile and what it exchanges with its neighbours
+ */
+struct HydrologyBlock {
+	int tileCol = 0;
+	int tileRow = 0;
+	int col0 = 0;
+	int col1 = 0;
+	int row0 = 0;
+	int row1 = 0;
+
+	//ring of cells around the block inside the mosaic and their filled elevations of the last round
+	QVector<qint64> halo;
+	QVector<float> haloValues;
+	//halo cells whose value dropped since the last round
+	QVector<int> changedHalo;
+
+	//flow into the block by cell, flow out of it by the cell it enters
+	QVector<QPair<qint64, quint32>> inflow;
+	QVector<QPair<qint64, quint32>> outflow;
+
+	qint64 filledCells = 0;
+	quint32 maxAccumulation = 0;
+
+	int width() const {return col1 - col0;}
+	int height() const {return row1 - row0;}
+	bool contains(const int col, const int row) const {return col >= col0 && col < col1 && row >= row0 && row < row1;}
+};
+
+static void runBlocks(QThreadPool* threadPool, QVector<HydrologyBlock>& blocks, const std::function<void(HydrologyBlock&)>& func)
+{
+	QFutureSynchronizer<void> synchronizer;
+	for (HydrologyBlock& block : blocks) {
+		HydrologyBlock* blockPtr = &block;
+		synchronizer.addFuture(QtConcurrent::run(threadPool, [blockPtr, &func]() {
+			func(*blockPtr);
+		}));
+	}
+	synchronizer.waitForFinished();
+}
+
+/**
+ * @brief cells [col0,col1) x [row0,row1) of the block from the tile (tileCol,tileRow), false for a missing tile
+ */
+static bool readTileCells(QVector<float>& z, const HydrologyBlock& block, const HydrologyGrid& grid, HgtLoader* loader,
+						  const int tileCol, const int tileRow, const int col0, const int col1, const int row0, const int row1)
+{
+	TileHandle tile;
+	if (!loader->getTileHandle(tile, grid.leftBottomCorner.x() + tileCol + 0.5,
+							   grid.leftBottomCorner.y() + grid.tilesLat - 1 - tileRow + 0.5)) {
+		return false;
+	}
+	const int colOffset = tileCol*grid.pixPerDeg;
+	const int rowOffset = tileRow*grid.pixPerDeg;
+	loader->visitTileView(tile, [&](const auto& view) {
+		for (int row = row0; row < row1; ++row) {
+			float* out = z.data() + (row - block.row0)*block.width() + col0 - block.col0;
+			for (int col = col0; col < col1; ++col) {
+				const qint16 elevation = view.elevation(col - colOffset, row - rowOffset);
+				*out++ = elevation == ERROR_ELEVATION_SRTM_HGT ? NAN_HYDROLOGY : float(elevation);
+			}
+		}
+	});
+	return true;
+}
+
+/**
+ * @brief elevations of the block row by row, NaN for voids and missing tiles.
+ * The western column and northern row of a missing tile are read from the neighbours sharing them
+ */
+static void readBlock(QVector<float>& z, const HydrologyBlock& block, const HydrologyGrid& grid, HgtLoader* loader)
+{
+	z.resize(block.width()*block.height());
+	std::fill(z.begin(), z.end(), NAN_HYDROLOGY);
+	if (readTileCells(z, block, grid, loader, block.tileCol, block.tileRow, block.col0, block.col1, block.row0, block.row1)) {
+		return;
+	}
+	bool corner = false;
+	if (block.tileCol > 0) {
+		corner = readTileCells(z, block, grid, loader, block.tileCol - 1, block.tileRow, block.col0, block.col0 + 1, block.row0, block.row1);
+	}
+	if (block.tileRow > 0) {
+		corner = readTileCells(z, block, grid, loader, block.tileCol, block.tileRow - 1, block.col0, block.col1, block.row0, block.row0 + 1) || corner;
+	}
+	if (!corner && block.tileCol > 0 && block.tileRow > 0) {
+		readTileCells(z, block, grid, loader, block.tileCol - 1, block.tileRow - 1, block.col0, block.col0 + 1, block.row0, block.row0 + 1);
+	}
+}
+
+Hydrology::Hydrology(HgtLoader* loader) :
+	m_loader(loader),
+	m_threadPool(QThreadPool::globalInstance())
+{
+}
+
+void Hydrology::setThreadPool(QThreadPool* threadPool)
+{
+	m_threadPool = threadPool ? threadPool : QThreadPool::globalInstance();
+}
+
+bool Hydrology::compute(HydrologyResult& result, const QString& directory,
+						const double minLon, const double maxLon, const double minLat, const double maxLat)
+{
+	result = HydrologyResult();
+	if (!Geo::Constants::isCorrectGeoCoord(minLon, minLat) || !Geo::Constants::isCorrectGeoCoord(maxLon, maxLat)
+		|| minLon > maxLon || minLat > maxLat) {
+		qDebug() << "Hydrology.compute. Rectangle incorrect.";
+		return false;
+	}
+
+	HydrologyGrid& grid = result.grid;
+	grid.leftBottomCorner = QPoint(qFloor(minLon), qFloor(minLat));
+	grid.tilesLon = std::max(1, qCeil(maxLon) - grid.leftBottomCorner.x());
+	grid.tilesLat = std::max(1, qCeil(maxLat) - grid.leftBottomCorner.y());
+
+	//the grid follows the tiles, they have to agree on the resolution
+	for (int lat = grid.leftBottomCorner.y(); lat < grid.leftBottomCorner.y() + grid.tilesLat; ++lat) {
+		for (int lon = grid.leftBottomCorner.x(); lon < grid.leftBottomCorner.x() + grid.tilesLon; ++lon) {
+			TileHandle tile;
+			if (!m_loader->getTileHandle(tile, lon + 0.5, lat + 0.5)) {
+				continue;
+			}
+			const int pixPerDeg = qRound(sqrt(double(tile.size()/2))) - 1;
+			if (grid.pixPerDeg != 0 && grid.pixPerDeg != pixPerDeg) {
+				qDebug() << QString("Hydrology.compute. Tile %1,%2 has another resolution.").arg(lon).arg(lat);
+				return false;
+			}
+			grid.pixPerDeg = pixPerDeg;
+		}
+	}
+	if (!grid.isValid()) {
+		qDebug() << "Hydrology.compute. No tiles in the rectangle.";
+		return false;
+	}
+
+	if (!QDir().mkpath(directory)) {
+		qDebug() << "Hydrology.compute. Can't create" << directory;
+		return false;
+	}
+	result.filledPath = QDir(directory).filePath(FILLED_FILE_HYDROLOGY);
+	result.directionPath = QDir(directory).filePath(DIRECTION_FILE_HYDROLOGY);
+	result.accumulationPath = QDir(directory).filePath(ACCUMULATION_FILE_HYDROLOGY);
+	HydrologyRaster filledRaster;
+	HydrologyRaster directionRaster;
+	HydrologyRaster accumulationRaster;
+	if (!filledRaster.create(result.filledPath, grid.cellCount()*qint64(sizeof(float)))
+		|| !directionRaster.create(result.directionPath, grid.cellCount())
+		|| !accumulationRaster.create(result.accumulationPath, grid.cellCount()*qint64(sizeof(quint32)))) {
+		return false;
+	}
+	float* filled = filledRaster.data<float>();
+	quint8* direction = directionRaster.data<quint8>();
+	quint32* accumulation = accumulationRaster.data<quint32>();
+
+	const int cols = grid.cols();
+	const int rows = grid.rows();
+	const int pixPerDeg = grid.pixPerDeg;
+
+	//a block per tile, it takes the seams on its western and northern side (readBlock falls back to the neighbour
+	//sharing them when the tile is missing), the last column and row of the mosaic belong to the eastern and southern tiles
+	QVector<HydrologyBlock> blocks;
+	QVector<int> blockIndexOfTile(grid.tilesLon*grid.tilesLat);
+	for (int tileRow = 0; tileRow < grid.tilesLat; ++tileRow) {
+		for (int tileCol = 0; tileCol < grid.tilesLon; ++tileCol) {
+			HydrologyBlock block;
+			block.tileCol = tileCol;
+			block.tileRow = tileRow;
+			block.col0 = tileCol*pixPerDeg;
+			block.col1 = tileCol == grid.tilesLon - 1 ? cols : block.col0 + pixPerDeg;
+			block.row0 = tileRow*pixPerDeg;
+			block.row1 = tileRow == grid.tilesLat - 1 ? rows : block.row0 + pixPerDeg;
+			for (int row = block.row0 - 1; row <= block.row1; ++row) {
+				for (int col = block.col0 - 1; col <= block.col1; ++col) {
+					if (row >= 0 && col >= 0 && row < rows && col < cols && !block.contains(col, row)) {
+						block.halo.append(qint64(row)*cols + col);
+					}
+				}
+			}
+			blockIndexOfTile[tileRow*grid.tilesLon + tileCol] = blocks.size();
+			blocks.append(block);
+		}
+	}
+	auto blockOfCell = [&](const qint64 index) -> HydrologyBlock& {
+		const int tileCol = std::min(int(index % cols)/pixPerDeg, grid.tilesLon - 1);
+		const int tileRow = std::min(int(index/cols)/pixPerDeg, grid.tilesLat - 1);
+		return blocks[blockIndexOfTile.at(tileRow*grid.tilesLon + tileCol)];
+	};
+
+	//filling: the mosaic edge keeps its elevation, the rest starts at +inf and is lowered by the flood
+	runBlocks(m_threadPool, blocks, [&](HydrologyBlock& block) {
+		QVector<float> z;
+		readBlock(z, block, grid, m_loader);
+		const float* in = z.constData();
+		for (int row = block.row0; row < block.row1; ++row) {
+			float* out = filled + qint64(row)*cols;
+			for (int col = block.col0; col < block.col1; ++col, ++in) {
+				const bool edge = row == 0 || col == 0 || row == rows - 1 || col == cols - 1;
+				out[col] = (edge || *in != *in) ? *in : INF_HYDROLOGY;
+			}
+		}
+	});
+
+	auto exchangeHalo = [&](HydrologyBlock& block) {
+		block.changedHalo.clear();
+		block.haloValues.resize(block.halo.size());
+		for (int i = 0; i < block.halo.size(); ++i) {
+			const float value = filled[block.halo.at(i)];
+			//bitwise, NaN stays NaN
+			if (result.fillRounds == 0 || memcmp(&value, &block.haloValues.at(i), sizeof(value)) != 0) {
+				block.haloValues[i] = value;
+				if (value != INF_HYDROLOGY) {
+					block.changedHalo.append(i);
+				}
+			}
+		}
+	};
+
+	auto flood = [&](HydrologyBlock& block) {
+		if (result.fillRounds > 1 && block.changedHalo.isEmpty()) {
+			return;
+		}
+		QVector<float> z;
+		readBlock(z, block, grid, m_loader);
+		std::priority_queue<FloodEntry, std::vector<FloodEntry>, std::greater<FloodEntry>> open;
+
+		//voids drain whatever touches them
+		auto push = [&](const float level, const qint64 index) {
+			open.push(FloodEntry{level == level ? level : -INF_HYDROLOGY, index});
+		};
+		if (result.fillRounds == 1) {
+			for (int row = block.row0; row < block.row1; ++row) {
+				for (int col = block.col0; col < block.col1; ++col) {
+					const qint64 index = qint64(row)*cols + col;
+					if (filled[index] != INF_HYDROLOGY) {
+						push(filled[index], index);
+					}
+				}
+			}
+		}
+		for (const int i : block.changedHalo) {
+			push(block.haloValues.at(i), block.halo.at(i));
+		}
+
+		while (!open.empty()) {
+			const FloodEntry entry = open.top();
+			open.pop();
+			const int col = int(entry.index % cols);
+			const int row = int(entry.index/cols);
+			//stale entry of a cell lowered again
+			if (block.contains(col, row) && entry.level != filled[entry.index] && entry.level != -INF_HYDROLOGY) {
+				continue;
+			}
+			const float level = std::nextafter(entry.level, INF_HYDROLOGY);
+			for (int direction = 0; direction < 8; ++direction) {
+				const int nextCol = col + DIRECTION_COL_HYDROLOGY[direction];
+				const int nextRow = row + DIRECTION_ROW_HYDROLOGY[direction];
+				if (!block.contains(nextCol, nextRow)) {
+					continue;
+				}
+				const float nextZ = z.at((nextRow - block.row0)*block.width() + nextCol - block.col0);
+				const qint64 next = qint64(nextRow)*cols + nextCol;
+				const float candidate = std::max(nextZ, level);
+				if (candidate < filled[next]) {
+					filled[next] = candidate;
+					open.push(FloodEntry{candidate, next});
+				}
+			}
+		}
+	};
+
+	//rounds until no block lowers a cell of its neighbours' halo
+	bool changed = false;
+	while (true) {
+		runBlocks(m_threadPool, blocks, exchangeHalo);
+		changed = false;
+		for (const HydrologyBlock& block : blocks) {
+			changed = changed || !block.changedHalo.isEmpty();
+		}
+		if (!changed && result.fillRounds > 0) {
+			break;
+		}
+		++result.fillRounds;
+		runBlocks(m_threadPool, blocks, flood);
+	}
+
+	//directions read the halo straight from the filled raster, nothing writes it any more
+	const double metresPerSample = Geo::Constants::EARTH_MEAN_RADIUS*M_PI/180.0/pixPerDeg;
+	runBlocks(m_threadPool, blocks, [&](HydrologyBlock& block) {
+		QVector<float> z;
+		readBlock(z, block, grid, m_loader);
+		const float* in = z.constData();
+		for (int row = block.row0; row < block.row1; ++row) {
+			const double dx = metresPerSample*cos(qDegreesToRadians(grid.lat(row)));
+			const double distance[8] = {dx, sqrt(dx*dx + metresPerSample*metresPerSample), metresPerSample,
+										sqrt(dx*dx + metresPerSample*metresPerSample), dx,
+										sqrt(dx*dx + metresPerSample*metresPerSample), metresPerSample,
+										sqrt(dx*dx + metresPerSample*metresPerSample)};
+			for (int col = block.col0; col < block.col1; ++col, ++in) {
+				const qint64 index = qint64(row)*cols + col;
+				const float level = filled[index];
+				//elevations are whole metres, a depression is raised by a metre at least, a flat only by the gradient
+				if (level >= *in + 1.0f) {
+					++block.filledCells;
+				}
+				quint8 code = 0;
+				double steepest = 0.0;
+				for (int i = 0; i < 8 && level == level; ++i) {
+					const int nextCol = col + DIRECTION_COL_HYDROLOGY[i];
+					const int nextRow = row + DIRECTION_ROW_HYDROLOGY[i];
+					if (nextCol < 0 || nextRow < 0 || nextCol >= cols || nextRow >= rows) {
+						continue;
+					}
+					const float next = filled[qint64(nextRow)*cols + nextCol];
+					const double drop = (double(level) - next)/distance[i];
+					if (drop > steepest) {
+						steepest = drop;
+						code = quint8(1 << i);
+					}
+				}
+				direction[index] = code;
+			}
+		}
+	});
+
+	auto downstream = [&](const qint64 index, const quint8 code) {
+		const int i = qCountTrailingZeroBits(quint32(code));
+		return index + qint64(DIRECTION_ROW_HYDROLOGY[i])*cols + DIRECTION_COL_HYDROLOGY[i];
+	};
+
+	//accumulation inside each block in topological order, what leaves the block goes to its neighbour's inflow
+	runBlocks(m_threadPool, blocks, [&](HydrologyBlock& block) {
+		const int width = block.width();
+		QVector<quint8> inDegree(width*block.height(), 0);
+		for (int row = block.row0; row < block.row1; ++row) {
+			for (int col = block.col0; col < block.col1; ++col) {
+				const qint64 index = qint64(row)*cols + col;
+				accumulation[index] = filled[index] == filled[index] ? 1 : 0;
+				if (direction[index] != 0) {
+					const qint64 next = downstream(index, direction[index]);
+					const int nextCol = int(next % cols);
+					const int nextRow = int(next/cols);
+					if (block.contains(nextCol, nextRow)) {
+						++inDegree[(nextRow - block.row0)*width + nextCol - block.col0];
+					}
+				}
+			}
+		}
+
+		QVector<qint64> ready;
+		for (int row = block.row0; row < block.row1; ++row) {
+			for (int col = block.col0; col < block.col1; ++col) {
+				if (inDegree.at((row - block.row0)*width + col - block.col0) == 0) {
+					ready.append(qint64(row)*cols + col);
+				}
+			}
+		}
+		while (!ready.isEmpty()) {
+			const qint64 index = ready.takeLast();
+			if (direction[index] == 0) {
+				continue;
+			}
+			const qint64 next = downstream(index, direction[index]);
+			const int nextCol = int(next % cols);
+			const int nextRow = int(next/cols);
+			if (!block.contains(nextCol, nextRow)) {
+				block.outflow.append(qMakePair(next, accumulation[index]));
+				continue;
+			}
+			accumulation[next] += accumulation[index];
+			if (--inDegree[(nextRow - block.row0)*width + nextCol - block.col0] == 0) {
+				ready.append(next);
+			}
+		}
+	});
+
+	//the flow graph is acyclic, so the flow crosses a finite number of seams
+	while (true) {
+		changed = false;
+		for (HydrologyBlock& block : blocks) {
+			for (const QPair<qint64, quint32>& flow : block.outflow) {
+				blockOfCell(flow.first).inflow.append(flow);
+				changed = true;
+			}
+			block.outflow.clear();
+		}
+		if (!changed) {
+			break;
+		}
+		++result.accumulationRounds;
+		runBlocks(m_threadPool, blocks, [&](HydrologyBlock& block) {
+			for (const QPair<qint64, quint32>& flow : block.inflow) {
+				qint64 index = flow.first;
+				while (true) {
+					accumulation[index] += flow.second;
+					if (direction[index] == 0) {
+						break;
+					}
+					const qint64 next = downstream(index, direction[index]);
+					if (!block.contains(int(next % cols), int(next/cols))) {
+						block.outflow.append(qMakePair(next, flow.second));
+						break;
+					}
+					index = next;
+				}
+			}
+			block.inflow.clear();
+		});
+	}
+
+	runBlocks(m_threadPool, blocks, [&](HydrologyBlock& block) {
+		for (int row = block.row0; row < block.row1; ++row) {
+			const quint32* in = accumulation + qint64(row)*cols;
+			block.maxAccumulation = std::max(block.maxAccumulation, *std::max_element(in + block.col0, in + block.col1));
+		}
+	});
+	for (const HydrologyBlock& block : blocks) {
+		result.filledCells += block.filledCells;
+		result.maxAccumulation = std::max(result.maxAccumulation, block.maxAccumulation);
+	}
+	return true;
+}
@@ -0,0 +1,568 @@
+#include <QHash>
+#include <QtMath>
+#include <QDebug>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "LeastCostPath.h"
+#include "../Geo/GeoConstants.h"
+
+const int BLOCK_BITS_COST = 6;
+const int BLOCK_SIZE_COST = 1 << BLOCK_BITS_COST;
+//cell size ratio of neighbouring levels
+const int LEVEL_RATIO_COST = 4;
+//cells of the coarsest level, it covers the whole search box
+const qint64 MAX_COARSE_CELLS_COST = 1 << 18;
+//margin of the search box around the two points, share of their distance in degrees, at least the minimum
+const double BOX_MARGIN_SHARE_COST = 0.5;
+const double MIN_BOX_MARGIN_COST = 0.05;
+//the corridor is widened this many times when a finer level finds no path inside it
+const int MAX_CORRIDOR_RETRIES_COST = 2;
+
+//z of the cells in missing tiles
+const float IMPASSABLE_COST = std::numeric_limits<float>::infinity();
+
+//state of a cell: direction from its parent in the low 3 bits
+const quint8 HAS_PARENT_COST = 0x08;
+const quint8 LOADED_COST = 0x40;
+const quint8 CLOSED_COST = 0x80;
+
+//0 is east, counter-clockwise, rows grow to the south
+const int DIRECTION_COL_COST[8] = {1, 1, 0, -1, -1, -1, 0, 1};
+const int DIRECTION_ROW_COST[8] = {0, -1, -1, -1, 0, 1, 1, 1};
+
+/**
+ * @brief monotone radix heap, keys are the bit patterns of non-negative floats, which sort like the floats
+ */
+class CostRadixHeap
+{
+public:
+	struct Entry {
+		quint32 key;
+		quint32 cell;
+	};
+
+	bool isEmpty() const {return m_size == 0;}
+
+	void push(const float priority, const quint32 cell)
+	{
+		quint32 key = 0;
+		memcpy(&key, &priority, sizeof(key));
+		//the heuristic is consistent, keys never fall below the last one taken but by float rounding of g + h,
+		//such keys are taken next
+		key = std::max(key, m_last);
+		m_buckets[bucket(key)].push_back(Entry{key, cell});
+		++m_size;
+	}
+
+	Entry pop()
+	{
+		if (m_buckets[0].empty()) {
+			int i = 1;
+			while (m_buckets[i].empty()) {
+				++i;
+			}
+			quint32 minKey = m_buckets[i].front().key;
+			for (const Entry& entry : m_buckets[i]) {
+				minKey = std::min(minKey, entry.key);
+			}
+			m_last = minKey;
+			for (const Entry& entry : m_buckets[i]) {
+				m_buckets[bucket(entry.key)].push_back(entry);
+			}
+			m_buckets[i].clear();
+		}
+		Entry retVal = m_buckets[0].back();
+		m_buckets[0].pop_back();
+		--m_size;
+		return retVal;
+	}
+
+	qint64 memory() const
+	{
+		qint64 retVal = 0;
+		for (const std::vector<Entry>& bucket : m_buckets) {
+			retVal += qint64(bucket.capacity())*qint64(sizeof(Entry));
+		}
+		return retVal;
+	}
+
+private:
+	int bucket(const quint32 key) const {return key == m_last ? 0 : 32 - qCountLeadingZeroBits(key ^ m_last);}
+
+private:
+	std::vector<Entry> m_buckets[33];
+	quint32 m_last = 0;
+	qint64 m_size = 0;
+};
+
+/**
+ * @brief samples addressed by absolute indices, col = (lon + 180)*pixPerDeg, row = (90 - lat)*pixPerDeg.
+ * Tiles are loaded on first use and held until the search ends.
+ */
+class CostSamples
+{
+public:
+	CostSamples(HgtLoader* loader, const int pixPerDeg) :
+		m_loader(loader),
+		m_pixPerDeg(pixPerDeg)
+	{
+	}
+
+	//mean of the samples [col0,col1) x [row0,row1) of the tiles that exist, NaN if all are voids,
+	//IMPASSABLE_COST if all tiles are missing
+	float mean(const int col0, const int row0, const int col1, const int row1)
+	{
+		qint64 sum = 0;
+		qint64 count = 0;
+		bool anyTile = false;
+		for (int tileRow = row0/m_pixPerDeg; tileRow <= (row1 - 1)/m_pixPerDeg; ++tileRow) {
+			for (int tileCol = col0/m_pixPerDeg; tileCol <= (col1 - 1)/m_pixPerDeg; ++tileCol) {
+				const TileHandle& tile = this->tile(tileCol - 180, 89 - tileRow);
+				if (!tile.isValid()) {
+					continue;
+				}
+				anyTile = true;
+				const int localCol0 = std::max(col0, tileCol*m_pixPerDeg) - tileCol*m_pixPerDeg;
+				const int localCol1 = std::min(col1, (tileCol + 1)*m_pixPerDeg) - tileCol*m_pixPerDeg;
+				const int localRow0 = std::max(row0, tileRow*m_pixPerDeg) - tileRow*m_pixPerDeg;
+				const int localRow1 = std::min(row1, (tileRow + 1)*m_pixPerDeg) - tileRow*m_pixPerDeg;
+				m_loader->visitTileView(tile, [&](const auto& view) {
+					typedef typename std::decay<decltype(view)>::type View;
+					for (int row = localRow0; row < localRow1; ++row) {
+						for (int col = localCol0; col < localCol1; ++col) {
+							qint16 elevation = ERROR_ELEVATION_SRTM_HGT;
+							if (View::SIDE_SIZE - 1 == m_pixPerDeg) {
+								elevation = view.elevation(col, row);
+							} else {
+								//tile of another resolution, nearest sample
+								view.getElevation(elevation, tileCol - 180 + double(col)/m_pixPerDeg, 90 - tileRow - double(row)/m_pixPerDeg);
+							}
+							if (elevation != ERROR_ELEVATION_SRTM_HGT) {
+								sum += elevation;
+								++count;
+							}
+						}
+					}
+				});
+			}
+		}
+		if (!anyTile) {
+			return IMPASSABLE_COST;
+		}
+		return count > 0 ? float(double(sum)/count) : std::numeric_limits<float>::quiet_NaN();
+	}
+
+private:
+	const TileHandle& tile(const int lon, const int lat)
+	{
+		const qint64 key = qint64(lat) << 32 | quint32(lon);
+		auto it = m_tiles.find(key);
+		if (it == m_tiles.end()) {
+			TileHandle tile;
+			m_loader->getTileHandle(tile, lon + 0.5, lat + 0.5);
+			it = m_tiles.insert(key, tile);
+		}
+		return it.value();
+	}
+
+private:
+	HgtLoader* m_loader;
+	int m_pixPerDeg;
+	QHash<qint64, TileHandle> m_tiles;
+};
+
+struct CostBlock {
+	float z[BLOCK_SIZE_COST*BLOCK_SIZE_COST];
+	float g[BLOCK_SIZE_COST*BLOCK_SIZE_COST];
+	quint8 state[BLOCK_SIZE_COST*BLOCK_SIZE_COST];
+};
+
+/**
+ * @brief cells of one level, cell (col,row) holds samples col0 + col*factor .. + factor of the search box
+ */
+class CostLevel
+{
+public:
+	CostLevel(CostSamples& samples, const int factor, const int col0, const int row0, const int colEnd, const int rowEnd,
+			  const int pixPerDeg) :
+		m_samples(samples),
+		m_factor(factor),
+		m_col0(col0),
+		m_row0(row0),
+		m_colEnd(colEnd),
+		m_rowEnd(rowEnd),
+		m_cols((colEnd - col0 + factor - 1)/factor),
+		m_rows((rowEnd - row0 + factor - 1)/factor),
+		m_blockCols((m_cols + BLOCK_SIZE_COST - 1) >> BLOCK_BITS_COST),
+		m_blocks(size_t(m_blockCols)*((m_rows + BLOCK_SIZE_COST - 1) >> BLOCK_BITS_COST))
+	{
+		const double metresPerSample = Geo::Constants::EARTH_MEAN_RADIUS*M_PI/180.0/pixPerDeg;
+		m_dy = float(factor*metresPerSample);
+		m_dx.resize(m_rows);
+		m_diagonal.resize(m_rows);
+		m_minDx = std::numeric_limits<float>::max();
+		for (int row = 0; row < m_rows; ++row) {
+			const double lat = 90.0 - (row0 + row*factor + (factor - 1)*0.5)/pixPerDeg;
+			m_dx[row] = float(factor*metresPerSample*cos(qDegreesToRadians(lat)));
+			m_diagonal[row] = std::sqrt(m_dx.at(row)*m_dx.at(row) + m_dy*m_dy);
+			m_minDx = std::min(m_minDx, m_dx.at(row));
+		}
+	}
+
+	int factor() const {return m_factor;}
+	int cols() const {return m_cols;}
+	int rows() const {return m_rows;}
+	float dx(const int row) const {return m_dx.at(row);}
+	float dy() const {return m_dy;}
+	float diagonal(const int row) const {return m_diagonal.at(row);}
+	float minDx() const {return m_minDx;}
+	qint64 memory() const {return m_blockCount*qint64(sizeof(CostBlock)) + qint64(m_blocks.size())*qint64(sizeof(void*));}
+
+	//block of the cell, allocated on first use, nullptr if the memory limit is reached
+	CostBlock* block(const int col, const int row, const qint64 maxMemory)
+	{
+		std::unique_ptr<CostBlock>& block = m_blocks[size_t(row >> BLOCK_BITS_COST)*m_blockCols + (col >> BLOCK_BITS_COST)];
+		if (!block) {
+			if (memory() + qint64(sizeof(CostBlock)) > maxMemory) {
+				return nullptr;
+			}
+			block.reset(new CostBlock);
+			std::fill(block->g, block->g + BLOCK_SIZE_COST*BLOCK_SIZE_COST, std::numeric_limits<float>::infinity());
+			memset(block->state, 0, sizeof(block->state));
+			++m_blockCount;
+		}
+		return block.get();
+	}
+
+	static int index(const int col, const int row)
+	{
+		return (row & (BLOCK_SIZE_COST - 1)) << BLOCK_BITS_COST | (col & (BLOCK_SIZE_COST - 1));
+	}
+
+	float z(CostBlock* block, const int col, const int row)
+	{
+		const int i = index(col, row);
+		if (!(block->state[i] & LOADED_COST)) {
+			const int sampleCol = m_col0 + col*m_factor;
+			const int sampleRow = m_row0 + row*m_factor;
+			block->z[i] = m_samples.mean(sampleCol, sampleRow, std::min(sampleCol + m_factor, m_colEnd), std::min(sampleRow + m_factor, m_rowEnd));
+			block->state[i] |= LOADED_COST;
+		}
+		return block->z[i];
+	}
+
+	//absolute sample of the cell's centre
+	double centreCol(const int col) const {return m_col0 + col*m_factor + (std::min(m_factor, m_colEnd - m_col0 - col*m_factor) - 1)*0.5;}
+	double centreRow(const int row) const {return m_row0 + row*m_factor + (std::min(m_factor, m_rowEnd - m_row0 - row*m_factor) - 1)*0.5;}
+
+private:
+	CostSamples& m_samples;
+	int m_factor;
+	int m_col0;
+	int m_row0;
+	int m_colEnd;
+	int m_rowEnd;
+	int m_cols;
+	int m_rows;
+	int m_blockCols;
+	std::vector<std::unique_ptr<CostBlock>> m_blocks;
+	qint64 m_blockCount = 0;
+	QVector<float> m_dx;
+	QVector<float> m_diagonal;
+	float m_dy = 0.0f;
+	float m_minDx = 0.0f;
+};
+
+enum class CostSearchStatus {
+	Found,
+	NoPath,
+	OutOfMemory
+};
+
+struct CostSearchParameters {
+	float climbWeight;
+	float descentWeight;
+	float maxGrade;
+	qint64 maxMemory;
+};
+
+/**
+ * @brief A* over the cells of the level the mask allows, mask has a byte per cell of the coarser level (empty - all)
+ */
+static CostSearchStatus searchLevel(QVector<QPoint>& path, float& cost, qint64& expanded, qint64& memory, CostLevel& level,
+									const QVector<quint8>& mask, const int maskCols, const QPoint& start, const QPoint& goal,
+									const CostSearchParameters& parameters)
+{
+	path.clear();
+	auto allowed = [&mask, maskCols](const int col, const int row) {
+		return mask.isEmpty() || mask.at((row/LEVEL_RATIO_COST)*maskCols + col/LEVEL_RATIO_COST) != 0;
+	};
+
+	CostBlock* goalBlock = level.block(goal.x(), goal.y(), parameters.maxMemory);
+	CostBlock* startBlock = level.block(start.x(), start.y(), parameters.maxMemory);
+	if (!goalBlock || !startBlock) {
+		return CostSearchStatus::OutOfMemory;
+	}
+	const float goalZ = level.z(goalBlock, goal.x(), goal.y());
+	if (goalZ == IMPASSABLE_COST || level.z(startBlock, start.x(), start.y()) == IMPASSABLE_COST) {
+		return CostSearchStatus::NoPath;
+	}
+
+	const float diagonalStep = std::sqrt(level.minDx()*level.minDx() + level.dy()*level.dy());
+	//flat distance only: a step through a void climbs for free, so no climb to the goal can be counted on
+	auto heuristic = [&](const int col, const int row) {
+		const int dc = std::abs(col - goal.x());
+		const int dr = std::abs(row - goal.y());
+		const int diagonal = std::min(dc, dr);
+		return diagonal*diagonalStep + (dc - diagonal)*level.minDx() + (dr - diagonal)*level.dy();
+	};
+
+	CostRadixHeap heap;
+	const quint32 cols = quint32(level.cols());
+	startBlock->g[CostLevel::index(start.x(), start.y())] = 0.0f;
+	heap.push(heuristic(start.x(), start.y()), quint32(start.y())*cols + start.x());
+
+	CostSearchStatus retVal = CostSearchStatus::NoPath;
+	while (!heap.isEmpty()) {
+		//the open set counts against the limit too, blocks get what the heap leaves
+		const qint64 heapMemory = heap.memory();
+		if (level.memory() + heapMemory > parameters.maxMemory) {
+			memory = std::max(memory, level.memory() + heapMemory);
+			return CostSearchStatus::OutOfMemory;
+		}
+		const qint64 blockMemory = parameters.maxMemory - heapMemory;
+
+		const CostRadixHeap::Entry entry = heap.pop();
+		const int col = int(entry.cell % cols);
+		const int row = int(entry.cell/cols);
+		CostBlock* block = level.block(col, row, blockMemory);
+		const int i = CostLevel::index(col, row);
+		if (block->state[i] & CLOSED_COST) {
+			continue;
+		}
+		block->state[i] |= CLOSED_COST;
+		++expanded;
+		if (col == goal.x() && row == goal.y()) {
+			retVal = CostSearchStatus::Found;
+			break;
+		}
+
+		const float g = block->g[i];
+		const float z = block->z[i];
+		for (int direction = 0; direction < 8; ++direction) {
+			const int nextCol = col + DIRECTION_COL_COST[direction];
+			const int nextRow = row + DIRECTION_ROW_COST[direction];
+			if (nextCol < 0 || nextRow < 0 || nextCol >= level.cols() || nextRow >= level.rows() || !allowed(nextCol, nextRow)) {
+				continue;
+			}
+			CostBlock* next = level.block(nextCol, nextRow, blockMemory);
+			if (!next) {
+				memory = std::max(memory, level.memory() + heap.memory());
+				return CostSearchStatus::OutOfMemory;
+			}
+			const int j = CostLevel::index(nextCol, nextRow);
+			if (next->state[j] & CLOSED_COST) {
+				continue;
+			}
+			const float nextZ = level.z(next, nextCol, nextRow);
+			if (nextZ == IMPASSABLE_COST) {
+				continue;
+			}
+
+			const float step = (direction & 1) ? level.diagonal(row) : (direction == 0 || direction == 4 ? level.dx(row) : level.dy());
+			const float dz = (z == z && nextZ == nextZ) ? nextZ - z : 0.0f;
+			if (std::abs(dz) > step*parameters.maxGrade) {
+				continue;
+			}
+			const float nextG = g + step + parameters.climbWeight*std::max(dz, 0.0f) + parameters.descentWeight*std::max(-dz, 0.0f);
+			if (nextG < next->g[j]) {
+				next->g[j] = nextG;
+				next->state[j] = quint8((next->state[j] & LOADED_COST) | HAS_PARENT_COST | direction);
+				heap.push(nextG + heuristic(nextCol, nextRow), quint32(nextRow)*cols + nextCol);
+			}
+		}
+	}
+	memory = std::max(memory, level.memory() + heap.memory());
+	if (retVal != CostSearchStatus::Found) {
+		return retVal;
+	}
+
+	cost = goalBlock->g[CostLevel::index(goal.x(), goal.y())];
+	QPoint cell = goal;
+	path.append(cell);
+	while (cell != start) {
+		const quint8 state = level.block(cell.x(), cell.y(), parameters.maxMemory)->state[CostLevel::index(cell.x(), cell.y())];
+		const int direction = state & 7;
+		cell = QPoint(cell.x() - DIRECTION_COL_COST[direction], cell.y() - DIRECTION_ROW_COST[direction]);
+		path.append(cell);
+	}
+	std::reverse(path.begin(), path.end());
+	return retVal;
+}
+
+//cells of the level within radius of the path
+static QVector<quint8> corridorMask(const QVector<QPoint>& path, const CostLevel& level, const int radius)
+{
+	QVector<quint8> retVal(level.cols()*level.rows(), 0);
+	for (const QPoint& cell : path) {
+		const int row0 = std::max(0, cell.y() - radius);
+		const int row1 = std::min(level.rows() - 1, cell.y() + radius);
+		const int col0 = std::max(0, cell.x() - radius);
+		const int col1 = std::min(level.cols() - 1, cell.x() + radius);
+		for (int row = row0; row <= row1; ++row) {
+			memset(retVal.data() + row*level.cols() + col0, 1, col1 - col0 + 1);
+		}
+	}
+	return retVal;
+}
+
+LeastCostPath::LeastCostPath(HgtLoader* loader) :
+	m_loader(loader)
+{
+}
+
+void LeastCostPath::setClimbWeight(const double weight)
+{
+	m_climbWeight = std::max(0.0, weight);
+}
+
+void LeastCostPath::setDescentWeight(const double weight)
+{
+	m_descentWeight = std::max(0.0, weight);
+}
+
+void LeastCostPath::setMaxSlope(const double degrees)
+{
+	m_maxSlope = qBound(0.0, degrees, 90.0);
+}
+
+void LeastCostPath::setCorridor(const int cells)
+{
+	m_corridor = std::max(1, cells);
+}
+
+void LeastCostPath::setMaxMemory(const qint64 bytes)
+{
+	m_maxMemory = bytes;
+}
+
+bool LeastCostPath::find(CostPathResult& result, const QPointF& from, const QPointF& to)
+{
+	result = CostPathResult();
+	if (!Geo::Constants::isCorrectGeoCoord(from.x(), from.y()) || !Geo::Constants::isCorrectGeoCoord(to.x(), to.y())) {
+		qDebug() << "LeastCostPath.find. Lon,lat incorrect.";
+		return false;
+	}
+
+	//the grid of the start tile, tiles of another resolution are read by nearest sample
+	TileHandle startTile;
+	if (!m_loader->getTileHandle(startTile, from.x(), from.y())) {
+		qDebug() << QString("LeastCostPath.find. No tile at %1,%2.").arg(from.x()).arg(from.y());
+		return false;
+	}
+	const int pixPerDeg = qRound(sqrt(double(startTile.size()/2))) - 1;
+	startTile.reset();
+
+	const double margin = std::max(MIN_BOX_MARGIN_COST, BOX_MARGIN_SHARE_COST*std::max(std::abs(to.x() - from.x()), std::abs(to.y() - from.y())));
+	const double west = std::max(-180.0, std::min(from.x(), to.x()) - margin);
+	const double east = std::min(180.0 - 1e-9, std::max(from.x(), to.x()) + margin);
+	const double south = std::max(-90.0 + 1e-9, std::min(from.y(), to.y()) - margin);
+	const double north = std::min(90.0, std::max(from.y(), to.y()) + margin);
+	const int col0 = qFloor((west + 180.0)*pixPerDeg);
+	const int colEnd = qFloor((east + 180.0)*pixPerDeg) + 1;
+	const int row0 = qFloor((90.0 - north)*pixPerDeg);
+	const int rowEnd = qFloor((90.0 - south)*pixPerDeg) + 1;
+	const QPoint startSample(qRound((from.x() + 180.0)*pixPerDeg), qRound((90.0 - from.y())*pixPerDeg));
+	const QPoint goalSample(qRound((to.x() + 180.0)*pixPerDeg), qRound((90.0 - to.y())*pixPerDeg));
+
+	//coarsest level is the first one whose box fits MAX_COARSE_CELLS_COST
+	QVector<int> factors;
+	factors.append(1);
+	while (qint64(colEnd - col0)*(rowEnd - row0)/(qint64(factors.last())*factors.last()) > MAX_COARSE_CELLS_COST) {
+		factors.append(factors.last()*LEVEL_RATIO_COST);
+	}
+
+	CostSearchParameters parameters;
+	parameters.climbWeight = float(m_climbWeight);
+	parameters.descentWeight = float(m_descentWeight);
+	parameters.maxGrade = m_maxSlope >= 90.0 ? std::numeric_limits<float>::infinity() : float(tan(qDegreesToRadians(m_maxSlope)));
+	parameters.maxMemory = m_maxMemory;
+
+	CostSamples samples(m_loader, pixPerDeg);
+	QVector<QPoint> coarsePath;
+	std::unique_ptr<CostLevel> coarseLevel;
+	std::unique_ptr<CostLevel> level;
+	QVector<QPoint> path;
+	float cost = 0.0f;
+
+	for (int i = factors.size() - 1; i >= 0; --i) {
+		const int factor = factors.at(i);
+		level.reset(new CostLevel(samples, factor, col0, row0, colEnd, rowEnd, pixPerDeg));
+		const QPoint start((startSample.x() - col0)/factor, (startSample.y() - row0)/factor);
+		const QPoint goal((goalSample.x() - col0)/factor, (goalSample.y() - row0)/factor);
+		result.levels++;
+
+		//widening corridors, the last attempt searches the whole box
+		CostSearchStatus status = CostSearchStatus::NoPath;
+		for (int attempt = 0; attempt <= MAX_CORRIDOR_RETRIES_COST + 1; ++attempt) {
+			QVector<quint8> mask;
+			if (coarseLevel && attempt <= MAX_CORRIDOR_RETRIES_COST) {
+				mask = corridorMask(coarsePath, *coarseLevel, m_corridor << attempt);
+			}
+			if (attempt > 0) {
+				//cells of an attempt are searched again in the next one
+				level.reset(new CostLevel(samples, factor, col0, row0, colEnd, rowEnd, pixPerDeg));
+			}
+			qint64 memory = qint64(mask.size());
+			status = searchLevel(path, cost, result.expandedCells, memory, *level, mask,
+								 coarseLevel ? coarseLevel->cols() : 0, start, goal, parameters);
+			result.peakMemory = std::max(result.peakMemory, memory);
+			if (status != CostSearchStatus::NoPath || mask.isEmpty()) {
+				break;
+			}
+		}
+
+		if (status == CostSearchStatus::OutOfMemory) {
+			qDebug() << QString("LeastCostPath.find. Memory limit of %1 MB reached at level %2.").arg(m_maxMemory >> 20).arg(factor);
+			return false;
+		}
+		if (status == CostSearchStatus::NoPath && i > 0) {
+			//block means hide narrow passes and gaps between missing tiles, the finer level searches without a corridor
+			coarsePath.clear();
+			coarseLevel.reset();
+			continue;
+		}
+		if (status == CostSearchStatus::NoPath) {
+			qDebug() << QString("LeastCostPath.find. No path at level %1.").arg(factor);
+			return false;
+		}
+		coarsePath = path;
+		coarseLevel.swap(level);
+	}
+
+	//coarseLevel holds the finest level now
+	CostLevel& finest = *coarseLevel;
+	result.cost = cost;
+	result.path.reserve(path.size());
+	result.elevations.reserve(path.size());
+	for (int i = 0; i < path.size(); ++i) {
+		const QPoint& cell = path.at(i);
+		result.path.append(QPointF(finest.centreCol(cell.x())/pixPerDeg - 180.0, 90.0 - finest.centreRow(cell.y())/pixPerDeg));
+		const float z = finest.z(finest.block(cell.x(), cell.y(), std::numeric_limits<qint64>::max()), cell.x(), cell.y());
+		result.elevations.append(z);
+		if (i == 0) {
+			continue;
+		}
+		const bool alongRow = cell.x() != path.at(i - 1).x();
+		const bool alongCol = cell.y() != path.at(i - 1).y();
+		const int row = path.at(i - 1).y();
+		result.length += (alongRow && alongCol) ? finest.diagonal(row) : (alongRow ? finest.dx(row) : finest.dy());
+		const float previous = result.elevations.at(i - 1);
+		if (z == z && previous == previous) {
+			result.climb += std::max(z - previous, 0.0f);
+			result.descent += std::max(previous - z, 0.0f);
+		}
+	}
+	return true;
+}
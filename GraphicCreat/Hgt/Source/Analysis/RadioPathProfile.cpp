@@ -0,0 +1,177 @@
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <QFutureSynchronizer>
+#include "RadioPathProfile.h"
+#include "RouteProfile.h"
+#include "../Geo/GeoConstants.h"
+
+//metres per second
+const double SPEED_OF_LIGHT_RADIO = 299792458.0;
+//jobs per pool thread, links of a job share nothing but the loader's cache
+const int JOBS_PER_THREAD_RADIO = 8;
+
+static void shrink(RadioPathResult& result)
+{
+	result.distance = QVector<double>();
+	result.terrain = QVector<float>();
+	result.bulge = QVector<float>();
+	result.terrainWithBulge = QVector<float>();
+	result.lineOfSight = QVector<float>();
+	result.fresnelRadius = QVector<float>();
+	result.clearance = QVector<float>();
+}
+
+static void computeLink(RadioPathResult& result, const RadioLink& link, RouteProfile& profile, QVector<ProfilePoint>& points,
+						const double frequencyMHz, const double kFactor, const bool keepArrays)
+{
+	result = RadioPathResult();
+	profile.compute(points, QVector<QPointF>() << link.from << link.to);
+	if (points.size() < 2) {
+		return;
+	}
+
+	result.distance.resize(points.size());
+	result.terrain.resize(points.size());
+	for (int i = 0; i < points.size(); ++i) {
+		result.distance[i] = points.at(i).distance;
+		result.terrain[i] = points.at(i).elevation;
+	}
+
+	//antennas over a void stand on the geoid
+	const float fromGround = points.first().elevation;
+	const float toGround = points.last().elevation;
+	const double fromAltitude = (fromGround == fromGround ? fromGround : 0.0f) + link.fromHeight;
+	const double toAltitude = (toGround == toGround ? toGround : 0.0f) + link.toHeight;
+	RadioPathProfile::evaluate(result, fromAltitude, toAltitude, frequencyMHz, kFactor);
+
+	if (!keepArrays) {
+		shrink(result);
+	}
+}
+
+RadioPathProfile::RadioPathProfile(HgtLoader* loader) :
+	m_loader(loader),
+	m_threadPool(QThreadPool::globalInstance())
+{
+}
+
+void RadioPathProfile::setFrequency(const double frequencyMHz)
+{
+	m_frequencyMHz = frequencyMHz;
+}
+
+void RadioPathProfile::setKFactor(const double kFactor)
+{
+	m_kFactor = kFactor;
+}
+
+void RadioPathProfile::setSamples(const int samples)
+{
+	m_samples = std::max(2, samples);
+}
+
+void RadioPathProfile::setKeepArrays(const bool keepArrays)
+{
+	m_keepArrays = keepArrays;
+}
+
+void RadioPathProfile::setThreadPool(QThreadPool* threadPool)
+{
+	m_threadPool = threadPool ? threadPool : QThreadPool::globalInstance();
+}
+
+void RadioPathProfile::evaluate(RadioPathResult& result, const double fromAltitude, const double toAltitude,
+								const double frequencyMHz, const double kFactor)
+{
+	const int count = std::min(result.distance.size(), result.terrain.size());
+	result.bulge.resize(count);
+	result.terrainWithBulge.resize(count);
+	result.lineOfSight.resize(count);
+	result.fresnelRadius.resize(count);
+	result.clearance.resize(count);
+	result.fromAltitude = float(fromAltitude);
+	result.toAltitude = float(toAltitude);
+	result.minClearanceRatio = std::numeric_limits<float>::quiet_NaN();
+	result.minClearance = std::numeric_limits<float>::quiet_NaN();
+	result.criticalIndex = -1;
+	if (count < 2) {
+		return;
+	}
+
+	const double* distance = result.distance.constData();
+	const float* terrain = result.terrain.constData();
+	float* bulge = result.bulge.data();
+	float* terrainWithBulge = result.terrainWithBulge.data();
+	float* lineOfSight = result.lineOfSight.data();
+	float* fresnelRadius = result.fresnelRadius.data();
+	float* clearance = result.clearance.data();
+
+	result.length = distance[count - 1] - distance[0];
+	const double start = distance[0];
+	const float length = float(std::max(result.length, 1e-3));
+	const float bulgeFactor = float(1.0/(2.0*kFactor*Geo::Constants::EARTH_MEAN_RADIUS));
+	const float fresnelFactor = float(SPEED_OF_LIGHT_RADIO/(frequencyMHz*1e6))/length;
+	const float from = float(fromAltitude);
+	const float slope = float(toAltitude - fromAltitude)/length;
+
+	//no branches and no calls but sqrt, the loop is vectorized; NaN terrain propagates to the clearance
+	for (int i = 0; i < count; ++i) {
+		const float d1 = float(distance[i] - start);
+		const float d1d2 = std::max(0.0f, d1*(length - d1));
+		bulge[i] = d1d2*bulgeFactor;
+		terrainWithBulge[i] = terrain[i] + bulge[i];
+		lineOfSight[i] = from + slope*d1;
+		fresnelRadius[i] = std::sqrt(fresnelFactor*d1d2);
+		clearance[i] = lineOfSight[i] - terrainWithBulge[i];
+	}
+
+	//the Fresnel zone is empty at the antennas
+	for (int i = 1; i < count - 1; ++i) {
+		if (!(fresnelRadius[i] > 0.0f) || clearance[i] != clearance[i]) {
+			continue;
+		}
+		const float ratio = clearance[i]/fresnelRadius[i];
+		if (!result.isValid() || ratio < result.minClearanceRatio) {
+			result.minClearanceRatio = ratio;
+			result.criticalIndex = i;
+		}
+		if (!(clearance[i] >= result.minClearance)) {
+			result.minClearance = clearance[i];
+		}
+	}
+}
+
+bool RadioPathProfile::compute(RadioPathResult& result, const RadioLink& link)
+{
+	RouteProfile profile(m_loader);
+	profile.setSamplesPerSegment(m_samples);
+	QVector<ProfilePoint> points;
+	computeLink(result, link, profile, points, m_frequencyMHz, m_kFactor, m_keepArrays);
+	return result.isValid();
+}
+
+QVector<RadioPathResult> RadioPathProfile::compute(const QVector<RadioLink>& links)
+{
+	QVector<RadioPathResult> retVal(links.size());
+	if (links.isEmpty()) {
+		return retVal;
+	}
+
+	const int jobCount = std::min(links.size(), std::max(1, m_threadPool->maxThreadCount())*JOBS_PER_THREAD_RADIO);
+	const int linksPerJob = (links.size() + jobCount - 1)/jobCount;
+
+	QFutureSynchronizer<void> synchronizer;
+	for (int first = 0; first < links.size(); first += linksPerJob) {
+		const int last = std::min(links.size(), first + linksPerJob);
+		synchronizer.addFuture(QtConcurrent::run(m_threadPool, [this, &links, &retVal, first, last]() {
+			RouteProfile profile(m_loader);
+			profile.setSamplesPerSegment(m_samples);
+			QVector<ProfilePoint> points;
+			for (int i = first; i < last; ++i) {
+				computeLink(retVal[i], links.at(i), profile, points, m_frequencyMHz, m_kFactor, m_keepArrays);
+			}
+		}));
+	}
+	synchronizer.waitForFinished();
+	return retVal;
+}
@@ -0,0 +1,162 @@
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <QFutureSynchronizer>
+#include <QHash>
+#include <QtMath>
+#include <limits>
+#include "RouteProfile.h"
+#include "../Geo/GeoConstants.h"
+#include "../Geo/GeoidGrid.h"
+
+//jobs per pool thread, small routes are grouped so a job amortizes its tile lookups
+const int JOBS_PER_THREAD_PROFILE = 8;
+
+/**
+ * @brief tiles used by one job, missing tiles are remembered as invalid handles
+ */
+class ProfileTiles
+{
+public:
+	explicit ProfileTiles(HgtLoader* loader) : m_loader(loader) {}
+
+	float elevation(const double lon, const double lat)
+	{
+		const int lonName = qFloor(lon);
+		const int latName = qFloor(lat);
+		const qint64 key = qint64(latName) << 32 | quint32(lonName);
+		if (key != m_currentKey) {
+			auto it = m_tiles.find(key);
+			if (it == m_tiles.end()) {
+				TileHandle tile;
+				m_loader->getTileHandle(tile, lon, lat);
+				it = m_tiles.insert(key, tile);
+			}
+			m_current = it.value();
+			m_currentKey = key;
+		}
+
+		float retVal = std::numeric_limits<float>::quiet_NaN();
+		if (!m_current.isValid()) {
+			return retVal;
+		}
+		m_loader->visitTileView(m_current, [&](const auto& view) {
+			qint16 elevation = 0;
+			if (view.getElevation(elevation, lon, lat) && elevation != ERROR_ELEVATION_SRTM_HGT) {
+				retVal = elevation;
+			}
+		});
+		return retVal;
+	}
+
+private:
+	HgtLoader* m_loader;
+	QHash<qint64, TileHandle> m_tiles;
+	TileHandle m_current;
+	qint64 m_currentKey = std::numeric_limits<qint64>::min();
+};
+
+static void computeProfile(QVector<ProfilePoint>& profile, const QVector<QPointF>& route, const int samplesPerSegment,
+						   ProfileTiles& tiles, const Geo::GeoidGrid* geoid)
+{
+	RouteProfile::samplePoints(profile, route, samplesPerSegment);
+	for (ProfilePoint& point : profile) {
+		point.elevation = tiles.elevation(point.lon, point.lat);
+	}
+	if (geoid) {
+		//the batch kernel of the grid takes separate coordinate and height arrays
+		const int count = profile.size();
+		QVector<double> lons(count);
+		QVector<double> lats(count);
+		QVector<float> heights(count);
+		for (int i = 0; i < count; ++i) {
+			lons[i] = profile.at(i).lon;
+			lats[i] = profile.at(i).lat;
+			heights[i] = profile.at(i).elevation;
+		}
+		geoid->toEllipsoidal(heights.data(), lons.constData(), lats.constData(), count);
+		for (int i = 0; i < count; ++i) {
+			profile[i].elevation = heights.at(i);
+		}
+	}
+}
+
+RouteProfile::RouteProfile(HgtLoader* loader) :
+	m_loader(loader),
+	m_threadPool(QThreadPool::globalInstance())
+{
+}
+
+void RouteProfile::setSamplesPerSegment(const int samples)
+{
+	m_samplesPerSegment = std::max(2, samples);
+}
+
+void RouteProfile::setThreadPool(QThreadPool* threadPool)
+{
+	m_threadPool = threadPool ? threadPool : QThreadPool::globalInstance();
+}
+
+void RouteProfile::setGeoid(const Geo::GeoidGrid* geoid)
+{
+	m_geoid = geoid;
+}
+
+void RouteProfile::samplePoints(QVector<ProfilePoint>& profile, const QVector<QPointF>& route, const int samplesPerSegment)
+{
+	profile.clear();
+	if (route.isEmpty()) {
+		return;
+	}
+	const int samples = std::max(2, samplesPerSegment);
+	profile.reserve(1 + (route.size() - 1)*(samples - 1));
+
+	ProfilePoint point;
+	point.lon = route.first().x();
+	point.lat = route.first().y();
+	profile.append(point);
+
+	double totalDistance = 0.0;
+	for (int i = 1; i < route.size(); ++i) {
+		const QPointF& from = route.at(i - 1);
+		const QPointF& to = route.at(i);
+		const double segmentLength = Geo::Constants::distance(from.x(), from.y(), to.x(), to.y());
+		for (int j = 1; j < samples; ++j) {
+			const double t = double(j)/(samples - 1);
+			point.lon = from.x() + t*(to.x() - from.x());
+			point.lat = from.y() + t*(to.y() - from.y());
+			point.distance = totalDistance + t*segmentLength;
+			profile.append(point);
+		}
+		totalDistance += segmentLength;
+	}
+}
+
+void RouteProfile::compute(QVector<ProfilePoint>& profile, const QVector<QPointF>& route)
+{
+	ProfileTiles tiles(m_loader);
+	computeProfile(profile, route, m_samplesPerSegment, tiles, m_geoid);
+}
+
+QVector<QVector<ProfilePoint>> RouteProfile::compute(const QVector<QVector<QPointF>>& routes)
+{
+	QVector<QVector<ProfilePoint>> retVal(routes.size());
+	if (routes.isEmpty()) {
+		return retVal;
+	}
+
+	const int jobCount = std::min(routes.size(), std::max(1, m_threadPool->maxThreadCount())*JOBS_PER_THREAD_PROFILE);
+	const int routesPerJob = (routes.size() + jobCount - 1)/jobCount;
+
+	QFutureSynchronizer<void> synchronizer;
+	for (int first = 0; first < routes.size(); first += routesPerJob) {
+		const int last = std::min(routes.size(), first + routesPerJob);
+		synchronizer.addFuture(QtConcurrent::run(m_threadPool, [this, &routes, &retVal, first, last]() {
+			ProfileTiles tiles(m_loader);
+			for (int i = first; i < last; ++i) {
+				computeProfile(retVal[i], routes.at(i), m_samplesPerSegment, tiles, m_geoid);
+			}
+		}));
+	}
+	synchronizer.waitForFinished();
+	return retVal;
+}
@@ -0,0 +1,397 @@
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <QFutureSynchronizer>
+#include <QHash>
+#include <QtMath>
+#include <QDebug>
+#include <queue>
+#include "TerrainClearance.h"
+#include "../Geo/GeoConstants.h"
+#include "../Geo/GeoidGrid.h"
+
+//jobs per pool thread, small routes are grouped so a job amortizes its tile lookups
+const int JOBS_PER_THREAD_CLEARANCE = 8;
+//stretches of at most this many samples are read sample by sample
+const int LEAF_SAMPLES_CLEARANCE = 32;
+//parts of a segment shorter than this (in t) are rounding leftovers at tile corners
+const double MIN_PART_CLEARANCE = 1e-12;
+
+struct ClearanceTile {
+	TileHandle handle;
+	QSharedPointer<const TileMaxPyramid> pyramid;
+
+	bool isValid() const {return handle.isValid() && pyramid;}
+};
+
+/**
+ * @brief tiles and their block maxima used by one job, missing tiles are remembered as invalid entries
+ */
+class ClearanceTiles
+{
+public:
+	explicit ClearanceTiles(HgtLoader* loader) : m_loader(loader) {}
+
+	ClearanceTile tile(const int lon, const int lat)
+	{
+		const qint64 key = qint64(lat) << 32 | quint32(lon);
+		auto it = m_tiles.find(key);
+		if (it == m_tiles.end()) {
+			ClearanceTile tile;
+			if (m_loader->getTileHandle(tile.handle, lon + 0.5, lat + 0.5)) {
+				tile.pyramid = m_loader->getTileMaxPyramid(tile.handle);
+			}
+			it = m_tiles.insert(key, tile);
+		}
+		return it.value();
+	}
+
+	HgtLoader* loader() const {return m_loader;}
+
+private:
+	HgtLoader* m_loader;
+	QHash<qint64, ClearanceTile> m_tiles;
+};
+
+/**
+ * @brief part of a segment inside one tile, sampled at t0 + (t1 - t0)*k/steps, k = 0..steps
+ */
+struct SegmentPart {
+	double t0 = 0.0;
+	double t1 = 0.0;
+	int steps = 1;
+	//invalid over missing tiles
+	ClearanceTile tile;
+	double pixPerDeg = 0.0;
+
+	double t(const int k) const {return t0 + (t1 - t0)*k/steps;}
+};
+
+//samples first..last of a part, bound is a lower bound of their clearance
+struct ClearanceStretch {
+	int part;
+	int first;
+	int last;
+	float bound;
+
+	bool operator>(const ClearanceStretch& other) const {return bound > other.bound;}
+};
+
+//run of consecutive samples below the margin, in t of the segment
+struct ViolationRun {
+	double t0;
+	double t1;
+	double step;
+	float minClearance;
+};
+
+/**
+ * @brief best first search over the samples of one segment
+ */
+class SegmentSearch
+{
+public:
+	SegmentSearch(ClearanceTiles& tiles, const QPointF& from, const QPointF& to, const double altitudeFrom,
+				  const double altitudeTo, const double margin) :
+		m_tiles(tiles),
+		m_from(from),
+		m_delta(to - from),
+		m_altitudeFrom(altitudeFrom),
+		m_altitudeDelta(altitudeTo - altitudeFrom),
+		m_margin(margin)
+	{
+	}
+
+	void run(SegmentClearance& clearance, const double startDistance, const double length)
+	{
+		clearance = SegmentClearance();
+		splitByTiles(clearance, length);
+
+		std::priority_queue<ClearanceStretch, std::vector<ClearanceStretch>, std::greater<ClearanceStretch>> queue;
+		for (int i = 0; i < m_parts.size(); ++i) {
+			if (m_parts.at(i).tile.isValid()) {
+				queue.push(stretch(i, 0, m_parts.at(i).steps));
+			}
+		}
+
+		while (!queue.empty()) {
+			const ClearanceStretch current = queue.top();
+			queue.pop();
+			//the queue is ordered by bound, none of the remaining stretches can change the result
+			if (current.bound >= m_margin && current.bound >= m_best) {
+				break;
+			}
+			if (current.last - current.first < LEAF_SAMPLES_CLEARANCE) {
+				readSamples(clearance, current);
+				continue;
+			}
+			const int middle = (current.first + current.last)/2;
+			queue.push(stretch(current.part, current.first, middle));
+			queue.push(stretch(current.part, middle + 1, current.last));
+		}
+
+		if (m_best < std::numeric_limits<float>::infinity()) {
+			clearance.minClearance = m_best;
+			clearance.distance = startDistance + m_bestT*length;
+			clearance.lon = m_from.x() + m_bestT*m_delta.x();
+			clearance.lat = m_from.y() + m_bestT*m_delta.y();
+			clearance.terrain = m_bestTerrain;
+			clearance.altitude = float(altitude(m_bestT));
+		}
+		mergeViolations(clearance, startDistance, length);
+	}
+
+private:
+	double altitude(const double t) const {return m_altitudeFrom + t*m_altitudeDelta;}
+
+	void splitByTiles(SegmentClearance& clearance, const double length)
+	{
+		QVector<double> cuts;
+		cuts << 0.0 << 1.0;
+		if (m_delta.x() != 0.0) {
+			const double west = std::min(m_from.x(), m_from.x() + m_delta.x());
+			const double east = std::max(m_from.x(), m_from.x() + m_delta.x());
+			for (int lon = qFloor(west) + 1; lon < east; ++lon) {
+				cuts.append((lon - m_from.x())/m_delta.x());
+			}
+		}
+		if (m_delta.y() != 0.0) {
+			const double south = std::min(m_from.y(), m_from.y() + m_delta.y());
+			const double north = std::max(m_from.y(), m_from.y() + m_delta.y());
+			for (int lat = qFloor(south) + 1; lat < north; ++lat) {
+				cuts.append((lat - m_from.y())/m_delta.y());
+			}
+		}
+		std::sort(cuts.begin(), cuts.end());
+
+		const double span = std::max(std::abs(m_delta.x()), std::abs(m_delta.y()));
+		for (int i = 1; i < cuts.size(); ++i) {
+			SegmentPart part;
+			part.t0 = cuts.at(i - 1);
+			part.t1 = cuts.at(i);
+			if (part.t1 - part.t0 < MIN_PART_CLEARANCE) {
+				continue;
+			}
+			const double t = (part.t0 + part.t1)/2.0;
+			part.tile = m_tiles.tile(qFloor(m_from.x() + t*m_delta.x()), qFloor(m_from.y() + t*m_delta.y()));
+			if (!part.tile.isValid()) {
+				clearance.unknownDistance += (part.t1 - part.t0)*length;
+				m_parts.append(part);
+				continue;
+			}
+			part.pixPerDeg = part.tile.pyramid->sideSize() - 1;
+			//one sample per pixel step along the larger of the lon and lat extents
+			part.steps = std::max(1, int(std::ceil((part.t1 - part.t0)*span*part.pixPerDeg)));
+			clearance.totalSamples += part.steps + 1;
+			m_parts.append(part);
+		}
+	}
+
+	//nearest sample of the point like TileView::getPixelIndex, unclamped
+	void pixel(int& col, int& row, const SegmentPart& part, const double t) const
+	{
+		const QPoint corner = part.tile.handle.leftBottomCorner();
+		col = qFloor((m_from.x() + t*m_delta.x() - corner.x())*part.pixPerDeg + 0.5);
+		row = qFloor((corner.y() + 1 - m_from.y() - t*m_delta.y())*part.pixPerDeg + 0.5);
+	}
+
+	ClearanceStretch stretch(const int partIndex, const int first, const int last) const
+	{
+		const SegmentPart& part = m_parts.at(partIndex);
+		const double t0 = part.t(first);
+		const double t1 = part.t(last);
+		int col0 = 0;
+		int row0 = 0;
+		int col1 = 0;
+		int row1 = 0;
+		pixel(col0, row0, part, t0);
+		pixel(col1, row1, part, t1);
+		const qint16 terrain = part.tile.pyramid->query(std::min(col0, col1), std::min(row0, row1),
+														 std::max(col0, col1), std::max(row0, row1));
+
+		ClearanceStretch retVal;
+		retVal.part = partIndex;
+		retVal.first = first;
+		retVal.last = last;
+		//voids only, nothing to read
+		retVal.bound = terrain == ERROR_ELEVATION_SRTM_HGT ? std::numeric_limits<float>::infinity()
+														   : float(std::min(altitude(t0), altitude(t1)) - terrain);
+		return retVal;
+	}
+
+	void readSamples(SegmentClearance& clearance, const ClearanceStretch& current)
+	{
+		const SegmentPart& part = m_parts.at(current.part);
+		const double step = (part.t1 - part.t0)/part.steps;
+		m_tiles.loader()->visitTileView(part.tile.handle, [&](const auto& view) {
+			bool inRun = false;
+			for (int k = current.first; k <= current.last; ++k) {
+				const double t = part.t(k);
+				qint16 elevation = 0;
+				clearance.readSamples++;
+				if (!view.getElevation(elevation, m_from.x() + t*m_delta.x(), m_from.y() + t*m_delta.y())
+						|| elevation == ERROR_ELEVATION_SRTM_HGT) {
+					clearance.voidSamples++;
+					inRun = false;
+					continue;
+				}
+				const float value = float(altitude(t) - elevation);
+				if (value < m_best || (value == m_best && t < m_bestT)) {
+					m_best = value;
+					m_bestT = t;
+					m_bestTerrain = elevation;
+				}
+				if (value >= m_margin) {
+					inRun = false;
+					continue;
+				}
+				if (inRun) {
+					ViolationRun& run = m_runs.last();
+					run.t1 = t;
+					run.minClearance = std::min(run.minClearance, value);
+				} else {
+					m_runs.append(ViolationRun{t, t, step, value});
+					inRun = true;
+				}
+			}
+		});
+	}
+
+	//runs of neighbouring leaves and parts touch within one sample step
+	void mergeViolations(SegmentClearance& clearance, const double startDistance, const double length)
+	{
+		std::sort(m_runs.begin(), m_runs.end(), [](const ViolationRun& a, const ViolationRun& b) {
+			return a.t0 < b.t0;
+		});
+		for (int i = 0; i < m_runs.size(); ++i) {
+			ViolationRun merged = m_runs.at(i);
+			while (i + 1 < m_runs.size() && m_runs.at(i + 1).t0 - merged.t1 <= 1.001*std::max(merged.step, m_runs.at(i + 1).step)) {
+				++i;
+				merged.t1 = std::max(merged.t1, m_runs.at(i).t1);
+				merged.step = std::max(merged.step, m_runs.at(i).step);
+				merged.minClearance = std::min(merged.minClearance, m_runs.at(i).minClearance);
+			}
+			ClearanceViolation violation;
+			violation.fromDistance = startDistance + merged.t0*length;
+			violation.toDistance = startDistance + merged.t1*length;
+			violation.minClearance = merged.minClearance;
+			clearance.violations.append(violation);
+		}
+	}
+
+private:
+	ClearanceTiles& m_tiles;
+	QPointF m_from;
+	QPointF m_delta;
+	double m_altitudeFrom;
+	double m_altitudeDelta;
+	float m_margin;
+
+	QVector<SegmentPart> m_parts;
+	QVector<ViolationRun> m_runs;
+	float m_best = std::numeric_limits<float>::infinity();
+	double m_bestT = 0.0;
+	float m_bestTerrain = 0.0f;
+};
+
+static void computeClearance(RouteClearance& clearance, const QVector<QPointF>& route, const QVector<double>& altitudes,
+							 const double margin, const Geo::GeoidGrid* geoid, ClearanceTiles& tiles)
+{
+	clearance = RouteClearance();
+	if (route.size() < 2) {
+		return;
+	}
+
+	//orthometric altitudes at the waypoints, the undulation changes by centimetres along a segment
+	QVector<double> heights = altitudes;
+	if (geoid) {
+		for (int i = 0; i < route.size(); ++i) {
+			heights[i] -= geoid->undulation(route.at(i).x(), route.at(i).y());
+		}
+	}
+
+	clearance.segments.resize(route.size() - 1);
+	double totalDistance = 0.0;
+	for (int i = 1; i < route.size(); ++i) {
+		const QPointF& from = route.at(i - 1);
+		const QPointF& to = route.at(i);
+		const double length = Geo::Constants::distance(from.x(), from.y(), to.x(), to.y());
+
+		SegmentClearance& segment = clearance.segments[i - 1];
+		SegmentSearch search(tiles, from, to, heights.at(i - 1), heights.at(i), margin);
+		search.run(segment, totalDistance, length);
+		if (segment.hasMinimum() && (!clearance.isValid() || segment.minClearance < clearance.minClearance)) {
+			clearance.minClearance = segment.minClearance;
+			clearance.minSegment = i - 1;
+		}
+		totalDistance += length;
+	}
+}
+
+bool RouteClearance::isClear() const
+{
+	for (const SegmentClearance& segment : segments) {
+		if (!segment.violations.isEmpty()) {
+			return false;
+		}
+	}
+	return true;
+}
+
+TerrainClearance::TerrainClearance(HgtLoader* loader) :
+	m_loader(loader),
+	m_threadPool(QThreadPool::globalInstance())
+{
+}
+
+void TerrainClearance::setMargin(const double margin)
+{
+	m_margin = margin;
+}
+
+void TerrainClearance::setGeoid(const Geo::GeoidGrid* geoid)
+{
+	m_geoid = geoid;
+}
+
+void TerrainClearance::setThreadPool(QThreadPool* threadPool)
+{
+	m_threadPool = threadPool ? threadPool : QThreadPool::globalInstance();
+}
+
+bool TerrainClearance::compute(RouteClearance& clearance, const QVector<QPointF>& route, const QVector<double>& altitudes)
+{
+	clearance = RouteClearance();
+	if (route.size() != altitudes.size()) {
+		qDebug() << QString("TerrainClearance.compute. %1 waypoints, but %2 altitudes.").arg(route.size()).arg(altitudes.size());
+		return false;
+	}
+	ClearanceTiles tiles(m_loader);
+	computeClearance(clearance, route, altitudes, m_margin, m_geoid, tiles);
+	return clearance.isValid();
+}
+
+QVector<RouteClearance> TerrainClearance::compute(const QVector<QVector<QPointF>>& routes, const QVector<QVector<double>>& altitudes)
+{
+	QVector<RouteClearance> retVal(routes.size());
+	if (routes.isEmpty() || routes.size() != altitudes.size()) {
+		return retVal;
+	}
+
+	const int jobCount = std::min(routes.size(), std::max(1, m_threadPool->maxThreadCount())*JOBS_PER_THREAD_CLEARANCE);
+	const int routesPerJob = (routes.size() + jobCount - 1)/jobCount;
+
+	QFutureSynchronizer<void> synchronizer;
+	for (int first = 0; first < routes.size(); first += routesPerJob) {
+		const int last = std::min(routes.size(), first + routesPerJob);
+		synchronizer.addFuture(QtConcurrent::run(m_threadPool, [this, &routes, &altitudes, &retVal, first, last]() {
+			ClearanceTiles tiles(m_loader);
+			for (int i = first; i < last; ++i) {
+				if (routes.at(i).size() == altitudes.at(i).size()) {
+					computeClearance(retVal[i], routes.at(i), altitudes.at(i), m_margin, m_geoid, tiles);
+				}
+			}
+		}));
+	}
+	synchronizer.waitForFinished();
+	return retVal;
+}
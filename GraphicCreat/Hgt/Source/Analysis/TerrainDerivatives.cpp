@@ -0,0 +1,360 @@
+#include <QtConcurrent>
+#include <QMutexLocker>
+#include <QVarLengthArray>
+#include <QtMath>
+#include <QDebug>
+#include <algorithm>
+#include <limits>
+#include "TerrainDerivatives.h"
+#include "../CpuFeatures.h"
+#include "../Geo/GeoConstants.h"
+
+//rows per block, a block with its two halo rows stays in L2 for SRTM1 tiles
+const int BLOCK_ROWS_TERRAIN = 32;
+const float NAN_TERRAIN = std::numeric_limits<float>::quiet_NaN();
+const double RAD2DEG_TERRAIN = 180.0/M_PI;
+//sun positions are rounded to this, in degrees
+const double SUN_STEP_TERRAIN = 0.1;
+
+/**
+ * @brief the tile with its eight neighbours, [0][*] is the northern row, [1][1] the tile itself
+ */
+struct TerrainNeighbourhood {
+	TileHandle tiles[3][3];
+	int sideSize = 0;
+};
+
+static void readSamples(HgtLoader* loader, const TileHandle& tile, float* out, const int row, const int col, const int count)
+{
+	QVarLengthArray<qint16, 4096> samples(count);
+	loader->visitTileView(tile, [&](const auto& view) {
+		view.readRow(samples.data(), row, col, count);
+	});
+	for (int i = 0; i < count; ++i) {
+		out[i] = samples[i] == ERROR_ELEVATION_SRTM_HGT ? NAN_TERRAIN : float(samples[i]);
+	}
+}
+
+/**
+ * @brief row -1..sideSize of the tile with one halo column on each side, sideSize+2 values.
+ * Neighbours share the edge samples, so the halo comes from their second row or column.
+ * Missing neighbours are replaced by repeating the edge.
+ */
+static void readPaddedRow(HgtLoader* loader, const TerrainNeighbourhood& area, const int row, float* out)
+{
+	const int sideSize = area.sideSize;
+	int tileRow = 1;
+	int srcRow = row;
+	if (row < 0) {
+		tileRow = 0;
+		srcRow = sideSize - 2;
+	} else if (row >= sideSize) {
+		tileRow = 2;
+		srcRow = 1;
+	}
+	if (!area.tiles[tileRow][1].isValid()) {
+		tileRow = 1;
+		srcRow = std::max(0, std::min(sideSize - 1, row));
+	}
+
+	readSamples(loader, area.tiles[tileRow][1], out + 1, srcRow, 0, sideSize);
+
+	if (area.tiles[tileRow][0].isValid()) {
+		readSamples(loader, area.tiles[tileRow][0], out, srcRow, sideSize - 2, 1);
+	} else {
+		out[0] = out[1];
+	}
+
+	if (area.tiles[tileRow][2].isValid()) {
+		readSamples(loader, area.tiles[tileRow][2], out + sideSize + 1, srcRow, 1, 1);
+	} else {
+		out[sideSize + 1] = out[sideSize];
+	}
+}
+
+#if defined(HGT_X86_DISPATCH)
+/**
+ * @brief Horn's gradients of 8 columns per step, returns the columns done, the rest is left to the scalar loop
+ */
+HGT_TARGET("avx") static int rowGradientsAvx(float* dzdEast, float* dzdNorth, const float* top, const float* middle,
+											 const float* bottom, const int count, const float eastScale, const float northScale)
+{
+	const __m256 two = _mm256_set1_ps(2.0f);
+	const __m256 eastFactor = _mm256_set1_ps(eastScale);
+	const __m256 northFactor = _mm256_set1_ps(northScale);
+	int col = 0;
+	for (; col + 8 <= count; col += 8) {
+		const __m256 a = _mm256_loadu_ps(top + col);
+		const __m256 b = _mm256_loadu_ps(top + col + 1);
+		const __m256 c = _mm256_loadu_ps(top + col + 2);
+		const __m256 d = _mm256_loadu_ps(middle + col);
+		const __m256 f = _mm256_loadu_ps(middle + col + 2);
+		const __m256 g = _mm256_loadu_ps(bottom + col);
+		const __m256 h = _mm256_loadu_ps(bottom + col + 1);
+		const __m256 i = _mm256_loadu_ps(bottom + col + 2);
+		//(c + 2f + i) - (a + 2d + g)
+		__m256 east = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(c, i), _mm256_mul_ps(two, f)),
+									_mm256_add_ps(_mm256_add_ps(a, g), _mm256_mul_ps(two, d)));
+		//(a + 2b + c) - (g + 2h + i)
+		__m256 north = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(a, c), _mm256_mul_ps(two, b)),
+									 _mm256_add_ps(_mm256_add_ps(g, i), _mm256_mul_ps(two, h)));
+		_mm256_storeu_ps(dzdEast + col, _mm256_mul_ps(east, eastFactor));
+		_mm256_storeu_ps(dzdNorth + col, _mm256_mul_ps(north, northFactor));
+	}
+	return col;
+}
+#endif
+
+/**
+ * @brief Horn's gradients of one row, top/middle/bottom are padded rows, output j uses input columns j..j+2
+ */
+static void rowGradients(float* dzdEast, float* dzdNorth, const float* top, const float* middle, const float* bottom,
+						 const int count, const float eastScale, const float northScale)
+{
+	int col = 0;
+#if defined(HGT_X86_DISPATCH)
+	if (CpuFeatures::hasAvx()) {
+		col = rowGradientsAvx(dzdEast, dzdNorth, top, middle, bottom, count, eastScale, northScale);
+	}
+#endif
+	for (; col < count; ++col) {
+		const float* t = top + col;
+		const float* m = middle + col;
+		const float* b = bottom + col;
+		dzdEast[col] = ((t[2] + 2.0f*m[2] + b[2]) - (t[0] + 2.0f*m[0] + b[0]))*eastScale;
+		dzdNorth[col] = ((t[0] + 2.0f*t[1] + t[2]) - (b[0] + 2.0f*b[1] + b[2]))*northScale;
+	}
+}
+
+TerrainDerivatives::TerrainDerivatives(HgtLoader* loader) :
+	m_loader(loader)
+{
+}
+
+void TerrainDerivatives::setSunPosition(const double azimuth, const double altitude)
+{
+	const double steps = 360.0/SUN_STEP_TERRAIN;
+	double azimuthSteps = fmod(double(qRound64(azimuth/SUN_STEP_TERRAIN)), steps);
+	if (azimuthSteps < 0.0) {
+		azimuthSteps += steps;
+	}
+	m_sunAzimuth = azimuthSteps*SUN_STEP_TERRAIN;
+	m_sunAltitude = qRound64(altitude/SUN_STEP_TERRAIN)*SUN_STEP_TERRAIN;
+}
+
+void TerrainDerivatives::setMaxCacheMemory(const qint64 bytes)
+{
+	QMutexLocker locker(&m_cacheLock);
+	m_maxCacheBytes = std::max<qint64>(0, bytes);
+}
+
+qint64 TerrainDerivatives::maxCacheMemory() const
+{
+	return m_maxCacheBytes;
+}
+
+QString TerrainDerivatives::cacheKey(const TerrainProduct product) const
+{
+	if (product == TerrainProduct::Hillshade) {
+		//in steps of the rounding, the doubles themselves may differ in the last bits
+		return QString("%1/%2/%3").arg(int(product)).arg(qRound64(m_sunAzimuth/SUN_STEP_TERRAIN)).arg(qRound64(m_sunAltitude/SUN_STEP_TERRAIN));
+	}
+	return QString::number(int(product));
+}
+
+bool TerrainDerivatives::compute(TerrainRaster& raster, const TileHandle& tile, const TerrainProduct product)
+{
+	if (!tile.isValid() || !m_loader->visitTileView(tile, [](const auto&) {})) {
+		qDebug() << "TerrainDerivatives.compute. Unknown tile format.";
+		return false;
+	}
+
+	TerrainNeighbourhood area;
+	area.sideSize = qRound(sqrt(double(tile.size()/sizeof(qint16))));
+	const int sideSize = area.sideSize;
+	const QPoint corner = tile.leftBottomCorner();
+	for (int tileRow = 0; tileRow < 3; ++tileRow) {
+		for (int tileCol = 0; tileCol < 3; ++tileCol) {
+			if (tileRow == 1 && tileCol == 1) {
+				area.tiles[1][1] = tile;
+				continue;
+			}
+			TileHandle neighbour;
+			double lon = corner.x() + tileCol - 1 + 0.5;
+			double lat = corner.y() + 1 - tileRow + 0.5;
+			if (m_loader->getTileHandle(neighbour, lon, lat) && neighbour.size() == tile.size()) {
+				area.tiles[tileRow][tileCol] = neighbour;
+			}
+		}
+	}
+
+	raster.leftBottomCorner = corner;
+	raster.sideSize = sideSize;
+	raster.product = product;
+	if (raster.data.size() != sideSize*sideSize) {
+		raster.data.resize(sideSize*sideSize);
+	}
+	float* output = raster.data.data();
+
+	const double pixPerDeg = sideSize - 1;
+	const double sunAzimuth = qDegreesToRadians(m_sunAzimuth);
+	const double sunAltitude = qDegreesToRadians(m_sunAltitude);
+	const float sunEast = sin(sunAzimuth)*cos(sunAltitude);
+	const float sunNorth = cos(sunAzimuth)*cos(sunAltitude);
+	const float sunUp = sin(sunAltitude);
+	HgtLoader* loader = m_loader;
+
+	QVector<int> blocks;
+	for (int row = 0; row < sideSize; row += BLOCK_ROWS_TERRAIN) {
+		blocks.append(row);
+	}
+
+	QtConcurrent::blockingMap(blocks, [&, loader, output](const int blockRow) {
+		const int rowEnd = std::min(sideSize, blockRow + BLOCK_ROWS_TERRAIN);
+		const int stride = sideSize + 2;
+		//block rows with one halo row above and below
+		QVector<float> padded((rowEnd - blockRow + 2)*stride);
+		for (int row = blockRow - 1; row <= rowEnd; ++row) {
+			readPaddedRow(loader, area, row, padded.data() + (row - blockRow + 1)*stride);
+		}
+
+		QVector<float> dzdEast(sideSize);
+		QVector<float> dzdNorth(sideSize);
+		for (int row = blockRow; row < rowEnd; ++row) {
+			const float* top = padded.constData() + (row - blockRow)*stride;
+			const float* middle = top + stride;
+			const float* bottom = middle + stride;
+
+			const double lat = corner.y() + 1 - row/pixPerDeg;
+			const double dx = Geo::Constants::metersPerDegreeLon(lat)/pixPerDeg;
+			const double dy = Geo::Constants::metersPerDegreeLat(lat)/pixPerDeg;
+			rowGradients(dzdEast.data(), dzdNorth.data(), top, middle, bottom, sideSize, 1.0/(8.0*dx), 1.0/(8.0*dy));
+
+			float* out = output + qint64(row)*sideSize;
+			switch (product) {
+			case TerrainProduct::Slope:
+				for (int col = 0; col < sideSize; ++col) {
+					const float p = dzdEast[col];
+					const float q = dzdNorth[col];
+					out[col] = atan(sqrt(p*p + q*q))*RAD2DEG_TERRAIN;
+				}
+				break;
+			case TerrainProduct::Aspect:
+				for (int col = 0; col < sideSize; ++col) {
+					const float p = dzdEast[col];
+					const float q = dzdNorth[col];
+					if (p == 0.0f && q == 0.0f) {
+						out[col] = -1.0f;
+						continue;
+					}
+					//downslope is against the gradient
+					float azimuth = atan2(-p, -q)*RAD2DEG_TERRAIN;
+					out[col] = azimuth < 0.0f ? azimuth + 360.0f : azimuth;
+				}
+				break;
+			case TerrainProduct::Curvature: {
+				const float invDx2 = 1.0/(dx*dx);
+				const float invDy2 = 1.0/(dy*dy);
+				for (int col = 0; col < sideSize; ++col) {
+					const float e = middle[col + 1];
+					const float d2x = ((middle[col] + middle[col + 2])*0.5f - e)*invDx2;
+					const float d2y = ((top[col + 1] + bottom[col + 1])*0.5f - e)*invDy2;
+					out[col] = -2.0f*(d2x + d2y)*100.0f;
+				}
+				break;
+			}
+			case TerrainProduct::Hillshade:
+				for (int col = 0; col < sideSize; ++col) {
+					const float p = dzdEast[col];
+					const float q = dzdNorth[col];
+					if (p != p || q != q) {
+						out[col] = NAN_TERRAIN;
+						continue;
+					}
+					//surface normal (-p, -q, 1) against the light direction
+					const float light = (-p*sunEast - q*sunNorth + sunUp)/sqrt(p*p + q*q + 1.0f);
+					out[col] = std::max(0.0f, light)*255.0f;
+				}
+				break;
+			}
+		}
+	});
+
+	return true;
+}
+
+QSharedPointer<const TerrainRaster> TerrainDerivatives::cached(const TileHandle& tile, const TerrainProduct product)
+{
+	if (!tile.isValid()) {
+		return QSharedPointer<const TerrainRaster>();
+	}
+
+	QSharedPointer<TileStorage> storage = tile.storage();
+	const QString key = cacheKey(product);
+	QSharedPointer<const TerrainRaster> retVal;
+	qint64 builtBytes = 0;
+	{
+		QMutexLocker locker(&storage->derivedLock);
+		retVal = storage->derived.value(key);
+		if (!retVal) {
+			QSharedPointer<TerrainRaster> raster(new TerrainRaster);
+			if (!compute(*raster, tile, product)) {
+				return QSharedPointer<const TerrainRaster>();
+			}
+			builtBytes = qint64(raster->data.size())*qint64(sizeof(float));
+			storage->derived.insert(key, raster);
+			retVal = raster;
+		}
+	}
+
+	touchCached(storage, key, builtBytes);
+	return retVal;
+}
+
+void TerrainDerivatives::touchCached(const QSharedPointer<TileStorage>& storage, const QString& key, const qint64 builtBytes)
+{
+	QMutexLocker locker(&m_cacheLock);
+	CacheEntry entry;
+	entry.storage = storage;
+	entry.key = key;
+	entry.bytes = builtBytes;
+	for (int i = 0; i < m_cache.size(); ++i) {
+		if (m_cache.at(i).storage == storage && m_cache.at(i).key == key) {
+			entry.bytes += m_cache.takeAt(i).bytes;
+			break;
+		}
+	}
+	m_cache.append(entry);
+	m_cacheBytes += builtBytes;
+
+	//rasters of destroyed tiles were freed with them
+	for (int i = m_cache.size() - 2; i >= 0; --i) {
+		if (m_cache.at(i).storage.isNull()) {
+			m_cacheBytes -= m_cache.takeAt(i).bytes;
+		}
+	}
+
+	//holders of a dropped raster keep it until they release it
+	while (m_cacheBytes > m_maxCacheBytes && m_cache.size() > 1) {
+		CacheEntry oldest = m_cache.takeFirst();
+		m_cacheBytes -= oldest.bytes;
+		QSharedPointer<TileStorage> oldStorage = oldest.storage.toStrongRef();
+		if (oldStorage) {
+			QMutexLocker storageLocker(&oldStorage->derivedLock);
+			oldStorage->derived.remove(oldest.key);
+		}
+	}
+}
+
+QList<QSharedPointer<const TerrainRaster>> TerrainDerivatives::cachedByRect(const double minLon, const double maxLon,
+																			const double minLat, const double maxLat, const TerrainProduct product)
+{
+	QList<QSharedPointer<const TerrainRaster>> retVal;
+	for (const TileHandle& tile : m_loader->getTileHandlesByRect(minLon, maxLon, minLat, maxLat)) {
+		QSharedPointer<const TerrainRaster> raster = cached(tile, product);
+		if (raster) {
+			retVal.append(raster);
+		}
+	}
+	return retVal;
+}
@@ -0,0 +1,135 @@
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <QFutureSynchronizer>
+#include <QHash>
+#include <QFile>
+#include <QDebug>
+#include <algorithm>
+#include <limits>
+#include "UtmResampler.h"
+
+const float NAN_UTM_RESAMPLER = std::numeric_limits<float>::quiet_NaN();
+
+UtmResampler::UtmResampler(HgtLoader* loader) :
+	m_loader(loader),
+	m_threadPool(QThreadPool::globalInstance())
+{
+}
+
+void UtmResampler::setThreadPool(QThreadPool* threadPool)
+{
+	m_threadPool = threadPool ? threadPool : QThreadPool::globalInstance();
+}
+
+void UtmResampler::setBlockRows(const int blockRows)
+{
+	m_blockRows = std::max(1, blockRows);
+}
+
+bool UtmResampler::resample(QVector<float>& raster, const UtmGrid& grid)
+{
+	if (!grid.isValid() || grid.cellCount() > std::numeric_limits<int>::max()) {
+		qDebug() << "UtmResampler.resample. Grid incorrect.";
+		return false;
+	}
+	raster.resize(int(grid.cellCount()));
+	return resample(raster.data(), grid);
+}
+
+bool UtmResampler::resampleToFile(const QString& path, const UtmGrid& grid)
+{
+	if (!grid.isValid()) {
+		qDebug() << "UtmResampler.resampleToFile. Grid incorrect.";
+		return false;
+	}
+
+	const qint64 bytes = grid.cellCount()*qint64(sizeof(float));
+	QFile file(path);
+	if (!file.open(QIODevice::ReadWrite | QIODevice::Truncate) || !file.resize(bytes)) {
+		qDebug() << "UtmResampler.resampleToFile. Can't create" << path;
+		return false;
+	}
+	uchar* data = file.map(0, bytes);
+	if (!data) {
+		qDebug() << "UtmResampler.resampleToFile. Can't map" << path;
+		return false;
+	}
+
+	bool retVal = resample(reinterpret_cast<float*>(data), grid);
+	file.unmap(data);
+	file.close();
+	return retVal;
+}
+
+bool UtmResampler::resample(float* raster, const UtmGrid& grid)
+{
+	if (!raster || !grid.isValid()) {
+		qDebug() << "UtmResampler.resample. Grid incorrect.";
+		return false;
+	}
+
+	const Geo::UtmProjection projection(grid.zone, grid.north);
+	QFutureSynchronizer<void> synchronizer;
+	for (int row = 0; row < grid.rows; row += m_blockRows) {
+		const int rowEnd = std::min(grid.rows, row + m_blockRows);
+		synchronizer.addFuture(QtConcurrent::run(m_threadPool, [this, raster, &grid, &projection, row, rowEnd]() {
+			resampleRows(raster, grid, projection, row, rowEnd);
+		}));
+	}
+	synchronizer.waitForFinished();
+	return true;
+}
+
+void UtmResampler::resampleRows(float* raster, const UtmGrid& grid, const Geo::UtmProjection& projection,
+								const int rowBegin, const int rowEnd)
+{
+	const int cols = grid.cols;
+	QVector<double> eastings(cols);
+	QVector<double> northings(cols);
+	QVector<double> lons(cols);
+	QVector<double> lats(cols);
+	for (int col = 0; col < cols; ++col) {
+		eastings[col] = grid.minEasting + (col + 0.5)*grid.cellSize;
+	}
+
+	//tiles of this block by left bottom corner, invalid handles for missing tiles so they are probed once
+	QHash<quint32, TileHandle> tiles;
+
+	for (int row = rowBegin; row < rowEnd; ++row) {
+		std::fill(northings.begin(), northings.end(), grid.maxNorthing - (row + 0.5)*grid.cellSize);
+		projection.inverse(eastings.constData(), northings.constData(), lons.data(), lats.data(), cols);
+		for (int col = 0; col < cols; ++col) {
+			//grids crossing the antimeridian
+			lons[col] -= 360.0*floor((lons[col] + 180.0)/360.0);
+		}
+
+		float* out = raster + qint64(row)*cols;
+		for (int col0 = 0; col0 < cols;) {
+			const int tileLon = floor(lons.at(col0));
+			const int tileLat = floor(lats.at(col0));
+			int col1 = col0 + 1;
+			while (col1 < cols && int(floor(lons.at(col1))) == tileLon && int(floor(lats.at(col1))) == tileLat) ++col1;
+
+			const quint32 key = quint32(tileLon + 180) << 16 | quint32(tileLat + 90);
+			auto it = tiles.find(key);
+			if (it == tiles.end()) {
+				TileHandle tile;
+				if (!m_loader->getTileHandle(tile, tileLon + 0.5, tileLat + 0.5)) {
+					tile.reset();
+				}
+				it = tiles.insert(key, tile);
+			}
+
+			const bool found = it.value().isValid() && m_loader->visitTileView(it.value(), [&](const auto& view) {
+				const double pixPerDeg = view.PIX_PER_DEG;
+				for (int col = col0; col < col1; ++col) {
+					out[col] = view.interpolate((lons.at(col) - tileLon)*pixPerDeg, (tileLat + 1 - lats.at(col))*pixPerDeg);
+				}
+			});
+			if (!found) {
+				std::fill(out + col0, out + col1, NAN_UTM_RESAMPLER);
+			}
+			col0 = col1;
+		}
+	}
+}
@@ -0,0 +1,479 @@
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <QFutureSynchronizer>
+#include <QCryptographicHash>
+#include <QImage>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QMutexLocker>
+#include <QtMath>
+#include <QDebug>
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include "XyzTileGenerator.h"
+#include "../Geo/GeoConstants.h"
+
+const QString MANIFEST_FILE_XYZ = "pyramid.hash";
+const float NAN_XYZ = std::numeric_limits<float>::quiet_NaN();
+const double RAD2DEG_XYZ = 180.0/M_PI;
+
+/**
+ * @brief source tiles under one map tile and its one pixel margin, row-major from the south-west tile
+ */
+struct XyzSources {
+	int lon0 = 0;
+	int lat0 = 0;
+	int cols = 0;
+	int rows = 0;
+	QVector<TileHandle> tiles;
+
+	const TileHandle* find(const int lon, const int lat) const
+	{
+		const int col = lon - lon0;
+		const int row = lat - lat0;
+		if (col < 0 || col >= cols || row < 0 || row >= rows || !tiles.at(row*cols + col).isValid()) {
+			return nullptr;
+		}
+		return &tiles.at(row*cols + col);
+	}
+};
+
+struct XyzJob {
+	int zoom = 0;
+	int x = 0;
+	int y = 0;
+};
+
+/**
+ * @brief jobs of one worker. The owner takes from the front, thieves take from the back,
+ * so both keep working on neighbouring map tiles that share source tiles.
+ */
+class XyzWorkQueue
+{
+public:
+	void append(const XyzJob& job) {m_jobs.append(job);}
+
+	bool takeFirst(XyzJob& job)
+	{
+		QMutexLocker locker(&m_lock);
+		if (m_jobs.isEmpty()) {
+			return false;
+		}
+		job = m_jobs.takeFirst();
+		return true;
+	}
+
+	bool steal(XyzJob& job)
+	{
+		QMutexLocker locker(&m_lock);
+		if (m_jobs.isEmpty()) {
+			return false;
+		}
+		job = m_jobs.takeLast();
+		return true;
+	}
+
+private:
+	QMutex m_lock;
+	QList<XyzJob> m_jobs;
+};
+
+//global pixel coordinates of the zoom level to degrees
+static inline double pixelToLon(const double pixel, const int zoom)
+{
+	return pixel/(Geo::Constants::TILE_SIZE_PIX*double(1 << zoom))*360.0 - 180.0;
+}
+
+static inline double pixelToLat(const double pixel, const int zoom)
+{
+	const double n = M_PI*(1.0 - 2.0*pixel/(Geo::Constants::TILE_SIZE_PIX*double(1 << zoom)));
+	return atan(sinh(n))*RAD2DEG_XYZ;
+}
+
+static inline int lonToTileX(const double lon, const int zoom)
+{
+	const int count = 1 << zoom;
+	return std::max(0, std::min(count - 1, int(floor((lon + 180.0)/360.0*count))));
+}
+
+static inline int latToTileY(const double lat, const int zoom)
+{
+	const int count = 1 << zoom;
+	const double latRad = qDegreesToRadians(std::max(-Geo::Constants::MERCATOR_MAX_LAT, std::min(Geo::Constants::MERCATOR_MAX_LAT, lat)));
+	return std::max(0, std::min(count - 1, int(floor((1.0 - asinh(tan(latRad))/M_PI)/2.0*count))));
+}
+
+static inline quint32 sourceKey(const QPoint& corner)
+{
+	return quint32(corner.x() + 180) << 16 | quint32(corner.y() + 90);
+}
+
+/**
+ * @brief bilinear samples of the grid cells [row0,row1) x [col0,col1) that fall into the view's tile
+ */
+template<typename View>
+static void sampleBilinear(const View& view, float* grid, const int stride, const double* lons, const double* lats,
+						   const int row0, const int row1, const int col0, const int col1)
+{
+	const QPoint corner = view.leftBottomCorner();
+	for (int row = row0; row < row1; ++row) {
+		const double rowF = (corner.y() + 1 - lats[row])*View::PIX_PER_DEG;
+		float* out = grid + row*stride;
+		for (int col = col0; col < col1; ++col) {
+			out[col] = view.interpolate((lons[col] - corner.x())*View::PIX_PER_DEG, rowF);
+		}
+	}
+}
+
+XyzTileGenerator::XyzTileGenerator(HgtLoader* loader) :
+	m_loader(loader),
+	m_threadPool(QThreadPool::globalInstance())
+{
+}
+
+void XyzTileGenerator::setFormat(const XyzTileFormat format)
+{
+	m_format = format;
+}
+
+void XyzTileGenerator::setSunPosition(const double azimuth, const double altitude)
+{
+	m_sunAzimuth = azimuth;
+	m_sunAltitude = altitude;
+}
+
+void XyzTileGenerator::setThreadPool(QThreadPool* threadPool)
+{
+	m_threadPool = threadPool ? threadPool : QThreadPool::globalInstance();
+}
+
+bool XyzTileGenerator::collectSources(XyzSources& sources, const int zoom, const int x, const int y, const QRect& area)
+{
+	const int size = Geo::Constants::TILE_SIZE_PIX;
+	//one pixel margin for the hillshade stencil
+	const double west = std::max(Geo::Constants::GEO_MIN_LON, pixelToLon(x*size - 1, zoom));
+	const double east = std::min(Geo::Constants::GEO_MAX_LON - 1e-9, pixelToLon((x + 1)*size + 1, zoom));
+	const double north = pixelToLat(y*size - 1, zoom);
+	const double south = pixelToLat((y + 1)*size + 1, zoom);
+
+	sources.lon0 = floor(west);
+	sources.lat0 = floor(south);
+	sources.cols = int(floor(east)) - sources.lon0 + 1;
+	sources.rows = int(floor(north)) - sources.lat0 + 1;
+	sources.tiles.resize(sources.cols*sources.rows);
+
+	bool found = false;
+	for (int row = 0; row < sources.rows; ++row) {
+		for (int col = 0; col < sources.cols; ++col) {
+			TileHandle& tile = sources.tiles[row*sources.cols + col];
+			const int lon = sources.lon0 + col;
+			const int lat = sources.lat0 + row;
+			//without an area only the tiles on disk are opened, a map tile of a low zoom covers thousands of them
+			const bool wanted = area.isValid() ? area.contains(lon, lat)
+											   : m_loader->doesExistHgtInCache(lon + 0.5, lat + 0.5);
+			if (!wanted) {
+				tile.reset();
+				continue;
+			}
+			if (m_loader->getTileHandle(tile, lon + 0.5, lat + 0.5)) {
+				found = true;
+			} else {
+				tile.reset();
+			}
+		}
+	}
+	return found;
+}
+
+QByteArray XyzTileGenerator::sourceDigest(const TileHandle& tile)
+{
+	const quint32 key = sourceKey(tile.leftBottomCorner());
+	{
+		QMutexLocker locker(&m_digestLock);
+		auto it = m_digests.find(key);
+		if (it != m_digests.end()) {
+			return it.value();
+		}
+	}
+
+	//hashed outside of the lock, two workers may hash the same tile once
+	const QByteArray digest = QCryptographicHash::hash(tile.rawData(), QCryptographicHash::Sha1);
+	QMutexLocker locker(&m_digestLock);
+	m_digests.insert(key, digest);
+	return digest;
+}
+
+QByteArray XyzTileGenerator::tileKey(const XyzSources& sources, const int zoom, const int x, const int y)
+{
+	QCryptographicHash hash(QCryptographicHash::Sha1);
+	QString settings = QString("%1/%2/%3/%4").arg(int(m_format)).arg(zoom).arg(x).arg(y);
+	if (m_format == XyzTileFormat::Hillshade) {
+		settings += QString("/%1/%2").arg(m_sunAzimuth).arg(m_sunAltitude);
+	}
+	hash.addData(settings.toUtf8());
+	for (const TileHandle& tile : sources.tiles) {
+		hash.addData(tile.isValid() ? sourceDigest(tile) : QByteArray("-"));
+	}
+	return hash.result().toHex();
+}
+
+bool XyzTileGenerator::render(QImage& image, const int zoom, const int x, const int y)
+{
+	if (zoom < Geo::Constants::MIN_ZOOM_LEVEL || zoom > Geo::Constants::MAX_ZOOM_LEVEL
+			|| x < 0 || y < 0 || x >= (1 << zoom) || y >= (1 << zoom)) {
+		qDebug() << "XyzTileGenerator.render. Tile index incorrect.";
+		return false;
+	}
+
+	XyzSources sources;
+	if (!collectSources(sources, zoom, x, y, QRect())) {
+		return false;
+	}
+	render(image, sources, zoom, x, y);
+	return true;
+}
+
+void XyzTileGenerator::render(QImage& image, const XyzSources& sources, const int zoom, const int x, const int y)
+{
+	const int size = Geo::Constants::TILE_SIZE_PIX;
+	const int stride = size + 2;
+
+	//pixel centres with a one pixel margin, the grid is separable in lon and lat
+	QVector<double> lons(stride);
+	QVector<double> lats(stride);
+	for (int i = 0; i < stride; ++i) {
+		lons[i] = std::max(Geo::Constants::GEO_MIN_LON,
+						   std::min(Geo::Constants::GEO_MAX_LON - 1e-9, pixelToLon(x*size + i - 1 + 0.5, zoom)));
+		lats[i] = pixelToLat(y*size + i - 1 + 0.5, zoom);
+	}
+
+	//runs of rows and columns that read the same source tile
+	QVector<float> grid(stride*stride, NAN_XYZ);
+	for (int row0 = 0; row0 < stride;) {
+		const int tileLat = floor(lats.at(row0));
+		int row1 = row0 + 1;
+		while (row1 < stride && int(floor(lats.at(row1))) == tileLat) ++row1;
+
+		for (int col0 = 0; col0 < stride;) {
+			const int tileLon = floor(lons.at(col0));
+			int col1 = col0 + 1;
+			while (col1 < stride && int(floor(lons.at(col1))) == tileLon) ++col1;
+
+			const TileHandle* tile = sources.find(tileLon, tileLat);
+			if (tile) {
+				m_loader->visitTileView(*tile, [&](const auto& view) {
+					sampleBilinear(view, grid.data(), stride, lons.constData(), lats.constData(), row0, row1, col0, col1);
+				});
+			}
+			col0 = col1;
+		}
+		row0 = row1;
+	}
+
+	if (image.width() != size || image.height() != size || image.format() != QImage::Format_ARGB32) {
+		image = QImage(size, size, QImage::Format_ARGB32);
+	}
+
+	if (m_format == XyzTileFormat::TerrainRgb) {
+		for (int row = 0; row < size; ++row) {
+			QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(row));
+			const float* values = grid.constData() + (row + 1)*stride + 1;
+			for (int col = 0; col < size; ++col) {
+				const float value = values[col];
+				if (value != value) {
+					line[col] = qRgba(0, 0, 0, 0);
+					continue;
+				}
+				const int code = std::max(0, std::min(0xFFFFFF, int(lround((value + 10000.0f)*10.0f))));
+				line[col] = qRgba(code >> 16, (code >> 8) & 0xFF, code & 0xFF, 255);
+			}
+		}
+		return;
+	}
+
+	const double sunAzimuth = qDegreesToRadians(m_sunAzimuth);
+	const double sunAltitude = qDegreesToRadians(m_sunAltitude);
+	const float sunEast = sin(sunAzimuth)*cos(sunAltitude);
+	const float sunNorth = cos(sunAzimuth)*cos(sunAltitude);
+	const float sunUp = sin(sunAltitude);
+	//pixel size on the ground at the equator, the mercator scale is 1/cos(lat)
+	const double equatorPixel = 2.0*M_PI*Geo::Constants::EARTH_A_RADIUS/(size*double(1 << zoom));
+
+	for (int row = 0; row < size; ++row) {
+		QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(row));
+		const float* top = grid.constData() + row*stride;
+		const float* middle = top + stride;
+		const float* bottom = middle + stride;
+		const float scale = 1.0/(8.0*equatorPixel*cos(qDegreesToRadians(lats.at(row + 1))));
+		for (int col = 0; col < size; ++col) {
+			const float* t = top + col;
+			const float* m = middle + col;
+			const float* b = bottom + col;
+			//Horn's gradients, as in TerrainDerivatives
+			const float p = ((t[2] + 2.0f*m[2] + b[2]) - (t[0] + 2.0f*m[0] + b[0]))*scale;
+			const float q = ((t[0] + 2.0f*t[1] + t[2]) - (b[0] + 2.0f*b[1] + b[2]))*scale;
+			if (p != p || q != q) {
+				line[col] = qRgba(0, 0, 0, 0);
+				continue;
+			}
+			const float light = (-p*sunEast - q*sunNorth + sunUp)/sqrt(p*p + q*q + 1.0f);
+			const int grey = qRound(std::max(0.0f, light)*255.0f);
+			line[col] = qRgba(grey, grey, grey, 255);
+		}
+	}
+}
+
+bool XyzTileGenerator::generate(const QString& outputDir, const double minLon, const double maxLon, const double minLat, const double maxLat,
+								const int minZoom, const int maxZoom, XyzTileCounters* counters)
+{
+	if (minZoom < Geo::Constants::MIN_ZOOM_LEVEL || maxZoom > Geo::Constants::MAX_ZOOM_LEVEL || minZoom > maxZoom) {
+		qDebug() << "XyzTileGenerator.generate. Zoom range incorrect.";
+		return false;
+	}
+	if (!Geo::Constants::isCorrectGeoCoord(minLon, minLat) || !Geo::Constants::isCorrectGeoCoord(maxLon, maxLat)) {
+		qDebug() << "XyzTileGenerator.generate. Lon,lat incorrect.";
+		return false;
+	}
+
+	QDir dir(outputDir);
+	if (!dir.exists() && !dir.mkpath(".")) {
+		qDebug() << "XyzTileGenerator.generate. Can't create" << outputDir;
+		return false;
+	}
+
+	//z/x/y -> key of the last rendered output
+	QHash<QString, QByteArray> manifest;
+	QFile manifestFile(dir.filePath(MANIFEST_FILE_XYZ));
+	if (manifestFile.open(QIODevice::ReadOnly)) {
+		while (!manifestFile.atEnd()) {
+			const QList<QByteArray> fields = manifestFile.readLine().trimmed().split(' ');
+			if (fields.size() == 2) {
+				manifest.insert(QString::fromUtf8(fields.at(0)), fields.at(1));
+			}
+		}
+		manifestFile.close();
+	}
+
+	{
+		QMutexLocker locker(&m_digestLock);
+		m_digests.clear();
+	}
+
+	//source tiles of the requested area, map tiles on its border do not probe the tiles around it
+	const QRect area(QPoint(floor(std::min(minLon, maxLon)), floor(std::min(minLat, maxLat))),
+					 QPoint(floor(std::max(minLon, maxLon)), floor(std::max(minLat, maxLat))));
+
+	//contiguous runs of map tiles per worker, row by row within a zoom level
+	const int workerCount = std::max(1, m_threadPool->maxThreadCount());
+	QVector<XyzJob> jobs;
+	for (int zoom = minZoom; zoom <= maxZoom; ++zoom) {
+		const int x0 = lonToTileX(std::min(minLon, maxLon), zoom);
+		const int x1 = lonToTileX(std::max(minLon, maxLon), zoom);
+		const int y0 = latToTileY(std::max(minLat, maxLat), zoom);
+		const int y1 = latToTileY(std::min(minLat, maxLat), zoom);
+		for (int y = y0; y <= y1; ++y) {
+			for (int x = x0; x <= x1; ++x) {
+				XyzJob job;
+				job.zoom = zoom;
+				job.x = x;
+				job.y = y;
+				jobs.append(job);
+			}
+		}
+	}
+
+	std::vector<XyzWorkQueue> queues(workerCount);
+	for (int i = 0; i < jobs.size(); ++i) {
+		queues[qint64(i)*workerCount/jobs.size()].append(jobs.at(i));
+	}
+
+	QVector<XyzTileCounters> workerCounters(workerCount);
+	//empty key: the tile was not written and is dropped from the manifest
+	QVector<QHash<QString, QByteArray>> workerKeys(workerCount);
+	{
+		QFutureSynchronizer<void> synchronizer;
+		for (int worker = 0; worker < workerCount; ++worker) {
+			synchronizer.addFuture(QtConcurrent::run(m_threadPool, [&, worker]() {
+				XyzTileCounters& done = workerCounters[worker];
+				QHash<QString, QByteArray>& keys = workerKeys[worker];
+				QImage image;
+				XyzJob job;
+				while (true) {
+					bool found = queues[worker].takeFirst(job);
+					for (int i = 1; !found && i < workerCount; ++i) {
+						found = queues[(worker + i) % workerCount].steal(job);
+					}
+					if (!found) {
+						break;
+					}
+
+					const QString name = QString("%1/%2/%3").arg(job.zoom).arg(job.x).arg(job.y);
+					const QString path = dir.filePath(name + ".png");
+					XyzSources sources;
+					if (!collectSources(sources, job.zoom, job.x, job.y, area)) {
+						done.empty++;
+						keys.insert(name, QByteArray());
+						continue;
+					}
+
+					const QByteArray key = tileKey(sources, job.zoom, job.x, job.y);
+					if (manifest.value(name) == key && QFile::exists(path)) {
+						done.skipped++;
+						keys.insert(name, key);
+						continue;
+					}
+
+					render(image, sources, job.zoom, job.x, job.y);
+					dir.mkpath(QString("%1/%2").arg(job.zoom).arg(job.x));
+					QSaveFile file(path);
+					if (!file.open(QIODevice::WriteOnly) || !image.save(&file, "PNG") || !file.commit()) {
+						qDebug() << "XyzTileGenerator.generate. Can't write" << path;
+						done.failed++;
+						keys.insert(name, QByteArray());
+						continue;
+					}
+					done.rendered++;
+					keys.insert(name, key);
+				}
+			}));
+		}
+	}
+
+	XyzTileCounters total;
+	for (int worker = 0; worker < workerCount; ++worker) {
+		total.rendered += workerCounters.at(worker).rendered;
+		total.skipped += workerCounters.at(worker).skipped;
+		total.empty += workerCounters.at(worker).empty;
+		total.failed += workerCounters.at(worker).failed;
+		for (auto it = workerKeys.at(worker).constBegin(); it != workerKeys.at(worker).constEnd(); ++it) {
+			if (it.value().isEmpty()) {
+				manifest.remove(it.key());
+			} else {
+				manifest.insert(it.key(), it.value());
+			}
+		}
+	}
+	if (counters) {
+		*counters = total;
+	}
+
+	QSaveFile saveManifest(dir.filePath(MANIFEST_FILE_XYZ));
+	if (!saveManifest.open(QIODevice::WriteOnly)) {
+		qDebug() << "XyzTileGenerator.generate. Can't write" << MANIFEST_FILE_XYZ;
+		return false;
+	}
+	QTextStream stream(&saveManifest);
+	for (auto it = manifest.constBegin(); it != manifest.constEnd(); ++it) {
+		stream << it.key() << ' ' << QString::fromLatin1(it.value()) << '\n';
+	}
+	stream.flush();
+	if (!saveManifest.commit()) {
+		qDebug() << "XyzTileGenerator.generate. Can't write" << MANIFEST_FILE_XYZ;
+		return false;
+	}
+
+	return total.failed == 0;
+}
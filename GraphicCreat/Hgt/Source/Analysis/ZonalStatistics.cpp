@@ -0,0 +1,162 @@
+#include <QThreadPool>
+#include <QtMath>
+#include <algorithm>
+#include "ZonalStatistics.h"
+#include "PolygonTileWalk.h"
+
+struct ZonalAccumulator {
+	qint64 count = 0;
+	qint64 voidCount = 0;
+	qint64 sum = 0;
+	qint64 sumSq = 0;
+	qint16 min = std::numeric_limits<qint16>::max();
+	qint16 max = std::numeric_limits<qint16>::min();
+	int missingTiles = 0;
+	QVector<qint64> histogram;
+
+	void merge(const ZonalAccumulator& other) {
+		count += other.count;
+		voidCount += other.voidCount;
+		sum += other.sum;
+		sumSq += other.sumSq;
+		missingTiles += other.missingTiles;
+		if (other.count > 0) {
+			min = std::min(min, other.min);
+			max = std::max(max, other.max);
+		}
+		if (histogram.size() < other.histogram.size()) {
+			histogram.resize(other.histogram.size());
+		}
+		for (int i = 0; i < other.histogram.size(); ++i) {
+			histogram[i] += other.histogram.at(i);
+		}
+	}
+};
+
+struct ZonalHistogram {
+	int binCount = 0;
+	double minElevation = 0.0;
+	double binWidth = 0.0;
+};
+
+//branch free, so the compiler turns it into packed compares, min/max and adds
+static void accumulateSpan(ZonalAccumulator& acc, const qint16* values, const int count)
+{
+	qint64 sum = 0;
+	qint64 sumSq = 0;
+	int valid = 0;
+	qint16 spanMin = std::numeric_limits<qint16>::max();
+	qint16 spanMax = std::numeric_limits<qint16>::min();
+
+	for (int i = 0; i < count; ++i) {
+		const qint16 value = values[i];
+		const bool isValid = value != ERROR_ELEVATION_SRTM_HGT;
+		const qint32 masked = isValid ? value : 0;
+		valid += isValid;
+		sum += masked;
+		sumSq += qint64(masked*masked);
+		spanMin = std::min(spanMin, isValid ? value : std::numeric_limits<qint16>::max());
+		//void is the smallest qint16, it never wins
+		spanMax = std::max(spanMax, value);
+	}
+
+	acc.count += valid;
+	acc.voidCount += count - valid;
+	acc.sum += sum;
+	acc.sumSq += sumSq;
+	if (valid > 0) {
+		acc.min = std::min(acc.min, spanMin);
+		acc.max = std::max(acc.max, spanMax);
+	}
+}
+
+static void accumulateHistogram(ZonalAccumulator& acc, const ZonalHistogram& settings, const qint16* values, const int count)
+{
+	for (int i = 0; i < count; ++i) {
+		if (values[i] == ERROR_ELEVATION_SRTM_HGT) continue;
+		int bin = floor((values[i] - settings.minElevation)/settings.binWidth);
+		bin = std::max(0, std::min(settings.binCount - 1, bin));
+		acc.histogram[bin]++;
+	}
+}
+
+ZonalStatistics::ZonalStatistics(HgtLoader* loader) :
+	m_loader(loader),
+	m_threadPool(QThreadPool::globalInstance())
+{
+}
+
+void ZonalStatistics::setHistogram(const int binCount, const double minElevation, const double maxElevation)
+{
+	m_binCount = maxElevation > minElevation ? std::max(0, binCount) : 0;
+	m_histogramMin = minElevation;
+	m_histogramMax = maxElevation;
+}
+
+void ZonalStatistics::setThreadPool(QThreadPool* threadPool)
+{
+	m_threadPool = threadPool ? threadPool : QThreadPool::globalInstance();
+}
+
+ZonalStats ZonalStatistics::compute(const QList<QPointF>& polygon)
+{
+	QList<QList<QPointF>> polygons;
+	polygons.append(polygon);
+	return compute(polygons).first();
+}
+
+QVector<ZonalStats> ZonalStatistics::compute(const QList<QList<QPointF>>& polygons)
+{
+	QVector<ZonalStats> retVal(polygons.size());
+
+	ZonalHistogram histogram;
+	histogram.binCount = m_binCount;
+	histogram.minElevation = m_histogramMin;
+	histogram.binWidth = m_binCount > 0 ? (m_histogramMax - m_histogramMin)/m_binCount : 0.0;
+
+	QVector<PolygonTile> tiles = PolygonTileWalk::coveredTiles(polygons);
+	ZonalAccumulator empty;
+	if (histogram.binCount > 0) {
+		empty.histogram.fill(0, histogram.binCount);
+	}
+	QVector<ZonalAccumulator> results(tiles.size(), empty);
+
+	PolygonTileWalk::walk(tiles, m_loader, m_threadPool, polygons, [&results, &histogram](const int tileIndex, const PolygonSpanRow& row) {
+		ZonalAccumulator& acc = results[tileIndex];
+		accumulateSpan(acc, row.values, row.count);
+		if (histogram.binCount > 0) {
+			accumulateHistogram(acc, histogram, row.values, row.count);
+		}
+	});
+
+	QVector<ZonalAccumulator> merged(polygons.size());
+	for (int i = 0; i < tiles.size(); ++i) {
+		ZonalAccumulator& result = results[i];
+		result.missingTiles = tiles.at(i).missing ? 1 : 0;
+		merged[tiles.at(i).polygonIndex].merge(result);
+	}
+
+	for (int i = 0; i < polygons.size(); ++i) {
+		const ZonalAccumulator& acc = merged.at(i);
+		ZonalStats& stats = retVal[i];
+		stats.count = acc.count;
+		stats.voidCount = acc.voidCount;
+		stats.missingTiles = acc.missingTiles;
+		stats.histogramMin = histogram.minElevation;
+		stats.binWidth = histogram.binWidth;
+		stats.histogram = acc.histogram;
+		if (histogram.binCount > 0 && stats.histogram.isEmpty()) {
+			stats.histogram.fill(0, histogram.binCount);
+		}
+		if (acc.count == 0) {
+			continue;
+		}
+		stats.min = acc.min;
+		stats.max = acc.max;
+		stats.mean = double(acc.sum)/acc.count;
+		double variance = double(acc.sumSq)/acc.count - stats.mean*stats.mean;
+		stats.stddev = sqrt(std::max(0.0, variance));
+	}
+
+	return retVal;
+}
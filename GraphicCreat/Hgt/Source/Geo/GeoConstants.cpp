@@ -22,6 +22,31 @@ bool Constants::isCorrectGeoCoord(const QPointF &pos)
 	return isCorrectGeoCoord(pos.x(), pos.y());
 }
 
+double Constants::metersPerDegreeLat(const double lat)
+{
+	const double e2 = EARTH_FLATTENING_FACTOR*(2.0 - EARTH_FLATTENING_FACTOR);
+	const double sinLat = sin(lat*DEG2RAD1);
+	const double w = 1.0 - e2*sinLat*sinLat;
+	//meridian radius of curvature
+	return DEG2RAD1*EARTH_A_RADIUS*(1.0 - e2)/(w*sqrt(w));
+}
+
+double Constants::metersPerDegreeLon(const double lat)
+{
+	const double e2 = EARTH_FLATTENING_FACTOR*(2.0 - EARTH_FLATTENING_FACTOR);
+	const double sinLat = sin(lat*DEG2RAD1);
+	//prime vertical radius of curvature times cos(lat)
+	return DEG2RAD1*EARTH_A_RADIUS*cos(lat*DEG2RAD1)/sqrt(1.0 - e2*sinLat*sinLat);
+}
+
+double Constants::distance(const double lon1, const double lat1, const double lon2, const double lat2)
+{
+	const double sinHalfLat = sin((lat2 - lat1)*DEG2RAD1/2.0);
+	const double sinHalfLon = sin((lon2 - lon1)*DEG2RAD1/2.0);
+	const double a = sinHalfLat*sinHalfLat + cos(lat1*DEG2RAD1)*cos(lat2*DEG2RAD1)*sinHalfLon*sinHalfLon;
+	return 2.0*EARTH_MEAN_RADIUS*atan2(sqrt(a), sqrt(1.0 - a));
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 } ///namespace Geo
 ///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,309 @@
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QSaveFile>
+#include <QSysInfo>
+#include <QDebug>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include "GeoidGrid.h"
+
+const char GEOID_GRID_MAGIC[4] = {'G', 'E', 'O', 'N'};
+const quint32 GEOID_GRID_VERSION = 1;
+//written in native order, reads back differently on a host with other byte order
+const quint32 GEOID_GRID_BYTE_ORDER_MARK = 0x01020304;
+//centimetres, EGM96 undulations are within +-110 m
+const float SCALE_GEOID_GRID = 0.01f;
+//points per block of the batch kernel, indices and weights of a block stay in L1
+const int BLOCK_GEOID_GRID = 256;
+
+struct GeoidGridHeader {
+	char magic[4];
+	quint32 version;
+	quint32 byteOrderMark;
+	quint32 rows;
+	quint32 cols;
+	float scale;
+	double north;
+	double west;
+	double latStep;
+	double lonStep;
+	qint64 sourceModified;
+	qint64 sourceSize;
+	char reserved[24];
+};
+static_assert(sizeof(GeoidGridHeader) == 96, "samples have to start at 96 byte offset");
+
+///////////////////////////////////////////////////////////////////////////////
+namespace Geo {
+///////////////////////////////////////////////////////////////////////////////
+
+QString GeoidGrid::cacheFileName(const QString& sourceFileName, const QString& cacheDir)
+{
+	QString byteOrder = QSysInfo::ByteOrder == QSysInfo::LittleEndian ? ".le" : ".be";
+	QString name = QFileInfo(sourceFileName).completeBaseName() + byteOrder + ".geoid";
+	QString dir = cacheDir.isEmpty() ? QFileInfo(sourceFileName).absolutePath() : cacheDir;
+	return QDir::toNativeSeparators(QDir(dir).absolutePath() + QDir::separator() + name);
+}
+
+bool GeoidGrid::load(const QString& fileName, const QString& cacheDir)
+{
+	m_samples.clear();
+
+	//the cache file itself, e.g. shipped without the text grid
+	QFile file(fileName);
+	if (!file.open(QIODevice::ReadOnly)) {
+		qDebug() << QString("GeoidGrid.load. Can't open file %1.").arg(fileName);
+		return false;
+	}
+	char magic[4] = {};
+	const bool isCacheFile = file.read(magic, sizeof(magic)) == sizeof(magic) && memcmp(magic, GEOID_GRID_MAGIC, sizeof(magic)) == 0;
+	file.close();
+	if (isCacheFile) {
+		return readCacheFile(fileName, QString());
+	}
+
+	const QString gridCacheFileName = cacheFileName(fileName, cacheDir);
+	if (readCacheFile(gridCacheFileName, fileName)) {
+		return true;
+	}
+	if (!parseTextGrid(fileName)) {
+		return false;
+	}
+	//the grid is usable without the cache, e.g. in a read-only directory
+	writeCacheFile(gridCacheFileName, fileName);
+	return true;
+}
+
+bool GeoidGrid::parseTextGrid(const QString& fileName)
+{
+	QFile file(fileName);
+	if (!file.open(QIODevice::ReadOnly)) {
+		qDebug() << QString("GeoidGrid.parseTextGrid. Can't open file %1.").arg(fileName);
+		return false;
+	}
+	QByteArray text = file.readAll();
+	file.close();
+
+	//strtod stops at the terminating zero
+	const char* it = text.constData();
+	char* end = nullptr;
+	double header[6];
+	for (double& value : header) {
+		value = strtod(it, &end);
+		if (end == it) {
+			qDebug() << QString("GeoidGrid.parseTextGrid. No grid header in %1.").arg(fileName);
+			return false;
+		}
+		it = end;
+	}
+
+	const double south = header[0];
+	const double north = header[1];
+	const double west = header[2];
+	const double east = header[3];
+	const double latStep = header[4];
+	const double lonStep = header[5];
+	if (!(latStep > 0.0) || !(lonStep > 0.0) || !(north > south) || !(east > west)) {
+		qDebug() << QString("GeoidGrid.parseTextGrid. Unexpected grid header in %1.").arg(fileName);
+		return false;
+	}
+	const int rows = qRound((north - south)/latStep) + 1;
+	const int cols = qRound((east - west)/lonStep) + 1;
+	if (rows < 2 || cols < 2 || qint64(rows)*cols > std::numeric_limits<int>::max()) {
+		qDebug() << QString("GeoidGrid.parseTextGrid. Unexpected grid size %1x%2 in %3.").arg(rows).arg(cols).arg(fileName);
+		return false;
+	}
+
+	QVector<qint16> samples(rows*cols);
+	for (qint16& sample : samples) {
+		const double value = strtod(it, &end);
+		if (end == it) {
+			qDebug() << QString("GeoidGrid.parseTextGrid. Expected %1 values in %2.").arg(samples.size()).arg(fileName);
+			return false;
+		}
+		it = end;
+		sample = qint16(qBound(-32768L, lround(value/SCALE_GEOID_GRID), 32767L));
+	}
+
+	m_samples.swap(samples);
+	m_rows = rows;
+	m_cols = cols;
+	m_north = north;
+	m_west = west;
+	m_latStep = latStep;
+	m_lonStep = lonStep;
+	m_scale = SCALE_GEOID_GRID;
+	updateSteps();
+	return true;
+}
+
+bool GeoidGrid::readCacheFile(const QString& cacheFileName, const QString& sourceFileName)
+{
+	QFile file(cacheFileName);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return false;
+	}
+
+	GeoidGridHeader header;
+	if (file.read(reinterpret_cast<char*>(&header), sizeof(header)) != sizeof(header)
+			|| memcmp(header.magic, GEOID_GRID_MAGIC, sizeof(header.magic)) != 0
+			|| header.version != GEOID_GRID_VERSION
+			|| header.byteOrderMark != GEOID_GRID_BYTE_ORDER_MARK
+			|| header.rows < 2 || header.cols < 2 || quint64(header.rows)*header.cols > quint64(std::numeric_limits<int>::max())) {
+		return false;
+	}
+	const qint64 dataSize = qint64(header.rows)*header.cols*qint64(sizeof(qint16));
+	if (file.size() != qint64(sizeof(header)) + dataSize) {
+		return false;
+	}
+	//a damaged header would turn into infinite or NaN cell indices in the lookups
+	if (!(header.latStep > 0.0) || !(header.lonStep > 0.0) || !qIsFinite(header.latStep) || !qIsFinite(header.lonStep)
+			|| !qIsFinite(header.north) || !qIsFinite(header.west) || !(header.scale > 0.0f) || !qIsFinite(header.scale)
+			|| (header.rows - 1)*header.latStep > 180.0 + 1e-6 || (header.cols - 1)*header.lonStep > 360.0 + 1e-6) {
+		qDebug() << QString("GeoidGrid.readCacheFile. Unexpected grid header in %1.").arg(cacheFileName);
+		return false;
+	}
+
+	//the cache is still valid without the source, like the native tiles
+	QFileInfo source(sourceFileName);
+	if (!sourceFileName.isEmpty() && source.exists()
+			&& (header.sourceSize != source.size() || header.sourceModified != source.lastModified().toMSecsSinceEpoch())) {
+		return false;
+	}
+
+	QVector<qint16> samples(int(header.rows*header.cols));
+	if (file.read(reinterpret_cast<char*>(samples.data()), dataSize) != dataSize) {
+		qDebug() << QString("GeoidGrid.readCacheFile. Can't read file %1.").arg(cacheFileName);
+		return false;
+	}
+
+	m_samples.swap(samples);
+	m_rows = int(header.rows);
+	m_cols = int(header.cols);
+	m_north = header.north;
+	m_west = header.west;
+	m_latStep = header.latStep;
+	m_lonStep = header.lonStep;
+	m_scale = header.scale;
+	updateSteps();
+	return true;
+}
+
+bool GeoidGrid::writeCacheFile(const QString& cacheFileName, const QString& sourceFileName) const
+{
+	GeoidGridHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, GEOID_GRID_MAGIC, sizeof(header.magic));
+	header.version = GEOID_GRID_VERSION;
+	header.byteOrderMark = GEOID_GRID_BYTE_ORDER_MARK;
+	header.rows = quint32(m_rows);
+	header.cols = quint32(m_cols);
+	header.scale = m_scale;
+	header.north = m_north;
+	header.west = m_west;
+	header.latStep = m_latStep;
+	header.lonStep = m_lonStep;
+	QFileInfo source(sourceFileName);
+	header.sourceModified = source.lastModified().toMSecsSinceEpoch();
+	header.sourceSize = source.size();
+
+	QDir().mkpath(QFileInfo(cacheFileName).absolutePath());
+
+	//write-then-rename, another process never reads a half written grid
+	QSaveFile cacheFile(cacheFileName);
+	if (!cacheFile.open(QIODevice::WriteOnly)) {
+		qDebug() << QString("GeoidGrid.writeCacheFile. Can't create file %1.").arg(cacheFileName);
+		return false;
+	}
+	cacheFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	cacheFile.write(reinterpret_cast<const char*>(m_samples.constData()), qint64(m_samples.size())*qint64(sizeof(qint16)));
+
+	return cacheFile.commit();
+}
+
+void GeoidGrid::updateSteps()
+{
+	m_invLatStep = 1.0/m_latStep;
+	m_invLonStep = 1.0/m_lonStep;
+	//a global grid repeats its first column at west + 360
+	const double cellsAround = 360.0/m_lonStep;
+	const bool global = std::abs((m_cols - 1) - cellsAround) < 1e-6;
+	m_period = global ? cellsAround : 0.0;
+	m_invPeriod = global ? 1.0/cellsAround : 0.0;
+}
+
+void GeoidGrid::undulations(float* out, const double* lon, const double* lat, const int count) const
+{
+	if (m_samples.isEmpty()) {
+		std::fill(out, out + std::max(count, 0), 0.0f);
+		return;
+	}
+
+	//index math of a block first, it has no dependencies between the points and is vectorized,
+	//then the gathers, which are served from the ~2 MB grid in L2/L3
+	int offsets[BLOCK_GEOID_GRID];
+	float fxs[BLOCK_GEOID_GRID];
+	float fys[BLOCK_GEOID_GRID];
+	const double maxX = m_cols - 1;
+	const double maxY = m_rows - 1;
+	const qint16* samples = m_samples.constData();
+
+	for (int first = 0; first < count; first += BLOCK_GEOID_GRID) {
+		const int size = std::min(BLOCK_GEOID_GRID, count - first);
+		const double* blockLon = lon + first;
+		const double* blockLat = lat + first;
+
+		for (int i = 0; i < size; ++i) {
+			double x = (blockLon[i] - m_west)*m_invLonStep;
+			x -= std::floor(x*m_invPeriod)*m_period;
+			double y = (m_north - blockLat[i])*m_invLatStep;
+			x = std::min(x > 0.0 ? x : 0.0, maxX);
+			y = std::min(y > 0.0 ? y : 0.0, maxY);
+			const int col = std::min(int(x), m_cols - 2);
+			const int row = std::min(int(y), m_rows - 2);
+			fxs[i] = float(x - col);
+			fys[i] = float(y - row);
+			offsets[i] = row*m_cols + col;
+		}
+
+		float* blockOut = out + first;
+		for (int i = 0; i < size; ++i) {
+			const qint16* top = samples + offsets[i];
+			const qint16* bottom = top + m_cols;
+			const float upper = top[0] + fxs[i]*(top[1] - top[0]);
+			const float lower = bottom[0] + fxs[i]*(bottom[1] - bottom[0]);
+			blockOut[i] = (upper + fys[i]*(lower - upper))*m_scale;
+		}
+	}
+}
+
+void GeoidGrid::toEllipsoidal(float* heights, const double* lon, const double* lat, const int count) const
+{
+	float undulation[BLOCK_GEOID_GRID];
+	for (int first = 0; first < count; first += BLOCK_GEOID_GRID) {
+		const int size = std::min(BLOCK_GEOID_GRID, count - first);
+		undulations(undulation, lon + first, lat + first, size);
+		for (int i = 0; i < size; ++i) {
+			heights[first + i] += undulation[i];
+		}
+	}
+}
+
+void GeoidGrid::toOrthometric(float* heights, const double* lon, const double* lat, const int count) const
+{
+	float undulation[BLOCK_GEOID_GRID];
+	for (int first = 0; first < count; first += BLOCK_GEOID_GRID) {
+		const int size = std::min(BLOCK_GEOID_GRID, count - first);
+		undulations(undulation, lon + first, lat + first, size);
+		for (int i = 0; i < size; ++i) {
+			heights[first + i] -= undulation[i];
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+} ///namespace Geo
+///////////////////////////////////////////////////////////////////////////////
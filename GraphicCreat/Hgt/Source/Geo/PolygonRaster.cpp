@@ -0,0 +1,195 @@
+#include <cmath>
+#include <algorithm>
+
+#include "PolygonRaster.h"
+
+//samples closer than this to the polygon boundary (in samples) count as covered
+const double BOUNDARY_EPS_POLYGON_RASTER = 1e-9;
+
+///////////////////////////////////////////////////////////////////////////////
+namespace Geo {
+///////////////////////////////////////////////////////////////////////////////
+
+struct ScanEdge {
+	double x0, y0, x1, y1;
+	int rowEnd;
+};
+
+static void appendTile(QVector<QPoint>& tiles, const int lon, const int lat)
+{
+	tiles.append(QPoint(lon, lat));
+}
+
+//tiles crossed by the segment, walked column by column
+static void appendSegmentTiles(QVector<QPoint>& tiles, QPointF p0, QPointF p1)
+{
+	if (p0.x() > p1.x()) {
+		std::swap(p0, p1);
+	}
+
+	int col0 = floor(p0.x());
+	int col1 = floor(p1.x());
+	double dx = p1.x() - p0.x();
+
+	for (int col = col0; col <= col1; ++col) {
+		double xa = std::max(p0.x(), double(col));
+		double xb = std::min(p1.x(), double(col + 1));
+		double ya = p0.y();
+		double yb = p1.y();
+		if (dx > 0.0) {
+			ya = p0.y() + (xa - p0.x())*(p1.y() - p0.y())/dx;
+			yb = p0.y() + (xb - p0.x())*(p1.y() - p0.y())/dx;
+		}
+		int row0 = floor(std::min(ya, yb));
+		int row1 = floor(std::max(ya, yb));
+		for (int row = row0; row <= row1; ++row) {
+			appendTile(tiles, col, row);
+		}
+	}
+}
+
+//x of the crossings of the closed polygon with the horizontal line y, half-open in y so vertices count once
+static void scanlineCrossings(QVector<double>& xs, const QList<QPointF>& nodes, const double y)
+{
+	xs.clear();
+	const int count = nodes.count();
+	for (int i = 0; i < count; ++i) {
+		const QPointF& a = nodes.at(i);
+		const QPointF& b = nodes.at((i + 1) % count);
+		if ((a.y() <= y && y < b.y()) || (b.y() <= y && y < a.y())) {
+			xs.append(a.x() + (y - a.y())*(b.x() - a.x())/(b.y() - a.y()));
+		}
+	}
+	std::sort(xs.begin(), xs.end());
+}
+
+QVector<QPoint> PolygonRaster::coveredTiles(const QList<QPointF>& nodes)
+{
+	QVector<QPoint> tiles;
+	const int count = nodes.count();
+	if (count == 0) {
+		return tiles;
+	}
+
+	if (count == 1) {
+		appendTile(tiles, floor(nodes.first().x()), floor(nodes.first().y()));
+		return tiles;
+	}
+
+	//boundary
+	const int edgeCount = count == 2 ? 1 : count;
+	double minLat = nodes.first().y();
+	double maxLat = nodes.first().y();
+	for (int i = 0; i < edgeCount; ++i) {
+		appendSegmentTiles(tiles, nodes.at(i), nodes.at((i + 1) % count));
+		minLat = std::min(minLat, nodes.at(i).y());
+		maxLat = std::max(maxLat, nodes.at(i).y());
+	}
+
+	//interior: a tile not crossed by the boundary is either fully inside or fully outside,
+	//so the scanline through the middle of each tile row finds all inside tiles
+	if (count >= 3) {
+		QVector<double> xs;
+		for (int row = floor(minLat); row <= floor(maxLat); ++row) {
+			scanlineCrossings(xs, nodes, row + 0.5);
+			for (int i = 0; i + 1 < xs.size(); i += 2) {
+				for (int col = floor(xs.at(i)); col <= floor(xs.at(i + 1)); ++col) {
+					appendTile(tiles, col, row);
+				}
+			}
+		}
+	}
+
+	std::sort(tiles.begin(), tiles.end(), [](const QPoint& a, const QPoint& b) {
+		return a.x() < b.x() || (a.x() == b.x() && a.y() < b.y());
+	});
+	tiles.erase(std::unique(tiles.begin(), tiles.end()), tiles.end());
+
+	return tiles;
+}
+
+QVector<SampleSpan> PolygonRaster::sampleMask(const QList<QPointF>& nodes, const QPoint& leftBottomCorner, const int sideSize)
+{
+	QVector<SampleSpan> spans;
+	const int count = nodes.count();
+	if (count < 3 || sideSize < 2) {
+		return spans;
+	}
+
+	const double pixPerDeg = sideSize - 1;
+	const double lon0 = leftBottomCorner.x();
+	const double latTop = leftBottomCorner.y() + 1;
+	auto rowLat = [&](const int row) {return latTop - row/pixPerDeg;};
+
+	//edge table bucketed by the first row the edge crosses
+	QVector<QVector<ScanEdge>> startingEdges(sideSize);
+	for (int i = 0; i < count; ++i) {
+		const QPointF& a = nodes.at(i);
+		const QPointF& b = nodes.at((i + 1) % count);
+		if (a.y() == b.y()) {
+			continue;
+		}
+		double yLow = std::min(a.y(), b.y());
+		double yHigh = std::max(a.y(), b.y());
+		int rowStart = std::max(0, int(floor((latTop - yHigh)*pixPerDeg)));
+		int rowEnd = std::min(sideSize - 1, int(floor((latTop - yLow)*pixPerDeg)) + 1);
+		if (rowStart > rowEnd) {
+			continue;
+		}
+		startingEdges[rowStart].append(ScanEdge{a.x(), a.y(), b.x(), b.y(), rowEnd});
+	}
+
+	QVector<ScanEdge> active;
+	QVector<double> xs;
+	for (int row = 0; row < sideSize; ++row) {
+		active.erase(std::remove_if(active.begin(), active.end(), [row](const ScanEdge& edge) {
+			return edge.rowEnd < row;
+		}), active.end());
+		active += startingEdges.at(row);
+		if (active.isEmpty()) {
+			continue;
+		}
+
+		const double lat = rowLat(row);
+		xs.clear();
+		for (const ScanEdge& edge : active) {
+			if ((edge.y0 <= lat && lat < edge.y1) || (edge.y1 <= lat && lat < edge.y0)) {
+				xs.append(edge.x0 + (lat - edge.y0)*(edge.x1 - edge.x0)/(edge.y1 - edge.y0));
+			}
+		}
+		std::sort(xs.begin(), xs.end());
+
+		for (int i = 0; i + 1 < xs.size(); i += 2) {
+			int colBegin = std::max(0, int(ceil((xs.at(i) - lon0)*pixPerDeg - BOUNDARY_EPS_POLYGON_RASTER)));
+			int colEnd = std::min(sideSize, int(floor((xs.at(i + 1) - lon0)*pixPerDeg + BOUNDARY_EPS_POLYGON_RASTER)) + 1);
+			if (colBegin >= colEnd) {
+				continue;
+			}
+			//pairs that touch in one sample are merged
+			if (!spans.isEmpty() && spans.last().row == row && spans.last().colEnd >= colBegin) {
+				spans.last().colEnd = std::max(spans.last().colEnd, colEnd);
+				continue;
+			}
+			SampleSpan span;
+			span.row = row;
+			span.colBegin = colBegin;
+			span.colEnd = colEnd;
+			spans.append(span);
+		}
+	}
+
+	return spans;
+}
+
+qint64 PolygonRaster::sampleCount(const QVector<SampleSpan>& spans)
+{
+	qint64 retVal = 0;
+	for (const SampleSpan& span : spans) {
+		retVal += span.colEnd - span.colBegin;
+	}
+	return retVal;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+} ///namespace Geo
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,109 @@
+#include <cmath>
+#include <algorithm>
+
+#include "UtmProjection.h"
+#include "GeoConstants.h"
+
+const double SCALE_FACTOR_UTM = 0.9996;
+const double FALSE_EASTING_UTM = 500000.0;
+const double FALSE_NORTHING_SOUTH_UTM = 10000000.0;
+
+//third flattening and the Krüger coefficients
+const double N_UTM = Geo::Constants::EARTH_FLATTENING_FACTOR/(2.0 - Geo::Constants::EARTH_FLATTENING_FACTOR);
+const double N2_UTM = N_UTM*N_UTM;
+const double N3_UTM = N2_UTM*N_UTM;
+//rectifying radius times the scale factor
+const double K0A_UTM = SCALE_FACTOR_UTM*Geo::Constants::EARTH_A_RADIUS/(1.0 + N_UTM)*(1.0 + N2_UTM/4.0 + N2_UTM*N2_UTM/64.0);
+
+const double ALPHA_UTM[3] = {N_UTM/2.0 - 2.0/3.0*N2_UTM + 5.0/16.0*N3_UTM, 13.0/48.0*N2_UTM - 3.0/5.0*N3_UTM, 61.0/240.0*N3_UTM};
+const double BETA_UTM[3] = {N_UTM/2.0 - 2.0/3.0*N2_UTM + 37.0/96.0*N3_UTM, 1.0/48.0*N2_UTM + 1.0/15.0*N3_UTM, 17.0/480.0*N3_UTM};
+const double DELTA_UTM[3] = {2.0*N_UTM - 2.0/3.0*N2_UTM - 2.0*N3_UTM, 7.0/3.0*N2_UTM - 8.0/5.0*N3_UTM, 56.0/15.0*N3_UTM};
+
+///////////////////////////////////////////////////////////////////////////////
+namespace Geo {
+///////////////////////////////////////////////////////////////////////////////
+
+UtmProjection::UtmProjection(const int zone, const bool north) :
+	m_zone(zone),
+	m_north(north),
+	m_lon0(zone*Constants::UTM_ZONE_SIZE_DEGREE - 183.0),
+	m_falseNorthing(north ? 0.0 : FALSE_NORTHING_SOUTH_UTM)
+{
+}
+
+int UtmProjection::zoneOf(const double lon)
+{
+	return std::max(1, std::min(60, int(floor((lon + 180.0)/Constants::UTM_ZONE_SIZE_DEGREE)) + 1));
+}
+
+QPointF UtmProjection::forward(const double lon, const double lat) const
+{
+	const double phi = lat*Constants::DEG2RAD1;
+	const double lambda = (lon - m_lon0)*Constants::DEG2RAD1;
+	const double c = 2.0*sqrt(N_UTM)/(1.0 + N_UTM);
+	const double sinPhi = sin(phi);
+	//conformal latitude
+	const double t = sinh(atanh(sinPhi) - c*atanh(c*sinPhi));
+	const double xi = atan2(t, cos(lambda));
+	const double eta = atanh(sin(lambda)/sqrt(1.0 + t*t));
+
+	double easting = eta;
+	double northing = xi;
+	for (int j = 1; j <= 3; ++j) {
+		easting += ALPHA_UTM[j - 1]*cos(2*j*xi)*sinh(2*j*eta);
+		northing += ALPHA_UTM[j - 1]*sin(2*j*xi)*cosh(2*j*eta);
+	}
+	return QPointF(FALSE_EASTING_UTM + K0A_UTM*easting, m_falseNorthing + K0A_UTM*northing);
+}
+
+QPointF UtmProjection::inverse(const double easting, const double northing) const
+{
+	double lon = 0.0;
+	double lat = 0.0;
+	inverse(&easting, &northing, &lon, &lat, 1);
+	return QPointF(lon, lat);
+}
+
+void UtmProjection::inverse(const double* easting, const double* northing, double* lon, double* lat, const int count) const
+{
+	const double rad2deg = 1.0/Constants::DEG2RAD1;
+	for (int i = 0; i < count; ++i) {
+		const double xi = (northing[i] - m_falseNorthing)/K0A_UTM;
+		const double eta = (easting[i] - FALSE_EASTING_UTM)/K0A_UTM;
+
+		//sin/cos of 2xi, 4xi, 6xi and sinh/cosh of 2eta, 4eta, 6eta by the multiple angle formulas
+		const double s1 = sin(2.0*xi);
+		const double c1 = cos(2.0*xi);
+		const double s2 = 2.0*s1*c1;
+		const double c2 = 2.0*c1*c1 - 1.0;
+		const double s3 = s1*c2 + c1*s2;
+		const double c3 = c1*c2 - s1*s2;
+		const double e = exp(2.0*eta);
+		const double sh1 = 0.5*(e - 1.0/e);
+		const double ch1 = 0.5*(e + 1.0/e);
+		const double sh2 = 2.0*sh1*ch1;
+		const double ch2 = 2.0*ch1*ch1 - 1.0;
+		const double sh3 = sh1*ch2 + ch1*sh2;
+		const double ch3 = ch1*ch2 + sh1*sh2;
+
+		const double xiP = xi - BETA_UTM[0]*s1*ch1 - BETA_UTM[1]*s2*ch2 - BETA_UTM[2]*s3*ch3;
+		const double etaP = eta - BETA_UTM[0]*c1*sh1 - BETA_UTM[1]*c2*sh2 - BETA_UTM[2]*c3*sh3;
+		const double ep = exp(etaP);
+		const double shP = 0.5*(ep - 1.0/ep);
+		const double chP = 0.5*(ep + 1.0/ep);
+		const double cosXiP = cos(xiP);
+
+		//conformal latitude
+		const double chi = asin(sin(xiP)/chP);
+		const double t1 = sin(2.0*chi);
+		const double u1 = cos(2.0*chi);
+		const double t2 = 2.0*t1*u1;
+		const double t3 = t1*(2.0*u1*u1 - 1.0) + u1*t2;
+		lat[i] = (chi + DELTA_UTM[0]*t1 + DELTA_UTM[1]*t2 + DELTA_UTM[2]*t3)*rad2deg;
+		lon[i] = m_lon0 + atan2(shP, cosXiP)*rad2deg;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+} ///namespace Geo
+///////////////////////////////////////////////////////////////////////////////
@@ -1,14 +1,95 @@
 #include <QCoreApplication>
 #include <QDebug>
+#include <QMutexLocker>
+#include <QTimer>
+#include <QHash>
+#include <QtEndian>
+#include <cstring>
+#include <type_traits>
 #include "HgtLoader.h"
-#ifdef GDAL_AVAILABLE
-	#include "Loaders/HgtLoaderGdem.h"
-#endif
+#include "CpuFeatures.h"
+#include "Loaders/HgtLoaderGdem.h"
 #include "Loaders/HgtLoaderSrtm.h"
 #include "Geo/GeoConstants.h"
 
 HgtLoader* HgtLoader::m_instance;
 
+//sample positions closer than this (in samples) to the tile grid are on the grid
+const double GRID_EPS_RASTER = 1e-6;
+
+#if defined(HGT_X86_DISPATCH)
+//byte swap of 16 samples per step, returns the samples done
+HGT_TARGET("avx2") static int swapSamplesAvx2(qint16* data, const int count)
+{
+	const __m256i mask = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+										  1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+	int i = 0;
+	for (; i + 16 <= count; i += 16) {
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i), _mm256_shuffle_epi8(v, mask));
+	}
+	return i;
+}
+
+//byte swap of 8 samples per step, returns the samples done
+HGT_TARGET("ssse3") static int swapSamplesSsse3(qint16* data, const int count)
+{
+	const __m128i mask = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+	int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), _mm_shuffle_epi8(v, mask));
+	}
+	return i;
+}
+#endif
+
+//reverses the bytes of count 16 bit samples in place
+static void swapSamples(qint16* data, const int count)
+{
+	int i = 0;
+#if defined(HGT_X86_DISPATCH)
+	if (CpuFeatures::hasAvx2()) {
+		i = swapSamplesAvx2(data, count);
+	} else if (CpuFeatures::hasSsse3()) {
+		i = swapSamplesSsse3(data, count);
+	}
+#endif
+	for (; i < count; ++i) {
+		data[i] = qbswap(data[i]);
+	}
+}
+
+//count samples of the row starting at col
+template<typename View, typename OutT>
+static void copySamples(const View& view, OutT* out, const int row, const int col, const int count)
+{
+	if constexpr (std::is_same<typename View::Sample, OutT>::value) {
+		memcpy(out, view.sampleData(col, row), count*sizeof(OutT));
+		if (View::SAMPLE_BYTE_ORDER != QSysInfo::ByteOrder) {
+			swapSamples(out, count);
+		}
+	} else {
+		for (int i = 0; i < count; ++i) {
+			const qint16 value = view.elevation(col + i, row);
+			out[i] = value == ERROR_ELEVATION_SRTM_HGT ? std::numeric_limits<OutT>::quiet_NaN() : OutT(value);
+		}
+	}
+}
+
+static inline void storeSample(qint16& out, const float value)
+{
+	out = value != value ? ERROR_ELEVATION_SRTM_HGT : qint16(qRound(value));
+}
+
+static inline void storeSample(float& out, const float value)
+{
+	out = value;
+}
+
+static inline qint16 voidSample(const qint16*) {return ERROR_ELEVATION_SRTM_HGT;}
+static inline float voidSample(const float*) {return std::numeric_limits<float>::quiet_NaN();}
+
 HgtLoader* HgtLoader::instance() {
     return m_instance;
 }
@@ -21,12 +102,12 @@ HgtLoader::HgtLoader(QString hgtArchiveDir, HgtType hgtType)
     : QObject(nullptr)
 {
 	qRegisterMetaType<TileOwn>("TileOwn");
+	qRegisterMetaType<HgtStatsSnapshot>("HgtStatsSnapshot");
 
-    m_settings.hgtArchiveDir = hgtArchiveDir;
+	m_stats.reset(new HgtStats);
 
-#ifdef GDAL_AVAILABLE
+    m_settings.hgtArchiveDir = hgtArchiveDir;
     m_hgtType = hgtType;
-#endif
 
 	initHgtType(m_hgtType);
 }
@@ -67,29 +148,138 @@ void HgtLoader::initHgtType(HgtType type)
 		m_hgtType = HgtType::SRTM;
 	}
 	else if(m_hgtType == HgtType::GDEM) {
-#ifdef GDAL_AVAILABLE
         m_hgtLoaderCore = new HgtLoaderGdem(&m_settings, this);
 		m_hgtType = HgtType::GDEM;
-#else
-		initHgtType(HgtType::SRTM);
+	}
+	m_hgtLoaderCore->setStats(m_stats);
+	updateDownloader();
+}
+
+HgtStatsSnapshot HgtLoader::stats() const
+{
+	return m_stats->snapshot();
+}
+
+void HgtLoader::setStatsInterval(const int msec)
+{
+	if (msec <= 0) {
+		if (m_statsTimer) {
+			m_statsTimer->stop();
+		}
 		return;
-#endif
+	}
+	if (!m_statsTimer) {
+		m_statsTimer = new QTimer(this);
+		connect(m_statsTimer, &QTimer::timeout, this, [this]() {
+			emit statsUpdated(stats());
+		});
+	}
+	m_statsTimer->start(msec);
+}
+
+void HgtLoader::reloadHgtLoaderCore()
+{
+	if (m_hgtLoaderCore) {
+		m_hgtLoaderCore->deleteLater();
+		m_hgtLoaderCore = nullptr;
+	}
+	//initHgtType() recreates the core because it is empty now, but also resets the cache directory
+	QString hgtCachePath = m_settings.hgtCachePath;
+	initHgtType(m_hgtType);
+	m_settings.hgtCachePath = hgtCachePath;
+	updateDownloader();
+}
+
+void HgtLoader::updateDownloader()
+{
+	const bool enabled = !m_settings.onlyFromCache && !m_settings.serverAddress.isEmpty();
+	if (enabled && !m_downloader) {
+		m_downloader.reset(new HgtDownloader);
+		m_downloader->setMaxConcurrent(m_maxConcurrentDownloads);
+		//queued to the loader's thread, the tile is dropped from the RAM cache before tileDownloaded() is emitted
+		connect(m_downloader.data(), &HgtDownloader::tileDownloaded, this, [this](const QPoint& leftBottomCorner, const bool ok) {
+			if (ok && m_hgtLoaderCore) {
+				m_hgtLoaderCore->forgetTile(leftBottomCorner);
+			}
+		});
+		connect(m_downloader.data(), &HgtDownloader::tileDownloaded, this, &HgtLoader::tileDownloaded);
+	}
+	if (m_downloader) {
+		m_downloader->setServerAddress(enabled ? m_settings.serverAddress : QString());
+		m_downloader->setCacheDirectory(m_settings.hgtCachePath);
+	}
+	if (m_hgtLoaderCore) {
+		m_hgtLoaderCore->setDownloader(enabled ? m_downloader : QSharedPointer<HgtDownloader>());
 	}
 }
 
 void HgtLoader::setCacheDirectory(const QString& hgtCachePath)
 {
     m_settings.hgtCachePath = QDir(hgtCachePath).absolutePath();
+	updateDownloader();
 }
 
 void HgtLoader::setServerAddress(const QString& serverAddress)
 {
     m_settings.serverAddress = serverAddress;
+	updateDownloader();
 }
 
 void HgtLoader::setOnlyFromCache(const bool onlyFromCache)
 {
 	m_settings.onlyFromCache = onlyFromCache;
+	updateDownloader();
+}
+
+void HgtLoader::setMaxConcurrentDownloads(const int requests)
+{
+	m_maxConcurrentDownloads = std::max(1, requests);
+	if (m_downloader) {
+		m_downloader->setMaxConcurrent(m_maxConcurrentDownloads);
+	}
+}
+
+int HgtLoader::downloadHgtByRect(const double minLon, const double maxLon, const double minLat, const double maxLat)
+{
+	int retVal = 0;
+	if (m_settings.onlyFromCache || !m_downloader || !isCorrectPoint(minLon, minLat) || !isCorrectPoint(maxLon, maxLat)) {
+		return retVal;
+	}
+
+	const int lonMin = floor(std::min(minLon, maxLon));
+	const int lonMax = floor(std::max(minLon, maxLon));
+	const int latMin = floor(std::min(minLat, maxLat));
+	const int latMax = floor(std::max(minLat, maxLat));
+	for (int lon = lonMin; lon <= lonMax; ++lon) {
+		for (int lat = latMin; lat <= latMax; ++lat) {
+			const QString fileName = m_hgtLoaderCore->getHgtName(lon, lat);
+			if (QFile::exists(QDir(m_settings.hgtCachePath).filePath(fileName))) {
+				continue;
+			}
+			retVal += m_downloader->fetch(QPoint(lon, lat), fileName);
+		}
+	}
+	return retVal;
+}
+
+void HgtLoader::setMaxTilesInRam(const int maxTiles)
+{
+	m_settings.maxNumOfTilesInRAM = std::max(1, maxTiles);
+}
+
+int HgtLoader::maxTilesInRam() const
+{
+	return m_settings.maxNumOfTilesInRAM;
+}
+
+void HgtLoader::setMaxIntegralMemory(const qint64 bytes)
+{
+	m_settings.maxIntegralBytes = std::max<qint64>(0, bytes);
+}
+
+qint64 HgtLoader::maxIntegralMemory() const
+{
+	return m_settings.maxIntegralBytes;
 }
 
 bool HgtLoader::isOnlyFromCache() const
@@ -97,9 +287,100 @@ bool HgtLoader::isOnlyFromCache() const
     return m_settings.onlyFromCache;
 }
 
-bool HgtLoader::getElevationFromTile(qint16& elevation, const double lon, const double lat, const QByteArray data) const
+void HgtLoader::setNativeCacheDirectory(const QString& nativeCachePath, const bool fillVoids)
+{
+	m_settings.nativeCachePath = nativeCachePath.isEmpty() ? QString() : QDir(nativeCachePath).absolutePath();
+	m_settings.fillVoids = fillVoids;
+	//tiles cached in RAM were loaded in the previous format
+	reloadHgtLoaderCore();
+}
+
+void HgtLoader::setSharedMemoryCache(const bool enabled, const bool fillVoids)
+{
+	m_settings.sharedMemoryCache = enabled;
+	m_settings.fillVoids = fillVoids;
+	//tiles cached in RAM were loaded in the previous format
+	reloadHgtLoaderCore();
+}
+
+bool HgtLoader::isSharedMemoryCache() const
+{
+	return m_settings.sharedMemoryCache;
+}
+
+QVector<Geo::SampleSpan> HgtLoader::getPolygonMask(const QList<QPointF>& nodes, const TileOwn& tile) const
+{
+	int sideSize = qRound(sqrt(double(tile.data.size()/sizeof(qint16))));
+	return Geo::PolygonRaster::sampleMask(nodes, tile.leftBottomCorner, sideSize);
+}
+
+QVector<Geo::SampleSpan> HgtLoader::getPolygonMask(const QList<QPointF>& nodes, const TileHandle& tile) const
+{
+	int sideSize = qRound(sqrt(double(tile.size()/sizeof(qint16))));
+	return Geo::PolygonRaster::sampleMask(nodes, tile.leftBottomCorner(), sideSize);
+}
+
+QString HgtLoader::nativeCacheDirectory() const
+{
+	return m_settings.nativeCachePath;
+}
+
+bool HgtLoader::getElevationFromTile(qint16& elevation, const double lon, const double lat, const QByteArray& data,
+									 const QSysInfo::Endian byteOrder) const
+{
+	return m_hgtLoaderCore->getElevationFromTile(elevation, lon, lat, data, byteOrder);
+}
+
+bool HgtLoader::getElevationFromTile(qint16& elevation, const double lon, const double lat, const TileOwn& tile) const
+{
+	return m_hgtLoaderCore->getElevationFromTile(elevation, lon, lat, tile.data, tile.byteOrder);
+}
+
+bool HgtLoader::getElevationFromTile(qint16& elevation, const double lon, const double lat, const TileHandle& tile) const
+{
+	bool found = false;
+	bool known = visitTileView(tile, [&](const auto& view) {
+		found = view.getElevation(elevation, lon, lat);
+	});
+	if (!known) {
+		//formats without a specialized view, the loader knows their layout
+		return tile.isValid() && m_hgtLoaderCore->getElevationFromTile(elevation, lon, lat, tile.rawData(), tile.byteOrder());
+	}
+	return found;
+}
+
+bool HgtLoader::getTileHandle(TileHandle& handle, const double lon, const double lat)
+{
+	if (!isCorrectPoint(lon, lat)) {
+		return false;
+	}
+	return m_hgtLoaderCore->getTileHandle(handle, lon, lat);
+}
+
+QList<TileHandle> HgtLoader::getTileHandlesByRect(const double minLon, const double maxLon, const double minLat, const double maxLat)
 {
-	return m_hgtLoaderCore->getElevationFromTile(elevation, lon, lat, data);
+	QList<TileHandle> handles;
+	if (!isCorrectPoint(minLon, minLat) || !isCorrectPoint(maxLon, maxLat)) {
+        qDebug() << "HgtLoader.getTileHandlesByRect. Lon,lat incorrect.";
+		return handles;
+	}
+
+	int lonmin = floor(std::min(minLon, maxLon));
+	int lonmax = floor(std::max(minLon, maxLon));
+	int latmin = floor(std::min(minLat, maxLat));
+	int latmax = floor(std::max(minLat, maxLat));
+
+	for(int lon=lonmin; lon<=lonmax; ++lon) {
+		for(int lat=latmin; lat<=latmax; ++lat) {
+			TileHandle handle;
+			if (!m_hgtLoaderCore->getTileHandle(handle, lon, lat)) {
+				continue;
+			}
+			handles.append(handle);
+		}
+	}
+
+	return handles;
 }
 
 bool HgtLoader::getHgtFileOffset(qint64& offset, const double lon, const double lat) const
@@ -140,13 +421,249 @@ QList<TileOwn> HgtLoader::getHgtTilesByPolygon(const QList<QPointF> &nodes, cons
 	return m_hgtLoaderCore->getHgtTilesByPolygon(nodes, saveTilesInsideModule);
 }
 
-bool HgtLoader::doesExistHgtByRect(const double minLon, const double maxLon, const double minLat, const double maxLat, QList<QString>& requiredFiles, const bool exitOnFirstFail)
+QSharedPointer<const TileIntegral> HgtLoader::getTileIntegral(const TileHandle& tile) const
 {
-	if (m_settings.hgtCachePath.isEmpty()) {
-        qDebug() <<"HgtLoader.isExistsHgt. Cache hgt directory is not exists.";
+	if (!tile.isValid()) {
+		return QSharedPointer<const TileIntegral>();
+	}
+
+	QSharedPointer<TileStorage> storage = tile.storage();
+	QSharedPointer<const TileIntegral> retVal;
+	qint64 builtBytes = 0;
+	{
+		QMutexLocker locker(&storage->integralLock);
+		if (!storage->integral) {
+			TileStorage* target = storage.data();
+			visitTileView(tile, [target](const auto& view) {
+				target->integral = TileIntegral::build(view);
+			});
+			builtBytes = storage->integral ? storage->integral->memory() : 0;
+		}
+		retVal = storage->integral;
+	}
+
+	if (retVal) {
+		touchIntegral(storage, builtBytes);
+	}
+	return retVal;
+}
+
+void HgtLoader::touchIntegral(const QSharedPointer<TileStorage>& storage, const qint64 builtBytes) const
+{
+	QMutexLocker locker(&m_integralLock);
+	IntegralEntry entry;
+	entry.storage = storage;
+	entry.bytes = builtBytes;
+	for (int i = 0; i < m_integrals.size(); ++i) {
+		if (m_integrals.at(i).storage == storage) {
+			entry.bytes += m_integrals.takeAt(i).bytes;
+			break;
+		}
+	}
+	m_integrals.append(entry);
+	m_integralBytes += builtBytes;
+
+	//tables of destroyed tiles were freed with them
+	for (int i = m_integrals.size() - 2; i >= 0; --i) {
+		if (m_integrals.at(i).storage.isNull()) {
+			m_integralBytes -= m_integrals.takeAt(i).bytes;
+		}
+	}
+
+	//holders of a dropped table keep it until they release it
+	while (m_integralBytes > m_settings.maxIntegralBytes && m_integrals.size() > 1) {
+		IntegralEntry oldest = m_integrals.takeFirst();
+		m_integralBytes -= oldest.bytes;
+		QSharedPointer<TileStorage> oldStorage = oldest.storage.toStrongRef();
+		if (oldStorage) {
+			QMutexLocker storageLocker(&oldStorage->integralLock);
+			oldStorage->integral.reset();
+		}
+	}
+}
+
+QSharedPointer<const TileMaxPyramid> HgtLoader::getTileMaxPyramid(const TileHandle& tile) const
+{
+	if (!tile.isValid()) {
+		return QSharedPointer<const TileMaxPyramid>();
+	}
+
+	TileStorage* storage = tile.storage().data();
+	QMutexLocker locker(&storage->maxPyramidLock);
+	if (!storage->maxPyramid) {
+		visitTileView(tile, [storage](const auto& view) {
+			storage->maxPyramid = TileMaxPyramid::build(view);
+		});
+	}
+	return storage->maxPyramid;
+}
+
+bool HgtLoader::getRectStatistics(RectStatistics& stats, const double minLon, const double maxLon, const double minLat, const double maxLat)
+{
+	stats = RectStatistics();
+	if (!isCorrectPoint(minLon, minLat) || !isCorrectPoint(maxLon, maxLat)) {
+        qDebug() << "HgtLoader.getRectStatistics. Lon,lat incorrect.";
 		return false;
 	}
 
+	const double west = std::min(minLon, maxLon);
+	const double east = std::max(minLon, maxLon);
+	const double south = std::min(minLat, maxLat);
+	const double north = std::max(minLat, maxLat);
+
+	qint64 sum = 0;
+	qint64 sumSq = 0;
+
+	for(int lon=floor(west); lon<=floor(east); ++lon) {
+		for(int lat=floor(south); lat<=floor(north); ++lat) {
+			TileHandle tile;
+			QSharedPointer<const TileIntegral> integral;
+			if (getTileHandle(tile, lon + 0.5, lat + 0.5)) {
+				integral = getTileIntegral(tile);
+			}
+			if (!integral) {
+				stats.missingTiles++;
+				continue;
+			}
+
+			//the tile owns rows 1..side-1 and columns 0..side-2, the shared edges are counted by the neighbours
+			const int sideSize = integral->sideSize();
+			const double pixPerDeg = sideSize - 1;
+			int col0 = std::max(0, int(ceil((west - lon)*pixPerDeg)));
+			int col1 = std::min(sideSize - 2, int(floor((east - lon)*pixPerDeg)));
+			int row0 = std::max(1, int(ceil((lat + 1 - north)*pixPerDeg)));
+			int row1 = std::min(sideSize - 1, int(floor((lat + 1 - south)*pixPerDeg)));
+			if (col0 > col1 || row0 > row1) {
+				continue;
+			}
+
+			qint64 tileSum = 0;
+			qint64 tileSumSq = 0;
+			qint64 tileVoids = 0;
+			integral->query(tileSum, tileSumSq, tileVoids, col0, row0, col1, row1);
+			sum += tileSum;
+			sumSq += tileSumSq;
+			stats.voidCount += tileVoids;
+			stats.count += qint64(col1 - col0 + 1)*(row1 - row0 + 1) - tileVoids;
+		}
+	}
+
+	if (stats.count > 0) {
+		stats.mean = double(sum)/stats.count;
+		stats.variance = std::max(0.0, double(sumSq)/stats.count - stats.mean*stats.mean);
+	}
+
+	return stats.isValid();
+}
+
+bool HgtLoader::rasterSize(int& cols, int& rows, const double minLon, const double maxLon,
+						   const double minLat, const double maxLat, const double stepDeg)
+{
+	cols = 0;
+	rows = 0;
+	if (!(stepDeg > 0.0) || !Geo::Constants::isCorrectGeoCoord(minLon, minLat) || !Geo::Constants::isCorrectGeoCoord(maxLon, maxLat)) {
+		return false;
+	}
+	const double width = fabs(maxLon - minLon)/stepDeg;
+	const double height = fabs(maxLat - minLat)/stepDeg;
+	if (width >= std::numeric_limits<int>::max() || height >= std::numeric_limits<int>::max()) {
+		return false;
+	}
+	cols = int(floor(width + GRID_EPS_RASTER)) + 1;
+	rows = int(floor(height + GRID_EPS_RASTER)) + 1;
+	return true;
+}
+
+bool HgtLoader::extractRaster(qint16* buffer, const qint64 bufferSize, const double minLon, const double maxLon,
+							  const double minLat, const double maxLat, const double stepDeg)
+{
+	return extractRasterSamples(buffer, bufferSize, minLon, maxLon, minLat, maxLat, stepDeg);
+}
+
+bool HgtLoader::extractRaster(float* buffer, const qint64 bufferSize, const double minLon, const double maxLon,
+							  const double minLat, const double maxLat, const double stepDeg)
+{
+	return extractRasterSamples(buffer, bufferSize, minLon, maxLon, minLat, maxLat, stepDeg);
+}
+
+template<typename OutT>
+bool HgtLoader::extractRasterSamples(OutT* buffer, const qint64 bufferSize, const double minLon, const double maxLon,
+									 const double minLat, const double maxLat, const double stepDeg)
+{
+	int cols = 0;
+	int rows = 0;
+	if (!isCorrectPoint(minLon, minLat) || !isCorrectPoint(maxLon, maxLat)
+			|| !rasterSize(cols, rows, minLon, maxLon, minLat, maxLat, stepDeg)) {
+        qDebug() << "HgtLoader.extractRaster. Lon,lat or step incorrect.";
+		return false;
+	}
+	if (!buffer || bufferSize < qint64(cols)*rows) {
+        qDebug() << "HgtLoader.extractRaster. Buffer too small.";
+		return false;
+	}
+
+	const double west = std::min(minLon, maxLon);
+	const double north = std::max(minLat, maxLat);
+	const OutT voidValue = voidSample(buffer);
+
+	//columns in runs of the same tile column, a sample on a seam belongs to the eastern tile
+	QVector<double> lons(cols);
+	QVector<int> runEnds;
+	for (int col = 0; col < cols; ++col) {
+		lons[col] = west + col*stepDeg;
+		if (col > 0 && int(floor(lons.at(col))) != int(floor(lons.at(col - 1)))) {
+			runEnds.append(col);
+		}
+	}
+	runEnds.append(cols);
+
+	//missing tiles are kept as invalid handles, so they are looked up once
+	QHash<quint32, TileHandle> tiles;
+
+	for (int row = 0; row < rows; ++row) {
+		const double lat = north - row*stepDeg;
+		const int tileLat = floor(lat);
+		OutT* out = buffer + qint64(row)*cols;
+
+		int col0 = 0;
+		for (int col1 : runEnds) {
+			const int tileLon = floor(lons.at(col0));
+			const quint32 key = quint32(tileLon + 180) << 16 | quint32(tileLat + 90);
+			auto it = tiles.find(key);
+			if (it == tiles.end()) {
+				TileHandle tile;
+				if (!getTileHandle(tile, tileLon + 0.5, tileLat + 0.5)) {
+					tile.reset();
+				}
+				it = tiles.insert(key, tile);
+			}
+
+			const bool found = it.value().isValid() && visitTileView(it.value(), [&](const auto& view) {
+				const double pixPerDeg = view.PIX_PER_DEG;
+				const double rowF = (tileLat + 1 - lat)*pixPerDeg;
+				const double colF = (lons.at(col0) - tileLon)*pixPerDeg;
+				const bool onGrid = fabs(stepDeg*pixPerDeg - 1.0) < GRID_EPS_RASTER/std::max(1, col1 - col0)
+						&& fabs(rowF - qRound(rowF)) < GRID_EPS_RASTER && fabs(colF - qRound(colF)) < GRID_EPS_RASTER;
+				if (onGrid) {
+					copySamples(view, out + col0, qRound(rowF), qRound(colF), col1 - col0);
+					return;
+				}
+				for (int col = col0; col < col1; ++col) {
+					storeSample(out[col], view.interpolate((lons.at(col) - tileLon)*pixPerDeg, rowF));
+				}
+			});
+			if (!found) {
+				std::fill(out + col0, out + col1, voidValue);
+			}
+			col0 = col1;
+		}
+	}
+
+	return true;
+}
+
+bool HgtLoader::doesExistHgtByRect(const double minLon, const double maxLon, const double minLat, const double maxLat, QList<QString>& requiredFiles, const bool exitOnFirstFail)
+{
 	if (!isCorrectPoint(minLon, minLat)) {
         qDebug() <<"HgtLoader.isExistsHgt. Min lon,lat incorrect.";
 		return false;
@@ -167,30 +684,43 @@ bool HgtLoader::doesExistHgtByRect(const double minLon, const double maxLon, con
 	int latmin = std::min(lat1,lat2);
 	int latmax = std::max(lat1,lat2);
 
+	QVector<QPoint> corners;
+	for(int lon=lonmin; lon<=lonmax; ++lon) {
+		for(int lat=latmin; lat<=latmax; ++lat) {
+			corners.append(QPoint(lon, lat));
+		}
+	}
+
+	return doesExistHgtTiles(corners, requiredFiles, exitOnFirstFail);
+}
+
+bool HgtLoader::doesExistHgtTiles(const QVector<QPoint>& leftBottomCorners, QList<QString>& requiredFiles, const bool exitOnFirstFail)
+{
+	if (m_settings.hgtCachePath.isEmpty()) {
+        qDebug() <<"HgtLoader.isExistsHgt. Cache hgt directory is not exists.";
+		return false;
+	}
+
 	QString hgtFileName;
 	QString srcHgtFileName;
 	bool retVal = true;
-	bool cycle = false;
 
-	for(int lon=lonmin; lon<=lonmax; ++lon) {
-		for(int lat=latmin; lat<=latmax; ++lat) {
-			cycle = true;
-			hgtFileName = m_hgtLoaderCore->getHgtHalfPathFileName((double)lon, (double)lat);
-			if (hgtFileName.isEmpty()) {
-                qDebug() <<QString("HgtDetect.isExistsHgt. hgtFileName.isEmpty lon=%1, lat=%2").arg(lon).arg(lat);
+	for (const QPoint& corner : leftBottomCorners) {
+		hgtFileName = m_hgtLoaderCore->getHgtHalfPathFileName((double)corner.x(), (double)corner.y());
+		if (hgtFileName.isEmpty()) {
+            qDebug() <<QString("HgtDetect.isExistsHgt. hgtFileName.isEmpty lon=%1, lat=%2").arg(corner.x()).arg(corner.y());
+			return false;
+		}
+		srcHgtFileName = QDir::toNativeSeparators(QDir(m_settings.hgtCachePath).absolutePath() + QDir::separator() + hgtFileName);
+		requiredFiles.append(srcHgtFileName);
+		if (!QFile::exists(srcHgtFileName)) {
+			retVal = false;
+			if (exitOnFirstFail) {
 				return false;
 			}
-			srcHgtFileName = QDir::toNativeSeparators(QDir(m_settings.hgtCachePath).absolutePath() + QDir::separator() + hgtFileName);
-			requiredFiles.append(srcHgtFileName);
-			if (!QFile::exists(srcHgtFileName)) {
-				retVal = false;
-				if (exitOnFirstFail) {
-					return false;
-				}
-			}
 		}
 	}
-	if (!cycle) {
+	if (leftBottomCorners.isEmpty()) {
 		retVal = false;
 	}
 	return retVal;
@@ -208,31 +738,27 @@ bool HgtLoader::doesExistHgtByRect(const double minLon, const double maxLon, con
 	return retV;
 }
 
-bool HgtLoader::doesExistHgtByPolygon(const QList<QPointF>& nodes, QList<QString>& requiredFiles)
+bool HgtLoader::doesExistHgtInCache(const double lon, const double lat) const
 {
-	bool retVal = false;
-
-	if (nodes.count() == 0) return retVal;
+	if (m_settings.hgtCachePath.isEmpty() || !isCorrectPoint(lon, lat)) {
+		return false;
+	}
+	return QFile::exists(QDir(m_settings.hgtCachePath).filePath(m_hgtLoaderCore->getHgtName(lon, lat)));
+}
 
-	double minLon = std::numeric_limits<double>::max();
-	double minLat = std::numeric_limits<double>::max();
-	double maxLon = -std::numeric_limits<double>::max();
-	double maxLat = -std::numeric_limits<double>::max();
+bool HgtLoader::doesExistHgtByPolygon(const QList<QPointF>& nodes, QList<QString>& requiredFiles)
+{
+	if (nodes.count() == 0) return false;
 
 	for( int i = 0; i < nodes.count(); i++ ) {
 		auto item = nodes.at(i);
-		if (item.x() < minLon) minLon = item.x();
-		if (item.x() > maxLon) maxLon = item.x();
-		if (item.y() < minLat) minLat = item.y();
-		if (item.y() > maxLat) maxLat = item.y();
+		if (!Geo::Constants::isCorrectGeoCoord(item) || !isCorrectPoint(item.x(), item.y())) {
+            qDebug() <<"HgtLoader.isExistsHgt. Polygon lon,lat incorrect.";
+			return false;
+		}
 	}
 
-	if (!Geo::Constants::isCorrectCoord(minLon)) return retVal;
-	if (!Geo::Constants::isCorrectCoord(minLat)) return retVal;
-
-	retVal = doesExistHgtByRect(minLon, maxLon, minLat, maxLat, requiredFiles);
-
-	return retVal;
+	return doesExistHgtTiles(Geo::PolygonRaster::coveredTiles(nodes), requiredFiles, false);
 }
 
 bool HgtLoader::doesExistHgtByPolygon(const QList<QPointF> &nodes)
@@ -0,0 +1,207 @@
+#include <QHash>
+#include <QMutexLocker>
+#include <QtAlgorithms>
+#include <algorithm>
+#include <cmath>
+#include "HgtStats.h"
+
+//slots probed for a tile before its access is counted as other
+const int MAX_PROBE_STATS = 16;
+
+//the counter's thread is its only writer, a relaxed load and store is enough
+static inline void increment(std::atomic<quint64>& counter, const quint64 value = 1)
+{
+	counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+//0 is the empty slot
+static inline quint32 tileKey(const int lon, const int lat)
+{
+	return (quint32(lat + 90) << 16 | quint32(lon + 180)) + 1;
+}
+
+double HgtLatencyHistogram::percentileNs(const double percentile) const
+{
+	if (count == 0) {
+		return 0.0;
+	}
+	const quint64 rank = std::max<quint64>(1, quint64(std::ceil(count*percentile/100.0)));
+	quint64 sum = 0;
+	for (int i = 0; i < buckets.size(); ++i) {
+		sum += buckets.at(i);
+		if (sum >= rank) {
+			return double(quint64(1) << (i + 1));
+		}
+	}
+	return double(quint64(1) << buckets.size());
+}
+
+HgtStats::LocalCounters::~LocalCounters()
+{
+	stats->retire(&counters);
+}
+
+HgtStats::ThreadCounters* HgtStats::local()
+{
+	if (!m_local.hasLocalData()) {
+		LocalCounters* local = new LocalCounters;
+		local->stats = this;
+		m_local.setLocalData(local);
+		QMutexLocker locker(&m_threadsLock);
+		m_threads.append(&local->counters);
+		return &local->counters;
+	}
+	return &m_local.localData()->counters;
+}
+
+void HgtStats::retire(const ThreadCounters* counters)
+{
+	QMutexLocker locker(&m_threadsLock);
+	add(m_retired, *counters);
+	m_retired.threads++;
+	m_threads.removeOne(const_cast<ThreadCounters*>(counters));
+}
+
+void HgtStats::record(Histogram& histogram, const qint64 ns)
+{
+	const quint64 value = quint64(std::max<qint64>(ns, 0));
+	const int bucket = std::min(HgtLatencyHistogram::BUCKET_COUNT - 1, 63 - int(qCountLeadingZeroBits(value | 1)));
+	increment(histogram.buckets[bucket]);
+	increment(histogram.count);
+	increment(histogram.sumNs, value);
+}
+
+void HgtStats::recordTile(ThreadCounters* counters, const int lon, const int lat)
+{
+	const quint32 key = tileKey(lon, lat);
+	quint32 slot = (key*2654435761u) >> 24;
+	for (int i = 0; i < MAX_PROBE_STATS; ++i, slot = (slot + 1) % TILE_SLOT_COUNT) {
+		TileSlot& tile = counters->tiles[slot];
+		const quint32 slotKey = tile.key.load(std::memory_order_relaxed);
+		if (slotKey == key) {
+			increment(tile.count);
+			return;
+		}
+		if (slotKey == 0) {
+			//count first, snapshot() reads the key with acquire and sees the count of a published slot
+			increment(tile.count);
+			tile.key.store(key, std::memory_order_release);
+			return;
+		}
+	}
+	increment(counters->otherTileAccess);
+}
+
+void HgtStats::recordHit(const int lon, const int lat)
+{
+	ThreadCounters* counters = local();
+	increment(counters->hits);
+	recordTile(counters, lon, lat);
+}
+
+void HgtStats::recordMiss(const int lon, const int lat)
+{
+	ThreadCounters* counters = local();
+	increment(counters->misses);
+	recordTile(counters, lon, lat);
+}
+
+void HgtStats::recordEviction()
+{
+	increment(local()->evictions);
+}
+
+void HgtStats::recordLockWait(const qint64 ns)
+{
+	record(local()->lockWait, ns);
+}
+
+void HgtStats::recordOpen(const qint64 ns)
+{
+	record(local()->openLatency, ns);
+}
+
+void HgtStats::recordMap(const qint64 ns)
+{
+	record(local()->mapLatency, ns);
+}
+
+void HgtStats::fileOpened(const qint64 mappedBytes)
+{
+	m_mappedBytes.fetch_add(mappedBytes, std::memory_order_relaxed);
+	m_openFiles.fetch_add(1, std::memory_order_relaxed);
+}
+
+void HgtStats::fileClosed(const qint64 mappedBytes)
+{
+	m_mappedBytes.fetch_sub(mappedBytes, std::memory_order_relaxed);
+	m_openFiles.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void HgtStats::add(HgtLatencyHistogram& sum, const Histogram& histogram)
+{
+	for (int i = 0; i < HgtLatencyHistogram::BUCKET_COUNT; ++i) {
+		sum.buckets[i] += histogram.buckets[i].load(std::memory_order_relaxed);
+	}
+	sum.count += histogram.count.load(std::memory_order_relaxed);
+	sum.sumNs += histogram.sumNs.load(std::memory_order_relaxed);
+}
+
+void HgtStats::add(Totals& sum, const ThreadCounters& counters)
+{
+	sum.hits += counters.hits.load(std::memory_order_relaxed);
+	sum.misses += counters.misses.load(std::memory_order_relaxed);
+	sum.evictions += counters.evictions.load(std::memory_order_relaxed);
+	sum.otherTileAccess += counters.otherTileAccess.load(std::memory_order_relaxed);
+	add(sum.lockWait, counters.lockWait);
+	add(sum.openLatency, counters.openLatency);
+	add(sum.mapLatency, counters.mapLatency);
+	for (const TileSlot& tile : counters.tiles) {
+		const quint32 key = tile.key.load(std::memory_order_acquire);
+		if (key != 0) {
+			sum.tileAccess[key] += tile.count.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+HgtStatsSnapshot HgtStats::snapshot() const
+{
+	HgtStatsSnapshot retVal;
+	retVal.mappedBytes = m_mappedBytes.load(std::memory_order_relaxed);
+	retVal.openFiles = m_openFiles.load(std::memory_order_relaxed);
+
+	Totals sum;
+	{
+		QMutexLocker locker(&m_threadsLock);
+		sum = m_retired;
+		for (const ThreadCounters* counters : m_threads) {
+			add(sum, *counters);
+		}
+		sum.threads += m_threads.size();
+	}
+	retVal.hits = sum.hits;
+	retVal.misses = sum.misses;
+	retVal.evictions = sum.evictions;
+	retVal.otherTileAccess = sum.otherTileAccess;
+	retVal.lockWait = sum.lockWait;
+	retVal.openLatency = sum.openLatency;
+	retVal.mapLatency = sum.mapLatency;
+	retVal.threads = sum.threads;
+	const QHash<quint32, quint64>& tileAccess = sum.tileAccess;
+
+	retVal.lockWaitMeanNs = retVal.lockWait.meanNs();
+	retVal.lockWaitP99Ns = retVal.lockWait.percentileNs(99.0);
+
+	retVal.tileAccess.reserve(tileAccess.size());
+	for (auto it = tileAccess.constBegin(); it != tileAccess.constEnd(); ++it) {
+		const quint32 key = it.key() - 1;
+		HgtTileAccess access;
+		access.leftBottomCorner = QPoint(int(key & 0xffff) - 180, int(key >> 16) - 90);
+		access.count = it.value();
+		retVal.tileAccess.append(access);
+	}
+	std::sort(retVal.tileAccess.begin(), retVal.tileAccess.end(), [](const HgtTileAccess& a, const HgtTileAccess& b) {
+		return a.count > b.count;
+	});
+	return retVal;
+}
@@ -0,0 +1,116 @@
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QSaveFile>
+#include <QThread>
+#include <atomic>
+#include "HgtTrace.h"
+
+//slot index mask of the ring
+const quint64 TRACE_MASK = HgtTrace::TRACE_CAPACITY - 1;
+
+/**
+ * @brief one span. seq is the span's 1-based sequence number, 0 while it is written, readers copy a slot
+ * and keep it only if seq did not change meanwhile (seqlock)
+ */
+struct TraceSlot {
+	std::atomic<quint64> seq;
+	std::atomic<const char*> name;
+	std::atomic<quint64> threadId;
+	std::atomic<qint64> begin;
+	std::atomic<qint64> end;
+};
+
+//zero initialized static storage, pages are touched only when spans are recorded
+static TraceSlot s_slots[HgtTrace::TRACE_CAPACITY];
+static std::atomic<quint64> s_next(0);
+
+qint64 HgtTrace::now()
+{
+	static const QElapsedTimer timer = []() {
+		QElapsedTimer retVal;
+		retVal.start();
+		return retVal;
+	}();
+	return timer.nsecsElapsed();
+}
+
+void HgtTrace::record(const char* name, const qint64 beginNs, const qint64 endNs)
+{
+	const quint64 index = s_next.fetch_add(1, std::memory_order_relaxed);
+	TraceSlot& slot = s_slots[index & TRACE_MASK];
+	slot.seq.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.name.store(name, std::memory_order_relaxed);
+	slot.threadId.store(quint64(quintptr(QThread::currentThreadId())), std::memory_order_relaxed);
+	slot.begin.store(beginNs, std::memory_order_relaxed);
+	slot.end.store(endNs, std::memory_order_relaxed);
+	slot.seq.store(index + 1, std::memory_order_release);
+}
+
+QByteArray HgtTrace::toChromeJson()
+{
+	const QByteArray pid = QByteArray::number(QCoreApplication::applicationPid());
+
+	QByteArray retVal;
+	retVal.reserve(TRACE_CAPACITY*96);
+	retVal += "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+	bool first = true;
+	for (const TraceSlot& slot : s_slots) {
+		const quint64 seq = slot.seq.load(std::memory_order_acquire);
+		if (seq == 0) {
+			continue;
+		}
+		const char* name = slot.name.load(std::memory_order_relaxed);
+		const quint64 threadId = slot.threadId.load(std::memory_order_relaxed);
+		const qint64 begin = slot.begin.load(std::memory_order_relaxed);
+		const qint64 end = slot.end.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot.seq.load(std::memory_order_relaxed) != seq || !name) {
+			//overwritten while reading
+			continue;
+		}
+
+		if (!first) {
+			retVal += ',';
+		}
+		first = false;
+		//names are identifiers from the code, they need no escaping
+		retVal += "\n{\"name\":\"";
+		retVal += name;
+		retVal += "\",\"cat\":\"hgt\",\"ph\":\"X\",\"pid\":";
+		retVal += pid;
+		retVal += ",\"tid\":";
+		retVal += QByteArray::number(threadId);
+		//chrome trace times are in microseconds
+		retVal += ",\"ts\":";
+		retVal += QByteArray::number(begin/1000.0, 'f', 3);
+		retVal += ",\"dur\":";
+		retVal += QByteArray::number((end - begin)/1000.0, 'f', 3);
+		retVal += '}';
+	}
+	retVal += "\n]}\n";
+	return retVal;
+}
+
+bool HgtTrace::dump(const QString& filePath)
+{
+	QSaveFile file(filePath);
+	if (!file.open(QIODevice::WriteOnly)) {
+		qDebug() << QString("HgtTrace.dump. Can't open file %1.").arg(filePath);
+		return false;
+	}
+	file.write(toChromeJson());
+	if (!file.commit()) {
+		qDebug() << QString("HgtTrace.dump. Can't write file %1.").arg(filePath);
+		return false;
+	}
+	return true;
+}
+
+void HgtTrace::clear()
+{
+	for (TraceSlot& slot : s_slots) {
+		slot.seq.store(0, std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,536 @@
+#include <QtEndian>
+#include <QtMath>
+#include <QDebug>
+#include <limits>
+#include "GeoTiffReader.h"
+
+//tiff tags
+const quint16 TIFF_TAG_IMAGE_WIDTH = 256;
+const quint16 TIFF_TAG_IMAGE_LENGTH = 257;
+const quint16 TIFF_TAG_BITS_PER_SAMPLE = 258;
+const quint16 TIFF_TAG_COMPRESSION = 259;
+const quint16 TIFF_TAG_STRIP_OFFSETS = 273;
+const quint16 TIFF_TAG_SAMPLES_PER_PIXEL = 277;
+const quint16 TIFF_TAG_ROWS_PER_STRIP = 278;
+const quint16 TIFF_TAG_STRIP_BYTE_COUNTS = 279;
+const quint16 TIFF_TAG_PREDICTOR = 317;
+const quint16 TIFF_TAG_TILE_WIDTH = 322;
+const quint16 TIFF_TAG_TILE_LENGTH = 323;
+const quint16 TIFF_TAG_TILE_OFFSETS = 324;
+const quint16 TIFF_TAG_TILE_BYTE_COUNTS = 325;
+const quint16 TIFF_TAG_SAMPLE_FORMAT = 339;
+const quint16 TIFF_TAG_MODEL_PIXEL_SCALE = 33550;
+const quint16 TIFF_TAG_MODEL_TIEPOINT = 33922;
+const quint16 TIFF_TAG_GEO_KEY_DIRECTORY = 34735;
+const quint16 TIFF_TAG_GDAL_NODATA = 42113;
+
+//tiff field types
+const quint16 TIFF_TYPE_BYTE = 1;
+const quint16 TIFF_TYPE_ASCII = 2;
+const quint16 TIFF_TYPE_SHORT = 3;
+const quint16 TIFF_TYPE_LONG = 4;
+const quint16 TIFF_TYPE_DOUBLE = 12;
+
+const quint16 TIFF_COMPRESSION_NONE = 1;
+const quint16 TIFF_COMPRESSION_ADOBE_DEFLATE = 8;
+const quint16 TIFF_COMPRESSION_DEFLATE = 32946;
+
+const quint16 TIFF_SAMPLE_FORMAT_INT = 2;
+const quint16 TIFF_SAMPLE_FORMAT_FLOAT = 3;
+
+const quint16 TIFF_PREDICTOR_HORIZONTAL = 2;
+
+const quint16 GEO_KEY_RASTER_TYPE = 1025;
+const quint16 GEO_RASTER_PIXEL_IS_POINT = 2;
+
+//12 bytes per ifd entry
+const int TIFF_IFD_ENTRY_SIZE = 12;
+//number of decoded deflate chunks kept per file
+const int MAX_DECODED_CHUNKS_GEOTIFF = 16;
+
+const qint16 VOID_ELEVATION_GEOTIFF = std::numeric_limits<qint16>::min();
+
+quint16 GeoTiffReader::readU16(const qint64 pos) const
+{
+	return m_bigEndian ? qFromBigEndian<quint16>(m_data + pos) : qFromLittleEndian<quint16>(m_data + pos);
+}
+
+quint32 GeoTiffReader::readU32(const qint64 pos) const
+{
+	return m_bigEndian ? qFromBigEndian<quint32>(m_data + pos) : qFromLittleEndian<quint32>(m_data + pos);
+}
+
+double GeoTiffReader::readDouble(const qint64 pos) const
+{
+	quint64 bits = m_bigEndian ? qFromBigEndian<quint64>(m_data + pos) : qFromLittleEndian<quint64>(m_data + pos);
+	double value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+bool GeoTiffReader::readTagValues(QVector<double>& values, const qint64 entryPos) const
+{
+	quint16 type = readU16(entryPos + 2);
+	quint32 count = readU32(entryPos + 4);
+
+	int typeSize = 0;
+	switch (type) {
+	case TIFF_TYPE_BYTE:
+	case TIFF_TYPE_ASCII:
+		typeSize = 1;
+		break;
+	case TIFF_TYPE_SHORT:
+		typeSize = 2;
+		break;
+	case TIFF_TYPE_LONG:
+		typeSize = 4;
+		break;
+	case TIFF_TYPE_DOUBLE:
+		typeSize = 8;
+		break;
+	default:
+		return false;
+	}
+
+	qint64 valuesSize = qint64(typeSize)*count;
+	qint64 valuesPos = entryPos + 8;
+	if (valuesSize > 4) {
+		valuesPos = readU32(entryPos + 8);
+	}
+	if (valuesPos < 0 || valuesPos + valuesSize > m_size) {
+		return false;
+	}
+
+	values.resize(count);
+	for (quint32 i = 0; i < count; ++i) {
+		qint64 pos = valuesPos + qint64(i)*typeSize;
+		switch (type) {
+		case TIFF_TYPE_BYTE:
+		case TIFF_TYPE_ASCII:
+			values[i] = m_data[pos];
+			break;
+		case TIFF_TYPE_SHORT:
+			values[i] = readU16(pos);
+			break;
+		case TIFF_TYPE_LONG:
+			values[i] = readU32(pos);
+			break;
+		case TIFF_TYPE_DOUBLE:
+			values[i] = readDouble(pos);
+			break;
+		}
+	}
+
+	return true;
+}
+
+bool GeoTiffReader::open(const uchar* data, const qint64 size)
+{
+	//tags missing from this file must not keep the values of the previous one
+	*this = GeoTiffReader();
+	m_data = data;
+	m_size = size;
+
+	if (!m_data || m_size < 8) {
+		return false;
+	}
+
+	if (m_data[0] == 'I' && m_data[1] == 'I') {
+		m_bigEndian = false;
+	}
+	else if (m_data[0] == 'M' && m_data[1] == 'M') {
+		m_bigEndian = true;
+	}
+	else {
+		qDebug() << "GeoTiffReader.open. Not a tiff file.";
+		return false;
+	}
+
+	if (readU16(2) != 42) {
+		qDebug() << "GeoTiffReader.open. Unsupported tiff version (BigTIFF?).";
+		return false;
+	}
+
+	if (!readIfd(readU32(4))) {
+		return false;
+	}
+
+	m_valid = true;
+	return true;
+}
+
+bool GeoTiffReader::readIfd(const qint64 ifdOffset)
+{
+	if (ifdOffset + 2 > m_size) {
+		qDebug() << "GeoTiffReader.readIfd. Incorrect ifd offset.";
+		return false;
+	}
+
+	int entries = readU16(ifdOffset);
+	if (ifdOffset + 2 + qint64(entries)*TIFF_IFD_ENTRY_SIZE > m_size) {
+		qDebug() << "GeoTiffReader.readIfd. Truncated ifd.";
+		return false;
+	}
+
+	int bitsPerSample = 0;
+	int sampleFormat = 1;
+	int compression = TIFF_COMPRESSION_NONE;
+	int samplesPerPixel = 1;
+	int rowsPerStrip = 0;
+	int tileWidth = 0;
+	int tileHeight = 0;
+	QVector<double> offsets;
+	QVector<double> byteCounts;
+	QVector<double> pixelScale;
+	QVector<double> tiepoint;
+	QVector<double> geoKeys;
+	QVector<double> noData;
+
+	for (int i = 0; i < entries; ++i) {
+		qint64 entryPos = ifdOffset + 2 + qint64(i)*TIFF_IFD_ENTRY_SIZE;
+		quint16 tag = readU16(entryPos);
+
+		QVector<double> values;
+		if (!readTagValues(values, entryPos) || values.isEmpty()) {
+			continue;
+		}
+
+		switch (tag) {
+		case TIFF_TAG_IMAGE_WIDTH: m_width = int(values.first()); break;
+		case TIFF_TAG_IMAGE_LENGTH: m_height = int(values.first()); break;
+		case TIFF_TAG_BITS_PER_SAMPLE: bitsPerSample = int(values.first()); break;
+		case TIFF_TAG_COMPRESSION: compression = int(values.first()); break;
+		case TIFF_TAG_SAMPLES_PER_PIXEL: samplesPerPixel = int(values.first()); break;
+		case TIFF_TAG_ROWS_PER_STRIP: rowsPerStrip = int(values.first()); break;
+		case TIFF_TAG_PREDICTOR: m_predictor = int(values.first()); break;
+		case TIFF_TAG_TILE_WIDTH: tileWidth = int(values.first()); break;
+		case TIFF_TAG_TILE_LENGTH: tileHeight = int(values.first()); break;
+		case TIFF_TAG_SAMPLE_FORMAT: sampleFormat = int(values.first()); break;
+		case TIFF_TAG_STRIP_OFFSETS:
+		case TIFF_TAG_TILE_OFFSETS: offsets = values; break;
+		case TIFF_TAG_STRIP_BYTE_COUNTS:
+		case TIFF_TAG_TILE_BYTE_COUNTS: byteCounts = values; break;
+		case TIFF_TAG_MODEL_PIXEL_SCALE: pixelScale = values; break;
+		case TIFF_TAG_MODEL_TIEPOINT: tiepoint = values; break;
+		case TIFF_TAG_GEO_KEY_DIRECTORY: geoKeys = values; break;
+		case TIFF_TAG_GDAL_NODATA: noData = values; break;
+		default: break;
+		}
+	}
+
+	if (m_width <= 0 || m_height <= 0 || samplesPerPixel != 1) {
+		qDebug() << "GeoTiffReader.readIfd. Unsupported raster layout.";
+		return false;
+	}
+
+	if (bitsPerSample == 16 && sampleFormat != TIFF_SAMPLE_FORMAT_FLOAT) {
+		m_sampleType = SampleType::Int16;
+	}
+	else if (bitsPerSample == 32 && sampleFormat == TIFF_SAMPLE_FORMAT_FLOAT) {
+		m_sampleType = SampleType::Float32;
+	}
+	else {
+		qDebug() << QString("GeoTiffReader.readIfd. Unsupported sample type bits=%1 format=%2.").arg(bitsPerSample).arg(sampleFormat);
+		return false;
+	}
+	m_bytesPerSample = bitsPerSample/8;
+
+	if (compression == TIFF_COMPRESSION_ADOBE_DEFLATE || compression == TIFF_COMPRESSION_DEFLATE) {
+		m_deflate = true;
+	}
+	else if (compression != TIFF_COMPRESSION_NONE) {
+		qDebug() << QString("GeoTiffReader.readIfd. Unsupported compression %1.").arg(compression);
+		return false;
+	}
+
+	if (m_predictor != 1 && !(m_predictor == TIFF_PREDICTOR_HORIZONTAL && m_sampleType == SampleType::Int16)) {
+		qDebug() << QString("GeoTiffReader.readIfd. Unsupported predictor %1.").arg(m_predictor);
+		return false;
+	}
+
+	m_tiled = tileWidth > 0 && tileHeight > 0;
+	m_chunkWidth = m_tiled ? tileWidth : m_width;
+	m_chunkHeight = m_tiled ? tileHeight : (rowsPerStrip > 0 ? std::min(rowsPerStrip, m_height) : m_height);
+	m_chunksAcross = (m_width + m_chunkWidth - 1)/m_chunkWidth;
+	int chunksDown = (m_height + m_chunkHeight - 1)/m_chunkHeight;
+
+	if (offsets.size() < m_chunksAcross*chunksDown || byteCounts.size() < offsets.size()) {
+		qDebug() << "GeoTiffReader.readIfd. Incorrect strip or tile offsets.";
+		return false;
+	}
+
+	m_chunkOffsets.resize(offsets.size());
+	m_chunkByteCounts.resize(offsets.size());
+	for (int i = 0; i < offsets.size(); ++i) {
+		m_chunkOffsets[i] = qint64(offsets.at(i));
+		m_chunkByteCounts[i] = qint64(byteCounts.at(i));
+		if (m_chunkOffsets[i] + m_chunkByteCounts[i] > m_size) {
+			qDebug() << "GeoTiffReader.readIfd. Strip or tile outside of file.";
+			return false;
+		}
+	}
+
+	m_hasGeoReference = pixelScale.size() >= 2 && tiepoint.size() >= 6 && pixelScale.at(0) > 0.0 && pixelScale.at(1) > 0.0;
+	if (m_hasGeoReference) {
+		m_pixelLon = pixelScale.at(0);
+		m_pixelLat = pixelScale.at(1);
+		m_originLon = tiepoint.at(3) - tiepoint.at(0)*m_pixelLon;
+		m_originLat = tiepoint.at(4) + tiepoint.at(1)*m_pixelLat;
+	}
+
+	//geo key directory: header of 4 shorts, then 4 shorts per key
+	for (int i = 4; i + 3 < geoKeys.size(); i += 4) {
+		if (int(geoKeys.at(i)) == GEO_KEY_RASTER_TYPE && int(geoKeys.at(i + 1)) == 0) {
+			m_pixelIsPoint = int(geoKeys.at(i + 3)) == GEO_RASTER_PIXEL_IS_POINT;
+		}
+	}
+
+	if (!noData.isEmpty()) {
+		QByteArray noDataText;
+		for (double c : noData) {
+			if (c == 0.0) break;
+			noDataText.append(char(c));
+		}
+		m_noData = noDataText.trimmed().toDouble(&m_hasNoData);
+	}
+
+	return true;
+}
+
+bool GeoTiffReader::getPixelIndex(int& col, int& row, const double lon, const double lat) const
+{
+	if (!m_valid) {
+		return false;
+	}
+
+	double colF = 0.0;
+	double rowF = 0.0;
+	if (m_hasGeoReference) {
+		colF = (lon - m_originLon)/m_pixelLon;
+		rowF = (m_originLat - lat)/m_pixelLat;
+		if (m_pixelIsPoint) {
+			colF += 0.5;
+			rowF += 0.5;
+		}
+	}
+	else {
+		//no georeference: 1 degree tile with samples on the edges, like srtm hgt
+		double degPerPixLon = 1.0/(m_width - 1);
+		double degPerPixLat = 1.0/(m_height - 1);
+		colF = (lon - floor(lon) + degPerPixLon/2.0)/degPerPixLon;
+		rowF = (floor(lat) + 1.0 + degPerPixLat/2.0 - lat)/degPerPixLat;
+	}
+
+	col = floor(colF);
+	row = floor(rowF);
+
+	if ((col < 0) || (col >= m_width)) {
+		return false;
+	}
+
+	if ((row < 0) || (row >= m_height)) {
+		return false;
+	}
+
+	return true;
+}
+
+int GeoTiffReader::chunkIndex(const int col, const int row) const
+{
+	return (row/m_chunkHeight)*m_chunksAcross + col/m_chunkWidth;
+}
+
+int GeoTiffReader::chunkRows(const int index) const
+{
+	if (m_tiled) {
+		return m_chunkHeight;
+	}
+	//last strip may be shorter
+	int firstRow = (index/m_chunksAcross)*m_chunkHeight;
+	return std::min(m_chunkHeight, m_height - firstRow);
+}
+
+const uchar* GeoTiffReader::chunk(const int index, bool& native)
+{
+	if (index < 0 || index >= m_chunkOffsets.size()) {
+		return nullptr;
+	}
+
+	qint64 expectedSize = qint64(m_chunkWidth)*chunkRows(index)*m_bytesPerSample;
+
+	if (!m_deflate && m_chunkByteCounts.at(index) < expectedSize) {
+		return nullptr;
+	}
+
+	if (!m_deflate && m_predictor == 1) {
+		native = false;
+		return m_data + m_chunkOffsets.at(index);
+	}
+
+	native = true;
+	auto it = m_decodedChunks.find(index);
+	if (it != m_decodedChunks.end()) {
+		return reinterpret_cast<const uchar*>(it.value().constData());
+	}
+
+	QByteArray decoded;
+	if (m_deflate) {
+		//qUncompress expects the big-endian uncompressed size in front of the zlib stream
+		QByteArray compressed;
+		compressed.resize(4 + int(m_chunkByteCounts.at(index)));
+		qToBigEndian<quint32>(quint32(expectedSize), compressed.data());
+		memcpy(compressed.data() + 4, m_data + m_chunkOffsets.at(index), m_chunkByteCounts.at(index));
+
+		decoded = qUncompress(compressed);
+		if (decoded.size() < expectedSize) {
+			qDebug() << QString("GeoTiffReader.chunk. Can't inflate chunk %1.").arg(index);
+			return nullptr;
+		}
+	}
+	else {
+		//uncompressed strip with a predictor, copied to undo the differences
+		decoded = QByteArray(reinterpret_cast<const char*>(m_data + m_chunkOffsets.at(index)), int(expectedSize));
+	}
+
+	if (m_bigEndian != (Q_BYTE_ORDER == Q_BIG_ENDIAN)) {
+		if (m_bytesPerSample == 2) {
+			qbswap<2>(decoded.constData(), expectedSize/2, decoded.data());
+		}
+		else {
+			qbswap<4>(decoded.constData(), expectedSize/4, decoded.data());
+		}
+	}
+
+	if (m_predictor == TIFF_PREDICTOR_HORIZONTAL) {
+		qint16* samples = reinterpret_cast<qint16*>(decoded.data());
+		int rows = chunkRows(index);
+		for (int r = 0; r < rows; ++r) {
+			qint16* line = samples + qint64(r)*m_chunkWidth;
+			for (int c = 1; c < m_chunkWidth; ++c) {
+				line[c] = qint16(line[c] + line[c - 1]);
+			}
+		}
+	}
+
+	if (m_decodedKeys.size() == MAX_DECODED_CHUNKS_GEOTIFF) {
+		m_decodedChunks.remove(m_decodedKeys.takeFirst());
+	}
+	m_decodedKeys.append(index);
+	it = m_decodedChunks.insert(index, decoded);
+
+	return reinterpret_cast<const uchar*>(it.value().constData());
+}
+
+qint16 GeoTiffReader::toElevation(const uchar* sample, const bool native) const
+{
+	bool swap = !native && (m_bigEndian != (Q_BYTE_ORDER == Q_BIG_ENDIAN));
+
+	if (m_sampleType == SampleType::Int16) {
+		qint16 value;
+		memcpy(&value, sample, sizeof(value));
+		if (swap) {
+			value = qbswap(value);
+		}
+		if (m_hasNoData && double(value) == m_noData) {
+			return VOID_ELEVATION_GEOTIFF;
+		}
+		return value;
+	}
+
+	quint32 bits;
+	memcpy(&bits, sample, sizeof(bits));
+	if (swap) {
+		bits = qbswap(bits);
+	}
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+
+	if (qIsNaN(value) || (m_hasNoData && double(value) == m_noData)) {
+		return VOID_ELEVATION_GEOTIFF;
+	}
+	return qint16(qBound(-32767.0, double(qRound(value)), 32767.0));
+}
+
+bool GeoTiffReader::getSample(qint16& value, const int col, const int row)
+{
+	if (!m_valid || col < 0 || col >= m_width || row < 0 || row >= m_height) {
+		return false;
+	}
+
+	bool native = false;
+	const uchar* data = chunk(chunkIndex(col, row), native);
+	if (!data) {
+		return false;
+	}
+
+	qint64 sampleOffset = qint64(row%m_chunkHeight)*m_chunkWidth + col%m_chunkWidth;
+	value = toElevation(data + sampleOffset*m_bytesPerSample, native);
+
+	return true;
+}
+
+bool GeoTiffReader::isNativeInt16Raster() const
+{
+	if (!m_valid || m_deflate || m_tiled || m_sampleType != SampleType::Int16) {
+		return false;
+	}
+	if (m_bigEndian != (Q_BYTE_ORDER == Q_BIG_ENDIAN)) {
+		return false;
+	}
+	if (m_predictor != 1) {
+		return false;
+	}
+	//other nodata values have to be mapped to the void elevation sample by sample
+	if (m_hasNoData && m_noData != double(VOID_ELEVATION_GEOTIFF)) {
+		return false;
+	}
+
+	//strips must follow each other without gaps
+	qint64 expected = m_chunkOffsets.first();
+	for (int i = 0; i < m_chunkOffsets.size(); ++i) {
+		if (m_chunkOffsets.at(i) != expected) {
+			return false;
+		}
+		expected += qint64(m_chunkWidth)*chunkRows(i)*m_bytesPerSample;
+	}
+
+	return (expected - m_chunkOffsets.first()) == qint64(m_width)*m_height*m_bytesPerSample;
+}
+
+const uchar* GeoTiffReader::rasterData() const
+{
+	return isNativeInt16Raster() ? m_data + m_chunkOffsets.first() : nullptr;
+}
+
+bool GeoTiffReader::decodeRaster(QByteArray& raster)
+{
+	if (!m_valid) {
+		return false;
+	}
+
+	raster.resize(int(qint64(m_width)*m_height*sizeof(qint16)));
+	qint16* out = reinterpret_cast<qint16*>(raster.data());
+
+	for (int chunkRow = 0; chunkRow < m_height; chunkRow += m_chunkHeight) {
+		for (int chunkCol = 0; chunkCol < m_width; chunkCol += m_chunkWidth) {
+			bool native = false;
+			int index = chunkIndex(chunkCol, chunkRow);
+			const uchar* data = chunk(index, native);
+			if (!data) {
+				return false;
+			}
+
+			int rows = std::min(chunkRows(index), m_height - chunkRow);
+			int cols = std::min(m_chunkWidth, m_width - chunkCol);
+			for (int r = 0; r < rows; ++r) {
+				const uchar* src = data + qint64(r)*m_chunkWidth*m_bytesPerSample;
+				qint16* dst = out + qint64(chunkRow + r)*m_width + chunkCol;
+				for (int c = 0; c < cols; ++c) {
+					dst[c] = toElevation(src + qint64(c)*m_bytesPerSample, native);
+				}
+			}
+		}
+	}
+
+	return true;
+}
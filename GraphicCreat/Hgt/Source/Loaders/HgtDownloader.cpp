@@ -0,0 +1,190 @@
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QSaveFile>
+#include <QTimer>
+#include <QDebug>
+#include "HgtDownloader.h"
+
+//a request is aborted if it has not finished by then
+const int REQUEST_TIMEOUT_DOWNLOADER = 120000;
+//SRTM3 and SRTM1 .hgt files
+const qint64 SRTM3_SIZE_DOWNLOADER = 2*1201*1201;
+const qint64 SRTM1_SIZE_DOWNLOADER = 2*3601*3601;
+
+HgtDownloader::HgtDownloader(QObject* parent) :
+	QObject(parent)
+{
+	m_clock.start();
+	m_worker = new QObject;
+	m_worker->moveToThread(&m_thread);
+	//the worker and its children are deleted on the downloader's thread
+	connect(&m_thread, &QThread::finished, m_worker, &QObject::deleteLater);
+	m_thread.start();
+}
+
+HgtDownloader::~HgtDownloader()
+{
+	//aborts the requests in flight, partial files are discarded with their QSaveFile
+	m_thread.quit();
+	m_thread.wait();
+}
+
+void HgtDownloader::setServerAddress(const QString& serverAddress)
+{
+	QMutexLocker locker(&m_lock);
+	m_serverAddress = serverAddress;
+	if (!m_serverAddress.isEmpty() && !m_serverAddress.endsWith('/')) {
+		m_serverAddress += '/';
+	}
+}
+
+void HgtDownloader::setCacheDirectory(const QString& hgtCachePath)
+{
+	QMutexLocker locker(&m_lock);
+	m_cachePath = hgtCachePath;
+}
+
+void HgtDownloader::setMaxConcurrent(const int requests)
+{
+	{
+		QMutexLocker locker(&m_lock);
+		m_maxConcurrent = std::max(1, requests);
+	}
+	QMetaObject::invokeMethod(m_worker, [this]() {
+		startRequests();
+	}, Qt::QueuedConnection);
+}
+
+void HgtDownloader::setRetryInterval(const int msec)
+{
+	QMutexLocker locker(&m_lock);
+	m_retryInterval = std::max(0, msec);
+}
+
+bool HgtDownloader::fetch(const QPoint& leftBottomCorner, const QString& fileName)
+{
+	{
+		QMutexLocker locker(&m_lock);
+		if (m_serverAddress.isEmpty() || m_cachePath.isEmpty() || fileName.isEmpty()) {
+			return false;
+		}
+		if (m_active.contains(fileName)) {
+			return true;
+		}
+		auto failed = m_failed.constFind(fileName);
+		if (failed != m_failed.constEnd() && m_clock.elapsed() - failed.value() < m_retryInterval) {
+			return false;
+		}
+
+		Request request;
+		request.leftBottomCorner = leftBottomCorner;
+		request.fileName = fileName;
+		request.url = m_serverAddress + fileName;
+		request.filePath = QDir(m_cachePath).filePath(fileName);
+		m_active.insert(fileName);
+		m_queue.enqueue(request);
+	}
+
+	QMetaObject::invokeMethod(m_worker, [this]() {
+		startRequests();
+	}, Qt::QueuedConnection);
+	return true;
+}
+
+int HgtDownloader::pendingCount() const
+{
+	QMutexLocker locker(&m_lock);
+	return m_active.size();
+}
+
+void HgtDownloader::startRequests()
+{
+	if (!m_network) {
+		m_network = new QNetworkAccessManager(m_worker);
+	}
+
+	while (true) {
+		Request request;
+		{
+			QMutexLocker locker(&m_lock);
+			if (m_running >= m_maxConcurrent || m_queue.isEmpty()) {
+				return;
+			}
+			request = m_queue.dequeue();
+			++m_running;
+		}
+		startRequest(request);
+	}
+}
+
+void HgtDownloader::startRequest(const Request& request)
+{
+	QDir().mkpath(QFileInfo(request.filePath).absolutePath());
+	//written to a temporary file, commit() renames it to filePath
+	QSaveFile* file = new QSaveFile(request.filePath, m_worker);
+	if (!file->open(QIODevice::WriteOnly)) {
+		qDebug() << QString("HgtDownloader.startRequest. Can't write file %1.").arg(request.filePath);
+		delete file;
+		finishRequest(request, false);
+		return;
+	}
+
+	QNetworkRequest networkRequest{QUrl(request.url)};
+	networkRequest.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
+	QNetworkReply* reply = m_network->get(networkRequest);
+	QTimer::singleShot(REQUEST_TIMEOUT_DOWNLOADER, reply, &QNetworkReply::abort);
+
+	//streamed to disk, tiles are not held in RAM
+	connect(reply, &QNetworkReply::readyRead, m_worker, [reply, file]() {
+		file->write(reply->readAll());
+	});
+	connect(reply, &QNetworkReply::finished, m_worker, [this, reply, file, request]() {
+		bool ok = reply->error() == QNetworkReply::NoError;
+		const QVariant status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute);
+		if (status.isValid() && status.toInt() != 200) {
+			ok = false;
+		}
+		if (ok) {
+			file->write(reply->readAll());
+			ok = isValidSize(request.fileName, file->pos());
+		}
+		if (ok) {
+			ok = file->commit();
+		} else {
+			qDebug() << QString("HgtDownloader.startRequest. Can't download %1: %2.").arg(request.url).arg(reply->errorString());
+			file->cancelWriting();
+		}
+		delete file;
+		reply->deleteLater();
+
+		finishRequest(request, ok);
+		startRequests();
+	});
+}
+
+void HgtDownloader::finishRequest(const Request& request, const bool ok)
+{
+	{
+		QMutexLocker locker(&m_lock);
+		--m_running;
+		m_active.remove(request.fileName);
+		if (ok) {
+			m_failed.remove(request.fileName);
+		} else {
+			m_failed.insert(request.fileName, m_clock.elapsed());
+		}
+	}
+	emit tileDownloaded(request.leftBottomCorner, ok);
+}
+
+bool HgtDownloader::isValidSize(const QString& fileName, const qint64 size)
+{
+	if (fileName.endsWith(".hgt", Qt::CaseInsensitive)) {
+		return size == SRTM3_SIZE_DOWNLOADER || size == SRTM1_SIZE_DOWNLOADER;
+	}
+	return size > 0;
+}
@@ -0,0 +1,564 @@
+#include <QFile>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QStringList>
+#include <QtEndian>
+#include <QtMath>
+#include <QMutexLocker>
+#include <QElapsedTimer>
+#include <QDebug>
+#include "HgtLoaderGdem.h"
+#include "../TileView.h"
+#include "../HgtTrace.h"
+#include "../Geo/GeoConstants.h"
+#include "../Geo/PolygonRaster.h"
+
+//number of pixels in width and height
+const int SIDE_SIZE_GDEM = 3601;
+//decoded tiles hold 2 bytes per sample
+const int SIZE_ELEVATION_GDEM = 2;
+
+const int ERROR_LONLAT_INDEX_GDEM = -1;
+//a tile found missing is looked for on disk again after this many msec, a finished download ends it early
+const qint64 MISSING_RECHECK_MS_GDEM = 5000;
+
+inline quint32 makeKeyLatLonGdem(int lat, int lon) {
+	return lat << 16 | lon;
+}
+
+//offset of the sample inside the row-major raster of sideSize x sideSize samples
+static bool getRasterOffset(qint64& offset, const double lon, const double lat, const int sideSize)
+{
+	if (sideSize < 2) {
+		return false;
+	}
+
+	double degPerPix = 1.0/(sideSize - 1);
+	int lonName = floor(lon);
+	int latName = floor(lat);
+
+	double lonCol = (lon - ((double)lonName) + degPerPix/2.0)/degPerPix;
+	double latRow = (((double)latName) + 1.0 + degPerPix/2.0 - lat)/degPerPix;
+	int col = floor(lonCol);
+	int row = floor(latRow);
+
+	if ((col < 0) || (col >= sideSize)) {
+		return false;
+	}
+
+	if ((row < 0) || (row >= sideSize)) {
+		return false;
+	}
+
+	offset = SIZE_ELEVATION_GDEM*(col + qint64(row)*sideSize);
+
+	return true;
+}
+
+HgtLoaderGdem::HgtLoaderGdem(HgtSettings *settings, QObject* parent) :
+    IHgtLoader(parent),
+    m_settings(settings)
+{
+    m_missingClock.start();
+}
+
+HgtLoaderGdem::~HgtLoaderGdem()
+{
+}
+
+bool HgtLoaderGdem::getElevationFromTile(qint16& elevation, const double lon, const double lat, const QByteArray& data,
+										 const QSysInfo::Endian byteOrder)
+{
+	QPoint leftBottomCorner(floor(lon), floor(lat));
+	const uchar* tileData = reinterpret_cast<const uchar*>(data.constData());
+	const bool nativeEndian = byteOrder == QSysInfo::ByteOrder;
+
+	if (nativeEndian && data.size() == GdemTileView::DATA_SIZE) {
+		return GdemTileView(tileData, data.size(), leftBottomCorner).getElevation(elevation, lon, lat);
+	}
+	if (nativeEndian && data.size() == GdemLowResTileView::DATA_SIZE) {
+		return GdemLowResTileView(tileData, data.size(), leftBottomCorner).getElevation(elevation, lon, lat);
+	}
+
+	//rasters of other sizes
+	int sideSize = qRound(sqrt(data.size()/SIZE_ELEVATION_GDEM));
+
+	qint64 eleOffset = 0;
+	if (!getRasterOffset(eleOffset, lon, lat, sideSize)) {
+		return false;
+	}
+
+	if (eleOffset+sizeof(elevation) > data.size()) {
+		return false;
+	}
+
+	memcpy(&elevation, data.constData()+eleOffset, sizeof(elevation));
+	if (!nativeEndian) {
+		elevation = qbswap(elevation);
+	}
+
+	return true;
+}
+
+bool HgtLoaderGdem::getTileHandle(TileHandle& handle, const double lon, const double lat)
+{
+	return getHgt(lon, lat, &handle);
+}
+
+void HgtLoaderGdem::forgetTile(const QPoint& leftBottomCorner)
+{
+	QMutexLocker locker(&m_cacheLock);
+	const quint32 latLon = makeKeyLatLonGdem(leftBottomCorner.y(), leftBottomCorner.x());
+	m_Cash.remove(latLon);
+	m_CashKey.removeAll(latLon);
+	m_missingSince.remove(latLon);
+}
+
+bool HgtLoaderGdem::getHgtFileOffset(qint64& offset, const double lon, const double lat) const
+{
+	return getRasterOffset(offset, lon, lat, SIDE_SIZE_GDEM);
+}
+
+bool HgtLoaderGdem::getElevation(qint16& elevation, const double lon, const double lat, const bool saveTileInsideModule)
+{
+    Q_UNUSED(saveTileInsideModule)
+    return getHgt(lon, lat, nullptr, &elevation);
+}
+
+QVector<QPointF> HgtLoaderGdem::getLeftBottomLocalHgt(const QString& dirPath)
+{
+	QVector<QPointF> retVal;
+
+	if (dirPath.isEmpty()) return retVal;
+	QDir dir(dirPath);
+	if (!dir.exists()) return retVal;
+
+	dir.setFilter(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot | QDir::NoSymLinks);
+	dir.setNameFilters( QStringList() << "*" + gdemSuffix);
+
+	QDirIterator it(dir, QDirIterator::Subdirectories);
+	while(it.hasNext()) {
+		QFileInfo fi(it.next());
+		QPointF node = getLeftBottomNode(fi.fileName());
+		if (!Geo::Constants::isCorrectCoord(node.x())) continue;
+		retVal.append(node);
+	}
+
+	return retVal;
+}
+
+//ASTGTMV003_N59E030_dem.tif
+QPointF HgtLoaderGdem::getLeftBottomNode(const QString& hgtName)
+{
+	QPointF retVal(Geo::Constants::INVALID_GEO_POS);
+
+	QString name = hgtName;
+	if (name.startsWith(gdemPrefix)) {
+		name = name.mid(gdemPrefix.size());
+	}
+
+	int latPos = name.indexOf("N");
+	int latSign = 1;
+	if (latPos < 0) {
+		latPos = name.indexOf("S");
+		latSign = -1;
+	}
+	if (latPos < 0) return retVal;
+
+	int lonPos = name.indexOf("E",latPos+1);
+	int lonSign = 1;
+	if (lonPos < 0) {
+		lonPos = name.indexOf("W",latPos+1);
+		lonSign = -1;
+	}
+	if (lonPos < 0) return retVal;
+
+	int endPos = name.indexOf("_", lonPos+1);
+	if (endPos < 0) return retVal;
+
+	latPos++;
+	QString lat_str = name.mid(latPos, lonPos-latPos);
+
+	lonPos++;
+	QString lon_str = name.mid(lonPos, endPos-lonPos);
+
+	bool okNumber;
+	int lat = lat_str.toInt(&okNumber);
+	if (!okNumber) return retVal;
+	int lon = lon_str.toInt(&okNumber);
+	if (!okNumber) return retVal;
+
+	retVal.setX(lon*lonSign);
+	retVal.setY(lat*latSign);
+
+	return retVal;
+}
+
+QList<TileOwn> HgtLoaderGdem::getHgtTilesByRect(const double minLon, const double maxLon, const double minLat, const double maxLat, const bool saveTilesInsideModule)
+{
+    Q_UNUSED(saveTilesInsideModule)
+	QList<TileOwn> map;
+	if (!isCorrectPoint(minLon, minLat)) {
+        qDebug() << "HgtLoaderGdem.getHgtTilesByRect. Min lon,lat incorrect.";
+		return map;
+	}
+	if (!isCorrectPoint(maxLon, maxLat)) {
+        qDebug() << "HgtLoaderGdem.getHgtTilesByRect. Max lon,lat incorrect.";
+		return map;
+	}
+
+	int lon1 = floor(minLon);
+	int lat1 = floor(minLat);
+
+	int lon2 = floor(maxLon);
+	int lat2 = floor(maxLat);
+
+	int lonmin = std::min(lon1,lon2);
+	int lonmax = std::max(lon1,lon2);
+	int latmin = std::min(lat1,lat2);
+	int latmax = std::max(lat1,lat2);
+
+	for(int lon=lonmin; lon<=lonmax; ++lon) {
+		for(int lat=latmin; lat<=latmax; ++lat) {
+			TileHandle handle;
+            if (!getHgt(lon,lat,&handle)) {
+                qDebug() << "HgtLoaderGdem.getHgtTilesByRect. Can't get gdem file from cache.";
+				continue;
+			}
+			map.append(tileOwnFromHandle(handle));
+		}
+	}
+
+	return map;
+}
+
+QList<TileOwn> HgtLoaderGdem::getHgtTilesByPolygon(const QList<QPointF> &nodes, const bool saveTilesInsideModule)
+{
+    Q_UNUSED(saveTilesInsideModule)
+	QList<TileOwn> map;
+
+	if (nodes.count() == 0) return map;
+
+	for( int i = 0; i < nodes.count(); i++ ) {
+		auto item = nodes.at(i);
+		if (!Geo::Constants::isCorrectGeoCoord(item) || !isCorrectPoint(item.x(), item.y())) {
+            qDebug() << "HgtLoaderGdem.getHgtTilesByPolygon. Lon,lat incorrect.";
+			return map;
+		}
+	}
+
+	//only the tiles the polygon touches, not its whole bounding rectangle
+	QVector<QPoint> corners = Geo::PolygonRaster::coveredTiles(nodes);
+	for (const QPoint& corner : corners) {
+		TileHandle handle;
+		if (!getHgt(corner.x(), corner.y(), &handle)) {
+            qDebug() << "HgtLoaderGdem.getHgtTilesByPolygon. Can't get gdem file from cache.";
+			continue;
+		}
+		map.append(tileOwnFromHandle(handle));
+	}
+
+	return map;
+}
+
+QString HgtLoaderGdem::getHgtFilePathAndNameFromCoordinates(const QPointF& geoPos)
+{
+    int lon = floor(geoPos.x());
+    int lat = floor(geoPos.y());
+    QString hgtFileName = getHgtHalfPathFileName((double)lon, (double)lat);
+    QString srcHgtFileName = QDir::toNativeSeparators(QDir(m_settings->hgtCachePath).absolutePath() + QDir::separator() + hgtFileName);
+    return srcHgtFileName;
+}
+
+bool HgtLoaderGdem::getHgt(const double lon, const double lat, TileHandle* handle, qint16* elevation)
+{
+    HGT_TRACE_SCOPE("HgtLoaderGdem::getHgt");
+
+    int lonName = floor(lon);
+	int latName = floor(lat);
+
+    quint32 latLon = makeKeyLatLonGdem(latName, lonName);
+
+    QSharedPointer<GdemCache> gdem;
+    QString gdemFileName;
+    {
+        HgtStatsLocker locker(&m_cacheLock, m_stats.data());
+        //another thread opening the tile is waited for, lookups of other tiles go on meanwhile
+        while (true) {
+            auto it = m_Cash.find(latLon);
+            if (it != m_Cash.end()){
+                gdem = it.value();
+                if (m_stats) {
+                    m_stats->recordHit(lonName, latName);
+                }
+                break;
+            }
+            if (!m_opening.contains(latLon)) {
+                break;
+            }
+            m_tileOpened.wait(&m_cacheLock);
+        }
+
+        if (!gdem && !m_Cash.contains(latLon)) {
+            if (m_stats) {
+                m_stats->recordMiss(lonName, latName);
+            }
+            QString coordFileName = getHgtName(lon, lat);
+            gdemFileName = QDir::toNativeSeparators(m_settings->hgtCachePath + QDir::separator() + coordFileName);
+
+            //while downloads are enabled a missing tile is not cached as missing, the lookups after the recheck
+            //interval ask the downloader again, which skips files that failed within its retry interval
+            if (m_downloader) {
+                auto missing = m_missingSince.constFind(latLon);
+                if (missing != m_missingSince.constEnd() && m_missingClock.elapsed() - missing.value() < MISSING_RECHECK_MS_GDEM) {
+                    return false;
+                }
+                if (!QFile::exists(gdemFileName)) {
+                    m_missingSince.insert(latLon, m_missingClock.elapsed());
+                    m_downloader->fetch(QPoint(lonName, latName), coordFileName);
+                    return false;
+                }
+                m_missingSince.remove(latLon);
+            }
+            m_opening.insert(latLon);
+        }
+    }
+
+    if (!gdemFileName.isEmpty()) {
+        gdem = openTile(gdemFileName);
+
+        HgtStatsLocker locker(&m_cacheLock, m_stats.data());
+        //the limit can be lowered while tiles are cached
+        while (!m_CashKey.isEmpty() && m_CashKey.size() >= m_settings->maxNumOfTilesInRAM){
+            //tiles still referenced by a TileHandle are unmapped when the last handle is released
+            auto key = m_CashKey.takeFirst();
+            m_Cash.remove(key);
+            if (m_stats) {
+                m_stats->recordEviction();
+            }
+        }
+        m_CashKey.append(latLon);
+        m_Cash.insert(latLon, gdem);
+        m_opening.remove(latLon);
+        m_tileOpened.wakeAll();
+    }
+
+    if (!gdem) {
+        return false;
+    }
+
+    //the reader is not thread safe, each tile has its own lock so lookups of other tiles don't wait for a decode
+    QMutexLocker readerLocker(&gdem->readerLock);
+    if (elevation) {
+        int col = 0;
+        int row = 0;
+        if (!gdem->reader.getPixelIndex(col, row, lon, lat) || !gdem->reader.getSample(*elevation, col, row)) {
+            qDebug("Failed to get elevation: lonName=%d latName=%d\n", lonName, latName);
+            return false;
+        }
+    }
+
+    if (handle) {
+        QPoint leftBottomCorner(lonName, latName);
+        if (gdem->reader.isNativeInt16Raster()) {
+            //zero-copy: the raster is stored in the file exactly as we hand it out
+            qint64 rasterSize = qint64(gdem->reader.width())*gdem->reader.height()*SIZE_ELEVATION_GDEM;
+            *handle = TileHandle(gdem, gdem->reader.rasterData(), rasterSize, leftBottomCorner, QSysInfo::ByteOrder);
+        } else {
+            //decoded once and never modified afterwards
+            HGT_TRACE_SCOPE("HgtLoaderGdem::decodeRaster");
+            if (gdem->raster.isEmpty() && !gdem->reader.decodeRaster(gdem->raster)) {
+                qDebug("Failed to decode gdem raster: lonName=%d latName=%d\n", lonName, latName);
+                gdem->raster.clear();
+                return false;
+            }
+            *handle = TileHandle(gdem, reinterpret_cast<const uchar*>(gdem->raster.constData()), gdem->raster.size(),
+                                 leftBottomCorner, QSysInfo::ByteOrder);
+        }
+    }
+
+	return true;
+}
+
+QSharedPointer<GdemCache> HgtLoaderGdem::openTile(const QString& gdemFileName)
+{
+    HGT_TRACE_SCOPE("HgtLoaderGdem::openTile");
+    QSharedPointer<GdemCache> gdem(new GdemCache);
+    gdem->gdemFile = new QFile(gdemFileName);
+    QElapsedTimer timer;
+    timer.start();
+    if (!gdem->gdemFile->open(QIODevice::ReadOnly)) {
+        qDebug() << QString("HgtLoaderGdem.getHgt. Can't open file %1.").arg(gdemFileName);
+    } else {
+        if (m_stats) {
+            m_stats->recordOpen(timer.nsecsElapsed());
+        }
+        timer.start();
+        gdem->fileSize = gdem->gdemFile->size();
+        gdem->data = gdem->gdemFile->map(0, gdem->fileSize);
+        if (m_stats) {
+            m_stats->recordMap(timer.nsecsElapsed());
+        }
+        if (gdem->data == nullptr) {
+            qDebug() << QString("HgtLoaderGdem.getHgt. Can't map file %1.").arg(gdemFileName);
+        } else if (!gdem->reader.open(gdem->data, gdem->fileSize)) {
+            qDebug() << QString("HgtLoaderGdem.getHgt. Can't read GeoTIFF %1.").arg(gdemFileName);
+            gdem->data = nullptr;
+        }
+    }
+
+    if (!gdem->data) {
+        gdem.reset();
+    } else if (m_stats) {
+        gdem->stats = m_stats;
+        gdem->mappedBytes = gdem->fileSize;
+        m_stats->fileOpened(gdem->mappedBytes);
+    }
+    return gdem;
+}
+
+bool HgtLoaderGdem::isCorrectPoint(const double lon, const double lat) const
+{
+
+	if ((lon < Geo::Constants::GEO_MIN_LON) || (lon > Geo::Constants::GEO_MAX_LON)) {
+		return false;
+	}
+
+	if ((lat < Geo::Constants::GEO_MIN_LAT) || (lat > Geo::Constants::GEO_MAX_LAT)) {
+		return false;
+	}
+
+	return true;
+}
+
+int HgtLoaderGdem::getLonIndex(const double lon) const
+{
+	int retVal = ERROR_LONLAT_INDEX_GDEM;
+	if ((lon < Geo::Constants::GEO_MIN_LON) || (lon > Geo::Constants::GEO_MAX_LON)) {
+		return retVal;
+	}
+
+	double longitude = 180.0 + lon;
+	double zoneIndex = longitude/6.0;
+	retVal = floor(zoneIndex);
+	retVal++;
+	if (retVal == 61) {
+		retVal = 60;
+	}
+
+	return retVal;
+}
+
+int HgtLoaderGdem::getLatIndex(const double lat) const
+{
+    int retVal = ERROR_LONLAT_INDEX_GDEM;
+	if ((lat < Geo::Constants::GEO_MIN_LAT) || (lat > Geo::Constants::GEO_MAX_LAT)) {
+		return retVal;
+	}
+	if (lat < -88.0) {
+		return 0;
+	}
+
+	double latitude = 88.0 + lat;
+	double zoneIndex = latitude/4.0;
+	retVal = floor(zoneIndex);
+	retVal++;
+
+	return retVal;
+}
+
+QString HgtLoaderGdem::getLonCellName(const double lon) const
+{
+    QString retVal = "";
+
+	int lonIndex = getLonIndex(lon);
+	if (lonIndex==ERROR_LONLAT_INDEX_GDEM) {
+		return retVal;
+	}
+
+	retVal += QString("%1").arg(lonIndex, 2, 10, QLatin1Char('0'));
+
+	return retVal;
+}
+
+QString HgtLoaderGdem::getLatCellName(const double lat) const
+{
+	QString retVal = "";
+
+	int latIndex = getLatIndex(lat);
+	if (latIndex==ERROR_LONLAT_INDEX_GDEM) {
+		return retVal;
+	}
+
+	if (latIndex >=23) {
+		latIndex -= 22;
+	}
+	else {
+		retVal = "S";
+		latIndex = 23 - latIndex;
+	}
+
+	//65=A, 66=B, ... 85=U
+	int code = 64 + abs(latIndex);
+	char symbol = (char)code;
+	retVal += symbol;
+
+	return retVal;
+}
+
+QString HgtLoaderGdem::getHgtName(const double lon, const double lat) const
+{
+    QString retVal = "";
+	if (!isCorrectPoint(lon, lat)) {
+        qDebug() << QString("HgtLoaderGdem.getHgtName. Incorrect lon=%1, lat=%2").arg(lon).arg(lat);
+		return retVal;
+	}
+
+	int lonName = floor(lon);
+	int latName = floor(lat);
+
+	retVal += gdemPrefix;
+	if (latName >= 0) {
+		retVal += "N";
+	}
+	else {
+		retVal += "S";
+	}
+	retVal += QString("%1").arg(abs(latName), 2, 10, QLatin1Char('0'));
+
+	if (lonName >= 0) {
+		retVal += "E";
+	}
+	else {
+		retVal += "W";
+	}
+	retVal += QString("%1").arg(abs(lonName), 3, 10, QLatin1Char('0'));
+	retVal += gdemSuffix;
+
+	return retVal;
+}
+
+QString HgtLoaderGdem::getHgtHalfPathFileName(const double lon, const double lat) const
+{
+	QString retVal = "";
+
+	QString lonCellName = getLonCellName(lon);
+	if (lonCellName.isEmpty()) {
+		return retVal;
+	}
+
+	QString latCellName = getLatCellName(lat);
+	if (latCellName.isEmpty()) {
+		return retVal;
+	}
+
+	QString hgtFileName = getHgtName(lon, lat);
+	if (hgtFileName.isEmpty()) {
+		return retVal;
+	}
+
+    retVal = latCellName + QDir::separator() + lonCellName + QDir::separator() + hgtFileName;
+
+	return retVal;
+}
@@ -0,0 +1,607 @@
+#include <QFile>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QStringList>
+#include <QtEndian>
+#include <QtMath>
+#include <QRectF>
+#include <QCoreApplication>
+#include <QMetaType>
+#include <QMutexLocker>
+#include <QElapsedTimer>
+#include <QDebug>
+#include "HgtLoaderSrtm.h"
+#include "NativeTileCache.h"
+#include "SharedTileCache.h"
+#include "../TileView.h"
+#include "../HgtTrace.h"
+#include "../Geo/GeoConstants.h"
+#include "../Geo/PolygonRaster.h"
+
+//degree per pixel
+const double DEG_PER_PIX_SRTM_HGT = 1.0/1200.0;
+//degree per half pixel
+const double DEG_PER_HALF_PIX_SRTM_HGT = 1.0/2400.0;
+//number of pixels in width and height
+const int SRTM_SIDE_SIZE_SRTM_HGT = 1201;
+//2 bytes in hgt file
+const int SIZE_ELEVATION_SRTM_HGT = 2;
+
+const int ERROR_LONLAT_INDEX_SRTM_HGT = -1;
+//a tile found missing is looked for on disk again after this many msec, a finished download ends it early
+const qint64 MISSING_RECHECK_MS_SRTM_HGT = 5000;
+
+inline quint32 makeKeyLatLon(int lat, int lon) {
+	return lat << 16 | lon;
+}
+
+static bool getTileElevation(qint16& elevation, const uchar* data, const qint64 size, const bool nativeEndian,
+							 const QPoint& leftBottomCorner, const double lon, const double lat)
+{
+	if (nativeEndian) {
+		if (size == Srtm1NativeTileView::DATA_SIZE) {
+			return Srtm1NativeTileView(data, size, leftBottomCorner).getElevation(elevation, lon, lat);
+		}
+		return Srtm3NativeTileView(data, size, leftBottomCorner).getElevation(elevation, lon, lat);
+	}
+
+	if (size == Srtm1TileView::DATA_SIZE) {
+		return Srtm1TileView(data, size, leftBottomCorner).getElevation(elevation, lon, lat);
+	}
+	return Srtm3TileView(data, size, leftBottomCorner).getElevation(elevation, lon, lat);
+}
+
+HgtLoaderSrtm::HgtLoaderSrtm(HgtSettings *settings, QObject* parent) :
+    m_settings(settings),
+    IHgtLoader(parent)
+{
+    m_missingClock.start();
+}
+
+HgtLoaderSrtm::~HgtLoaderSrtm()
+{    
+}
+
+bool HgtLoaderSrtm::getElevationFromTile(qint16& elevation, const double lon, const double lat, const QByteArray& data,
+										 const QSysInfo::Endian byteOrder)
+{
+	//a tile is raw big-endian also in the native modes if its conversion failed, the caller knows from the tile
+	QPoint leftBottomCorner(floor(lon), floor(lat));
+	return getTileElevation(elevation, reinterpret_cast<const uchar*>(data.constData()), data.size(),
+							byteOrder == QSysInfo::ByteOrder, leftBottomCorner, lon, lat);
+}
+
+bool HgtLoaderSrtm::getTileHandle(TileHandle& handle, const double lon, const double lat)
+{
+	return getHgt(lon, lat, &handle);
+}
+
+void HgtLoaderSrtm::forgetTile(const QPoint& leftBottomCorner)
+{
+	QMutexLocker locker(&m_cacheLock);
+	const quint32 latLon = makeKeyLatLon(leftBottomCorner.y(), leftBottomCorner.x());
+	m_Cash.remove(latLon);
+	m_CashKey.removeAll(latLon);
+	m_missingSince.remove(latLon);
+}
+
+bool HgtLoaderSrtm::getHgtFileOffset(qint64& offset, const double lon, const double lat) const
+{
+	int lonName = floor(lon);
+	int latName = floor(lat);
+
+	double lonCol = (lon - ((double)lonName) + DEG_PER_HALF_PIX_SRTM_HGT)/DEG_PER_PIX_SRTM_HGT;
+	double latRow = (((double)latName) + 1.0 + DEG_PER_HALF_PIX_SRTM_HGT - lat)/DEG_PER_PIX_SRTM_HGT;
+	int col = floor(lonCol);
+	int row = floor(latRow);
+
+	if ((col < 0) || (col >= SRTM_SIDE_SIZE_SRTM_HGT)) {
+		return false;
+	}
+
+	if ((row < 0) || (row >= SRTM_SIDE_SIZE_SRTM_HGT)) {
+		return false;
+	}
+
+	offset = SIZE_ELEVATION_SRTM_HGT*(col + row*SRTM_SIDE_SIZE_SRTM_HGT);
+
+	return true;
+}
+
+bool HgtLoaderSrtm::getElevation(qint16& elevation, const double lon, const double lat, const bool saveTileInsideModule)
+{
+    Q_UNUSED(saveTileInsideModule)
+    return getHgt(lon, lat, nullptr, &elevation);
+}
+
+QVector<QPointF> HgtLoaderSrtm::getLeftBottomLocalHgt(const QString& dirPath)
+{
+	QVector<QPointF> retVal;
+
+	if (dirPath.isEmpty()) return retVal;
+	QDir dir(dirPath);
+	if (!dir.exists()) return retVal;
+
+	dir.setFilter(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot | QDir::NoSymLinks);
+	dir.setNameFilters( QStringList() << "*.hgt");
+
+	QDirIterator it(dir, QDirIterator::Subdirectories);
+	while(it.hasNext()) {
+		QFileInfo fi(it.next());
+		QPointF node = getLeftBottomNode(fi.fileName());
+		if (!Geo::Constants::isCorrectCoord(node.x())) continue;
+		retVal.append(node);
+	}
+
+	return retVal;
+}
+
+//N59E030.hgt
+QPointF HgtLoaderSrtm::getLeftBottomNode(const QString& hgtName)
+{
+	QPointF retVal(Geo::Constants::INVALID_GEO_POS);
+
+	int latPos = hgtName.indexOf("N");
+	int latSign = 1;
+	if (latPos < 0) {
+		latPos = hgtName.indexOf("S");
+		latSign = -1;
+	}
+	if (latPos < 0) return retVal;
+
+	int lonPos = hgtName.indexOf("E",latPos+1);
+	int lonSign = 1;
+	if (lonPos < 0) {
+		lonPos = hgtName.indexOf("W",latPos+1);
+		lonSign = -1;
+	}
+	if (lonPos < 0) return retVal;
+
+	int dotPos = hgtName.lastIndexOf(".");
+	if (dotPos < 0) return retVal;
+
+	latPos++;
+	QString lat_str = hgtName.mid(latPos, lonPos-latPos);
+
+	lonPos++;
+	QString lon_str = hgtName.mid(lonPos, dotPos-lonPos);
+
+	bool okNumber;
+	int lat = lat_str.toInt(&okNumber);
+	if (!okNumber) return retVal;
+	int lon = lon_str.toInt(&okNumber);
+	if (!okNumber) return retVal;
+
+	retVal.setX(lon*lonSign);
+	retVal.setY(lat*latSign);
+
+	return retVal;
+}
+
+QList<TileOwn> HgtLoaderSrtm::getHgtTilesByRect(const double minLon, const double maxLon, const double minLat, const double maxLat, const bool saveTilesInsideModule)
+{
+    Q_UNUSED(saveTilesInsideModule)
+	QList<TileOwn> map;
+	if (!isCorrectPoint(minLon, minLat)) {
+        qDebug() << "HgtLoaderSrtm.getHgtTilesByRect. Min lon,lat incorrect.";
+		return map;
+	}
+	if (!isCorrectPoint(maxLon, maxLat)) {
+        qDebug() << "HgtLoaderSrtm.getHgtTilesByRect. Max lon,lat incorrect.";
+		return map;
+	}
+
+	int lon1 = floor(minLon);
+	int lat1 = floor(minLat);
+
+	int lon2 = floor(maxLon);
+	int lat2 = floor(maxLat);
+
+	int lonmin = std::min(lon1,lon2);
+	int lonmax = std::max(lon1,lon2);
+	int latmin = std::min(lat1,lat2);
+	int latmax = std::max(lat1,lat2);
+
+	for(int lon=lonmin; lon<=lonmax; ++lon) {
+		for(int lat=latmin; lat<=latmax; ++lat) {
+			TileHandle handle;
+            if (!getHgt(lon,lat,&handle)) {
+                qDebug() << "HgtLoaderSrtm.getHgtTilesByRect. Can't get hgt file from cache.";
+				continue;
+			}
+			map.append(tileOwnFromHandle(handle));
+		}
+	}
+
+	return map;
+}
+
+QList<TileOwn> HgtLoaderSrtm::getHgtTilesByPolygon(const QList<QPointF> &nodes, const bool saveTilesInsideModule)
+{
+    Q_UNUSED(saveTilesInsideModule)
+	QList<TileOwn> map;
+
+	if (nodes.count() == 0) return map;
+
+	for( int i = 0; i < nodes.count(); i++ ) {
+		auto item = nodes.at(i);
+		if (!Geo::Constants::isCorrectGeoCoord(item) || !isCorrectPoint(item.x(), item.y())) {
+            qDebug() << "HgtLoaderSrtm.getHgtTilesByPolygon. Lon,lat incorrect.";
+			return map;
+		}
+	}
+
+	//only the tiles the polygon touches, not its whole bounding rectangle
+	QVector<QPoint> corners = Geo::PolygonRaster::coveredTiles(nodes);
+	for (const QPoint& corner : corners) {
+		TileHandle handle;
+		if (!getHgt(corner.x(), corner.y(), &handle)) {
+            qDebug() << "HgtLoaderSrtm.getHgtTilesByPolygon. Can't get hgt file from cache.";
+			continue;
+		}
+		map.append(tileOwnFromHandle(handle));
+	}
+
+	return map;
+}
+
+QString HgtLoaderSrtm::getHgtFilePathAndNameFromCoordinates(const QPointF& geoPos)
+{
+    int lon = floor(geoPos.x());
+    int lat = floor(geoPos.y());
+    QString hgtFileName = getHgtHalfPathFileName((double)lon, (double)lat);
+    QString srcHgtFileName = QDir::toNativeSeparators(QDir(m_settings->hgtCachePath).absolutePath() + QDir::separator() + hgtFileName);
+    return srcHgtFileName;
+}
+
+bool HgtLoaderSrtm::getHgt(const double lon, const double lat, TileHandle* handle, qint16* elevation)
+{
+    HGT_TRACE_SCOPE("HgtLoaderSrtm::getHgt");
+
+    int lonName = floor(lon);
+	int latName = floor(lat);
+
+    quint32 latLon = makeKeyLatLon(latName, lonName);
+
+    QSharedPointer<SrtmCache> srtm;
+    QString hgtFileName;
+    {
+        HgtStatsLocker locker(&m_cacheLock, m_stats.data());
+        //another thread opening the tile is waited for, lookups of other tiles go on meanwhile
+        while (true) {
+            auto it = m_Cash.find(latLon);
+            if (it != m_Cash.end()){
+                srtm = it.value();
+                if (m_stats) {
+                    m_stats->recordHit(lonName, latName);
+                }
+                break;
+            }
+            if (!m_opening.contains(latLon)) {
+                break;
+            }
+            m_tileOpened.wait(&m_cacheLock);
+        }
+
+        if (!srtm && !m_Cash.contains(latLon)) {
+            if (m_stats) {
+                m_stats->recordMiss(lonName, latName);
+            }
+            QString coordFileName = getHgtName(lon, lat);
+            hgtFileName = QDir::toNativeSeparators(m_settings->hgtCachePath + QDir::separator() + coordFileName);
+
+            //while downloads are enabled a missing tile is not cached as missing, the lookups after the recheck
+            //interval ask the downloader again, which skips files that failed within its retry interval
+            if (m_downloader) {
+                auto missing = m_missingSince.constFind(latLon);
+                if (missing != m_missingSince.constEnd() && m_missingClock.elapsed() - missing.value() < MISSING_RECHECK_MS_SRTM_HGT) {
+                    return false;
+                }
+                if (!QFile::exists(hgtFileName)) {
+                    m_missingSince.insert(latLon, m_missingClock.elapsed());
+                    m_downloader->fetch(QPoint(lonName, latName), coordFileName);
+                    return false;
+                }
+                m_missingSince.remove(latLon);
+            }
+            m_opening.insert(latLon);
+        }
+    }
+
+    if (!hgtFileName.isEmpty()) {
+        //attaching a shared tile may wait for another process, converting takes a while: done outside the lock
+        srtm = openTile(hgtFileName);
+
+        HgtStatsLocker locker(&m_cacheLock, m_stats.data());
+        //the limit can be lowered while tiles are cached
+        while (!m_CashKey.isEmpty() && m_CashKey.size() >= m_settings->maxNumOfTilesInRAM){
+            //tiles still referenced by a TileHandle are unmapped when the last handle is released
+            auto key = m_CashKey.takeFirst();
+            m_Cash.remove(key);
+            if (m_stats) {
+                m_stats->recordEviction();
+            }
+        }
+        m_CashKey.append(latLon);
+        m_Cash.insert(latLon, srtm);
+        m_opening.remove(latLon);
+        m_tileOpened.wakeAll();
+    }
+
+    if (!srtm) {
+        return false;
+    }
+
+    if (elevation) {
+        QPoint leftBottomCorner(lonName, latName);
+        if (!getTileElevation(*elevation, srtm->data, srtm->fileSize, srtm->nativeEndian, leftBottomCorner, lon, lat)) {
+            qDebug("Failed to get elevation: lonName=%d latName=%d\n", lonName, latName);
+            return false;
+        }
+    }
+
+    if (handle) {
+        QSysInfo::Endian byteOrder = srtm->nativeEndian ? QSysInfo::ByteOrder : QSysInfo::BigEndian;
+        *handle = TileHandle(srtm, srtm->data, srtm->fileSize, QPoint(lonName, latName), byteOrder);
+    }
+
+	return true;
+}
+
+QSharedPointer<SrtmCache> HgtLoaderSrtm::openTile(const QString& hgtFileName)
+{
+    HGT_TRACE_SCOPE("HgtLoaderSrtm::openTile");
+    QElapsedTimer timer;
+    QSharedPointer<SrtmCache> srtm(new SrtmCache);
+    if (m_settings->sharedMemoryCache) {
+        //attach or create the host-wide copy
+        timer.start();
+        openSharedTile(srtm.data(), hgtFileName);
+        if (m_stats) {
+            m_stats->recordOpen(timer.nsecsElapsed());
+        }
+    } else if (!m_settings->nativeCachePath.isEmpty()) {
+        //open, convert on first use and map of the native copy
+        timer.start();
+        openNativeTile(srtm.data(), hgtFileName);
+        if (m_stats) {
+            m_stats->recordOpen(timer.nsecsElapsed());
+        }
+    }
+
+    if (!srtm->data) {
+        srtm->hgtFile = new QFile(hgtFileName);
+        timer.start();
+        if (!srtm->hgtFile->open(QIODevice::ReadOnly)) {
+            qDebug() << QString("HgtLoaderSrtm.getHgt. Can't open file %1.").arg(hgtFileName);
+        } else {
+            if (m_stats) {
+                m_stats->recordOpen(timer.nsecsElapsed());
+            }
+            timer.start();
+            srtm->fileSize = srtm->hgtFile->size();
+            srtm->data = srtm->hgtFile->map(0, srtm->fileSize);
+            if (m_stats) {
+                m_stats->recordMap(timer.nsecsElapsed());
+            }
+            if (srtm->data == nullptr) {
+                qDebug() << QString("HgtLoaderSrtm.getHgt. Can't map file %1.").arg(hgtFileName);
+            }
+        }
+    }
+
+    if (!srtm->data) {
+        srtm.reset();
+    } else if (m_stats && (srtm->hgtFile || srtm->sharedMemory)) {
+        srtm->stats = m_stats;
+        srtm->mappedBytes = srtm->fileSize;
+        m_stats->fileOpened(srtm->mappedBytes);
+    }
+    return srtm;
+}
+
+bool HgtLoaderSrtm::openNativeTile(SrtmCache* srtm, const QString& hgtFileName)
+{
+    QFile* nativeFile = nullptr;
+    qint64 dataSize = 0;
+    uchar* data = NativeTileCache::mapTile(nativeFile, dataSize, hgtFileName, m_settings->nativeCachePath, m_settings->fillVoids);
+    if (data) {
+        srtm->hgtFile = nativeFile;
+        srtm->data = data;
+        srtm->fileSize = dataSize;
+        srtm->nativeEndian = true;
+        return true;
+    }
+
+    //cache directory is not writable: convert in memory, tiles still have to come out native-endian
+    return convertTileInMemory(srtm, hgtFileName);
+}
+
+bool HgtLoaderSrtm::openSharedTile(SrtmCache* srtm, const QString& hgtFileName)
+{
+    QSharedMemory* segment = nullptr;
+    qint64 dataSize = 0;
+    const uchar* data = SharedTileCache::attachTile(segment, dataSize, hgtFileName, m_settings->fillVoids);
+    if (data) {
+        srtm->sharedMemory = segment;
+        //attached read-write to take over a dead creator's fill, the samples are not written after it is complete
+        srtm->data = const_cast<quint8*>(data);
+        srtm->fileSize = dataSize;
+        srtm->nativeEndian = true;
+        return true;
+    }
+
+    //no shared memory available: tiles still have to come out native-endian
+    if (!m_settings->nativeCachePath.isEmpty()) {
+        return openNativeTile(srtm, hgtFileName);
+    }
+    return convertTileInMemory(srtm, hgtFileName);
+}
+
+bool HgtLoaderSrtm::convertTileInMemory(SrtmCache* srtm, const QString& hgtFileName)
+{
+    QFile hgtFile(hgtFileName);
+    if (!hgtFile.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    uchar* hgtData = hgtFile.map(0, hgtFile.size());
+    if (!hgtData) {
+        qDebug() << QString("HgtLoaderSrtm.convertTileInMemory. Can't map file %1.").arg(hgtFileName);
+        return false;
+    }
+    if (!NativeTileCache::convertTile(srtm->nativeData, hgtData, hgtFile.size(), m_settings->fillVoids)) {
+        qDebug() << QString("HgtLoaderSrtm.convertTileInMemory. Can't convert file %1.").arg(hgtFileName);
+        return false;
+    }
+    srtm->data = reinterpret_cast<quint8*>(srtm->nativeData.data());
+    srtm->fileSize = srtm->nativeData.size();
+    srtm->nativeEndian = true;
+    return true;
+}
+
+bool HgtLoaderSrtm::isCorrectPoint(const double lon, const double lat) const
+{
+
+	if ((lon < Geo::Constants::GEO_MIN_LON) || (lon > Geo::Constants::GEO_MAX_LON)) {
+		return false;
+	}
+
+	if ((lat < Geo::Constants::GEO_MIN_LAT) || (lat > Geo::Constants::GEO_MAX_LAT)) {
+		return false;
+	}
+
+	return true;
+}
+
+int HgtLoaderSrtm::getLonIndex(const double lon) const
+{
+	int retVal = ERROR_LONLAT_INDEX_SRTM_HGT;
+	if ((lon < Geo::Constants::GEO_MIN_LON) || (lon > Geo::Constants::GEO_MAX_LON)) {
+		return retVal;
+	}
+
+	double longitude = 180.0 + lon;
+	double zoneIndex = longitude/6.0;
+	retVal = floor(zoneIndex);
+	retVal++;
+	if (retVal == 61) {
+		retVal = 60;
+	}
+
+	return retVal;
+}
+
+int HgtLoaderSrtm::getLatIndex(const double lat) const
+{
+    int retVal = ERROR_LONLAT_INDEX_SRTM_HGT;
+	if ((lat < Geo::Constants::GEO_MIN_LAT) || (lat > Geo::Constants::GEO_MAX_LAT)) {
+		return retVal;
+	}
+	if (lat < -88.0) {
+		return 0;
+	}
+
+	double latitude = 88.0 + lat;
+	double zoneIndex = latitude/4.0;
+	retVal = floor(zoneIndex);
+	retVal++;
+
+	return retVal;
+}
+
+QString HgtLoaderSrtm::getLonCellName(const double lon) const
+{
+    QString retVal = "";
+
+	int lonIndex = getLonIndex(lon);
+	if (lonIndex==ERROR_LONLAT_INDEX_SRTM_HGT) {
+		return retVal;
+	}
+
+	retVal += QString("%1").arg(lonIndex, 2, 10, QLatin1Char('0'));
+
+	return retVal;
+}
+
+QString HgtLoaderSrtm::getLatCellName(const double lat) const
+{
+	QString retVal = "";
+
+	int latIndex = getLatIndex(lat);
+	if (latIndex==ERROR_LONLAT_INDEX_SRTM_HGT) {
+//		log_warning(QString("HgtDetect.getLatCellName. Incorrect lat index. lat=%1").arg(lat));
+		return retVal;
+	}
+
+	if (latIndex >=23) {
+		latIndex -= 22;
+	}
+	else {
+		retVal = "S";
+		latIndex = 23 - latIndex;
+	}
+
+	//65=A, 66=B, ... 85=U
+	int code = 64 + abs(latIndex);
+	char symbol = (char)code;
+	retVal += symbol;
+
+	return retVal;
+}
+
+QString HgtLoaderSrtm::getHgtName(const double lon, const double lat) const
+{
+    QString retVal = "";
+	if (!isCorrectPoint(lon, lat)) {
+        qDebug() << QString("HgtDetectZip.getHgtName. Incorrect lon=%1, lat=%2").arg(lon).arg(lat);
+		return retVal;
+	}
+
+	int lonName = floor(lon);
+	int latName = floor(lat);
+
+	if (latName >= 0) {
+		retVal += "N";
+	}
+	else {
+		retVal += "S";
+	}
+	retVal += QString("%1").arg(abs(latName), 2, 10, QLatin1Char('0'));
+
+	if (lonName >= 0) {
+		retVal += "E";
+	}
+	else {
+		retVal += "W";
+	}
+	retVal += QString("%1").arg(abs(lonName), 3, 10, QLatin1Char('0'));
+	retVal += hgtExtension;
+
+	return retVal;
+}
+
+QString HgtLoaderSrtm::getHgtHalfPathFileName(const double lon, const double lat) const
+{
+	QString retVal = "";
+
+	QString lonCellName = getLonCellName(lon);
+	if (lonCellName.isEmpty()) {
+		return retVal;
+	}
+
+	QString latCellName = getLatCellName(lat);
+	if (latCellName.isEmpty()) {
+		return retVal;
+	}
+
+	QString hgtFileName = getHgtName(lon, lat);
+	if (hgtFileName.isEmpty()) {
+		return retVal;
+	}
+
+    retVal = latCellName + QDir::separator() + lonCellName + QDir::separator() + hgtFileName;
+
+	return retVal;
+}
+
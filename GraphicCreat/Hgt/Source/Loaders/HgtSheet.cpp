@@ -0,0 +1,49 @@
+#include <QFile>
+#include <QDataStream>
+#include "HgtSheet.h"
+#include "../HgtTrace.h"
+
+bool HgtSheet::read(const QString& filePath, const int gridSize, const QPoint& leftBottomCorner)
+{
+	HGT_TRACE_SCOPE("HgtSheet::read");
+	QFile file(filePath);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return false;
+	}
+
+	m_gridSize = gridSize;
+	m_leftBottomCorner = leftBottomCorner;
+	m_rows.clear();
+	m_rows.resize(gridSize);
+	for (int i = 0; i < gridSize; ++i) {
+		m_rows[i].resize(gridSize);
+	}
+
+	QDataStream stream(&file);
+	stream.setByteOrder(QDataStream::BigEndian);
+	for (int i = 0; i < gridSize; ++i) {
+		for (int j = 0; j < gridSize; ++j) {
+			qint16 height;
+			stream >> height;
+			m_rows[i][j] = height;
+		}
+	}
+
+	file.close();
+	return true;
+}
+
+double HgtSheet::height(const double lon, const double lat) const
+{
+	if (m_rows.isEmpty()) {
+		return 0.0;
+	}
+
+	double step = 1.0/(m_gridSize - 1);
+	double iFrac = (1.0 - (lat - m_leftBottomCorner.y()))/step;
+	double jFrac = (lon - m_leftBottomCorner.x())/step;
+	int i = qBound(0, static_cast<int>(iFrac), m_gridSize - 1);
+	int j = qBound(0, static_cast<int>(jFrac), m_gridSize - 1);
+
+	return m_rows[i][j];
+}
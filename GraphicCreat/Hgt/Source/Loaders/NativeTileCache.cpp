@@ -0,0 +1,234 @@
+#include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QSaveFile>
+#include <QSysInfo>
+#include <QtEndian>
+#include <QtMath>
+#include <QVector>
+#include <QDebug>
+#include <limits>
+#include "NativeTileCache.h"
+
+const char NATIVE_TILE_MAGIC[4] = {'H', 'G', 'T', 'N'};
+const quint32 NATIVE_TILE_VERSION = 1;
+//written in native order, reads back differently on a host with other byte order
+const quint32 NATIVE_TILE_BYTE_ORDER_MARK = 0x01020304;
+const quint32 NATIVE_TILE_FLAG_FILLED_VOIDS = 1;
+
+const qint16 VOID_ELEVATION_NATIVE_TILE = std::numeric_limits<qint16>::min();
+
+struct NativeTileHeader {
+	char magic[4];
+	quint32 version;
+	quint32 byteOrderMark;
+	quint32 sideSize;
+	qint64 sourceModified;
+	qint64 sourceSize;
+	quint32 flags;
+	char reserved[28];
+};
+static_assert(sizeof(NativeTileHeader) == 64, "samples have to start at 64 byte offset");
+
+static int sideSizeFromBytes(const qint64 size)
+{
+	int sideSize = qRound(sqrt(double(size/2)));
+	if (qint64(sideSize)*sideSize*2 != size) {
+		return 0;
+	}
+	return sideSize;
+}
+
+QString NativeTileCache::cacheFileName(const QString& sourceFileName, const QString& cacheDir, const bool fillVoids)
+{
+	QString byteOrder = QSysInfo::ByteOrder == QSysInfo::LittleEndian ? ".le" : ".be";
+	QString name = QFileInfo(sourceFileName).completeBaseName() + byteOrder + (fillVoids ? ".filled" : "") + ".hgtn";
+	return QDir::toNativeSeparators(QDir(cacheDir).absolutePath() + QDir::separator() + name);
+}
+
+bool NativeTileCache::convertTile(QByteArray& nativeData, const uchar* bigEndianData, const qint64 size, const bool fillVoids)
+{
+	if (!bigEndianData || sideSizeFromBytes(size) == 0) {
+		return false;
+	}
+
+	nativeData.resize(int(size));
+	return convertTile(reinterpret_cast<uchar*>(nativeData.data()), bigEndianData, size, fillVoids);
+}
+
+bool NativeTileCache::convertTile(uchar* nativeData, const uchar* bigEndianData, const qint64 size, const bool fillVoids)
+{
+	int sideSize = sideSizeFromBytes(size);
+	if (!nativeData || !bigEndianData || sideSize == 0) {
+		return false;
+	}
+
+	//qFromBigEndian over a whole array is vectorized by Qt
+	qFromBigEndian<qint16>(bigEndianData, size/2, nativeData);
+
+	if (fillVoids) {
+		NativeTileCache::fillVoids(reinterpret_cast<qint16*>(nativeData), sideSize);
+	}
+
+	return true;
+}
+
+void NativeTileCache::fillVoids(qint16* samples, const int sideSize)
+{
+	//rows are filled in place from the north, so the lookups below only meet samples that were valid
+	//from the start: the ones to the left and above were recorded before they could be overwritten,
+	//the ones to the right and below are not filled yet. Scratch memory is two rows of indices.
+	//nearest valid row above and at or below the current one per column, sideSize if there is none below
+	QVector<int> up(sideSize, -1);
+	QVector<int> down(sideSize, -1);
+
+	for (int row = 0; row < sideSize; ++row) {
+		qint16* line = samples + qint64(row)*sideSize;
+		int left = -1;
+		int right = -1;
+		for (int col = 0; col < sideSize; ++col) {
+			if (line[col] != VOID_ELEVATION_NATIVE_TILE) {
+				left = col;
+				up[col] = row;
+				continue;
+			}
+
+			if (right <= col) {
+				right = col + 1;
+				while (right < sideSize && line[right] == VOID_ELEVATION_NATIVE_TILE) ++right;
+			}
+			if (down[col] <= row) {
+				int next = row + 1;
+				while (next < sideSize && samples[qint64(next)*sideSize + col] == VOID_ELEVATION_NATIVE_TILE) ++next;
+				down[col] = next;
+			}
+
+			double sum = 0.0;
+			double weights = 0.0;
+			if (left >= 0) {
+				double w = 1.0/(col - left);
+				sum += w*line[left];
+				weights += w;
+			}
+			if (right < sideSize) {
+				double w = 1.0/(right - col);
+				sum += w*line[right];
+				weights += w;
+			}
+			if (up[col] >= 0) {
+				double w = 1.0/(row - up[col]);
+				sum += w*samples[qint64(up[col])*sideSize + col];
+				weights += w;
+			}
+			if (down[col] < sideSize) {
+				double w = 1.0/(down[col] - row);
+				sum += w*samples[qint64(down[col])*sideSize + col];
+				weights += w;
+			}
+			if (weights > 0.0) {
+				line[col] = qint16(qRound(sum/weights));
+			}
+		}
+	}
+}
+
+bool NativeTileCache::isValidCacheFile(const uchar* data, const qint64 size, const QString& sourceFileName, const bool fillVoids)
+{
+	if (!data || size < qint64(sizeof(NativeTileHeader))) {
+		return false;
+	}
+
+	NativeTileHeader header;
+	memcpy(&header, data, sizeof(header));
+
+	if (memcmp(header.magic, NATIVE_TILE_MAGIC, sizeof(header.magic)) != 0
+			|| header.version != NATIVE_TILE_VERSION
+			|| header.byteOrderMark != NATIVE_TILE_BYTE_ORDER_MARK) {
+		return false;
+	}
+
+	if (((header.flags & NATIVE_TILE_FLAG_FILLED_VOIDS) != 0) != fillVoids) {
+		return false;
+	}
+
+	if (size != qint64(sizeof(NativeTileHeader)) + qint64(header.sideSize)*header.sideSize*2) {
+		return false;
+	}
+
+	//the cache is still valid without the source, e.g. after the archive was removed
+	QFileInfo source(sourceFileName);
+	if (!source.exists()) {
+		return true;
+	}
+
+	return header.sourceSize == source.size() && header.sourceModified == source.lastModified().toMSecsSinceEpoch();
+}
+
+bool NativeTileCache::writeCacheFile(const QString& cacheFileName, const QString& sourceFileName, const bool fillVoids)
+{
+	QFile source(sourceFileName);
+	if (!source.open(QIODevice::ReadOnly)) {
+		return false;
+	}
+
+	qint64 sourceSize = source.size();
+	uchar* sourceData = source.map(0, sourceSize);
+	if (!sourceData) {
+		qDebug() << QString("NativeTileCache.writeCacheFile. Can't map file %1.").arg(sourceFileName);
+		return false;
+	}
+
+	QByteArray nativeData;
+	if (!convertTile(nativeData, sourceData, sourceSize, fillVoids)) {
+		qDebug() << QString("NativeTileCache.writeCacheFile. Unexpected size of %1.").arg(sourceFileName);
+		return false;
+	}
+
+	NativeTileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, NATIVE_TILE_MAGIC, sizeof(header.magic));
+	header.version = NATIVE_TILE_VERSION;
+	header.byteOrderMark = NATIVE_TILE_BYTE_ORDER_MARK;
+	header.sideSize = sideSizeFromBytes(sourceSize);
+	header.sourceModified = QFileInfo(sourceFileName).lastModified().toMSecsSinceEpoch();
+	header.sourceSize = sourceSize;
+	header.flags = fillVoids ? NATIVE_TILE_FLAG_FILLED_VOIDS : 0;
+
+	QDir().mkpath(QFileInfo(cacheFileName).absolutePath());
+
+	//write-then-rename, concurrent readers never see a half written tile
+	QSaveFile cacheFile(cacheFileName);
+	if (!cacheFile.open(QIODevice::WriteOnly)) {
+		qDebug() << QString("NativeTileCache.writeCacheFile. Can't create file %1.").arg(cacheFileName);
+		return false;
+	}
+	cacheFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	cacheFile.write(nativeData);
+
+	return cacheFile.commit();
+}
+
+uchar* NativeTileCache::mapTile(QFile*& file, qint64& dataSize, const QString& sourceFileName, const QString& cacheDir, const bool fillVoids)
+{
+	QString nativeFileName = cacheFileName(sourceFileName, cacheDir, fillVoids);
+
+	for (int attempt = 0; attempt < 2; ++attempt) {
+		if (attempt > 0 && !writeCacheFile(nativeFileName, sourceFileName, fillVoids)) {
+			break;
+		}
+
+		QFile* nativeFile = new QFile(nativeFileName);
+		if (nativeFile->open(QIODevice::ReadOnly)) {
+			qint64 size = nativeFile->size();
+			uchar* data = nativeFile->map(0, size);
+			if (isValidCacheFile(data, size, sourceFileName, fillVoids)) {
+				file = nativeFile;
+				dataSize = size - sizeof(NativeTileHeader);
+				return data + sizeof(NativeTileHeader);
+			}
+		}
+		delete nativeFile;
+	}
+
+	return nullptr;
+}
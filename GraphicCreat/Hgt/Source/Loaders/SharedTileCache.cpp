@@ -0,0 +1,177 @@
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QScopedPointer>
+#include <QSharedMemory>
+#include <QThread>
+#include <QCoreApplication>
+#include <QtMath>
+#include <QDebug>
+#include <atomic>
+#include <limits>
+#include "SharedTileCache.h"
+#include "NativeTileCache.h"
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#else
+#include <cerrno>
+#include <signal.h>
+#endif
+
+//a process waits this long for another live one to fill a segment, then loads the tile itself
+const int FILL_TIMEOUT_SHARED_TILE = 10000;
+//milliseconds between the checks whether the filling process is still running
+const int CREATOR_CHECK_SHARED_TILE = 50;
+//create() may lose against another process, attach() against the last detach of the segment
+const int MAX_ATTEMPTS_SHARED_TILE = 4;
+
+enum SharedTileState : quint32 {
+	//new segments are zero filled
+	SharedTileFilling = 0,
+	SharedTileReady = 1,
+	SharedTileFailed = 2
+};
+
+//samples start at a 64 byte offset like in NativeTileCache files
+struct SharedTileHeader {
+	std::atomic<quint32> state;
+	quint32 reserved0;
+	qint64 dataSize;
+	//pid of the process filling the segment, 0 until the creator has written it
+	std::atomic<qint64> creator;
+	char reserved[40];
+};
+static_assert(sizeof(SharedTileHeader) == 64, "samples have to start at 64 byte offset");
+static_assert(std::atomic<quint32>::is_always_lock_free, "the state is shared between processes");
+static_assert(std::atomic<qint64>::is_always_lock_free, "the creator is shared between processes");
+
+static bool isProcessRunning(const qint64 pid)
+{
+	if (pid <= 0) {
+		return true;
+	}
+#if defined(Q_OS_WIN)
+	HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, DWORD(pid));
+	if (!process) {
+		return GetLastError() == ERROR_ACCESS_DENIED;
+	}
+	DWORD exitCode = 0;
+	const bool retVal = GetExitCodeProcess(process, &exitCode) && exitCode == STILL_ACTIVE;
+	CloseHandle(process);
+	return retVal;
+#else
+	return kill(pid_t(pid), 0) == 0 || errno == EPERM;
+#endif
+}
+
+/**
+ * @brief fills the attached segment and publishes it, on success the segment is handed to the caller
+ */
+static bool fillTile(QSharedMemory*& segment, qint64& dataSize, QScopedPointer<QSharedMemory>& memory, const qint64 size,
+					 const QString& sourceFileName, const bool fillVoids)
+{
+	SharedTileHeader* header = static_cast<SharedTileHeader*>(memory->data());
+	uchar* data = static_cast<uchar*>(memory->data()) + sizeof(SharedTileHeader);
+	header->dataSize = size;
+	if (!SharedTileCache::fillSegment(data, size, sourceFileName, fillVoids)) {
+		qDebug() << QString("SharedTileCache.attachTile. Can't convert file %1.").arg(sourceFileName);
+		header->state.store(SharedTileFailed, std::memory_order_release);
+		return false;
+	}
+	//publishes the samples to the processes waiting in attach
+	header->state.store(SharedTileReady, std::memory_order_release);
+	dataSize = size;
+	segment = memory.take();
+	return true;
+}
+
+QString SharedTileCache::segmentKey(const QString& sourceFileName, const bool fillVoids)
+{
+	QFileInfo source(sourceFileName);
+	//QSharedMemory hashes the key, its length does not matter; v2 - the header holds the creator
+	return QString("HgtSharedTile:v2:%1:%2:%3").arg(source.absoluteFilePath())
+			.arg(source.lastModified().toMSecsSinceEpoch()).arg(fillVoids ? "filled" : "raw");
+}
+
+bool SharedTileCache::fillSegment(uchar* data, const qint64 dataSize, const QString& sourceFileName, const bool fillVoids)
+{
+	QFile source(sourceFileName);
+	if (!source.open(QIODevice::ReadOnly) || source.size() != dataSize) {
+		return false;
+	}
+	const uchar* sourceData = source.map(0, dataSize);
+	return NativeTileCache::convertTile(data, sourceData, dataSize, fillVoids);
+}
+
+const uchar* SharedTileCache::attachTile(QSharedMemory*& segment, qint64& dataSize, const QString& sourceFileName, const bool fillVoids)
+{
+	QFileInfo source(sourceFileName);
+	if (!source.exists()) {
+		return nullptr;
+	}
+	const qint64 size = source.size();
+	const qint64 segmentSize = qint64(sizeof(SharedTileHeader)) + size;
+	if (segmentSize > std::numeric_limits<int>::max()) {
+		return nullptr;
+	}
+
+	QScopedPointer<QSharedMemory> memory(new QSharedMemory(segmentKey(sourceFileName, fillVoids)));
+	const qint64 pid = QCoreApplication::applicationPid();
+	for (int attempt = 0; attempt < MAX_ATTEMPTS_SHARED_TILE; ++attempt) {
+		//read-write, a process may have to take over the filling
+		if (memory->attach(QSharedMemory::ReadWrite)) {
+			if (memory->size() < segmentSize) {
+				qDebug() << QString("SharedTileCache.attachTile. Segment of %1 is not usable.").arg(sourceFileName);
+				return nullptr;
+			}
+			SharedTileHeader* header = static_cast<SharedTileHeader*>(memory->data());
+			uchar* data = static_cast<uchar*>(memory->data()) + sizeof(SharedTileHeader);
+			QElapsedTimer timer;
+			timer.start();
+			qint64 lastCheck = -CREATOR_CHECK_SHARED_TILE;
+			quint32 state = header->state.load(std::memory_order_acquire);
+			while (state == SharedTileFilling && timer.elapsed() < FILL_TIMEOUT_SHARED_TILE) {
+				if (timer.elapsed() - lastCheck >= CREATOR_CHECK_SHARED_TILE) {
+					lastCheck = timer.elapsed();
+					//segments outlive their processes, a creator that died while filling is replaced by
+					//the first process that swaps in its own pid
+					qint64 creator = header->creator.load(std::memory_order_acquire);
+					if (!isProcessRunning(creator)) {
+						if (header->creator.compare_exchange_strong(creator, pid, std::memory_order_acq_rel)) {
+							qDebug() << QString("SharedTileCache.attachTile. Process %1 died filling %2, refilling.")
+										.arg(creator).arg(sourceFileName);
+							return fillTile(segment, dataSize, memory, size, sourceFileName, fillVoids) ? data : nullptr;
+						}
+						//another process took over, its time starts now
+						timer.restart();
+						lastCheck = -CREATOR_CHECK_SHARED_TILE;
+					}
+				}
+				QThread::msleep(1);
+				state = header->state.load(std::memory_order_acquire);
+			}
+			if (state != SharedTileReady || header->dataSize != size) {
+				qDebug() << QString("SharedTileCache.attachTile. Segment of %1 is not usable.").arg(sourceFileName);
+				return nullptr;
+			}
+			dataSize = size;
+			segment = memory.take();
+			return data;
+		}
+
+		if (memory->create(int(segmentSize))) {
+			SharedTileHeader* header = static_cast<SharedTileHeader*>(memory->data());
+			header->creator.store(pid, std::memory_order_release);
+			uchar* data = static_cast<uchar*>(memory->data()) + sizeof(SharedTileHeader);
+			return fillTile(segment, dataSize, memory, size, sourceFileName, fillVoids) ? data : nullptr;
+		}
+
+		if (memory->error() != QSharedMemory::AlreadyExists && memory->error() != QSharedMemory::NotFound) {
+			qDebug() << QString("SharedTileCache.attachTile. %1.").arg(memory->errorString());
+			return nullptr;
+		}
+	}
+	return nullptr;
+}
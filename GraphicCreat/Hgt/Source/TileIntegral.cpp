@@ -0,0 +1,24 @@
+#include "TileIntegral.h"
+
+TileIntegral::TileIntegral(const int sideSize) :
+	m_stride(sideSize + 1),
+	m_sum(m_stride*m_stride, 0),
+	m_sumSq(m_stride*m_stride, 0),
+	m_void(m_stride*m_stride, 0)
+{
+}
+
+void TileIntegral::accumulateColumns(qint64* sums, qint64* sumsSq, qint32* voidCounts, const int stride,
+									 const int colBegin, const int colEnd)
+{
+	//row by row, the inner loop over the block's columns is contiguous and vectorizes
+	for (int row = 2; row < stride; ++row) {
+		const qint64 above = qint64(row - 1)*stride;
+		const qint64 current = qint64(row)*stride;
+		for (int col = colBegin; col < colEnd; ++col) {
+			sums[current + col] += sums[above + col];
+			sumsSq[current + col] += sumsSq[above + col];
+			voidCounts[current + col] += voidCounts[above + col];
+		}
+	}
+}
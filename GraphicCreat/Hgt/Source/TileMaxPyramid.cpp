@@ -0,0 +1,60 @@
+#include "TileMaxPyramid.h"
+
+TileMaxPyramid::TileMaxPyramid(const int sideSize) :
+	m_sideSize(sideSize)
+{
+	int width = (sideSize + BLOCK_SIZE - 1)/BLOCK_SIZE;
+	m_widths.append(width);
+	while (width > 1) {
+		width = (width + 1)/2;
+		m_widths.append(width);
+	}
+	m_levels.resize(m_widths.size());
+	for (int level = 0; level < m_widths.size(); ++level) {
+		m_levels[level].fill(std::numeric_limits<qint16>::min(), m_widths.at(level)*m_widths.at(level));
+	}
+}
+
+void TileMaxPyramid::buildLevels()
+{
+	for (int level = 1; level < m_levels.size(); ++level) {
+		const QVector<qint16>& fine = m_levels.at(level - 1);
+		const int fineWidth = m_widths.at(level - 1);
+		const int width = m_widths.at(level);
+		qint16* coarse = m_levels[level].data();
+		for (int row = 0; row < fineWidth; ++row) {
+			for (int col = 0; col < fineWidth; ++col) {
+				qint16& value = coarse[(row/2)*width + col/2];
+				value = std::max(value, fine.at(row*fineWidth + col));
+			}
+		}
+	}
+}
+
+qint16 TileMaxPyramid::query(int col0, int row0, int col1, int row1) const
+{
+	col0 = std::max(0, col0);
+	row0 = std::max(0, row0);
+	col1 = std::min(m_sideSize - 1, col1);
+	row1 = std::min(m_sideSize - 1, row1);
+	if (col0 > col1 || row0 > row1) {
+		return std::numeric_limits<qint16>::min();
+	}
+
+	const int extent = std::max(col1 - col0, row1 - row0) + 1;
+	int level = 0;
+	while (level + 1 < m_levels.size() && 2*(BLOCK_SIZE << level) < extent) {
+		++level;
+	}
+
+	const int blockSize = BLOCK_SIZE << level;
+	const int width = m_widths.at(level);
+	const qint16* blocks = m_levels.at(level).constData();
+	qint16 retVal = std::numeric_limits<qint16>::min();
+	for (int row = row0/blockSize; row <= row1/blockSize; ++row) {
+		for (int col = col0/blockSize; col <= col1/blockSize; ++col) {
+			retVal = std::max(retVal, blocks[row*width + col]);
+		}
+	}
+	return retVal;
+}
@@ -0,0 +1,125 @@
+#include <QtEndian>
+#include <cstdio>
+#include <cstring>
+#include "ProfileWriter.h"
+
+const char MAGIC_PROFILE_WRITER[] = "HGTPROF1";
+
+template<typename T>
+static void appendLittleEndian(QByteArray& buffer, const T value)
+{
+	char bytes[sizeof(T)];
+	qToLittleEndian(value, bytes);
+	buffer.append(bytes, sizeof(T));
+}
+
+static void appendLittleEndian(QByteArray& buffer, const double value)
+{
+	quint64 bits;
+	memcpy(&bits, &value, sizeof(bits));
+	appendLittleEndian<quint64>(buffer, bits);
+}
+
+static void appendLittleEndian(QByteArray& buffer, const float value)
+{
+	quint32 bits;
+	memcpy(&bits, &value, sizeof(bits));
+	appendLittleEndian<quint32>(buffer, bits);
+}
+
+//ids may contain commas, quotes or line breaks
+static QByteArray csvField(const QString& text)
+{
+	QByteArray retVal = text.toUtf8();
+	retVal.replace('"', "\"\"");
+	return '"' + retVal + '"';
+}
+
+bool ProfileWriter::open(const QString& filePath, const Format format)
+{
+	m_format = format;
+	m_bytesWritten = 0;
+
+	bool opened = false;
+	if (filePath == "-") {
+		opened = m_file.open(stdout, QIODevice::WriteOnly);
+	} else {
+		m_file.setFileName(filePath);
+		opened = m_file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+	}
+	if (!opened) {
+		m_error = QString("Can't open %1").arg(filePath);
+		return false;
+	}
+
+	const QByteArray header = m_format == Format::Csv ? QByteArray("route_id,distance_m,lon,lat,elevation_m\n")
+													  : QByteArray(MAGIC_PROFILE_WRITER, int(sizeof(MAGIC_PROFILE_WRITER)) - 1);
+	if (m_file.write(header) != header.size()) {
+		m_error = QString("Can't write %1").arg(filePath);
+		return false;
+	}
+	m_bytesWritten += header.size();
+	return true;
+}
+
+bool ProfileWriter::write(const QVector<Route>& routes, const QVector<QVector<ProfilePoint>>& profiles)
+{
+	QByteArray buffer;
+	for (int i = 0; i < routes.size() && i < profiles.size(); ++i) {
+		if (m_format == Format::Csv) {
+			appendCsv(buffer, routes.at(i), profiles.at(i));
+		} else {
+			appendBinary(buffer, routes.at(i), profiles.at(i));
+		}
+	}
+
+	if (m_file.write(buffer) != buffer.size()) {
+		m_error = QString("Can't write %1").arg(m_file.fileName());
+		return false;
+	}
+	m_bytesWritten += buffer.size();
+	return true;
+}
+
+bool ProfileWriter::close()
+{
+	const bool retVal = m_file.flush();
+	m_file.close();
+	return retVal;
+}
+
+void ProfileWriter::appendCsv(QByteArray& buffer, const Route& route, const QVector<ProfilePoint>& profile) const
+{
+	const QByteArray id = csvField(route.id);
+	//~ 48 bytes per sample
+	buffer.reserve(buffer.size() + profile.size()*(id.size() + 48));
+	for (const ProfilePoint& point : profile) {
+		buffer += id;
+		buffer += ',';
+		buffer += QByteArray::number(point.distance, 'f', 2);
+		buffer += ',';
+		buffer += QByteArray::number(point.lon, 'f', 7);
+		buffer += ',';
+		buffer += QByteArray::number(point.lat, 'f', 7);
+		buffer += ',';
+		if (point.elevation == point.elevation) {
+			buffer += QByteArray::number(qRound(point.elevation));
+		}
+		buffer += '\n';
+	}
+}
+
+void ProfileWriter::appendBinary(QByteArray& buffer, const Route& route, const QVector<ProfilePoint>& profile) const
+{
+	const QByteArray id = route.id.toUtf8();
+	buffer.reserve(buffer.size() + 8 + id.size() + profile.size()*28);
+	appendLittleEndian<quint32>(buffer, quint32(id.size()));
+	buffer += id;
+	appendLittleEndian<quint32>(buffer, quint32(profile.size()));
+	for (const ProfilePoint& point : profile) {
+		appendLittleEndian(buffer, point.distance);
+		appendLittleEndian(buffer, point.lon);
+		appendLittleEndian(buffer, point.lat);
+		appendLittleEndian(buffer, point.elevation);
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <QFile>
+#include <QString>
+#include <QVector>
+#include <atomic>
+#include "RouteReader.h"
+#include "RouteProfile.h"
+
+/**
+ * @brief writes profiles as they come.
+ * CSV: "route_id,distance_m,lon,lat,elevation_m", route ids are quoted with "" for quotes inside,
+ * elevations are rounded to metres and empty for voids and missing tiles.
+ * Binary, little-endian: "HGTPROF1", then per route
+ * quint32 id length, id in UTF-8, quint32 sample count, samples of
+ * float64 distance, float64 lon, float64 lat, float32 elevation (NaN for voids).
+ */
+class ProfileWriter
+{
+public:
+	enum class Format {
+		Csv,
+		Binary
+	};
+
+	//"-" writes to stdout
+	bool open(const QString& filePath, const Format format);
+	bool write(const QVector<Route>& routes, const QVector<QVector<ProfilePoint>>& profiles);
+	bool close();
+
+	//may be called while another thread writes
+	qint64 bytesWritten() const {return m_bytesWritten.load();}
+	QString errorString() const {return m_error;}
+
+private:
+	void appendCsv(QByteArray& buffer, const Route& route, const QVector<ProfilePoint>& profile) const;
+	void appendBinary(QByteArray& buffer, const Route& route, const QVector<ProfilePoint>& profile) const;
+
+private:
+	Format m_format = Format::Csv;
+	QFile m_file;
+	std::atomic<qint64> m_bytesWritten {0};
+	QString m_error;
+};
@@ -0,0 +1,176 @@
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonParseError>
+#include "RouteReader.h"
+
+RouteReader::Format RouteReader::formatOf(const QString& filePath)
+{
+	const QString suffix = QFileInfo(filePath).suffix().toLower();
+	if (suffix == "csv" || suffix == "txt") {
+		return Format::Csv;
+	}
+	if (suffix == "geojson" || suffix == "json") {
+		return Format::GeoJson;
+	}
+	return Format::Unknown;
+}
+
+bool RouteReader::open(const QString& filePath, Format format)
+{
+	m_format = format == Format::Unknown ? formatOf(filePath) : format;
+	if (m_format == Format::Unknown) {
+		m_error = QString("Unknown route format of %1, use .csv or .geojson").arg(filePath);
+		return false;
+	}
+
+	m_file.setFileName(filePath);
+	if (!m_file.open(QIODevice::ReadOnly)) {
+		m_error = QString("Can't open %1").arg(filePath);
+		return false;
+	}
+
+	if (m_format == Format::GeoJson) {
+		const bool retVal = parseGeoJson(m_file.readAll());
+		m_file.close();
+		return retVal;
+	}
+	return true;
+}
+
+bool RouteReader::read(QVector<Route>& routes, const int count)
+{
+	if (m_format == Format::Csv) {
+		return readCsv(routes, count);
+	}
+	if (m_format == Format::GeoJson) {
+		return readGeoJson(routes, count);
+	}
+	return false;
+}
+
+bool RouteReader::readCsv(QVector<Route>& routes, const int count)
+{
+	const int first = routes.size();
+	while (routes.size() - first < count) {
+		if (m_file.atEnd()) {
+			if (!m_pending.points.isEmpty()) {
+				routes.append(m_pending);
+				m_pending = Route();
+			}
+			break;
+		}
+
+		const QByteArray line = m_file.readLine().trimmed();
+		++m_lineNumber;
+		if (line.isEmpty() || line.startsWith('#')) {
+			continue;
+		}
+
+		const QList<QByteArray> fields = line.split(',');
+		bool lonOk = false;
+		bool latOk = false;
+		const double lon = fields.size() >= 3 ? fields.at(1).trimmed().toDouble(&lonOk) : 0.0;
+		const double lat = fields.size() >= 3 ? fields.at(2).trimmed().toDouble(&latOk) : 0.0;
+		if (!lonOk || !latOk) {
+			//header or broken line
+			if (m_lineNumber > 1) {
+				++m_skippedLines;
+			}
+			continue;
+		}
+
+		const QString id = QString::fromUtf8(fields.at(0).trimmed());
+		if (id != m_pending.id && !m_pending.points.isEmpty()) {
+			routes.append(m_pending);
+			m_pending.points.clear();
+		}
+		m_pending.id = id;
+		m_pending.points.append(QPointF(lon, lat));
+	}
+	return routes.size() > first;
+}
+
+bool RouteReader::readGeoJson(QVector<Route>& routes, const int count)
+{
+	const int first = routes.size();
+	while (routes.size() - first < count && m_geoJsonNext < m_geoJsonRoutes.size()) {
+		routes.append(m_geoJsonRoutes.at(m_geoJsonNext));
+		//the parsed copy is not needed any more
+		m_geoJsonRoutes[m_geoJsonNext++] = Route();
+	}
+	return routes.size() > first;
+}
+
+//GeoJSON ids are strings or numbers
+static QString jsonId(const QJsonValue& value)
+{
+	if (value.isDouble()) {
+		return QString::number(value.toDouble(), 'g', 17);
+	}
+	return value.toString();
+}
+
+static QVector<QPointF> lineString(const QJsonArray& coordinates)
+{
+	QVector<QPointF> retVal;
+	retVal.reserve(coordinates.size());
+	for (const QJsonValue& coordinate : coordinates) {
+		const QJsonArray position = coordinate.toArray();
+		if (position.size() >= 2) {
+			retVal.append(QPointF(position.at(0).toDouble(), position.at(1).toDouble()));
+		}
+	}
+	return retVal;
+}
+
+bool RouteReader::parseGeoJson(const QByteArray& data)
+{
+	QJsonParseError error;
+	const QJsonDocument document = QJsonDocument::fromJson(data, &error);
+	if (error.error != QJsonParseError::NoError) {
+		m_error = QString("GeoJSON error at offset %1: %2").arg(error.offset).arg(error.errorString());
+		return false;
+	}
+
+	const QJsonObject root = document.object();
+	QJsonArray features;
+	if (root.value("type").toString() == "FeatureCollection") {
+		features = root.value("features").toArray();
+	} else if (root.value("type").toString() == "Feature") {
+		features.append(root);
+	} else {
+		m_error = "GeoJSON has to be a FeatureCollection or a Feature";
+		return false;
+	}
+
+	for (int i = 0; i < features.size(); ++i) {
+		const QJsonObject feature = features.at(i).toObject();
+		const QJsonObject properties = feature.value("properties").toObject();
+		QString id = jsonId(feature.value("id"));
+		if (id.isEmpty()) {
+			id = jsonId(properties.value("id"));
+		}
+		if (id.isEmpty()) {
+			id = properties.value("name").toString();
+		}
+		if (id.isEmpty()) {
+			id = QString::number(i);
+		}
+
+		const QJsonObject geometry = feature.value("geometry").toObject();
+		const QString type = geometry.value("type").toString();
+		const QJsonArray coordinates = geometry.value("coordinates").toArray();
+		if (type == "LineString") {
+			m_geoJsonRoutes.append(Route{id, lineString(coordinates)});
+		} else if (type == "MultiLineString") {
+			for (int part = 0; part < coordinates.size(); ++part) {
+				m_geoJsonRoutes.append(Route{QString("%1/%2").arg(id).arg(part), lineString(coordinates.at(part).toArray())});
+			}
+		} else {
+			++m_skippedLines;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+#include <QPointF>
+#include <QFile>
+
+struct Route {
+	QString id;
+	//x - lon, y - lat
+	QVector<QPointF> points;
+};
+
+/**
+ * @brief reads routes in chunks.
+ * CSV: one waypoint per line "route_id,lon,lat", consecutive lines with the same id form a route,
+ * a header line is skipped. The file is streamed.
+ * GeoJSON: LineString and MultiLineString features of a FeatureCollection (or a single Feature),
+ * the id is the feature's "id", properties "id" or "name", else its index. The document is parsed on open().
+ */
+class RouteReader
+{
+public:
+	enum class Format {
+		Unknown,
+		Csv,
+		GeoJson
+	};
+
+	//by the file extension
+	static Format formatOf(const QString& filePath);
+
+	bool open(const QString& filePath, Format format = Format::Unknown);
+
+	/**
+	 * @brief appends up to count routes
+	 * @return false if no route was read, at the end of the input or on error (see errorString())
+	 */
+	bool read(QVector<Route>& routes, const int count);
+
+	QString errorString() const {return m_error;}
+	qint64 skippedLines() const {return m_skippedLines;}
+
+private:
+	bool readCsv(QVector<Route>& routes, const int count);
+	bool readGeoJson(QVector<Route>& routes, const int count);
+	bool parseGeoJson(const QByteArray& data);
+
+private:
+	Format m_format = Format::Unknown;
+	QFile m_file;
+	QString m_error;
+	qint64 m_lineNumber = 0;
+	qint64 m_skippedLines = 0;
+	//route being collected from the CSV lines
+	Route m_pending;
+
+	QVector<Route> m_geoJsonRoutes;
+	int m_geoJsonNext = 0;
+};
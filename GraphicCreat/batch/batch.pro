@@ -0,0 +1,20 @@
+# headless elevation profiles of many routes, no GUI:
+#   hgt_batch --data=<dir with .hgt tiles> --input=routes.csv --output=profiles.csv [--format=binary]
+
+QT = core concurrent
+
+CONFIG += console c++17
+CONFIG -= app_bundle
+
+TARGET = hgt_batch
+
+include(../Hgt/Hgt.pri)
+
+HEADERS += \
+    RouteReader.h \
+    ProfileWriter.h
+
+SOURCES += \
+    RouteReader.cpp \
+    ProfileWriter.cpp \
+    main.cpp
@@ -0,0 +1,178 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QTextStream>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include "GeoidGrid.h"
+#include "HgtLoader.h"
+#include "RouteProfile.h"
+#include "RouteReader.h"
+#include "ProfileWriter.h"
+
+const int DEFAULT_CHUNK_BATCH = 10000;
+//seconds between progress lines
+const double PROGRESS_INTERVAL_BATCH = 5.0;
+
+struct BatchCounters {
+	qint64 routes = 0;
+	qint64 samples = 0;
+	qint64 voidSamples = 0;
+};
+
+static void report(QTextStream& log, const BatchCounters& counters, const qint64 bytes, const double seconds, const bool final)
+{
+	log << (final ? "done: " : "progress: ")
+		<< counters.routes << " routes, " << counters.samples << " samples (" << counters.voidSamples << " void), "
+		<< QString::number(bytes/1048576.0, 'f', 1) << " MiB in " << QString::number(seconds, 'f', 1) << " s, "
+		<< QString::number(counters.routes/std::max(seconds, 1e-9), 'f', 0) << " routes/s, "
+		<< QString::number(counters.samples/std::max(seconds, 1e-9), 'f', 0) << " samples/s\n";
+	log.flush();
+}
+
+int main(int argc, char* argv[])
+{
+	QCoreApplication app(argc, argv);
+	QCoreApplication::setApplicationName("hgt_batch");
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Elevation profiles of routes from CSV (route_id,lon,lat) or GeoJSON LineStrings.");
+	parser.addHelpOption();
+	QCommandLineOption inputOption(QStringList() << "i" << "input", "Routes, .csv or .geojson.", "file");
+	QCommandLineOption outputOption(QStringList() << "o" << "output", "Profiles, - for stdout.", "file", "-");
+	QCommandLineOption formatOption("format", "Output format: csv or binary.", "format", "csv");
+	QCommandLineOption dataOption("data", "Directory of the .hgt tiles.", "dir");
+	QCommandLineOption samplesOption("samples", "Samples per segment including both ends.", "count", "101");
+	QCommandLineOption threadsOption("threads", "Worker threads, 0 - all cores.", "count", "0");
+	QCommandLineOption chunkOption("chunk", "Routes per batch.", "count", QString::number(DEFAULT_CHUNK_BATCH));
+	QCommandLineOption tilesOption("tiles", "Tiles kept mapped by the loader.", "count", "64");
+	QCommandLineOption sharedOption("shared-memory", "Share the decoded tiles with the other processes on this host.");
+	QCommandLineOption geoidOption("geoid", "Geoid grid (EGM96 WW15MGH.GRD), elevations are written as WGS84 ellipsoidal heights.", "file");
+	parser.addOption(inputOption);
+	parser.addOption(outputOption);
+	parser.addOption(formatOption);
+	parser.addOption(dataOption);
+	parser.addOption(samplesOption);
+	parser.addOption(threadsOption);
+	parser.addOption(chunkOption);
+	parser.addOption(tilesOption);
+	parser.addOption(sharedOption);
+	parser.addOption(geoidOption);
+	parser.process(app);
+
+	QTextStream log(stderr);
+	if (!parser.isSet(inputOption) || !parser.isSet(dataOption)) {
+		log << "--input and --data are required\n" << parser.helpText();
+		return 2;
+	}
+	if (!QDir(parser.value(dataOption)).exists()) {
+		log << "Data directory " << parser.value(dataOption) << " not found\n";
+		return 2;
+	}
+	const QString format = parser.value(formatOption).toLower();
+	if (format != "csv" && format != "binary") {
+		log << "Unknown --format " << format << "\n";
+		return 2;
+	}
+
+	const int threads = parser.value(threadsOption).toInt();
+	if (threads > 0) {
+		QThreadPool::globalInstance()->setMaxThreadCount(threads);
+	}
+	const int chunk = std::max(1, parser.value(chunkOption).toInt());
+
+	HgtLoader loader;
+	loader.setCacheDirectory(parser.value(dataOption));
+	loader.setMaxTilesInRam(std::max(1, parser.value(tilesOption).toInt()));
+	if (parser.isSet(sharedOption)) {
+		loader.setSharedMemoryCache(true);
+	}
+
+	Geo::GeoidGrid geoid;
+	if (parser.isSet(geoidOption) && !geoid.load(parser.value(geoidOption))) {
+		log << "Can't load the geoid grid " << parser.value(geoidOption) << "\n";
+		return 1;
+	}
+
+	RouteProfile profile(&loader);
+	profile.setSamplesPerSegment(parser.value(samplesOption).toInt());
+	if (geoid.isValid()) {
+		profile.setGeoid(&geoid);
+	}
+
+	RouteReader reader;
+	if (!reader.open(parser.value(inputOption))) {
+		log << reader.errorString() << "\n";
+		return 1;
+	}
+	ProfileWriter writer;
+	if (!writer.open(parser.value(outputOption), format == "csv" ? ProfileWriter::Format::Csv : ProfileWriter::Format::Binary)) {
+		log << writer.errorString() << "\n";
+		return 1;
+	}
+
+	//writing overlaps with reading and computing the next chunk
+	QThreadPool writerPool;
+	writerPool.setMaxThreadCount(1);
+	QFuture<bool> pendingWrite;
+	bool writing = false;
+
+	BatchCounters counters;
+	QElapsedTimer timer;
+	timer.start();
+	double lastProgress = 0.0;
+
+	QVector<Route> routes;
+	QVector<QVector<QPointF>> points;
+	while (true) {
+		routes.clear();
+		if (!reader.read(routes, chunk)) {
+			break;
+		}
+		points.resize(routes.size());
+		for (int i = 0; i < routes.size(); ++i) {
+			points[i] = routes.at(i).points;
+		}
+		const QVector<QVector<ProfilePoint>> profiles = profile.compute(points);
+
+		counters.routes += routes.size();
+		for (const QVector<ProfilePoint>& route : profiles) {
+			counters.samples += route.size();
+			for (const ProfilePoint& point : route) {
+				counters.voidSamples += point.elevation != point.elevation;
+			}
+		}
+
+		if (writing && !pendingWrite.result()) {
+			log << writer.errorString() << "\n";
+			return 1;
+		}
+
+		const double seconds = timer.nsecsElapsed()*1e-9;
+		if (seconds - lastProgress >= PROGRESS_INTERVAL_BATCH) {
+			report(log, counters, writer.bytesWritten(), seconds, false);
+			lastProgress = seconds;
+		}
+
+		pendingWrite = QtConcurrent::run(&writerPool, [&writer, routes, profiles]() {
+			return writer.write(routes, profiles);
+		});
+		writing = true;
+	}
+
+	if (!reader.errorString().isEmpty()) {
+		log << reader.errorString() << "\n";
+		return 1;
+	}
+	if ((writing && !pendingWrite.result()) || !writer.close()) {
+		log << writer.errorString() << "\n";
+		return 1;
+	}
+	if (reader.skippedLines() > 0) {
+		log << "skipped " << reader.skippedLines() << " unreadable lines or features\n";
+	}
+	report(log, counters, writer.bytesWritten(), timer.nsecsElapsed()*1e-9, true);
+	return 0;
+}
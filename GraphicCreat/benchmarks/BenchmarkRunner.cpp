@@ -0,0 +1,305 @@
+#include <QDateTime>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRegularExpression>
+#include <QSysInfo>
+#include <QTextStream>
+#include <QThread>
+#include <QCoreApplication>
+#include <algorithm>
+#include <cmath>
+#include "BenchmarkRunner.h"
+
+const double DEFAULT_MIN_TIME_BENCHMARK = 0.5;
+const qint64 MAX_ITERATIONS_BENCHMARK = 1000000000;
+
+BenchmarkState::BenchmarkState(const qint64 iterations, const QVector<qint64>& args) :
+	m_iterations(iterations),
+	m_args(args)
+{
+}
+
+bool BenchmarkState::keepRunning()
+{
+	if (!m_started) {
+		m_started = true;
+		m_remaining = m_iterations;
+		resumeTiming();
+	}
+	if (m_error.isEmpty() && m_remaining > 0) {
+		--m_remaining;
+		return true;
+	}
+	pauseTiming();
+	return false;
+}
+
+void BenchmarkState::pauseTiming()
+{
+	if (!m_running) {
+		return;
+	}
+	m_realNs += m_timer.nsecsElapsed();
+	m_cpuNs += double(clock() - m_cpuStart)*1e9/CLOCKS_PER_SEC;
+	m_running = false;
+}
+
+void BenchmarkState::resumeTiming()
+{
+	if (m_running) {
+		return;
+	}
+	m_running = true;
+	m_cpuStart = clock();
+	m_timer.start();
+}
+
+void BenchmarkState::skipWithError(const QString& message)
+{
+	m_error = message;
+	m_remaining = 0;
+}
+
+void BenchmarkRunner::add(const QString& name, const Function& function, const QList<qint64>& args)
+{
+	if (args.isEmpty()) {
+		m_entries.append(Entry{name, function, QVector<qint64>()});
+		return;
+	}
+	for (qint64 arg : args) {
+		m_entries.append(Entry{QString("%1/%2").arg(name).arg(arg), function, QVector<qint64>() << arg});
+	}
+}
+
+void BenchmarkRunner::setContext(const QString& key, const QString& value)
+{
+	m_context.append(qMakePair(key, value));
+}
+
+BenchmarkRunner::Result BenchmarkRunner::runEntry(const Entry& entry, const double minTime)
+{
+	Result retVal;
+	retVal.name = entry.name;
+	retVal.runName = entry.name;
+
+	//grows the iteration count until one batch takes minTime, at most 10x per step
+	qint64 iterations = 1;
+	while (true) {
+		BenchmarkState state(iterations, entry.args);
+		entry.function(state);
+
+		const double seconds = state.m_realNs*1e-9;
+		const bool done = !state.m_error.isEmpty() || seconds >= minTime || iterations >= MAX_ITERATIONS_BENCHMARK;
+		if (done) {
+			retVal.iterations = iterations;
+			retVal.realNs = double(state.m_realNs)/iterations;
+			retVal.cpuNs = state.m_cpuNs/iterations;
+			if (seconds > 0.0) {
+				retVal.itemsPerSecond = state.m_itemsProcessed/seconds;
+				retVal.bytesPerSecond = state.m_bytesProcessed/seconds;
+			}
+			retVal.label = state.m_label;
+			retVal.error = state.m_error;
+			return retVal;
+		}
+
+		const double multiplier = std::min(10.0, std::max(1.0, minTime*1.4/std::max(seconds, 1e-9)));
+		iterations = std::min(MAX_ITERATIONS_BENCHMARK, std::max(iterations + 1, qint64(iterations*multiplier)));
+	}
+}
+
+int BenchmarkRunner::run(const QStringList& arguments)
+{
+	QString filter = ".";
+	QString outPath;
+	QString format = "console";
+	double minTime = DEFAULT_MIN_TIME_BENCHMARK;
+	int repetitions = 1;
+	bool listOnly = false;
+
+	for (const QString& argument : arguments) {
+		const QString value = argument.section('=', 1);
+		if (argument.startsWith("--benchmark_filter=")) {
+			filter = value;
+		} else if (argument.startsWith("--benchmark_min_time=")) {
+			//Google Benchmark accepts "0.5" and "0.5s"
+			minTime = QString(value).remove('s').toDouble();
+		} else if (argument.startsWith("--benchmark_repetitions=")) {
+			repetitions = std::max(1, value.toInt());
+		} else if (argument.startsWith("--benchmark_out=")) {
+			outPath = value;
+		} else if (argument.startsWith("--benchmark_format=")) {
+			format = value;
+		} else if (argument == "--benchmark_list_tests" || argument == "--benchmark_list_tests=true") {
+			listOnly = true;
+		}
+	}
+
+	const QRegularExpression expression(filter);
+	if (!expression.isValid()) {
+		QTextStream(stderr) << "Invalid --benchmark_filter " << filter << "\n";
+		return 1;
+	}
+
+	QTextStream console(stdout);
+	QList<Result> results;
+	bool failed = false;
+
+	if (format != "json" && !listOnly) {
+		console << QString("%1 %2 %3 %4\n").arg("Benchmark", -48).arg("Time", 16).arg("CPU", 16).arg("Iterations", 12);
+		console << QString(96, '-') << "\n";
+	}
+
+	for (const Entry& entry : m_entries) {
+		if (!expression.match(entry.name).hasMatch()) {
+			continue;
+		}
+		if (listOnly) {
+			console << entry.name << "\n";
+			continue;
+		}
+
+		QList<Result> runs;
+		for (int repetition = 0; repetition < repetitions; ++repetition) {
+			Result result = runEntry(entry, minTime);
+			result.repetition = repetition;
+			runs.append(result);
+			results.append(result);
+			failed |= !result.error.isEmpty();
+
+			if (format == "json") {
+				continue;
+			}
+			if (!result.error.isEmpty()) {
+				console << QString("%1 ERROR OCCURRED: '%2'\n").arg(result.name, -48).arg(result.error);
+			} else {
+				console << QString("%1 %2 ns %3 ns %4")
+						   .arg(result.name, -48).arg(result.realNs, 13, 'f', 0).arg(result.cpuNs, 13, 'f', 0).arg(result.iterations, 12);
+				if (result.itemsPerSecond > 0.0) {
+					console << QString(" items_per_second=%1").arg(result.itemsPerSecond, 0, 'g', 4);
+				}
+				if (!result.label.isEmpty()) {
+					console << " " << result.label;
+				}
+				console << "\n";
+			}
+			console.flush();
+		}
+
+		if (repetitions > 1 && runs.first().error.isEmpty()) {
+			//aggregates like Google Benchmark: name_mean, name_median, name_stddev
+			QVector<double> real;
+			QVector<double> cpu;
+			for (const Result& run : runs) {
+				real.append(run.realNs);
+				cpu.append(run.cpuNs);
+			}
+			auto mean = [](const QVector<double>& values) {
+				double sum = 0.0;
+				for (double value : values) sum += value;
+				return sum/values.size();
+			};
+			auto median = [](QVector<double> values) {
+				std::sort(values.begin(), values.end());
+				const int half = values.size()/2;
+				return values.size() % 2 ? values.at(half) : 0.5*(values.at(half - 1) + values.at(half));
+			};
+			auto stddev = [mean](const QVector<double>& values) {
+				const double average = mean(values);
+				double sum = 0.0;
+				for (double value : values) sum += (value - average)*(value - average);
+				return values.size() > 1 ? sqrt(sum/(values.size() - 1)) : 0.0;
+			};
+			const QString names[3] = {"mean", "median", "stddev"};
+			const double reals[3] = {mean(real), median(real), stddev(real)};
+			const double cpus[3] = {mean(cpu), median(cpu), stddev(cpu)};
+			for (int i = 0; i < 3; ++i) {
+				Result aggregate;
+				aggregate.name = entry.name + "_" + names[i];
+				aggregate.runName = entry.name;
+				aggregate.repetition = -1;
+				aggregate.iterations = repetitions;
+				aggregate.realNs = reals[i];
+				aggregate.cpuNs = cpus[i];
+				aggregate.label = names[i];
+				results.append(aggregate);
+			}
+		}
+	}
+
+	if (listOnly) {
+		return 0;
+	}
+
+	const QByteArray json = toJson(results);
+	if (format == "json") {
+		console.flush();
+		QFile out;
+		out.open(stdout, QIODevice::WriteOnly);
+		out.write(json);
+	}
+	if (!outPath.isEmpty()) {
+		QFile file(outPath);
+		if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size()) {
+			QTextStream(stderr) << "Can't write " << outPath << "\n";
+			return 1;
+		}
+	}
+	return failed ? 1 : 0;
+}
+
+QByteArray BenchmarkRunner::toJson(const QList<Result>& results) const
+{
+	QJsonObject context;
+	context["date"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+	context["host_name"] = QSysInfo::machineHostName();
+	context["executable"] = QCoreApplication::applicationFilePath();
+	context["num_cpus"] = QThread::idealThreadCount();
+	context["qt_version"] = QString(qVersion());
+#ifdef QT_NO_DEBUG
+	context["library_build_type"] = QString("release");
+#else
+	context["library_build_type"] = QString("debug");
+#endif
+	for (const auto& item : m_context) {
+		context[item.first] = item.second;
+	}
+
+	QJsonArray benchmarks;
+	for (const Result& result : results) {
+		QJsonObject object;
+		object["name"] = result.name;
+		object["run_name"] = result.runName;
+		object["run_type"] = result.repetition < 0 ? QString("aggregate") : QString("iteration");
+		if (result.repetition < 0) {
+			object["aggregate_name"] = result.label;
+		} else {
+			object["repetition_index"] = result.repetition;
+		}
+		object["iterations"] = double(result.iterations);
+		object["real_time"] = result.realNs;
+		object["cpu_time"] = result.cpuNs;
+		object["time_unit"] = QString("ns");
+		if (result.itemsPerSecond > 0.0) {
+			object["items_per_second"] = result.itemsPerSecond;
+		}
+		if (result.bytesPerSecond > 0.0) {
+			object["bytes_per_second"] = result.bytesPerSecond;
+		}
+		if (!result.label.isEmpty() && result.repetition >= 0) {
+			object["label"] = result.label;
+		}
+		if (!result.error.isEmpty()) {
+			object["error_occurred"] = true;
+			object["error_message"] = result.error;
+		}
+		benchmarks.append(object);
+	}
+
+	QJsonObject root;
+	root["context"] = context;
+	root["benchmarks"] = benchmarks;
+	return QJsonDocument(root).toJson(QJsonDocument::Indented);
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <QString>
+#include <QList>
+#include <QVector>
+#include <QElapsedTimer>
+#include <functional>
+#include <ctime>
+
+/**
+ * @brief state of one benchmark run, the body loops with while (state.keepRunning()) {...}
+ * like Google Benchmark's for (auto _ : state). Only the time inside the loop is measured.
+ */
+class BenchmarkState
+{
+public:
+	BenchmarkState(const qint64 iterations, const QVector<qint64>& args);
+
+	bool keepRunning();
+
+	//excludes setup inside the loop from the measurement
+	void pauseTiming();
+	void resumeTiming();
+
+	qint64 range(const int index = 0) const {return m_args.value(index);}
+	qint64 iterations() const {return m_iterations;}
+
+	void setItemsProcessed(const qint64 items) {m_itemsProcessed = items;}
+	void setBytesProcessed(const qint64 bytes) {m_bytesProcessed = bytes;}
+	void setLabel(const QString& label) {m_label = label;}
+	//the benchmark is reported with the error and not repeated
+	void skipWithError(const QString& message);
+
+private:
+	friend class BenchmarkRunner;
+
+	qint64 m_iterations = 0;
+	qint64 m_remaining = 0;
+	QVector<qint64> m_args;
+	bool m_started = false;
+	bool m_running = false;
+
+	QElapsedTimer m_timer;
+	clock_t m_cpuStart = 0;
+	qint64 m_realNs = 0;
+	double m_cpuNs = 0.0;
+
+	qint64 m_itemsProcessed = 0;
+	qint64 m_bytesProcessed = 0;
+	QString m_label;
+	QString m_error;
+};
+
+/**
+ * @brief minimal runner with Google Benchmark's command line and JSON output, so results can be compared
+ * with its tools (compare.py). Supported flags: --benchmark_filter=<regex>, --benchmark_min_time=<seconds>,
+ * --benchmark_repetitions=<n>, --benchmark_out=<file>, --benchmark_format=<console|json>, --benchmark_list_tests.
+ */
+class BenchmarkRunner
+{
+public:
+	typedef std::function<void(BenchmarkState&)> Function;
+
+	/**
+	 * @brief registers name, or name/arg for every arg
+	 */
+	void add(const QString& name, const Function& function, const QList<qint64>& args = QList<qint64>());
+
+	//context entries of the JSON output, e.g. the data directory
+	void setContext(const QString& key, const QString& value);
+
+	int run(const QStringList& arguments);
+
+private:
+	struct Entry {
+		QString name;
+		Function function;
+		QVector<qint64> args;
+	};
+
+	struct Result {
+		QString name;
+		QString runName;
+		int repetition = 0;
+		qint64 iterations = 0;
+		double realNs = 0.0;
+		double cpuNs = 0.0;
+		double itemsPerSecond = 0.0;
+		double bytesPerSecond = 0.0;
+		QString label;
+		QString error;
+	};
+
+	Result runEntry(const Entry& entry, const double minTime);
+	QByteArray toJson(const QList<Result>& results) const;
+
+private:
+	QList<Entry> m_entries;
+	QList<QPair<QString, QString>> m_context;
+};
@@ -0,0 +1,20 @@
+# microbenchmarks of HgtLoader and the profile path, Google Benchmark compatible JSON:
+#   hgt_benchmarks --benchmark_out=result.json [--benchmark_filter=<regex>] [--data=<dir with K38 tiles>]
+
+QT = core gui concurrent
+
+CONFIG += console c++17
+CONFIG -= app_bundle
+
+TARGET = hgt_benchmarks
+
+DEFINES += K38_DIR=\\\"$$PWD/../K38\\\"
+
+include(../Hgt/Hgt.pri)
+
+HEADERS += \
+    BenchmarkRunner.h
+
+SOURCES += \
+    BenchmarkRunner.cpp \
+    main.cpp
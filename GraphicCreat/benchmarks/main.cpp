@@ -0,0 +1,227 @@
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QPointF>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QVector>
+#include <cmath>
+#include <random>
+#include "BenchmarkRunner.h"
+#include "HgtLoader.h"
+#include "HgtSheet.h"
+#include "RouteProfile.h"
+
+#ifndef K38_DIR
+#define K38_DIR "K38"
+#endif
+
+//SRTM3 tiles checked in under K38
+const int GRID_SIZE_BENCHMARK = 1201;
+const QString FIRST_TILE_BENCHMARK = "N40E042.hgt";
+const QPoint FIRST_CORNER_BENCHMARK(42, 40);
+
+//results are stored here, so the compiler can't drop the measured work
+volatile qint64 sinkBenchmark = 0;
+
+//deterministic waypoints inside [minLon,maxLon]x[minLat,maxLat]
+static QVector<ProfileWaypoint> makeRoute(const int count, const double minLon, const double maxLon, const double minLat, const double maxLat)
+{
+	std::mt19937 random(count);
+	std::uniform_real_distribution<double> lon(minLon, maxLon);
+	std::uniform_real_distribution<double> lat(minLat, maxLat);
+	QVector<ProfileWaypoint> route;
+	for (int i = 0; i < count; ++i) {
+		ProfileWaypoint waypoint;
+		waypoint.lon = lon(random);
+		waypoint.lat = lat(random);
+		route.append(waypoint);
+	}
+	return route;
+}
+
+/**
+ * @brief empty .hgt files for the tiles of the rectangle in the sheet sub-directories of getHgtHalfPathFileName,
+ * doesExistHgtByRect only checks that the files exist
+ */
+static bool makeSheetLayout(HgtLoader& loader, const double minLon, const double maxLon, const double minLat, const double maxLat)
+{
+	for (int lon = floor(minLon); lon <= floor(maxLon); ++lon) {
+		for (int lat = floor(minLat); lat <= floor(maxLat); ++lat) {
+			const QString filePath = loader.getHgtFilePathAndNameFromCoordinates(QPointF(lon + 0.5, lat + 0.5));
+			if (!QDir().mkpath(QFileInfo(filePath).absolutePath())) {
+				return false;
+			}
+			QFile file(filePath);
+			if (!file.open(QIODevice::WriteOnly)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+static void registerBenchmarks(BenchmarkRunner& runner, const QString& dataDir)
+{
+	const QString firstTile = QDir(dataDir).filePath(FIRST_TILE_BENCHMARK);
+
+	runner.add("BM_MainWindowReadHGT", [firstTile](BenchmarkState& state) {
+		HgtSheet sheet;
+		while (state.keepRunning()) {
+			if (!sheet.read(firstTile, GRID_SIZE_BENCHMARK, FIRST_CORNER_BENCHMARK)) {
+				state.skipWithError("Can't open " + firstTile);
+				return;
+			}
+		}
+		state.setBytesProcessed(state.iterations()*GRID_SIZE_BENCHMARK*GRID_SIZE_BENCHMARK*qint64(sizeof(qint16)));
+	});
+
+	runner.add("BM_LoaderTileCold", [dataDir](BenchmarkState& state) {
+		while (state.keepRunning()) {
+			state.pauseTiming();
+			HgtLoader* loader = new HgtLoader();
+			loader->setCacheDirectory(dataDir);
+			state.resumeTiming();
+			TileHandle tile;
+			if (!loader->getTileHandle(tile, 42.5, 40.5)) {
+				state.skipWithError("No tile N40E042 in " + dataDir);
+			}
+			state.pauseTiming();
+			tile.reset();
+			delete loader;
+			state.resumeTiming();
+		}
+	});
+
+	runner.add("BM_GetElevationCold", [dataDir](BenchmarkState& state) {
+		while (state.keepRunning()) {
+			state.pauseTiming();
+			HgtLoader* loader = new HgtLoader();
+			loader->setCacheDirectory(dataDir);
+			state.resumeTiming();
+			qint16 elevation = 0;
+			if (!loader->getElevation(elevation, 42.5, 40.5)) {
+				state.skipWithError("No tile N40E042 in " + dataDir);
+			}
+			state.pauseTiming();
+			delete loader;
+			state.resumeTiming();
+		}
+	});
+
+	runner.add("BM_GetElevationHot", [dataDir](BenchmarkState& state) {
+		HgtLoader loader;
+		loader.setCacheDirectory(dataDir);
+		//six tiles, all of them stay in the loader's cache
+		const QVector<ProfileWaypoint> points = makeRoute(4096, 42.0, 44.999, 40.0, 41.999);
+		qint16 elevation = 0;
+		for (const ProfileWaypoint& point : points) {
+			if (!loader.getElevation(elevation, point.lon, point.lat)) {
+				state.skipWithError("Tiles N40..N41 E042..E044 missing in " + dataDir);
+				return;
+			}
+		}
+
+		qint64 sum = 0;
+		int i = 0;
+		while (state.keepRunning()) {
+			const ProfileWaypoint& point = points.at(i);
+			loader.getElevation(elevation, point.lon, point.lat);
+			sum += elevation;
+			i = (i + 1) & 4095;
+		}
+		state.setItemsProcessed(state.iterations());
+		sinkBenchmark = sum;
+	});
+
+	runner.add("BM_GetHgtTilesByRect", [dataDir](BenchmarkState& state) {
+		HgtLoader loader;
+		loader.setCacheDirectory(dataDir);
+		const double span = state.range(0) - 0.001;
+		while (state.keepRunning()) {
+			QList<TileOwn> tiles = loader.getHgtTilesByRect(42.0, 42.0 + span, 40.0, 40.0 + std::min(span, 3.999), true);
+			if (tiles.isEmpty()) {
+				state.skipWithError("No tiles in " + dataDir);
+			}
+		}
+	}, QList<qint64>() << 1 << 2 << 3);
+
+	runner.add("BM_DoesExistHgtByRect", [](BenchmarkState& state) {
+		QTemporaryDir fixture;
+		HgtLoader loader;
+		loader.setCacheDirectory(fixture.path());
+		const double span = state.range(0) - 0.001;
+		const double maxLon = 42.0 + span;
+		const double maxLat = 40.0 + std::min(span, 3.999);
+		if (!fixture.isValid() || !makeSheetLayout(loader, 42.0, maxLon, 40.0, maxLat)) {
+			state.skipWithError("Can't create the sheet layout in " + fixture.path());
+			return;
+		}
+
+		while (state.keepRunning()) {
+			if (!loader.doesExistHgtByRect(42.0, maxLon, 40.0, maxLat, false)) {
+				state.skipWithError("doesExistHgtByRect did not find the tiles in " + fixture.path());
+				return;
+			}
+		}
+	}, QList<qint64>() << 1 << 2 << 4);
+
+	//MainWindow's profile: one tile read with HgtSheet, nearest sample per profile point
+	runner.add("BM_ProfileMainWindow", [firstTile](BenchmarkState& state) {
+		HgtSheet sheet;
+		if (!sheet.read(firstTile, GRID_SIZE_BENCHMARK, FIRST_CORNER_BENCHMARK)) {
+			state.skipWithError("Can't open " + firstTile);
+			return;
+		}
+		auto height = [&sheet](const double x, const double y) {
+			return sheet.height(x, y);
+		};
+		const QVector<ProfileWaypoint> route = makeRoute(state.range(0), 42.01, 42.99, 40.01, 40.99);
+		QVector<QPointF> pathPoints;
+		QVector<double> distances;
+		while (state.keepRunning()) {
+			RouteProfile::chartPoints(pathPoints, distances, route, height);
+		}
+		state.setItemsProcessed(state.iterations()*pathPoints.size());
+	}, QList<qint64>() << 2 << 8 << 64);
+
+	//the same profile through HgtLoader, across the tiles N40..N41 E042..E044
+	runner.add("BM_ProfileLoader", [dataDir](BenchmarkState& state) {
+		HgtLoader loader;
+		loader.setCacheDirectory(dataDir);
+		auto height = [&loader](const double x, const double y) {
+			qint16 elevation = 0;
+			loader.getElevation(elevation, x, y);
+			return double(elevation);
+		};
+		const QVector<ProfileWaypoint> route = makeRoute(state.range(0), 42.01, 44.99, 40.01, 41.99);
+		QVector<QPointF> pathPoints;
+		QVector<double> distances;
+		while (state.keepRunning()) {
+			RouteProfile::chartPoints(pathPoints, distances, route, height);
+		}
+		state.setItemsProcessed(state.iterations()*pathPoints.size());
+	}, QList<qint64>() << 2 << 8 << 64);
+}
+
+int main(int argc, char* argv[])
+{
+	QCoreApplication app(argc, argv);
+
+	QString dataDir = K38_DIR;
+	for (const QString& argument : app.arguments()) {
+		if (argument.startsWith("--data=")) {
+			dataDir = argument.section('=', 1);
+		}
+	}
+	if (!QDir(dataDir).exists()) {
+		QTextStream(stderr) << "Data directory " << dataDir << " not found, pass --data=<dir with K38 tiles>\n";
+		return 1;
+	}
+
+	BenchmarkRunner runner;
+	runner.setContext("data_dir", QDir(dataDir).absolutePath());
+	registerBenchmarks(runner, dataDir);
+	return runner.run(app.arguments());
+}
@@ -1,14 +1,24 @@
 #include "mainwindow.h"
 
 #include <QHBoxLayout>
-#include <QFile>
-#include <QDataStream>
+#include <QFormLayout>
+#include <QDialog>
+#include <QDialogButtonBox>
+#include <QDoubleSpinBox>
+#include <QMenuBar>
 #include <QtCharts/QChart>
 #include <QtCharts/QLineSeries>
 #include <QtCharts/QScatterSeries>
 #include <QtCharts/QValueAxis>
 #include <QGeoCoordinate>
 #include <algorithm>
+#include "HgtTrace.h"
+#include "RouteProfile.h"
+#ifdef HGT_TRACE
+#include <QDateTime>
+#include <QDir>
+#include <QShortcut>
+#endif
 
 using namespace QtCharts;
 
@@ -35,7 +45,20 @@ MainWindow::MainWindow(QWidget *parent)
 
     loadHGT();
 
+    createRadioMenu();
+
     updateCharts();
+
+#ifdef HGT_TRACE
+    // Ctrl+Shift+T сохраняет последние спаны в Chrome trace JSON.
+    QShortcut *traceShortcut = new QShortcut(QKeySequence("Ctrl+Shift+T"), this);
+    connect(traceShortcut, &QShortcut::activated, this, [](){
+        QString tracePath = QDir::temp().filePath(QString("hgt-trace-%1.json").arg(QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss")));
+        if (HgtTrace::dump(tracePath)) {
+            qDebug() << "Trace saved" << tracePath;
+        }
+    });
+#endif
 }
 
 MainWindow::~MainWindow()
@@ -46,104 +69,141 @@ MainWindow::~MainWindow()
     }
 }
 
-void MainWindow::loadHGT()
+void MainWindow::createRadioMenu()
 {
-    QString filePath = "E:/Qt Projects/QT-Graphic-Task/GraphicCreat/K38/N40E042.hgt";
-
-    if(!readHGT(filePath)){
-        qWarning() << "Error : HGT Loading file" << filePath;
-    }
+    QMenu *radioMenu = menuBar()->addMenu("Радиотрасса");
+
+    QAction *radioAction = radioMenu->addAction("Профиль радиотрассы");
+    radioAction->setCheckable(true);
+    radioAction->setChecked(radioMode);
+    connect(radioAction, &QAction::toggled, this, [this](bool checked){
+        radioMode = checked;
+        updateCharts();
+    });
 
+    QAction *settingsAction = radioMenu->addAction("Параметры...");
+    connect(settingsAction, &QAction::triggered, this, &MainWindow::editRadioSettings);
 }
 
-bool MainWindow::readHGT(const QString &filePath)
+void MainWindow::editRadioSettings()
 {
-    QFile file(filePath);
-    if(!file.open(QIODevice::ReadOnly)){
-        return false;
-    }
-
-    hgtData.clear();
-    hgtData.resize(gridSize);
-    for(int i = 0; i < gridSize; ++i){
-        hgtData[i].resize(gridSize);
+    QDialog dialog(this);
+    dialog.setWindowTitle("Параметры радиотрассы");
+    QFormLayout *layout = new QFormLayout(&dialog);
+
+    QDoubleSpinBox *frequencyBox = new QDoubleSpinBox(&dialog);
+    frequencyBox->setRange(1.0, 100000.0);
+    frequencyBox->setDecimals(1);
+    frequencyBox->setSuffix(" МГц");
+    frequencyBox->setValue(radioFrequencyMHz);
+    layout->addRow("Частота", frequencyBox);
+
+    QDoubleSpinBox *kFactorBox = new QDoubleSpinBox(&dialog);
+    kFactorBox->setRange(0.1, 10.0);
+    kFactorBox->setDecimals(3);
+    kFactorBox->setSingleStep(0.1);
+    kFactorBox->setValue(radioKFactor);
+    layout->addRow("k-фактор", kFactorBox);
+
+    QDoubleSpinBox *fromHeightBox = new QDoubleSpinBox(&dialog);
+    fromHeightBox->setRange(0.0, 1000.0);
+    fromHeightBox->setSuffix(" м");
+    fromHeightBox->setValue(radioFromHeight);
+    layout->addRow("Высота антенны в начале", fromHeightBox);
+
+    QDoubleSpinBox *toHeightBox = new QDoubleSpinBox(&dialog);
+    toHeightBox->setRange(0.0, 1000.0);
+    toHeightBox->setSuffix(" м");
+    toHeightBox->setValue(radioToHeight);
+    layout->addRow("Высота антенны в конце", toHeightBox);
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &dialog);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    layout->addRow(buttons);
+
+    if (dialog.exec() != QDialog::Accepted) {
+        return;
     }
 
-    QDataStream stream(&file);
-    stream.setByteOrder(QDataStream::BigEndian);;
-    for (int i = 0; i < gridSize; ++i) {
-        for (int j = 0; j < gridSize; ++j) {
-            qint16 height;
-            stream >> height;
-            hgtData[i][j] = height;
-        }
+    radioFrequencyMHz = frequencyBox->value();
+    radioKFactor = kFactorBox->value();
+    radioFromHeight = fromHeightBox->value();
+    radioToHeight = toHeightBox->value();
+    if (radioMode) {
+        updateCharts();
     }
-
-    file.close();
-    return true;
 }
 
-double MainWindow::getHGTHeight(double x, double y)
+void MainWindow::loadHGT()
 {
-    if(hgtData.isEmpty()){
-        return 0.0;
+    QString filePath = "E:/Qt Projects/QT-Graphic-Task/GraphicCreat/K38/N40E042.hgt";
+
+    if(!hgtSheet.read(filePath, gridSize, QPoint(lonStart, latStart))){
+        qWarning() << "Error : HGT Loading file" << filePath;
     }
 
-    double step = 1.0 / (gridSize - 1);
-    double iFrac = (1.0 - (y - latStart)) / step;
-    double jFrac = (x - lonStart) / step;
-    int i = qBound(0, static_cast<int>(iFrac), gridSize - 1);
-    int j = qBound(0, static_cast<int>(jFrac), gridSize - 1);
+    // Высоты HGT отсчитываются от геоида EGM96, высоты точек - от эллипсоида WGS84.
+    QString geoidPath = "E:/Qt Projects/QT-Graphic-Task/GraphicCreat/EGM96/WW15MGH.GRD";
+    if(!geoid.load(geoidPath)){
+        qWarning() << "Error : Geoid Loading file" << geoidPath;
+    }
 
-    return hgtData[i][j];
 }
 
-
 void MainWindow::createPathPoints(QVector<QPointF> &pathPoints, QVector<double> &distances, const QList<Point> &sortedList)
 {
-    pathPoints.clear();
-    distances.clear();
-
-    if(inputList.size() < 2){
-        return;
+    HGT_TRACE_SCOPE("MainWindow::createPathPoints");
+    QVector<ProfileWaypoint> waypoints;
+    for (const Point &point : sortedList) {
+        ProfileWaypoint waypoint;
+        waypoint.lon = point.x;
+        waypoint.lat = point.y;
+        waypoint.height = point.h;
+        waypoints.append(waypoint);
     }
 
-    double totalDistance = 0.0;
-    QGeoCoordinate prevCoord(sortedList[0].y, sortedList[0].x);
-
-    pathPoints.append(QPointF(0.0, sortedList[0].h));
-    distances.append(0.0);
-
-    for (int i = 1; i < sortedList.size(); ++i) {
-        QGeoCoordinate currCoord(sortedList[i].y, sortedList[i].x);
-        double segmentLenght = prevCoord.distanceTo(currCoord);
-
-        for (int j = 0; j <= 100; ++j) {
-            double t = j / 100.0;
-            double x = sortedList[i-1].x + t * (sortedList[i].x - sortedList[i-1].x);
-            double y = sortedList[i-1].y + t * (sortedList[i].y - sortedList[i-1].y);
-            double h = getHGTHeight(x,y);
-
-            double dist = totalDistance + t * segmentLenght;
-            pathPoints.append(QPointF(dist, h));
-            distances.append(dist);
-        }
-
-        totalDistance += segmentLenght;
-        pathPoints.append(QPointF(totalDistance, sortedList[i].h));
-        distances.append(totalDistance);
+    RouteProfile::chartPoints(pathPoints, distances, waypoints, [this](double x, double y){
+        return hgtSheet.height(x, y);
+    });
+}
 
-        prevCoord = currCoord;
+void MainWindow::createRadioPathPoints(RadioPathResult &radioPath, const Point &from, const Point &to)
+{
+    HGT_TRACE_SCOPE("MainWindow::createRadioPathPoints");
+    radioPath = RadioPathResult();
+    radioPath.distance.resize(radioSamples);
+    radioPath.terrain.resize(radioSamples);
+
+    double length = QGeoCoordinate(from.y, from.x).distanceTo(QGeoCoordinate(to.y, to.x));
+    for (int i = 0; i < radioSamples; ++i) {
+        double t = double(i) / (radioSamples - 1);
+        double x = from.x + t * (to.x - from.x);
+        double y = from.y + t * (to.y - from.y);
+        radioPath.distance[i] = t * length;
+        radioPath.terrain[i] = hgtSheet.height(x, y);
     }
+
+    // Антенны стоят на рельефе в крайних точках, высоты над геоидом, как у HGT.
+    RadioPathProfile::evaluate(radioPath, radioPath.terrain.first() + radioFromHeight, radioPath.terrain.last() + radioToHeight,
+                               radioFrequencyMHz, radioKFactor);
 }
 
 void MainWindow::updateCharts()
 {
+    HGT_TRACE_SCOPE("MainWindow::updateCharts");
     QList<Point> sortedList = inputList;
     std::sort(sortedList.begin(), sortedList.end(), [](const Point &a, const Point &b){
         return (a.x == b.x) ? a.y < b.y: a.x < b.x;
     });
 
+    // Переводим эллипсоидальные высоты точек в высоты над геоидом, как у HGT.
+    if (geoid.isValid()) {
+        for (Point &point : sortedList) {
+            point.h -= geoid.undulation(point.x, point.y);
+        }
+    }
+
 
     // Creath Graphic
     QChart *heightChart = new QChart();
@@ -175,7 +235,7 @@ void MainWindow::updateCharts()
         QGeoCoordinate prevCoord(sortedList[0].y, sortedList[0].x);
         pointSeries->append(0.0, sortedList[0].h);
         pointLineSeries->append(0.0, sortedList[0].h);
-        if (!hgtData.isEmpty()) {
+        if (!hgtSheet.isEmpty()) {
             for (const QPointF &pt : pathPoints) {
                 heightSeries->append(pt);
                 minH = qMin(minH, pt.y());
@@ -203,6 +263,37 @@ void MainWindow::updateCharts()
             maxDistance = totalDistance;
         }
 
+        // Радиотрасса: рельеф с поправкой на кривизну Земли, прямая видимость и 60% первой зоны Френеля.
+        if (radioMode && !hgtSheet.isEmpty()) {
+            RadioPathResult radioPath;
+            createRadioPathPoints(radioPath, sortedList.first(), sortedList.last());
+
+            heightSeries->clear();
+            pointSeries->clear();
+            pointLineSeries->clear();
+            QLineSeries *fresnelSeries = new QLineSeries();
+            fresnelSeries->setColor(Qt::red);
+            minH = qMin(radioPath.fromAltitude, radioPath.toAltitude);
+            maxH = qMax(radioPath.fromAltitude, radioPath.toAltitude);
+            for (int i = 0; i < radioPath.distance.size(); ++i) {
+                heightSeries->append(radioPath.distance[i], radioPath.terrainWithBulge[i]);
+                fresnelSeries->append(radioPath.distance[i], radioPath.lineOfSight[i] - 0.6f * radioPath.fresnelRadius[i]);
+                minH = qMin(minH, double(qMin(radioPath.terrainWithBulge[i], radioPath.lineOfSight[i] - 0.6f * radioPath.fresnelRadius[i])));
+                maxH = qMax(maxH, double(radioPath.terrainWithBulge[i]));
+            }
+            pointSeries->append(0.0, radioPath.fromAltitude);
+            pointSeries->append(radioPath.length, radioPath.toAltitude);
+            pointLineSeries->append(0.0, radioPath.fromAltitude);
+            pointLineSeries->append(radioPath.length, radioPath.toAltitude);
+            maxDistance = radioPath.length;
+
+            heightChart->addSeries(fresnelSeries);
+            heightChart->setTitle(QString("Radio path %1 MHz, k = %2, antennas %3/%4 m: %5")
+                                  .arg(radioFrequencyMHz).arg(radioKFactor, 0, 'f', 2)
+                                  .arg(radioFromHeight).arg(radioToHeight)
+                                  .arg(radioPath.isClear() ? "clear" : "obstructed"));
+        }
+
     } else if (!sortedList.isEmpty()) {
         // Если только одна точка, показываем её.
         pointSeries->append(0.0, sortedList[0].h);
@@ -212,6 +303,7 @@ void MainWindow::updateCharts()
 
 
     // Настройка осей графика высот.
+    HGT_TRACE_SCOPE("MainWindow::chartLayout");
     QValueAxis *heightAxisX = new QValueAxis();
     heightAxisX->setTitleText("Расстояние (м)");
     heightAxisX->setRange(-100, maxDistance > 0.0 ? maxDistance + 100: 110.0);
@@ -236,8 +328,18 @@ void MainWindow::updateCharts()
     pointLineSeries->attachAxis(heightAxisY);
     pointLineSeries->attachAxis(heightAxisX);
 
-    // Установка графика в chartViews[0].
+    // Остальные серии (зона Френеля в режиме радиотрассы).
+    for (QAbstractSeries *series : heightChart->series()) {
+        if (series != heightSeries && series != pointSeries && series != pointLineSeries) {
+            series->attachAxis(heightAxisX);
+            series->attachAxis(heightAxisY);
+        }
+    }
+
+    // Установка графика в chartViews[0], прежний график вид не удаляет.
+    QChart *oldChart = chartViews[0]->chart();
     chartViews[0]->setChart(heightChart);
+    delete oldChart;
 }
 
 
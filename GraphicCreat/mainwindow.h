@@ -8,6 +8,9 @@
 #include <QChartView>
 #include <QVector>
 #include "point.h"
+#include "GeoidGrid.h"
+#include "HgtSheet.h"
+#include "RadioPathProfile.h"
 #include <QtCharts>
 
 
@@ -29,19 +32,31 @@ private:
 
     //Data
     QList<Point> inputList;
-    QVector<QVector<qint16>> hgtData;
+    HgtSheet hgtSheet;
     double latStart = 40.0;
     double lonStart = 42.0;
     int gridSize = 1201;
+    Geo::GeoidGrid geoid;
+
+    // Радиотрасса между первой и последней точкой: кривизна Земли с k-фактором и первая зона Френеля.
+    // Включается в меню "Радиотрасса", там же параметры линии.
+    bool radioMode = false;
+    double radioFrequencyMHz = 7000.0;
+    double radioKFactor = 4.0 / 3.0;
+    // Высоты антенн над рельефом, м.
+    double radioFromHeight = 30.0;
+    double radioToHeight = 30.0;
+    int radioSamples = 256;
 
 
     //Metods
-    bool readHGT(const QString &filePath);
-    double getHGTHeight(double x, double y);
     void createPathPoints(QVector<QPointF> &pathPoints, QVector<double> &distances, const QList<Point> &sortedList);
+    void createRadioPathPoints(RadioPathResult &radioPath, const Point &from, const Point &to);
 
     void updateCharts();
     void loadHGT();
+    void createRadioMenu();
+    void editRadioSettings();
 
 };
 #endif // MAINWINDOW_H
@@ -0,0 +1,22 @@
+#include <QTcpSocket>
+#include "ElevationServer.h"
+#include "ElevationService.h"
+#include "HttpConnection.h"
+
+ElevationServer::ElevationServer(ElevationService* service, QObject* parent) :
+	QTcpServer(parent),
+	m_service(service)
+{
+	connect(this, &QTcpServer::newConnection, this, &ElevationServer::acceptConnections);
+}
+
+void ElevationServer::acceptConnections()
+{
+	ElevationService* service = m_service;
+	while (QTcpSocket* socket = nextPendingConnection()) {
+		//owned by the socket, deleted with it
+		new HttpConnection(socket, [service](const HttpRequest& request, const HttpConnection::Responder& respond) {
+			service->handle(request, respond);
+		});
+	}
+}
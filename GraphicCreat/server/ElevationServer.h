@@ -0,0 +1,20 @@
+#pragma once
+
+#include <QTcpServer>
+
+class ElevationService;
+
+/**
+ * @brief accepts connections and serves their requests by the ElevationService, all sockets live in the server's thread
+ */
+class ElevationServer : public QTcpServer
+{
+public:
+	explicit ElevationServer(ElevationService* service, QObject* parent = nullptr);
+
+private:
+	void acceptConnections();
+
+private:
+	ElevationService* m_service = nullptr;
+};
@@ -0,0 +1,322 @@
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <QtEndian>
+#include <cmath>
+#include "ElevationService.h"
+#include "TileBatcher.h"
+#include "HgtLoader.h"
+#include "RouteProfile.h"
+
+const int MAX_SAMPLES_SERVICE = 100001;
+
+//JSON numbers are written by hand, QJsonDocument is slow for arrays of a million values
+static void appendElevation(QByteArray& json, const float elevation)
+{
+	if (std::isnan(elevation)) {
+		json += "null";
+	} else {
+		json += QByteArray::number(qRound(elevation));
+	}
+}
+
+static void appendArray(QByteArray& json, const char* key, const QVector<ProfilePoint>& profile, double ProfilePoint::*field,
+						const int precision)
+{
+	json += '"';
+	json += key;
+	json += "\":[";
+	for (int i = 0; i < profile.size(); ++i) {
+		if (i > 0) {
+			json += ',';
+		}
+		json += QByteArray::number(profile.at(i).*field, 'f', precision);
+	}
+	json += ']';
+}
+
+ElevationService::ElevationService(HgtLoader* loader, TileBatcher* batcher, QObject* parent) :
+	QObject(parent),
+	m_loader(loader),
+	m_batcher(batcher),
+	m_threadPool(QThreadPool::globalInstance())
+{
+}
+
+void ElevationService::setThreadPool(QThreadPool* threadPool)
+{
+	m_threadPool = threadPool;
+}
+
+void ElevationService::handle(const HttpRequest& request, const HttpConnection::Responder& respond)
+{
+	const bool get = request.method == "GET";
+	const bool post = request.method == "POST";
+	if (request.path == "/elevation" && (get || post)) {
+		handleElevation(request, respond);
+	} else if (request.path == "/profile" && (get || post)) {
+		handleProfile(request, respond);
+	} else if (request.path == "/raster" && get) {
+		handleRaster(request, respond);
+	} else if (request.path == "/stats" && get) {
+		handleStats(respond);
+	} else if (request.path == "/elevation" || request.path == "/profile" || request.path == "/raster" || request.path == "/stats") {
+		respond(HttpResponse::error(405, "Method not allowed"));
+	} else {
+		respond(HttpResponse::error(404, "Unknown endpoint " + request.path));
+	}
+}
+
+bool ElevationService::parsePath(QVector<QPointF>& points, const QString& path)
+{
+	const QStringList items = path.split(';');
+	if (items.size() > MAX_POINTS_SERVICE) {
+		return false;
+	}
+	points.reserve(items.size());
+	for (const QString& item : items) {
+		//a trailing ';' is allowed
+		if (item.isEmpty()) {
+			continue;
+		}
+		const int comma = item.indexOf(',');
+		bool lonOk = false;
+		bool latOk = false;
+		const double lon = item.left(comma).toDouble(&lonOk);
+		const double lat = item.mid(comma + 1).toDouble(&latOk);
+		if (comma < 0 || !lonOk || !latOk) {
+			return false;
+		}
+		points.append(QPointF(lon, lat));
+	}
+	return !points.isEmpty();
+}
+
+bool ElevationService::parseJsonPoints(QVector<QPointF>& points, const QByteArray& body, const QString& key, QString& error)
+{
+	QJsonParseError parseError;
+	const QJsonDocument document = QJsonDocument::fromJson(body, &parseError);
+	if (parseError.error != QJsonParseError::NoError || !document.isObject()) {
+		error = "Body is not a JSON object";
+		return false;
+	}
+	const QJsonArray array = document.object().value(key).toArray();
+	if (array.isEmpty() || array.size() > MAX_POINTS_SERVICE) {
+		error = QString("\"%1\" has to be an array of 1..%2 [lon,lat] pairs").arg(key).arg(MAX_POINTS_SERVICE);
+		return false;
+	}
+	points.reserve(array.size());
+	for (const QJsonValue& value : array) {
+		const QJsonArray pair = value.toArray();
+		if (pair.size() != 2 || !pair.at(0).isDouble() || !pair.at(1).isDouble()) {
+			error = QString("\"%1\" has to be an array of [lon,lat] pairs").arg(key);
+			return false;
+		}
+		points.append(QPointF(pair.at(0).toDouble(), pair.at(1).toDouble()));
+	}
+	return true;
+}
+
+void ElevationService::handleElevation(const HttpRequest& request, const HttpConnection::Responder& respond)
+{
+	QSharedPointer<PointBatch> batch(new PointBatch);
+	bool single = false;
+	if (request.method == "POST") {
+		QString error;
+		if (!parseJsonPoints(batch->points, request.body, "points", error)) {
+			respond(HttpResponse::error(400, error));
+			return;
+		}
+	} else if (request.query.hasQueryItem("points")) {
+		if (!parsePath(batch->points, request.query.queryItemValue("points"))) {
+			respond(HttpResponse::error(400, "points has to be lon,lat;lon,lat;.."));
+			return;
+		}
+	} else {
+		bool lonOk = false;
+		bool latOk = false;
+		const double lon = request.query.queryItemValue("lon").toDouble(&lonOk);
+		const double lat = request.query.queryItemValue("lat").toDouble(&latOk);
+		if (!lonOk || !latOk) {
+			respond(HttpResponse::error(400, "lon and lat or points are required"));
+			return;
+		}
+		batch->points.append(QPointF(lon, lat));
+		single = true;
+	}
+
+	batch->done = [respond, single](const PointBatch& batch) {
+		QByteArray json;
+		if (single) {
+			json += "{\"elevation\":";
+			appendElevation(json, batch.elevations.first());
+			json += '}';
+		} else {
+			json.reserve(batch.elevations.size()*6 + 16);
+			json += "{\"elevations\":[";
+			for (int i = 0; i < batch.elevations.size(); ++i) {
+				if (i > 0) {
+					json += ',';
+				}
+				appendElevation(json, batch.elevations.at(i));
+			}
+			json += "]}";
+		}
+		respond(HttpResponse::json(json));
+	};
+	m_batcher->submit(batch);
+}
+
+void ElevationService::handleProfile(const HttpRequest& request, const HttpConnection::Responder& respond)
+{
+	QVector<QPointF> route;
+	int samples = 101;
+	if (request.method == "POST") {
+		QString error;
+		if (!parseJsonPoints(route, request.body, "route", error)) {
+			respond(HttpResponse::error(400, error));
+			return;
+		}
+		samples = QJsonDocument::fromJson(request.body).object().value("samples").toInt(samples);
+	} else {
+		if (!parsePath(route, request.query.queryItemValue("path"))) {
+			respond(HttpResponse::error(400, "path has to be lon,lat;lon,lat;.."));
+			return;
+		}
+		if (request.query.hasQueryItem("samples")) {
+			samples = request.query.queryItemValue("samples").toInt();
+		}
+	}
+	if (route.size() < 2 || samples < 2 || samples > MAX_SAMPLES_SERVICE
+			|| qint64(route.size() - 1)*(samples - 1) + 1 > MAX_POINTS_SERVICE) {
+		respond(HttpResponse::error(400, QString("A route of at least 2 points, samples 2..%1 and at most %2 samples in total")
+											 .arg(MAX_SAMPLES_SERVICE).arg(MAX_POINTS_SERVICE)));
+		return;
+	}
+
+	QSharedPointer<QVector<ProfilePoint>> profile(new QVector<ProfilePoint>);
+	RouteProfile::samplePoints(*profile, route, samples);
+
+	QSharedPointer<PointBatch> batch(new PointBatch);
+	batch->points.reserve(profile->size());
+	for (const ProfilePoint& point : *profile) {
+		batch->points.append(QPointF(point.lon, point.lat));
+	}
+	batch->done = [respond, profile](const PointBatch& batch) {
+		QByteArray json;
+		json.reserve(profile->size()*48 + 64);
+		json += '{';
+		appendArray(json, "distance", *profile, &ProfilePoint::distance, 2);
+		json += ',';
+		appendArray(json, "lon", *profile, &ProfilePoint::lon, 7);
+		json += ',';
+		appendArray(json, "lat", *profile, &ProfilePoint::lat, 7);
+		json += ",\"elevation\":[";
+		for (int i = 0; i < batch.elevations.size(); ++i) {
+			if (i > 0) {
+				json += ',';
+			}
+			appendElevation(json, batch.elevations.at(i));
+		}
+		json += "]}";
+		respond(HttpResponse::json(json));
+	};
+	m_batcher->submit(batch);
+}
+
+void ElevationService::handleRaster(const HttpRequest& request, const HttpConnection::Responder& respond)
+{
+	const char* keys[] = {"minLon", "maxLon", "minLat", "maxLat", "step"};
+	double values[5];
+	for (int i = 0; i < 5; ++i) {
+		bool ok = false;
+		values[i] = request.query.queryItemValue(keys[i]).toDouble(&ok);
+		if (!ok) {
+			respond(HttpResponse::error(400, "minLon, maxLon, minLat, maxLat and step are required"));
+			return;
+		}
+	}
+	const double minLon = values[0], maxLon = values[1], minLat = values[2], maxLat = values[3], step = values[4];
+
+	int cols = 0;
+	int rows = 0;
+	if (!HgtLoader::rasterSize(cols, rows, minLon, maxLon, minLat, maxLat, step)) {
+		respond(HttpResponse::error(400, "Bad raster rectangle or step"));
+		return;
+	}
+	if (qint64(cols)*rows > MAX_RASTER_CELLS_SERVICE) {
+		respond(HttpResponse::error(413, QString("Raster of %1x%2 exceeds %3 samples").arg(cols).arg(rows).arg(MAX_RASTER_CELLS_SERVICE)));
+		return;
+	}
+	const bool json = request.query.queryItemValue("format") == "json";
+
+	//extraction runs on the pool, the answer is sent from the connection's thread
+	HgtLoader* loader = m_loader;
+	QtConcurrent::run(m_threadPool, [this, loader, respond, json, cols, rows, minLon, maxLon, minLat, maxLat, step]() {
+		QVector<qint16> raster(cols*rows);
+		HttpResponse response;
+		if (!loader->extractRaster(raster.data(), raster.size(), minLon, maxLon, minLat, maxLat, step)) {
+			response = HttpResponse::error(500, "Raster extraction failed");
+		} else if (json) {
+			QByteArray body;
+			body.reserve(raster.size()*6 + 64);
+			body += "{\"cols\":" + QByteArray::number(cols) + ",\"rows\":" + QByteArray::number(rows) + ",\"values\":[";
+			for (int i = 0; i < raster.size(); ++i) {
+				if (i > 0) {
+					body += ',';
+				}
+				if (raster.at(i) == ERROR_ELEVATION_SRTM_HGT) {
+					body += "null";
+				} else {
+					body += QByteArray::number(raster.at(i));
+				}
+			}
+			body += "]}";
+			response = HttpResponse::json(body);
+		} else {
+			response.contentType = "application/octet-stream";
+			response.body.resize(raster.size()*int(sizeof(qint16)));
+			uchar* bytes = reinterpret_cast<uchar*>(response.body.data());
+			for (int i = 0; i < raster.size(); ++i) {
+				qToLittleEndian(raster.at(i), bytes + i*sizeof(qint16));
+			}
+			response.headers.append(qMakePair(QByteArray("X-Raster-Cols"), QByteArray::number(cols)));
+			response.headers.append(qMakePair(QByteArray("X-Raster-Rows"), QByteArray::number(rows)));
+			response.headers.append(qMakePair(QByteArray("X-Raster-Void"), QByteArray::number(ERROR_ELEVATION_SRTM_HGT)));
+		}
+		QMetaObject::invokeMethod(this, [respond, response]() {
+			respond(response);
+		}, Qt::QueuedConnection);
+	});
+}
+
+void ElevationService::handleStats(const HttpConnection::Responder& respond)
+{
+	const HgtStatsSnapshot stats = m_loader->stats();
+	const TileBatcherCounters counters = m_batcher->counters();
+
+	QJsonObject cache;
+	cache["hits"] = double(stats.hits);
+	cache["misses"] = double(stats.misses);
+	cache["evictions"] = double(stats.evictions);
+	cache["mappedBytes"] = double(stats.mappedBytes);
+	cache["openFiles"] = stats.openFiles;
+	cache["maxTiles"] = m_loader->maxTilesInRam();
+	cache["lockWaitMeanNs"] = stats.lockWaitMeanNs;
+	cache["lockWaitP99Ns"] = stats.lockWaitP99Ns;
+	cache["threads"] = stats.threads;
+
+	QJsonObject batching;
+	batching["batches"] = double(counters.batches);
+	batching["points"] = double(counters.points);
+	batching["tileJobs"] = double(counters.tileJobs);
+	batching["flushes"] = double(counters.flushes);
+
+	QJsonObject root;
+	root["cache"] = cache;
+	root["batching"] = batching;
+	respond(HttpResponse::json(QJsonDocument(root).toJson(QJsonDocument::Compact)));
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <QObject>
+#include <QVector>
+#include <QPointF>
+#include "HttpConnection.h"
+
+class HgtLoader;
+class TileBatcher;
+class QThreadPool;
+
+/**
+ * @brief HTTP endpoints over one shared HgtLoader, answers are JSON, elevations of voids are null:
+ *  GET  /elevation?lon=..&lat=..                       {"elevation":e}
+ *  GET  /elevation?points=lon,lat;lon,lat;..           {"elevations":[..]}
+ *  POST /elevation {"points":[[lon,lat],..]}           {"elevations":[..]}
+ *  GET  /profile?path=lon,lat;..&samples=101           {"distance":[..],"lon":[..],"lat":[..],"elevation":[..]}
+ *  POST /profile {"route":[[lon,lat],..],"samples":101}
+ *  GET  /raster?minLon=..&maxLon=..&minLat=..&maxLat=..&step=..[&format=json]
+ *       int16 little endian rows from north to south (X-Raster-Cols, X-Raster-Rows), or {"cols","rows","values"}
+ *  GET  /stats                                         tile cache and batching counters
+ * Points and profiles go through the TileBatcher, rasters run on the thread pool.
+ * Has to live in the thread of the connections.
+ */
+class ElevationService : public QObject
+{
+public:
+	ElevationService(HgtLoader* loader, TileBatcher* batcher, QObject* parent = nullptr);
+
+	//default is QThreadPool::globalInstance()
+	void setThreadPool(QThreadPool* threadPool);
+
+	void handle(const HttpRequest& request, const HttpConnection::Responder& respond);
+
+	static const int MAX_POINTS_SERVICE = 1 << 20;
+	static const qint64 MAX_RASTER_CELLS_SERVICE = 1 << 22;
+
+private:
+	void handleElevation(const HttpRequest& request, const HttpConnection::Responder& respond);
+	void handleProfile(const HttpRequest& request, const HttpConnection::Responder& respond);
+	void handleRaster(const HttpRequest& request, const HttpConnection::Responder& respond);
+	void handleStats(const HttpConnection::Responder& respond);
+
+	//"lon,lat;lon,lat"
+	static bool parsePath(QVector<QPointF>& points, const QString& path);
+	//[[lon,lat],..] under the key of a JSON object
+	static bool parseJsonPoints(QVector<QPointF>& points, const QByteArray& body, const QString& key, QString& error);
+
+private:
+	HgtLoader* m_loader = nullptr;
+	TileBatcher* m_batcher = nullptr;
+	QThreadPool* m_threadPool = nullptr;
+};
@@ -0,0 +1,143 @@
+#include <QTcpSocket>
+#include <QPointer>
+#include <QUrl>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include "HttpConnection.h"
+
+static QByteArray statusText(const int status)
+{
+	switch (status) {
+	case 200: return "OK";
+	case 400: return "Bad Request";
+	case 404: return "Not Found";
+	case 405: return "Method Not Allowed";
+	case 413: return "Payload Too Large";
+	case 431: return "Request Header Fields Too Large";
+	case 503: return "Service Unavailable";
+	default: return status >= 500 ? "Internal Server Error" : "Error";
+	}
+}
+
+HttpResponse HttpResponse::json(const QByteArray& body, const int status)
+{
+	HttpResponse retVal;
+	retVal.status = status;
+	retVal.body = body;
+	return retVal;
+}
+
+HttpResponse HttpResponse::error(const int status, const QString& message)
+{
+	QJsonObject object;
+	object["error"] = message;
+	return json(QJsonDocument(object).toJson(QJsonDocument::Compact), status);
+}
+
+HttpConnection::HttpConnection(QTcpSocket* socket, const Handler& handler) :
+	QObject(socket),
+	m_socket(socket),
+	m_handler(handler)
+{
+	connect(m_socket, &QTcpSocket::readyRead, this, [this]() {
+		readRequests();
+	});
+	connect(m_socket, &QTcpSocket::disconnected, m_socket, &QObject::deleteLater);
+}
+
+void HttpConnection::readRequests()
+{
+	m_buffer += m_socket->readAll();
+	if (m_busy) {
+		return;
+	}
+
+	HttpRequest request;
+	HttpResponse error;
+	if (!parseRequest(request, error)) {
+		if (error.status != 200) {
+			write(error, false);
+		}
+		return;
+	}
+
+	m_busy = true;
+	QPointer<HttpConnection> self(this);
+	const bool keepAlive = request.keepAlive;
+	m_handler(request, [self, keepAlive](const HttpResponse& response) {
+		//the client may have gone meanwhile
+		if (!self) {
+			return;
+		}
+		self->write(response, keepAlive);
+		self->m_busy = false;
+		if (keepAlive && !self->m_buffer.isEmpty()) {
+			self->readRequests();
+		}
+	});
+}
+
+bool HttpConnection::parseRequest(HttpRequest& request, HttpResponse& error)
+{
+	const int headerEnd = m_buffer.indexOf("\r\n\r\n");
+	if (headerEnd < 0) {
+		if (m_buffer.size() > MAX_HEADER_SIZE) {
+			error = HttpResponse::error(431, "Request header too large");
+		}
+		return false;
+	}
+
+	const QList<QByteArray> lines = m_buffer.left(headerEnd).split('\n');
+	const QList<QByteArray> requestLine = lines.first().trimmed().split(' ');
+	if (requestLine.size() != 3 || !requestLine.at(2).startsWith("HTTP/1.")) {
+		error = HttpResponse::error(400, "Malformed request line");
+		return false;
+	}
+
+	for (int i = 1; i < lines.size(); ++i) {
+		const int colon = lines.at(i).indexOf(':');
+		if (colon > 0) {
+			request.headers.insert(lines.at(i).left(colon).trimmed().toLower(), lines.at(i).mid(colon + 1).trimmed());
+		}
+	}
+
+	bool ok = true;
+	const qint64 contentLength = request.headers.value("content-length", "0").toLongLong(&ok);
+	if (!ok || contentLength < 0 || contentLength > MAX_BODY_SIZE) {
+		error = HttpResponse::error(413, "Bad or too large Content-Length");
+		return false;
+	}
+	const qint64 requestSize = headerEnd + 4 + contentLength;
+	if (m_buffer.size() < requestSize) {
+		return false;
+	}
+
+	request.method = requestLine.at(0);
+	const QUrl url(QString::fromUtf8(requestLine.at(1)));
+	request.path = url.path();
+	request.query = QUrlQuery(url);
+	request.body = m_buffer.mid(headerEnd + 4, int(contentLength));
+	const QByteArray connection = request.headers.value("connection").toLower();
+	request.keepAlive = requestLine.at(2) == "HTTP/1.1" ? connection != "close" : connection == "keep-alive";
+
+	m_buffer.remove(0, int(requestSize));
+	return true;
+}
+
+void HttpConnection::write(const HttpResponse& response, const bool keepAlive)
+{
+	QByteArray header;
+	header += "HTTP/1.1 " + QByteArray::number(response.status) + ' ' + statusText(response.status) + "\r\n";
+	header += "Content-Type: " + response.contentType + "\r\n";
+	header += "Content-Length: " + QByteArray::number(response.body.size()) + "\r\n";
+	for (const auto& item : response.headers) {
+		header += item.first + ": " + item.second + "\r\n";
+	}
+	header += keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+
+	m_socket->write(header);
+	m_socket->write(response.body);
+	if (!keepAlive) {
+		m_socket->disconnectFromHost();
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <QObject>
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QUrlQuery>
+#include <functional>
+
+class QTcpSocket;
+
+struct HttpRequest {
+	QByteArray method;
+	QString path;
+	QUrlQuery query;
+	//header names in lower case
+	QHash<QByteArray, QByteArray> headers;
+	QByteArray body;
+	bool keepAlive = true;
+};
+
+struct HttpResponse {
+	int status = 200;
+	QByteArray contentType = "application/json";
+	QByteArray body;
+	QList<QPair<QByteArray, QByteArray>> headers;
+
+	static HttpResponse json(const QByteArray& body, const int status = 200);
+	static HttpResponse error(const int status, const QString& message);
+};
+
+/**
+ * @brief minimal HTTP/1.1 server side of one socket: parses requests (Content-Length bodies, no chunked
+ * encoding), hands them to the handler one at a time and keeps the connection alive between them.
+ * The handler may answer later through the responder, also after the connection was closed.
+ */
+class HttpConnection : public QObject
+{
+public:
+	typedef std::function<void(const HttpResponse&)> Responder;
+	typedef std::function<void(const HttpRequest&, const Responder&)> Handler;
+
+	HttpConnection(QTcpSocket* socket, const Handler& handler);
+
+	static const int MAX_HEADER_SIZE = 64*1024;
+	static const qint64 MAX_BODY_SIZE = 64*1024*1024;
+
+private:
+	void readRequests();
+	//false if the buffer does not hold a complete request yet
+	bool parseRequest(HttpRequest& request, HttpResponse& error);
+	void write(const HttpResponse& response, const bool keepAlive);
+
+private:
+	QTcpSocket* m_socket = nullptr;
+	Handler m_handler;
+	QByteArray m_buffer;
+	//a request is with the handler, the next one waits in m_buffer
+	bool m_busy = false;
+};
@@ -0,0 +1,129 @@
+#include <QThreadPool>
+#include <QTimer>
+#include <QtConcurrent>
+#include <QtMath>
+#include <limits>
+#include "TileBatcher.h"
+#include "HgtLoader.h"
+#include "Geo/GeoConstants.h"
+
+static inline qint64 tileKey(const double lon, const double lat)
+{
+	return qint64(qFloor(lat)) << 32 | quint32(qFloor(lon));
+}
+
+TileBatcher::TileBatcher(HgtLoader* loader, QObject* parent) :
+	QObject(parent),
+	m_loader(loader),
+	m_threadPool(QThreadPool::globalInstance())
+{
+	m_timer = new QTimer(this);
+	m_timer->setSingleShot(true);
+	m_timer->setInterval(2);
+	connect(m_timer, &QTimer::timeout, this, [this]() {
+		flush();
+	});
+}
+
+void TileBatcher::setThreadPool(QThreadPool* threadPool)
+{
+	m_threadPool = threadPool ? threadPool : QThreadPool::globalInstance();
+}
+
+void TileBatcher::setWindow(const int msec)
+{
+	m_timer->setInterval(std::max(0, msec));
+}
+
+void TileBatcher::setMaxPending(const int points)
+{
+	m_maxPending = std::max(1, points);
+}
+
+void TileBatcher::submit(const QSharedPointer<PointBatch>& batch)
+{
+	++m_counters.batches;
+	m_counters.points += batch->points.size();
+
+	batch->elevations.fill(std::numeric_limits<float>::quiet_NaN(), batch->points.size());
+	//jobs write through raw pointers, the vector must not detach later
+	float* out = batch->elevations.data();
+
+	int queued = 0;
+	for (int i = 0; i < batch->points.size(); ++i) {
+		const QPointF& point = batch->points.at(i);
+		if (!(point.x() >= Geo::Constants::GEO_MIN_LON && point.x() <= Geo::Constants::GEO_MAX_LON) ||
+			!(point.y() >= Geo::Constants::GEO_MIN_LAT && point.y() <= Geo::Constants::GEO_MAX_LAT)) {
+			continue;
+		}
+		m_pending[tileKey(point.x(), point.y())].append(Lookup{batch, out + i, point.x(), point.y()});
+		++queued;
+	}
+
+	if (queued == 0) {
+		finish(batch);
+		return;
+	}
+	batch->remaining.storeRelease(queued);
+	m_pendingPoints += queued;
+
+	if (m_pendingPoints >= m_maxPending) {
+		flush();
+	} else if (!m_timer->isActive()) {
+		m_timer->start();
+	}
+}
+
+void TileBatcher::flush()
+{
+	m_timer->stop();
+	if (m_pending.isEmpty()) {
+		return;
+	}
+	++m_counters.flushes;
+
+	for (auto it = m_pending.begin(); it != m_pending.end(); ++it) {
+		++m_counters.tileJobs;
+		QVector<Lookup> lookups = it.value();
+		QtConcurrent::run(m_threadPool, [this, lookups]() {
+			TileHandle tile;
+			const Lookup& first = lookups.first();
+			if (m_loader->getTileHandle(tile, first.lon, first.lat)) {
+				m_loader->visitTileView(tile, [&lookups](const auto& view) {
+					for (const Lookup& lookup : lookups) {
+						qint16 elevation = 0;
+						if (view.getElevation(elevation, lookup.lon, lookup.lat) && elevation != ERROR_ELEVATION_SRTM_HGT) {
+							*lookup.out = elevation;
+						}
+					}
+				});
+			}
+
+			//lookups of one request are consecutive, one atomic decrement per run
+			int i = 0;
+			while (i < lookups.size()) {
+				const QSharedPointer<PointBatch>& batch = lookups.at(i).batch;
+				int count = 0;
+				while (i < lookups.size() && lookups.at(i).batch == batch) {
+					++count;
+					++i;
+				}
+				if (batch->remaining.fetchAndAddOrdered(-count) == count) {
+					QSharedPointer<PointBatch> finished = batch;
+					QMetaObject::invokeMethod(this, [this, finished]() {
+						finish(finished);
+					}, Qt::QueuedConnection);
+				}
+			}
+		});
+	}
+	m_pending.clear();
+	m_pendingPoints = 0;
+}
+
+void TileBatcher::finish(const QSharedPointer<PointBatch>& batch)
+{
+	if (batch->done) {
+		batch->done(*batch);
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <QObject>
+#include <QHash>
+#include <QVector>
+#include <QPointF>
+#include <QAtomicInt>
+#include <QSharedPointer>
+#include <functional>
+
+class HgtLoader;
+class QThreadPool;
+class QTimer;
+
+/**
+ * @brief points of one request, elevations are NaN for voids and missing tiles
+ */
+struct PointBatch {
+	//x - lon, y - lat
+	QVector<QPointF> points;
+	QVector<float> elevations;
+	//called on the batcher's thread when all elevations are known
+	std::function<void(const PointBatch&)> done;
+
+	QAtomicInt remaining;
+};
+
+struct TileBatcherCounters {
+	quint64 batches = 0;
+	quint64 points = 0;
+	//one job reads one tile for all requests that were waiting for it
+	quint64 tileJobs = 0;
+	quint64 flushes = 0;
+};
+
+/**
+ * @brief coalesces the point lookups of concurrent requests by tile. Lookups wait up to the window
+ * (or until maxPending points are waiting), then every tile with waiting points becomes one job on the
+ * thread pool: one TileHandle, one TileView dispatch and a tight loop over the points of all requests.
+ * All methods have to be called from the batcher's thread.
+ */
+class TileBatcher : public QObject
+{
+public:
+	explicit TileBatcher(HgtLoader* loader, QObject* parent = nullptr);
+
+	//default is QThreadPool::globalInstance()
+	void setThreadPool(QThreadPool* threadPool);
+	void setWindow(const int msec);
+	void setMaxPending(const int points);
+
+	void submit(const QSharedPointer<PointBatch>& batch);
+	//starts the jobs of all waiting points
+	void flush();
+
+	TileBatcherCounters counters() const {return m_counters;}
+
+private:
+	struct Lookup {
+		QSharedPointer<PointBatch> batch;
+		float* out;
+		double lon;
+		double lat;
+	};
+
+	void finish(const QSharedPointer<PointBatch>& batch);
+
+private:
+	HgtLoader* m_loader = nullptr;
+	QThreadPool* m_threadPool = nullptr;
+	QTimer* m_timer = nullptr;
+	int m_maxPending = 65536;
+	int m_pendingPoints = 0;
+	QHash<qint64, QVector<Lookup>> m_pending;
+	TileBatcherCounters m_counters;
+};
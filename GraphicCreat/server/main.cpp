@@ -0,0 +1,69 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QHostAddress>
+#include <QTextStream>
+#include <QThreadPool>
+#include "HgtLoader.h"
+#include "TileBatcher.h"
+#include "ElevationService.h"
+#include "ElevationServer.h"
+
+int main(int argc, char* argv[])
+{
+	QCoreApplication app(argc, argv);
+	QCoreApplication::setApplicationName("hgt_server");
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("HTTP elevation service over .hgt tiles, see ElevationService for the endpoints.");
+	parser.addHelpOption();
+	QCommandLineOption dataOption("data", "Directory of the .hgt tiles.", "dir");
+	QCommandLineOption portOption("port", "TCP port.", "port", "8080");
+	QCommandLineOption addressOption("address", "Address to listen on.", "address", "127.0.0.1");
+	QCommandLineOption threadsOption("threads", "Worker threads, 0 - all cores.", "count", "0");
+	QCommandLineOption tilesOption("tiles", "Tiles kept mapped by the shared loader.", "count", "256");
+	QCommandLineOption windowOption("window", "Milliseconds lookups wait for other requests of the same tiles.", "msec", "2");
+	QCommandLineOption sharedOption("shared-memory", "Share the decoded tiles with the other processes on this host.");
+	parser.addOption(dataOption);
+	parser.addOption(portOption);
+	parser.addOption(addressOption);
+	parser.addOption(threadsOption);
+	parser.addOption(tilesOption);
+	parser.addOption(windowOption);
+	parser.addOption(sharedOption);
+	parser.process(app);
+
+	QTextStream log(stderr);
+	if (!parser.isSet(dataOption) || !QDir(parser.value(dataOption)).exists()) {
+		log << "--data with an existing directory is required\n" << parser.helpText();
+		return 2;
+	}
+
+	const int threads = parser.value(threadsOption).toInt();
+	if (threads > 0) {
+		QThreadPool::globalInstance()->setMaxThreadCount(threads);
+	}
+
+	//one loader and one tile cache for all connections
+	HgtLoader loader;
+	loader.setCacheDirectory(parser.value(dataOption));
+	loader.setMaxTilesInRam(std::max(1, parser.value(tilesOption).toInt()));
+	if (parser.isSet(sharedOption)) {
+		loader.setSharedMemoryCache(true);
+	}
+
+	TileBatcher batcher(&loader);
+	batcher.setWindow(std::max(0, parser.value(windowOption).toInt()));
+	ElevationService service(&loader, &batcher);
+	ElevationServer server(&service);
+
+	const QHostAddress address(parser.value(addressOption));
+	const quint16 port = quint16(parser.value(portOption).toUInt());
+	if (!server.listen(address, port)) {
+		log << "Can't listen on " << address.toString() << ":" << port << ": " << server.errorString() << "\n";
+		return 1;
+	}
+	log << "listening on " << address.toString() << ":" << server.serverPort() << "\n";
+	log.flush();
+	return app.exec();
+}
@@ -0,0 +1,24 @@
+# HTTP elevation service over one shared tile cache, no GUI:
+#   hgt_server --data=<dir with .hgt tiles> [--port=8080] [--tiles=256] [--window=2]
+
+QT = core network concurrent
+
+CONFIG += console c++17
+CONFIG -= app_bundle
+
+TARGET = hgt_server
+
+include(../Hgt/Hgt.pri)
+
+HEADERS += \
+    TileBatcher.h \
+    HttpConnection.h \
+    ElevationService.h \
+    ElevationServer.h
+
+SOURCES += \
+    TileBatcher.cpp \
+    HttpConnection.cpp \
+    ElevationService.cpp \
+    ElevationServer.cpp \
+    main.cpp